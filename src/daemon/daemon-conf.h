@@ -130,10 +130,14 @@ typedef struct pa_daemon_conf {
     unsigned default_n_fragments, default_fragment_size_msec;
     unsigned deferred_volume_safety_margin_usec;
     int deferred_volume_extra_delay_usec;
+    unsigned subscription_coalesce_msec;
+    unsigned volume_ramp_msec;
+    pa_volume_ramp_type_t volume_ramp_type;
     pa_sample_spec default_sample_spec;
     uint32_t alternate_sample_rate;
     pa_channel_map default_channel_map;
     size_t shm_size;
+    size_t scache_converted_size;
 } pa_daemon_conf;
 
 /* Allocate a new structure and fill it with sane defaults */
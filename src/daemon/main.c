@@ -65,6 +65,7 @@
 #include <pulse/mainloop.h>
 #include <pulse/mainloop-signal.h>
 #include <pulse/timeval.h>
+#include <pulse/rtclock.h>
 #include <pulse/xmalloc.h>
 
 #include <pulsecore/i18n.h>
@@ -340,6 +341,40 @@ static void set_all_rlimits(const pa_daemon_conf *conf) {
 }
 #endif
 
+#define STARTUP_SLOWEST_MODULES 5
+
+/* Logs how long running the startup script took and which modules
+ * were the slowest to load */
+static void log_startup_time(pa_core *c, pa_usec_t usec) {
+    pa_module *slowest[STARTUP_SLOWEST_MODULES], *m;
+    unsigned n = 0, i;
+    uint32_t idx;
+
+    pa_log_info("Startup script executed in %0.1f ms.", (double) usec / PA_USEC_PER_MSEC);
+
+    PA_IDXSET_FOREACH(m, c->modules, idx) {
+
+        if (n < STARTUP_SLOWEST_MODULES)
+            i = n++;
+        else if (m->open_usec + m->init_usec > slowest[n-1]->open_usec + slowest[n-1]->init_usec)
+            i = n - 1;
+        else
+            continue;
+
+        for (; i > 0 && slowest[i-1]->open_usec + slowest[i-1]->init_usec < m->open_usec + m->init_usec; i--)
+            slowest[i] = slowest[i-1];
+
+        slowest[i] = m;
+    }
+
+    for (i = 0; i < n; i++)
+        pa_log_info("Slowest modules: #%u %s took %0.1f ms (open %0.1f ms, init %0.1f ms).",
+                    slowest[i]->index, slowest[i]->name,
+                    (double) (slowest[i]->open_usec + slowest[i]->init_usec) / PA_USEC_PER_MSEC,
+                    (double) slowest[i]->open_usec / PA_USEC_PER_MSEC,
+                    (double) slowest[i]->init_usec / PA_USEC_PER_MSEC);
+}
+
 static char *check_configured_address(void) {
     char *default_server = NULL;
     pa_client_conf *c = pa_client_conf_new();
@@ -1019,8 +1054,12 @@ int main(int argc, char *argv[]) {
     c->default_fragment_size_msec = conf->default_fragment_size_msec;
     c->deferred_volume_safety_margin_usec = conf->deferred_volume_safety_margin_usec;
     c->deferred_volume_extra_delay_usec = conf->deferred_volume_extra_delay_usec;
+    c->subscription_coalesce_usec = (pa_usec_t) conf->subscription_coalesce_msec * PA_USEC_PER_MSEC;
+    c->volume_ramp_usec = (pa_usec_t) conf->volume_ramp_msec * PA_USEC_PER_MSEC;
+    c->volume_ramp_type = conf->volume_ramp_type;
     c->exit_idle_time = conf->exit_idle_time;
     c->scache_idle_time = conf->scache_idle_time;
+    c->scache_converted_size_max = conf->scache_converted_size;
     c->resample_method = conf->resample_method;
     c->realtime_priority = conf->realtime_priority;
     c->realtime_scheduling = !!conf->realtime_scheduling;
@@ -1068,6 +1107,8 @@ int main(int argc, char *argv[]) {
 #ifdef HAVE_DBUS
     if (start_server) {
 #endif
+        pa_usec_t startup_begin = pa_rtclock_now();
+
         if (conf->load_default_script_file) {
             FILE *f;
 
@@ -1080,6 +1121,8 @@ int main(int argc, char *argv[]) {
         if (r >= 0)
             r = pa_cli_command_execute(c, conf->script_commands, buf, &conf->fail);
 
+        log_startup_time(c, pa_rtclock_now() - startup_begin);
+
         pa_log_error("%s", s = pa_strbuf_tostring_free(buf));
         pa_xfree(s);
 
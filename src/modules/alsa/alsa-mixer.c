@@ -25,6 +25,9 @@
 #endif
 
 #include <sys/types.h>
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
 #include <asoundlib.h>
 #include <math.h>
 
@@ -40,6 +43,7 @@
 #include <pulse/xmalloc.h>
 #include <pulse/utf8.h>
 
+#include <pulsecore/core-error.h>
 #include <pulsecore/i18n.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
@@ -535,6 +539,7 @@ static void element_free(pa_alsa_element *e) {
     if (e->db_fix)
         decibel_fix_free(e->db_fix);
 
+    pa_xfree(e->volume_dB);
     pa_xfree(e->alsa_name);
     pa_xfree(e);
 }
@@ -566,6 +571,7 @@ void pa_alsa_path_set_free(pa_alsa_path_set *ps) {
     if (ps->paths)
         pa_hashmap_free(ps->paths, NULL, NULL);
 
+    pa_xfree(ps->mixer_device);
     pa_xfree(ps);
 }
 
@@ -595,9 +601,93 @@ static pa_volume_t from_alsa_volume(long v, long min, long max) {
         snd_mixer_selem_id_set_index((sid), 0);         \
     } while(FALSE)
 
-static int element_get_volume(pa_alsa_element *e, snd_mixer_t *m, const pa_channel_map *cm, pa_cvolume *v) {
+/* The elements of the path that was last selected on a mixer keep their
+ * handle for that mixer, so that the volume and mute calls don't have to
+ * look them up by name every time. Paths may be shared by the sinks and
+ * sources of a card, each with a mixer of its own and possibly running
+ * in their IO threads, hence the handle is only used if e->mixer matches
+ * both before and after reading it. */
+static snd_mixer_elem_t *element_get_handle(pa_alsa_element *e, snd_mixer_t *m) {
     snd_mixer_selem_id_t *sid;
     snd_mixer_elem_t *me;
+
+    if (pa_atomic_ptr_load(&e->mixer) == m) {
+        me = e->handle;
+
+        if (pa_atomic_ptr_load(&e->mixer) == m)
+            return me;
+    }
+
+    SELEM_INIT(sid, e->alsa_name);
+    if (!(me = snd_mixer_find_selem(m, sid)))
+        pa_log_warn("Element %s seems to have disappeared.", e->alsa_name);
+
+    return me;
+}
+
+static void element_cache_handle(pa_alsa_element *e, snd_mixer_t *m) {
+    snd_mixer_selem_id_t *sid;
+
+    pa_atomic_ptr_store(&e->mixer, NULL);
+
+    SELEM_INIT(sid, e->alsa_name);
+    if (!(e->handle = snd_mixer_find_selem(m, sid)))
+        return;
+
+    pa_atomic_ptr_store(&e->mixer, m);
+}
+
+/* Returns the step for *db_value from a table of the dB values of n
+ * steps starting at first, and replaces *db_value with the dB value of
+ * that step. The table must be sorted. Rounding is -1 for rounding
+ * down, +1 for rounding up and 0 for the nearest step. */
+static long dB_table_get_step(const long *table, long first, long n, long *db_value, int rounding) {
+    long lo = 0, hi = n, up, down;
+
+    pa_assert(table);
+    pa_assert(n > 0);
+    pa_assert(db_value);
+
+    /* Find the first step that is not below the value */
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+
+        if (table[mid] < *db_value)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    up = PA_MIN(lo, n - 1);
+    down = lo < n && table[lo] == *db_value ? lo : PA_MAX(lo - 1, 0);
+
+    if (rounding > 0)
+        lo = up;
+    else if (rounding < 0)
+        lo = down;
+    else
+        lo = labs(table[up] - *db_value) < labs(table[down] - *db_value) ? up : down;
+
+    *db_value = table[lo];
+    return first + lo;
+}
+
+static int element_get_alsa_volume(pa_alsa_element *e, snd_mixer_elem_t *me, snd_mixer_selem_channel_id_t c, long *value) {
+    if (e->direction == PA_ALSA_DIRECTION_OUTPUT)
+        return snd_mixer_selem_get_playback_volume(me, c, value);
+    else
+        return snd_mixer_selem_get_capture_volume(me, c, value);
+}
+
+static int element_set_alsa_volume(pa_alsa_element *e, snd_mixer_elem_t *me, snd_mixer_selem_channel_id_t c, long value) {
+    if (e->direction == PA_ALSA_DIRECTION_OUTPUT)
+        return snd_mixer_selem_set_playback_volume(me, c, value);
+    else
+        return snd_mixer_selem_set_capture_volume(me, c, value);
+}
+
+static int element_get_volume(pa_alsa_element *e, snd_mixer_t *m, const pa_channel_map *cm, pa_cvolume *v) {
+    snd_mixer_elem_t *me;
     snd_mixer_selem_channel_id_t c;
     pa_channel_position_mask_t mask = 0;
     unsigned k;
@@ -607,11 +697,8 @@ static int element_get_volume(pa_alsa_element *e, snd_mixer_t *m, const pa_chann
     pa_assert(cm);
     pa_assert(v);
 
-    SELEM_INIT(sid, e->alsa_name);
-    if (!(me = snd_mixer_find_selem(m, sid))) {
-        pa_log_warn("Element %s seems to have disappeared.", e->alsa_name);
+    if (!(me = element_get_handle(e, m)))
         return -1;
-    }
 
     pa_cvolume_mute(v, cm->channels);
 
@@ -619,68 +706,53 @@ static int element_get_volume(pa_alsa_element *e, snd_mixer_t *m, const pa_chann
 
     for (c = 0; c <= SND_MIXER_SCHN_LAST; c++) {
         int r;
+        long value = 0;
         pa_volume_t f;
 
+        if (!(e->alsa_channels & (1U << c)))
+            continue;
+
         if (e->has_dB) {
-            long value = 0;
-
-            if (e->direction == PA_ALSA_DIRECTION_OUTPUT) {
-                if (snd_mixer_selem_has_playback_channel(me, c)) {
-                    if (e->db_fix) {
-                        if ((r = snd_mixer_selem_get_playback_volume(me, c, &value)) >= 0) {
-                            /* If the channel volume is outside the limits set
-                             * by the dB fix, we clamp the hw volume to be
-                             * within the limits. */
-                            if (value < e->db_fix->min_step) {
-                                value = e->db_fix->min_step;
-                                snd_mixer_selem_set_playback_volume(me, c, value);
-                                pa_log_debug("Playback volume for element %s channel %i was below the dB fix limit. "
-                                             "Volume reset to %0.2f dB.", e->alsa_name, c,
-                                             e->db_fix->db_values[value - e->db_fix->min_step] / 100.0);
-                            } else if (value > e->db_fix->max_step) {
-                                value = e->db_fix->max_step;
-                                snd_mixer_selem_set_playback_volume(me, c, value);
-                                pa_log_debug("Playback volume for element %s channel %i was over the dB fix limit. "
-                                             "Volume reset to %0.2f dB.", e->alsa_name, c,
-                                             e->db_fix->db_values[value - e->db_fix->min_step] / 100.0);
-                            }
 
-                            /* Volume step -> dB value conversion. */
-                            value = e->db_fix->db_values[value - e->db_fix->min_step];
-                        }
-                    } else
-                        r = snd_mixer_selem_get_playback_dB(me, c, &value);
-                } else
-                    r = -1;
-            } else {
-                if (snd_mixer_selem_has_capture_channel(me, c)) {
-                    if (e->db_fix) {
-                        if ((r = snd_mixer_selem_get_capture_volume(me, c, &value)) >= 0) {
-                            /* If the channel volume is outside the limits set
-                             * by the dB fix, we clamp the hw volume to be
-                             * within the limits. */
-                            if (value < e->db_fix->min_step) {
-                                value = e->db_fix->min_step;
-                                snd_mixer_selem_set_capture_volume(me, c, value);
-                                pa_log_debug("Capture volume for element %s channel %i was below the dB fix limit. "
-                                             "Volume reset to %0.2f dB.", e->alsa_name, c,
-                                             e->db_fix->db_values[value - e->db_fix->min_step] / 100.0);
-                            } else if (value > e->db_fix->max_step) {
-                                value = e->db_fix->max_step;
-                                snd_mixer_selem_set_capture_volume(me, c, value);
-                                pa_log_debug("Capture volume for element %s channel %i was over the dB fix limit. "
-                                             "Volume reset to %0.2f dB.", e->alsa_name, c,
-                                             e->db_fix->db_values[value - e->db_fix->min_step] / 100.0);
-                            }
+            if (e->db_fix) {
+                if ((r = element_get_alsa_volume(e, me, c, &value)) >= 0) {
+                    /* If the channel volume is outside the limits set
+                     * by the dB fix, we clamp the hw volume to be
+                     * within the limits. */
+                    if (value < e->db_fix->min_step) {
+                        value = e->db_fix->min_step;
+                        element_set_alsa_volume(e, me, c, value);
+                        pa_log_debug("%s volume for element %s channel %i was below the dB fix limit. "
+                                     "Volume reset to %0.2f dB.",
+                                     e->direction == PA_ALSA_DIRECTION_OUTPUT ? "Playback" : "Capture", e->alsa_name, c,
+                                     e->db_fix->db_values[value - e->db_fix->min_step] / 100.0);
+                    } else if (value > e->db_fix->max_step) {
+                        value = e->db_fix->max_step;
+                        element_set_alsa_volume(e, me, c, value);
+                        pa_log_debug("%s volume for element %s channel %i was over the dB fix limit. "
+                                     "Volume reset to %0.2f dB.",
+                                     e->direction == PA_ALSA_DIRECTION_OUTPUT ? "Playback" : "Capture", e->alsa_name, c,
+                                     e->db_fix->db_values[value - e->db_fix->min_step] / 100.0);
+                    }
 
-                            /* Volume step -> dB value conversion. */
-                            value = e->db_fix->db_values[value - e->db_fix->min_step];
-                        }
-                    } else
-                        r = snd_mixer_selem_get_capture_dB(me, c, &value);
-                } else
-                    r = -1;
-            }
+                    /* Volume step -> dB value conversion. */
+                    value = e->db_fix->db_values[value - e->db_fix->min_step];
+                }
+
+            } else if (e->volume_dB) {
+                if ((r = element_get_alsa_volume(e, me, c, &value)) >= 0) {
+                    if (value >= e->min_volume && value <= e->max_volume)
+                        value = e->volume_dB[value - e->min_volume];
+                    else if (e->direction == PA_ALSA_DIRECTION_OUTPUT)
+                        r = snd_mixer_selem_ask_playback_vol_dB(me, value, &value);
+                    else
+                        r = snd_mixer_selem_ask_capture_vol_dB(me, value, &value);
+                }
+
+            } else if (e->direction == PA_ALSA_DIRECTION_OUTPUT)
+                r = snd_mixer_selem_get_playback_dB(me, c, &value);
+            else
+                r = snd_mixer_selem_get_capture_dB(me, c, &value);
 
             if (r < 0)
                 continue;
@@ -692,21 +764,7 @@ static int element_get_volume(pa_alsa_element *e, snd_mixer_t *m, const pa_chann
             f = from_alsa_dB(value);
 
         } else {
-            long value = 0;
-
-            if (e->direction == PA_ALSA_DIRECTION_OUTPUT) {
-                if (snd_mixer_selem_has_playback_channel(me, c))
-                    r = snd_mixer_selem_get_playback_volume(me, c, &value);
-                else
-                    r = -1;
-            } else {
-                if (snd_mixer_selem_has_capture_channel(me, c))
-                    r = snd_mixer_selem_get_capture_volume(me, c, &value);
-                else
-                    r = -1;
-            }
-
-            if (r < 0)
+            if (element_get_alsa_volume(e, me, c, &value) < 0)
                 continue;
 
             f = from_alsa_volume(value, e->min_volume, e->max_volume);
@@ -764,7 +822,6 @@ int pa_alsa_path_get_volume(pa_alsa_path *p, snd_mixer_t *m, const pa_channel_ma
 }
 
 static int element_get_switch(pa_alsa_element *e, snd_mixer_t *m, pa_bool_t *b) {
-    snd_mixer_selem_id_t *sid;
     snd_mixer_elem_t *me;
     snd_mixer_selem_channel_id_t c;
 
@@ -772,11 +829,8 @@ static int element_get_switch(pa_alsa_element *e, snd_mixer_t *m, pa_bool_t *b)
     pa_assert(e);
     pa_assert(b);
 
-    SELEM_INIT(sid, e->alsa_name);
-    if (!(me = snd_mixer_find_selem(m, sid))) {
-        pa_log_warn("Element %s seems to have disappeared.", e->alsa_name);
+    if (!(me = element_get_handle(e, m)))
         return -1;
-    }
 
     /* We return muted if at least one channel is muted */
 
@@ -784,17 +838,13 @@ static int element_get_switch(pa_alsa_element *e, snd_mixer_t *m, pa_bool_t *b)
         int r;
         int value = 0;
 
-        if (e->direction == PA_ALSA_DIRECTION_OUTPUT) {
-            if (snd_mixer_selem_has_playback_channel(me, c))
-                r = snd_mixer_selem_get_playback_switch(me, c, &value);
-            else
-                r = -1;
-        } else {
-            if (snd_mixer_selem_has_capture_channel(me, c))
-                r = snd_mixer_selem_get_capture_switch(me, c, &value);
-            else
-                r = -1;
-        }
+        if (!(e->alsa_channels & (1U << c)))
+            continue;
+
+        if (e->direction == PA_ALSA_DIRECTION_OUTPUT)
+            r = snd_mixer_selem_get_playback_switch(me, c, &value);
+        else
+            r = snd_mixer_selem_get_capture_switch(me, c, &value);
 
         if (r < 0)
             continue;
@@ -843,30 +893,11 @@ int pa_alsa_path_get_mute(pa_alsa_path *p, snd_mixer_t *m, pa_bool_t *muted) {
  * Rounding is done based on the rounding parameter: -1 means rounding down and
  * +1 means rounding up. */
 static long decibel_fix_get_step(pa_alsa_decibel_fix *db_fix, long *db_value, int rounding) {
-    unsigned i = 0;
-    unsigned max_i = 0;
-
     pa_assert(db_fix);
     pa_assert(db_value);
     pa_assert(rounding != 0);
 
-    max_i = db_fix->max_step - db_fix->min_step;
-
-    if (rounding > 0) {
-        for (i = 0; i < max_i; i++) {
-            if (db_fix->db_values[i] >= *db_value)
-                break;
-        }
-    } else {
-        for (i = 0; i < max_i; i++) {
-            if (db_fix->db_values[i + 1] > *db_value)
-                break;
-        }
-    }
-
-    *db_value = db_fix->db_values[i];
-
-    return i + db_fix->min_step;
+    return dB_table_get_step(db_fix->db_values, db_fix->min_step, db_fix->max_step - db_fix->min_step + 1, db_value, rounding);
 }
 
 /* Alsa lib documentation says for snd_mixer_selem_set_playback_dB() direction argument,
@@ -923,7 +954,6 @@ static int element_get_nearest_alsa_dB(snd_mixer_elem_t *me, snd_mixer_selem_cha
 
 static int element_set_volume(pa_alsa_element *e, snd_mixer_t *m, const pa_channel_map *cm, pa_cvolume *v, pa_bool_t deferred_volume, pa_bool_t write_to_hw) {
 
-    snd_mixer_selem_id_t *sid;
     pa_cvolume rv;
     snd_mixer_elem_t *me;
     snd_mixer_selem_channel_id_t c;
@@ -936,11 +966,8 @@ static int element_set_volume(pa_alsa_element *e, snd_mixer_t *m, const pa_chann
     pa_assert(v);
     pa_assert(pa_cvolume_compatible_with_channel_map(v, cm));
 
-    SELEM_INIT(sid, e->alsa_name);
-    if (!(me = snd_mixer_find_selem(m, sid))) {
-        pa_log_warn("Element %s seems to have disappeared.", e->alsa_name);
+    if (!(me = element_get_handle(e, m)))
         return -1;
-    }
 
     pa_cvolume_mute(&rv, cm->channels);
 
@@ -949,6 +976,12 @@ static int element_set_volume(pa_alsa_element *e, snd_mixer_t *m, const pa_chann
         pa_volume_t f = PA_VOLUME_MUTED;
         pa_bool_t found = FALSE;
 
+        /* If we call set_playback_volume() without checking first
+         * if the channel is available, ALSA behaves very
+         * strangely and doesn't fail the call */
+        if (!(e->alsa_channels & (1U << c)))
+            continue;
+
         for (k = 0; k < cm->channels; k++)
             if (e->masks[c][e->n_channels-1] & PA_CHANNEL_POSITION_MASK(cm->map[k])) {
                 found = TRUE;
@@ -965,70 +998,51 @@ static int element_set_volume(pa_alsa_element *e, snd_mixer_t *m, const pa_chann
 
         if (e->has_dB) {
             long value = to_alsa_dB(f);
-            int rounding;
+            int rounding = e->direction == PA_ALSA_DIRECTION_OUTPUT ? +1 : -1;
 
             if (e->volume_limit >= 0 && value > (e->max_dB * 100))
                 value = e->max_dB * 100;
 
-            if (e->direction == PA_ALSA_DIRECTION_OUTPUT) {
-                /* If we call set_playback_volume() without checking first
-                 * if the channel is available, ALSA behaves very
-                 * strangely and doesn't fail the call */
-                if (snd_mixer_selem_has_playback_channel(me, c)) {
-                    rounding = +1;
-                    if (e->db_fix) {
-                        if (write_to_hw)
-                            r = snd_mixer_selem_set_playback_volume(me, c, decibel_fix_get_step(e->db_fix, &value, rounding));
-                        else {
-                            decibel_fix_get_step(e->db_fix, &value, rounding);
-                            r = 0;
-                        }
+            if (e->db_fix || e->volume_dB) {
+                long step;
+
+                /* The same as below, but done with our own tables */
+                if (e->db_fix)
+                    step = decibel_fix_get_step(e->db_fix, &value, rounding);
+                else
+                    step = dB_table_get_step(e->volume_dB, e->min_volume, e->max_volume - e->min_volume + 1, &value,
+                                             write_to_hw && deferred_volume ? 0 : rounding);
 
+                r = write_to_hw ? element_set_alsa_volume(e, me, c, step) : 0;
+
+            } else if (e->direction == PA_ALSA_DIRECTION_OUTPUT) {
+                if (write_to_hw) {
+                    if (deferred_volume) {
+                        if ((r = element_get_nearest_alsa_dB(me, c, PA_ALSA_DIRECTION_OUTPUT, &value)) >= 0)
+                            r = snd_mixer_selem_set_playback_dB(me, c, value, 0);
                     } else {
-                        if (write_to_hw) {
-                            if (deferred_volume) {
-                                if ((r = element_get_nearest_alsa_dB(me, c, PA_ALSA_DIRECTION_OUTPUT, &value)) >= 0)
-                                    r = snd_mixer_selem_set_playback_dB(me, c, value, 0);
-                            } else {
-                                if ((r = snd_mixer_selem_set_playback_dB(me, c, value, rounding)) >= 0)
-                                    r = snd_mixer_selem_get_playback_dB(me, c, &value);
-                           }
-                        } else {
-                            long alsa_val;
-                            if ((r = snd_mixer_selem_ask_playback_dB_vol(me, value, rounding, &alsa_val)) >= 0)
-                                r = snd_mixer_selem_ask_playback_vol_dB(me, alsa_val, &value);
-                        }
+                        if ((r = snd_mixer_selem_set_playback_dB(me, c, value, rounding)) >= 0)
+                            r = snd_mixer_selem_get_playback_dB(me, c, &value);
                     }
-                } else
-                    r = -1;
+                } else {
+                    long alsa_val;
+                    if ((r = snd_mixer_selem_ask_playback_dB_vol(me, value, rounding, &alsa_val)) >= 0)
+                        r = snd_mixer_selem_ask_playback_vol_dB(me, alsa_val, &value);
+                }
             } else {
-                if (snd_mixer_selem_has_capture_channel(me, c)) {
-                    rounding = -1;
-                    if (e->db_fix) {
-                        if (write_to_hw)
-                            r = snd_mixer_selem_set_capture_volume(me, c, decibel_fix_get_step(e->db_fix, &value, rounding));
-                        else {
-                            decibel_fix_get_step(e->db_fix, &value, rounding);
-                            r = 0;
-                        }
-
+                if (write_to_hw) {
+                    if (deferred_volume) {
+                        if ((r = element_get_nearest_alsa_dB(me, c, PA_ALSA_DIRECTION_INPUT, &value)) >= 0)
+                            r = snd_mixer_selem_set_capture_dB(me, c, value, 0);
                     } else {
-                        if (write_to_hw) {
-                            if (deferred_volume) {
-                                if ((r = element_get_nearest_alsa_dB(me, c, PA_ALSA_DIRECTION_INPUT, &value)) >= 0)
-                                    r = snd_mixer_selem_set_capture_dB(me, c, value, 0);
-                            } else {
-                                if ((r = snd_mixer_selem_set_capture_dB(me, c, value, rounding)) >= 0)
-                                    r = snd_mixer_selem_get_capture_dB(me, c, &value);
-                            }
-                        } else {
-                            long alsa_val;
-                            if ((r = snd_mixer_selem_ask_capture_dB_vol(me, value, rounding, &alsa_val)) >= 0)
-                                r = snd_mixer_selem_ask_capture_vol_dB(me, alsa_val, &value);
-                        }
+                        if ((r = snd_mixer_selem_set_capture_dB(me, c, value, rounding)) >= 0)
+                            r = snd_mixer_selem_get_capture_dB(me, c, &value);
                     }
-                } else
-                    r = -1;
+                } else {
+                    long alsa_val;
+                    if ((r = snd_mixer_selem_ask_capture_dB_vol(me, value, rounding, &alsa_val)) >= 0)
+                        r = snd_mixer_selem_ask_capture_vol_dB(me, alsa_val, &value);
+                }
             }
 
             if (r < 0)
@@ -1045,19 +1059,8 @@ static int element_set_volume(pa_alsa_element *e, snd_mixer_t *m, const pa_chann
 
             value = to_alsa_volume(f, e->min_volume, e->max_volume);
 
-            if (e->direction == PA_ALSA_DIRECTION_OUTPUT) {
-                if (snd_mixer_selem_has_playback_channel(me, c)) {
-                    if ((r = snd_mixer_selem_set_playback_volume(me, c, value)) >= 0)
-                        r = snd_mixer_selem_get_playback_volume(me, c, &value);
-                } else
-                    r = -1;
-            } else {
-                if (snd_mixer_selem_has_capture_channel(me, c)) {
-                    if ((r = snd_mixer_selem_set_capture_volume(me, c, value)) >= 0)
-                        r = snd_mixer_selem_get_capture_volume(me, c, &value);
-                } else
-                    r = -1;
-            }
+            if ((r = element_set_alsa_volume(e, me, c, value)) >= 0)
+                r = element_get_alsa_volume(e, me, c, &value);
 
             if (r < 0)
                 continue;
@@ -1124,17 +1127,13 @@ int pa_alsa_path_set_volume(pa_alsa_path *p, snd_mixer_t *m, const pa_channel_ma
 
 static int element_set_switch(pa_alsa_element *e, snd_mixer_t *m, pa_bool_t b) {
     snd_mixer_elem_t *me;
-    snd_mixer_selem_id_t *sid;
     int r;
 
     pa_assert(m);
     pa_assert(e);
 
-    SELEM_INIT(sid, e->alsa_name);
-    if (!(me = snd_mixer_find_selem(m, sid))) {
-        pa_log_warn("Element %s seems to have disappeared.", e->alsa_name);
+    if (!(me = element_get_handle(e, m)))
         return -1;
-    }
 
     if (e->direction == PA_ALSA_DIRECTION_OUTPUT)
         r = snd_mixer_selem_set_playback_switch_all(me, b);
@@ -1242,6 +1241,9 @@ int pa_alsa_path_select(pa_alsa_path *p, snd_mixer_t *m) {
     pa_log_debug("Activating path %s", p->name);
     pa_alsa_path_dump(p);
 
+    PA_LLIST_FOREACH(e, p->elements)
+        element_cache_handle(e, m);
+
     PA_LLIST_FOREACH(e, p->elements) {
 
         switch (e->switch_use) {
@@ -1366,6 +1368,59 @@ static int check_required(pa_alsa_element *e, snd_mixer_elem_t *me) {
     return 0;
 }
 
+#define VOLUME_DB_TABLE_MAX 4096
+
+/* Records which channels the element has and, for elements that report
+ * dB values themselves, the dB value of every volume step, so that the
+ * volume calls need neither the channel checks nor ALSA's dB
+ * conversions, which walk the TLV data on every call. */
+static void element_compile(pa_alsa_element *e, snd_mixer_elem_t *me) {
+    snd_mixer_selem_channel_id_t c;
+    long i, n;
+
+    e->alsa_channels = 0;
+    for (c = 0; c <= SND_MIXER_SCHN_LAST; c++) {
+        int r;
+
+        if (e->direction == PA_ALSA_DIRECTION_OUTPUT)
+            r = snd_mixer_selem_has_playback_channel(me, c);
+        else
+            r = snd_mixer_selem_has_capture_channel(me, c);
+
+        if (r > 0)
+            e->alsa_channels |= 1U << c;
+    }
+
+    pa_xfree(e->volume_dB);
+    e->volume_dB = NULL;
+
+    if (e->volume_use != PA_ALSA_VOLUME_MERGE || !e->has_dB || e->db_fix)
+        return;
+
+    n = e->max_volume - e->min_volume + 1;
+    if (n > VOLUME_DB_TABLE_MAX)
+        return;
+
+    e->volume_dB = pa_xnew(long, n);
+
+    for (i = 0; i < n; i++) {
+        int r;
+
+        if (e->direction == PA_ALSA_DIRECTION_OUTPUT)
+            r = snd_mixer_selem_ask_playback_vol_dB(me, e->min_volume + i, &e->volume_dB[i]);
+        else
+            r = snd_mixer_selem_ask_capture_vol_dB(me, e->min_volume + i, &e->volume_dB[i]);
+
+        /* The lookups need a table that doesn't go down */
+        if (r < 0 || (i > 0 && e->volume_dB[i] < e->volume_dB[i-1])) {
+            pa_log_debug("Not using a dB table for element %s.", e->alsa_name);
+            pa_xfree(e->volume_dB);
+            e->volume_dB = NULL;
+            return;
+        }
+    }
+}
+
 static int element_probe(pa_alsa_element *e, snd_mixer_t *m) {
     snd_mixer_selem_id_t *sid;
     snd_mixer_elem_t *me;
@@ -1686,6 +1741,8 @@ static int element_probe(pa_alsa_element *e, snd_mixer_t *m) {
     if (check_required(e, me) < 0)
         return -1;
 
+    element_compile(e, me);
+
     return 0;
 }
 
@@ -2762,6 +2819,27 @@ void pa_alsa_path_set_callback(pa_alsa_path *p, snd_mixer_t *m, snd_mixer_elem_c
         element_set_callback(e, m, cb, userdata);
 }
 
+void pa_alsa_path_drop_handles(pa_alsa_path *p, snd_mixer_t *m) {
+    pa_alsa_element *e;
+
+    pa_assert(p);
+    pa_assert(m);
+
+    PA_LLIST_FOREACH(e, p->elements)
+        pa_atomic_ptr_cmpxchg(&e->mixer, m, NULL);
+}
+
+void pa_alsa_path_set_drop_handles(pa_alsa_path_set *ps, snd_mixer_t *m) {
+    pa_alsa_path *p;
+    void *state;
+
+    pa_assert(ps);
+    pa_assert(m);
+
+    PA_HASHMAP_FOREACH(p, ps->paths, state)
+        pa_alsa_path_drop_handles(p, m);
+}
+
 void pa_alsa_path_set_set_callback(pa_alsa_path_set *ps, snd_mixer_t *m, snd_mixer_elem_callback_t cb, void *userdata) {
     pa_alsa_path *p;
     void *state;
@@ -3698,14 +3776,17 @@ fail:
     return -1;
 }
 
+/* If mixer_device is NULL the mixer is looked up through the mapping's
+ * open PCM, otherwise it is opened directly by its control device name,
+ * which is what happens when the probe results came from the cache. */
 static void mapping_paths_probe(pa_alsa_mapping *m, pa_alsa_profile *profile,
-                                pa_alsa_direction_t direction) {
+                                pa_alsa_direction_t direction, const char *mixer_device) {
 
     pa_alsa_path *p;
     void *state;
     snd_pcm_t *pcm_handle;
     pa_alsa_path_set *ps;
-    snd_mixer_t *mixer_handle;
+    snd_mixer_t *mixer_handle = NULL;
 
     if (direction == PA_ALSA_DIRECTION_OUTPUT) {
         if (m->output_path_set)
@@ -3722,9 +3803,18 @@ static void mapping_paths_probe(pa_alsa_mapping *m, pa_alsa_profile *profile,
     if (!ps)
         return; /* No paths */
 
-    pa_assert(pcm_handle);
+    if (mixer_device) {
+        if (snd_mixer_open(&mixer_handle, 0) >= 0) {
+            if (prepare_mixer(mixer_handle, mixer_device) >= 0)
+                ps->mixer_device = pa_xstrdup(mixer_device);
+            else {
+                snd_mixer_close(mixer_handle);
+                mixer_handle = NULL;
+            }
+        }
+    } else if (pcm_handle)
+        mixer_handle = pa_alsa_open_mixer_for_pcm(pcm_handle, &ps->mixer_device);
 
-    mixer_handle = pa_alsa_open_mixer_for_pcm(pcm_handle, NULL);
     if (!mixer_handle) {
          /* Cannot open mixer, remove all entries */
         while (pa_hashmap_steal_first(ps->paths));
@@ -4151,6 +4241,35 @@ fail:
     return NULL;
 }
 
+/* A device that is busy now may well work on the next start, so the
+ * probe results must not be cached if one of them failed that way */
+static void probe_open_failed(pa_alsa_profile_set *ps, pa_alsa_mapping *m) {
+    if (errno == EBUSY || errno == EAGAIN || errno == EINTR) {
+        pa_log_info("Mapping %s is temporarily unavailable: %s", m->name, pa_cstrerror(errno));
+        ps->probe_incomplete = TRUE;
+    }
+}
+
+static void profile_set_drop_unsupported(pa_alsa_profile_set *ps) {
+    void *state;
+    pa_alsa_profile *p;
+    pa_alsa_mapping *m;
+
+    PA_HASHMAP_FOREACH(p, ps->profiles, state)
+        if (!p->supported) {
+            pa_hashmap_remove(ps->profiles, p->name);
+            profile_free(p);
+        }
+
+    PA_HASHMAP_FOREACH(m, ps->mappings, state)
+        if (m->supported <= 0) {
+            pa_hashmap_remove(ps->mappings, m->name);
+            mapping_free(m);
+        }
+
+    ps->probed = TRUE;
+}
+
 void pa_alsa_profile_set_probe(
         pa_alsa_profile_set *ps,
         const char *dev_id,
@@ -4239,6 +4358,7 @@ void pa_alsa_profile_set_probe(
                               SND_PCM_STREAM_PLAYBACK,
                               &try_period_size, &try_buffer_size, 0, NULL, NULL,
                               TRUE))) {
+                    probe_open_failed(ps, m);
                     p->supported = FALSE;
                     break;
                 }
@@ -4268,6 +4388,7 @@ void pa_alsa_profile_set_probe(
                               SND_PCM_STREAM_CAPTURE,
                               &try_period_size, &try_buffer_size, 0, NULL, NULL,
                               TRUE))) {
+                    probe_open_failed(ps, m);
                     p->supported = FALSE;
                     break;
                 }
@@ -4284,12 +4405,12 @@ probe_paths:
         if (p->output_mappings)
             PA_IDXSET_FOREACH(m, p->output_mappings, idx)
                 if (m->output_pcm)
-                    mapping_paths_probe(m, p, PA_ALSA_DIRECTION_OUTPUT);
+                    mapping_paths_probe(m, p, PA_ALSA_DIRECTION_OUTPUT, NULL);
 
         if (p->input_mappings)
             PA_IDXSET_FOREACH(m, p->input_mappings, idx)
                 if (m->input_pcm)
-                    mapping_paths_probe(m, p, PA_ALSA_DIRECTION_INPUT);
+                    mapping_paths_probe(m, p, PA_ALSA_DIRECTION_INPUT, NULL);
 
     }
 
@@ -4320,19 +4441,191 @@ probe_paths:
                 }
     }
 
+    profile_set_drop_unsupported(ps);
+}
+
+/* The probe cache is a plain text file. The first line is the key
+ * identifying the card and everything that influences the probing, it
+ * is followed by one "profile <name>" line per supported profile and
+ * one "output-paths <mapping> [<mixer device>]" or "input-paths ..."
+ * line per mapping that has mixer paths. */
+
+static void path_set_save(FILE *f, const char *kind, pa_alsa_mapping *m, pa_alsa_path_set *ps) {
+    if (!ps)
+        return;
+
+    if (ps->mixer_device)
+        fprintf(f, "%s %s %s\n", kind, m->name, ps->mixer_device);
+    else
+        fprintf(f, "%s %s\n", kind, m->name);
+}
+
+void pa_alsa_profile_set_save_probe_cache(pa_alsa_profile_set *ps, const char *fn, const char *key) {
+    FILE *f;
+    char *t;
+    void *state;
+    pa_alsa_profile *p;
+    pa_alsa_mapping *m;
+
+    pa_assert(ps);
+    pa_assert(ps->probed);
+    pa_assert(fn);
+    pa_assert(key);
+
+    if (ps->probe_incomplete) {
+        pa_log_info("Some devices could not be probed, not saving probe cache %s", fn);
+        return;
+    }
+
+    t = pa_sprintf_malloc("%s.tmp", fn);
+
+    if (!(f = pa_fopen_cloexec(t, "w"))) {
+        pa_log_warn("Failed to open probe cache %s: %s", t, pa_cstrerror(errno));
+        pa_xfree(t);
+        return;
+    }
+
+    fprintf(f, "%s\n", key);
+
     PA_HASHMAP_FOREACH(p, ps->profiles, state)
-        if (!p->supported) {
-            pa_hashmap_remove(ps->profiles, p->name);
-            profile_free(p);
-        }
+        fprintf(f, "profile %s\n", p->name);
 
-    PA_HASHMAP_FOREACH(m, ps->mappings, state)
-        if (m->supported <= 0) {
-            pa_hashmap_remove(ps->mappings, m->name);
-            mapping_free(m);
+    PA_HASHMAP_FOREACH(m, ps->mappings, state) {
+        path_set_save(f, "output-paths", m, m->output_path_set);
+        path_set_save(f, "input-paths", m, m->input_path_set);
+    }
+
+    if (fclose(f) != 0 || rename(t, fn) < 0) {
+        pa_log_warn("Failed to write probe cache %s: %s", fn, pa_cstrerror(errno));
+        unlink(t);
+    } else
+        pa_log_debug("Saved probe results to %s", fn);
+
+    pa_xfree(t);
+}
+
+int pa_alsa_profile_set_probe_from_cache(pa_alsa_profile_set *ps, const char *fn, const char *key) {
+    FILE *f;
+    char ln[1024];
+    pa_idxset *supported;
+    pa_hashmap *output_devices, *input_devices;
+    void *state;
+    pa_alsa_profile *p;
+    pa_alsa_mapping *m;
+    char *d;
+    int r = -1;
+
+    pa_assert(ps);
+    pa_assert(fn);
+    pa_assert(key);
+
+    if (ps->probed)
+        return 0;
+
+    if (!(f = pa_fopen_cloexec(fn, "r"))) {
+        if (errno != ENOENT)
+            pa_log_warn("Failed to open probe cache %s: %s", fn, pa_cstrerror(errno));
+        return -1;
+    }
+
+    supported = pa_idxset_new(NULL, NULL);
+    output_devices = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+    input_devices = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+
+    if (!fgets(ln, sizeof(ln), f) || !pa_streq(pa_strip_nl(ln), key)) {
+        pa_log_debug("Probe cache %s is stale.", fn);
+        goto finish;
+    }
+
+    /* Parse everything before touching the profile set, so that a bad
+     * file leaves it untouched for a regular probe */
+    while (fgets(ln, sizeof(ln), f)) {
+        char *name, *device;
+        pa_hashmap *devices = NULL;
+
+        pa_strip_nl(ln);
+
+        if (!(name = strchr(ln, ' ')))
+            goto invalid;
+
+        *(name++) = 0;
+
+        if (pa_streq(ln, "profile")) {
+            if (!(p = pa_hashmap_get(ps->profiles, name)))
+                goto invalid;
+
+            pa_idxset_put(supported, p, NULL);
+            continue;
         }
 
-    ps->probed = TRUE;
+        if (pa_streq(ln, "output-paths"))
+            devices = output_devices;
+        else if (pa_streq(ln, "input-paths"))
+            devices = input_devices;
+        else
+            goto invalid;
+
+        if ((device = strchr(name, ' ')))
+            *(device++) = 0;
+
+        if (!(m = pa_hashmap_get(ps->mappings, name)))
+            goto invalid;
+
+        /* An empty string records that no mixer could be opened */
+        if (pa_hashmap_put(devices, m, pa_xstrdup(device ? device : "")) < 0)
+            goto invalid;
+    }
+
+    if (pa_idxset_isempty(supported))
+        goto invalid;
+
+    PA_HASHMAP_FOREACH(p, ps->profiles, state) {
+        uint32_t idx;
+
+        if (!(p->supported = !!pa_idxset_get_by_data(supported, p, NULL)))
+            continue;
+
+        pa_log_debug("Profile %s supported (cached).", p->name);
+
+        if (p->output_mappings)
+            PA_IDXSET_FOREACH(m, p->output_mappings, idx) {
+                m->supported++;
+
+                d = pa_hashmap_get(output_devices, m);
+                mapping_paths_probe(m, p, PA_ALSA_DIRECTION_OUTPUT, d && *d ? d : NULL);
+            }
+
+        if (p->input_mappings)
+            PA_IDXSET_FOREACH(m, p->input_mappings, idx) {
+                m->supported++;
+
+                d = pa_hashmap_get(input_devices, m);
+                mapping_paths_probe(m, p, PA_ALSA_DIRECTION_INPUT, d && *d ? d : NULL);
+            }
+    }
+
+    profile_set_drop_unsupported(ps);
+
+    pa_log_info("Using cached probe results from %s", fn);
+    r = 0;
+    goto finish;
+
+invalid:
+    pa_log_warn("Invalid probe cache %s, ignoring.", fn);
+
+finish:
+    while ((d = pa_hashmap_steal_first(output_devices)))
+        pa_xfree(d);
+    while ((d = pa_hashmap_steal_first(input_devices)))
+        pa_xfree(d);
+
+    pa_hashmap_free(output_devices, NULL, NULL);
+    pa_hashmap_free(input_devices, NULL, NULL);
+    pa_idxset_free(supported, NULL, NULL);
+
+    fclose(f);
+
+    return r;
 }
 
 void pa_alsa_profile_set_dump(pa_alsa_profile_set *ps) {
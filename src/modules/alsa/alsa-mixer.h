@@ -30,6 +30,7 @@
 #include <pulse/channelmap.h>
 #include <pulse/volume.h>
 
+#include <pulsecore/atomic.h>
 #include <pulsecore/llist.h>
 #include <pulsecore/rtpoll.h>
 
@@ -152,6 +153,16 @@ struct pa_alsa_element {
     PA_LLIST_HEAD(pa_alsa_option, options);
 
     pa_alsa_decibel_fix *db_fix;
+
+    /* Filled in when probing: a bit per ALSA channel the element has,
+     * and the dB values of the steps from min_volume to max_volume
+     * unless there is a dB fix or the range is too large */
+    uint32_t alsa_channels;
+    long *volume_dB;
+
+    /* The element's handle on the mixer the path was last selected on */
+    pa_atomic_ptr_t mixer;
+    snd_mixer_elem_t *handle;
 };
 
 /* A path wraps a series of elements into a single entity which can be
@@ -191,6 +202,9 @@ struct pa_alsa_path {
 struct pa_alsa_path_set {
     pa_hashmap *paths;
     pa_alsa_direction_t direction;
+
+    /* The control device the paths were probed on */
+    char *mixer_device;
 };
 
 int pa_alsa_setting_select(pa_alsa_setting *s, snd_mixer_t *m);
@@ -210,11 +224,15 @@ int pa_alsa_path_set_volume(pa_alsa_path *path, snd_mixer_t *m, const pa_channel
 int pa_alsa_path_set_mute(pa_alsa_path *path, snd_mixer_t *m, pa_bool_t muted);
 int pa_alsa_path_select(pa_alsa_path *p, snd_mixer_t *m);
 void pa_alsa_path_set_callback(pa_alsa_path *p, snd_mixer_t *m, snd_mixer_elem_callback_t cb, void *userdata);
+/* Forget the element handles pa_alsa_path_select() cached for m, to be
+ * called before m is closed or when its elements are removed */
+void pa_alsa_path_drop_handles(pa_alsa_path *p, snd_mixer_t *m);
 void pa_alsa_path_free(pa_alsa_path *p);
 
 pa_alsa_path_set *pa_alsa_path_set_new(pa_alsa_mapping *m, pa_alsa_direction_t direction, const char *paths_dir);
 void pa_alsa_path_set_dump(pa_alsa_path_set *s);
 void pa_alsa_path_set_set_callback(pa_alsa_path_set *ps, snd_mixer_t *m, snd_mixer_elem_callback_t cb, void *userdata);
+void pa_alsa_path_set_drop_handles(pa_alsa_path_set *ps, snd_mixer_t *m);
 void pa_alsa_path_set_free(pa_alsa_path_set *s);
 
 struct pa_alsa_mapping {
@@ -288,6 +306,9 @@ struct pa_alsa_profile_set {
     pa_bool_t auto_profiles;
     pa_bool_t ignore_dB:1;
     pa_bool_t probed:1;
+
+    /* Some device failed to open for a reason that may go away */
+    pa_bool_t probe_incomplete:1;
 };
 
 void pa_alsa_mapping_dump(pa_alsa_mapping *m);
@@ -296,6 +317,8 @@ void pa_alsa_decibel_fix_dump(pa_alsa_decibel_fix *db_fix);
 
 pa_alsa_profile_set* pa_alsa_profile_set_new(const char *fname, const pa_channel_map *bonus);
 void pa_alsa_profile_set_probe(pa_alsa_profile_set *ps, const char *dev_id, const pa_sample_spec *ss, unsigned default_n_fragments, unsigned default_fragment_size_msec);
+int pa_alsa_profile_set_probe_from_cache(pa_alsa_profile_set *ps, const char *fn, const char *key);
+void pa_alsa_profile_set_save_probe_cache(pa_alsa_profile_set *ps, const char *fn, const char *key);
 void pa_alsa_profile_set_free(pa_alsa_profile_set *s);
 void pa_alsa_profile_set_dump(pa_alsa_profile_set *s);
 
@@ -84,11 +84,18 @@
 #define SMOOTHER_MIN_INTERVAL (2*PA_USEC_PER_MSEC)                 /* 2ms   -- min smoother update interval */
 #define SMOOTHER_MAX_INTERVAL (200*PA_USEC_PER_MSEC)               /* 200ms -- max smoother update interval */
 
+#define TSTAMP_MAX_AGE_USEC (1*PA_USEC_PER_SEC)                    /* 1s    -- driver timestamps older than this are considered bogus */
+#define TSTAMP_JITTER_PERIOD_USEC (10*PA_USEC_PER_SEC)             /* 10s   -- how often to publish timestamp jitter statistics */
+
 #define VOLUME_ACCURACY (PA_VOLUME_NORM/100)  /* don't require volume adjustments to be perfectly correct. don't necessarily extend granularity in software unless the differences get greater than this level */
 
 #define DEFAULT_REWIND_SAFEGUARD_BYTES (256U) /* 1.33ms @48kHz, we'll never rewind less than this */
 #define DEFAULT_REWIND_SAFEGUARD_USEC (1330) /* 1.33ms, depending on channels/rate/sample we may rewind more than 256 above */
 
+enum {
+    SINK_MESSAGE_TSTAMP_JITTER = PA_SINK_MESSAGE_MAX
+};
+
 struct userdata {
     pa_core *core;
     pa_module *module;
@@ -148,6 +155,9 @@ struct userdata {
     pa_usec_t smoother_interval;
     pa_usec_t last_smoother_update;
 
+    pa_bool_t use_htstamp;
+    pa_alsa_tstamp_jitter tstamp_jitter;
+
     pa_idxset *formats;
 
     pa_reserve_wrapper *reserve;
@@ -831,17 +841,31 @@ static void update_smoother(struct userdata *u) {
 
     /* Let's update the time smoother */
 
-    if (PA_UNLIKELY((err = pa_alsa_safe_delay(u->pcm_handle, &delay, u->hwbuf_size, &u->sink->sample_spec, FALSE)) < 0)) {
+    if (PA_UNLIKELY((err = pa_alsa_safe_delay(u->pcm_handle, status, &delay, u->hwbuf_size, &u->sink->sample_spec, FALSE)) < 0)) {
         pa_log_warn("Failed to query DSP status data: %s", pa_alsa_strerror(err));
         return;
     }
 
-    if (PA_UNLIKELY((err = snd_pcm_status(u->pcm_handle, status)) < 0))
-        pa_log_warn("Failed to get timestamp: %s", pa_alsa_strerror(err));
-    else {
+    if (u->use_htstamp) {
         snd_htimestamp_t htstamp = { 0, 0 };
+        pa_usec_t now;
+
         snd_pcm_status_get_htstamp(status, &htstamp);
         now1 = pa_timespec_load(&htstamp);
+        now = pa_rtclock_now();
+
+        /* If the timestamp is not on our clock, don't trust it again */
+        if (now1 > 0 && (now1 > now || now1 + TSTAMP_MAX_AGE_USEC < now)) {
+            pa_log_info("Driver timestamps are not usable, falling back to system time.");
+            u->use_htstamp = FALSE;
+            now1 = now;
+        } else if (now1 > 0) {
+            pa_usec_t avg, max;
+
+            /* max is below TSTAMP_MAX_AGE_USEC, it fits */
+            if (pa_alsa_tstamp_jitter_update(&u->tstamp_jitter, now1, now, TSTAMP_JITTER_PERIOD_USEC, &avg, &max))
+                pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(u->sink), SINK_MESSAGE_TSTAMP_JITTER, PA_UINT_TO_PTR((unsigned) max), (int64_t) avg, NULL, NULL);
+        }
     }
 
     /* Hmm, if the timestamp is 0, then it wasn't set and we take the current time */
@@ -1096,6 +1120,7 @@ static int unsuspend(struct userdata *u) {
     pa_smoother_reset(u->smoother, pa_rtclock_now(), TRUE);
     u->smoother_interval = SMOOTHER_MIN_INTERVAL;
     u->last_smoother_update = 0;
+    pa_alsa_tstamp_jitter_reset(&u->tstamp_jitter);
 
     u->first = TRUE;
     u->since_start = 0;
@@ -1126,6 +1151,17 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
 
     switch (code) {
 
+        case SINK_MESSAGE_TSTAMP_JITTER: {
+            /* This message is sent from IO-thread and handled in main thread. */
+            pa_proplist *pl = pa_proplist_new();
+
+            pa_alsa_tstamp_jitter_proplist(pl, (pa_usec_t) offset, (pa_usec_t) PA_PTR_TO_UINT(data));
+            pa_sink_update_proplist(u->sink, PA_UPDATE_REPLACE, pl);
+            pa_proplist_free(pl);
+
+            return 0;
+        }
+
         case PA_SINK_MESSAGE_GET_LATENCY: {
             pa_usec_t r = 0;
 
@@ -1200,14 +1236,23 @@ static int sink_set_state_cb(pa_sink *s, pa_sink_state_t new_state) {
     return 0;
 }
 
+static void drop_mixer_handles(struct userdata *u) {
+    if (u->mixer_path_set)
+        pa_alsa_path_set_drop_handles(u->mixer_path_set, u->mixer_handle);
+    else if (u->mixer_path)
+        pa_alsa_path_drop_handles(u->mixer_path, u->mixer_handle);
+}
+
 static int ctl_mixer_callback(snd_mixer_elem_t *elem, unsigned int mask) {
     struct userdata *u = snd_mixer_elem_get_callback_private(elem);
 
     pa_assert(u);
     pa_assert(u->mixer_handle);
 
-    if (mask == SND_CTL_EVENT_MASK_REMOVE)
+    if (mask == SND_CTL_EVENT_MASK_REMOVE) {
+        drop_mixer_handles(u);
         return 0;
+    }
 
     if (!PA_SINK_IS_LINKED(u->sink->state))
         return 0;
@@ -1229,8 +1274,10 @@ static int io_mixer_callback(snd_mixer_elem_t *elem, unsigned int mask) {
     pa_assert(u);
     pa_assert(u->mixer_handle);
 
-    if (mask == SND_CTL_EVENT_MASK_REMOVE)
+    if (mask == SND_CTL_EVENT_MASK_REMOVE) {
+        drop_mixer_handles(u);
         return 0;
+    }
 
     if (u->sink->suspend_cause & PA_SUSPEND_SESSION)
         return 0;
@@ -2069,6 +2116,7 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
             pa_rtclock_now(),
             TRUE);
     u->smoother_interval = SMOOTHER_MIN_INTERVAL;
+    u->use_htstamp = TRUE;
 
     dev_id = pa_modargs_get_value(
             ma, "device_id",
@@ -2382,6 +2430,9 @@ static void userdata_free(struct userdata *u) {
     if (u->mixer_fdl)
         pa_alsa_fdlist_free(u->mixer_fdl);
 
+    if (u->mixer_handle)
+        drop_mixer_handles(u);
+
     if (u->mixer_path && !u->mixer_path_set)
         pa_alsa_path_free(u->mixer_path);
 
@@ -77,8 +77,15 @@
 #define SMOOTHER_MIN_INTERVAL (2*PA_USEC_PER_MSEC)                 /* 2ms */
 #define SMOOTHER_MAX_INTERVAL (200*PA_USEC_PER_MSEC)               /* 200ms */
 
+#define TSTAMP_MAX_AGE_USEC (1*PA_USEC_PER_SEC)                    /* 1s */
+#define TSTAMP_JITTER_PERIOD_USEC (10*PA_USEC_PER_SEC)             /* 10s */
+
 #define VOLUME_ACCURACY (PA_VOLUME_NORM/100)
 
+enum {
+    SOURCE_MESSAGE_TSTAMP_JITTER = PA_SOURCE_MESSAGE_MAX
+};
+
 struct userdata {
     pa_core *core;
     pa_module *module;
@@ -134,6 +141,9 @@ struct userdata {
     pa_usec_t smoother_interval;
     pa_usec_t last_smoother_update;
 
+    pa_bool_t use_htstamp;
+    pa_alsa_tstamp_jitter tstamp_jitter;
+
     pa_reserve_wrapper *reserve;
     pa_hook_slot *reserve_slot;
     pa_reserve_monitor_wrapper *monitor;
@@ -773,17 +783,31 @@ static void update_smoother(struct userdata *u) {
 
     /* Let's update the time smoother */
 
-    if (PA_UNLIKELY((err = pa_alsa_safe_delay(u->pcm_handle, &delay, u->hwbuf_size, &u->source->sample_spec, TRUE)) < 0)) {
+    if (PA_UNLIKELY((err = pa_alsa_safe_delay(u->pcm_handle, status, &delay, u->hwbuf_size, &u->source->sample_spec, TRUE)) < 0)) {
         pa_log_warn("Failed to get delay: %s", pa_alsa_strerror(err));
         return;
     }
 
-    if (PA_UNLIKELY((err = snd_pcm_status(u->pcm_handle, status)) < 0))
-        pa_log_warn("Failed to get timestamp: %s", pa_alsa_strerror(err));
-    else {
+    if (u->use_htstamp) {
         snd_htimestamp_t htstamp = { 0, 0 };
+        pa_usec_t now;
+
         snd_pcm_status_get_htstamp(status, &htstamp);
         now1 = pa_timespec_load(&htstamp);
+        now = pa_rtclock_now();
+
+        /* If the timestamp is not on our clock, don't trust it again */
+        if (now1 > 0 && (now1 > now || now1 + TSTAMP_MAX_AGE_USEC < now)) {
+            pa_log_info("Driver timestamps are not usable, falling back to system time.");
+            u->use_htstamp = FALSE;
+            now1 = now;
+        } else if (now1 > 0) {
+            pa_usec_t avg, max;
+
+            /* max is below TSTAMP_MAX_AGE_USEC, it fits */
+            if (pa_alsa_tstamp_jitter_update(&u->tstamp_jitter, now1, now, TSTAMP_JITTER_PERIOD_USEC, &avg, &max))
+                pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(u->source), SOURCE_MESSAGE_TSTAMP_JITTER, PA_UINT_TO_PTR((unsigned) max), (int64_t) avg, NULL, NULL);
+        }
     }
 
     /* Hmm, if the timestamp is 0, then it wasn't set and we take the current time */
@@ -1003,6 +1027,7 @@ static int unsuspend(struct userdata *u) {
     pa_smoother_reset(u->smoother, pa_rtclock_now(), TRUE);
     u->smoother_interval = SMOOTHER_MIN_INTERVAL;
     u->last_smoother_update = 0;
+    pa_alsa_tstamp_jitter_reset(&u->tstamp_jitter);
 
     u->first = TRUE;
 
@@ -1029,6 +1054,17 @@ static int source_process_msg(pa_msgobject *o, int code, void *data, int64_t off
 
     switch (code) {
 
+        case SOURCE_MESSAGE_TSTAMP_JITTER: {
+            /* This message is sent from IO-thread and handled in main thread. */
+            pa_proplist *pl = pa_proplist_new();
+
+            pa_alsa_tstamp_jitter_proplist(pl, (pa_usec_t) offset, (pa_usec_t) PA_PTR_TO_UINT(data));
+            pa_source_update_proplist(u->source, PA_UPDATE_REPLACE, pl);
+            pa_proplist_free(pl);
+
+            return 0;
+        }
+
         case PA_SOURCE_MESSAGE_GET_LATENCY: {
             pa_usec_t r = 0;
 
@@ -1103,14 +1139,23 @@ static int source_set_state_cb(pa_source *s, pa_source_state_t new_state) {
     return 0;
 }
 
+static void drop_mixer_handles(struct userdata *u) {
+    if (u->mixer_path_set)
+        pa_alsa_path_set_drop_handles(u->mixer_path_set, u->mixer_handle);
+    else if (u->mixer_path)
+        pa_alsa_path_drop_handles(u->mixer_path, u->mixer_handle);
+}
+
 static int ctl_mixer_callback(snd_mixer_elem_t *elem, unsigned int mask) {
     struct userdata *u = snd_mixer_elem_get_callback_private(elem);
 
     pa_assert(u);
     pa_assert(u->mixer_handle);
 
-    if (mask == SND_CTL_EVENT_MASK_REMOVE)
+    if (mask == SND_CTL_EVENT_MASK_REMOVE) {
+        drop_mixer_handles(u);
         return 0;
+    }
 
     if (!PA_SOURCE_IS_LINKED(u->source->state))
         return 0;
@@ -1132,8 +1177,10 @@ static int io_mixer_callback(snd_mixer_elem_t *elem, unsigned int mask) {
     pa_assert(u);
     pa_assert(u->mixer_handle);
 
-    if (mask == SND_CTL_EVENT_MASK_REMOVE)
+    if (mask == SND_CTL_EVENT_MASK_REMOVE) {
+        drop_mixer_handles(u);
         return 0;
+    }
 
     if (u->source->suspend_cause & PA_SUSPEND_SESSION)
         return 0;
@@ -1799,6 +1846,7 @@ pa_source *pa_alsa_source_new(pa_module *m, pa_modargs *ma, const char*driver, p
             pa_rtclock_now(),
             TRUE);
     u->smoother_interval = SMOOTHER_MIN_INTERVAL;
+    u->use_htstamp = TRUE;
 
     dev_id = pa_modargs_get_value(
             ma, "device_id",
@@ -2082,6 +2130,9 @@ static void userdata_free(struct userdata *u) {
     if (u->mixer_fdl)
         pa_alsa_fdlist_free(u->mixer_fdl);
 
+    if (u->mixer_handle)
+        drop_mixer_handles(u);
+
     if (u->mixer_path && !u->mixer_path_set)
         pa_alsa_path_free(u->mixer_path);
 
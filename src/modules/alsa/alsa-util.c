@@ -25,6 +25,7 @@
 #endif
 
 #include <sys/types.h>
+#include <errno.h>
 #include <asoundlib.h>
 
 #include <pulse/sample.h>
@@ -732,6 +733,7 @@ snd_pcm_t *pa_alsa_open_by_device_string(
 fail:
     pa_xfree(d);
 
+    errno = -err;
     return NULL;
 }
 
@@ -751,6 +753,7 @@ snd_pcm_t *pa_alsa_open_by_template(
 
     snd_pcm_t *pcm_handle;
     char **i;
+    int err = ENOENT;
 
     for (i = template; *i; i++) {
         char *d;
@@ -770,12 +773,16 @@ snd_pcm_t *pa_alsa_open_by_template(
                 use_tsched,
                 require_exact_channel_number);
 
+        if (!pcm_handle)
+            err = errno;
+
         pa_xfree(d);
 
         if (pcm_handle)
             return pcm_handle;
     }
 
+    errno = err;
     return NULL;
 }
 
@@ -1149,24 +1156,30 @@ snd_pcm_sframes_t pa_alsa_safe_avail(snd_pcm_t *pcm, size_t hwbuf_size, const pa
     return n;
 }
 
-int pa_alsa_safe_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delay, size_t hwbuf_size, const pa_sample_spec *ss, pa_bool_t capture) {
+int pa_alsa_safe_delay(snd_pcm_t *pcm, snd_pcm_status_t *status, snd_pcm_sframes_t *delay, size_t hwbuf_size, const pa_sample_spec *ss, pa_bool_t capture) {
     ssize_t k;
     size_t abs_k;
     int r;
     snd_pcm_sframes_t avail = 0;
 
     pa_assert(pcm);
+    pa_assert(status);
     pa_assert(delay);
     pa_assert(hwbuf_size > 0);
     pa_assert(ss);
 
     /* Some ALSA driver expose weird bugs, let's inform the user about
      * what is going on. We're going to get both the avail and delay values so
-     * that we can compare and check them for capture */
+     * that we can compare and check them for capture. We take them from a
+     * single status snapshot so that they are consistent with the
+     * timestamp the driver stored in it. */
 
-    if ((r = snd_pcm_avail_delay(pcm, &avail, delay)) < 0)
+    if ((r = snd_pcm_status(pcm, status)) < 0)
         return r;
 
+    avail = (snd_pcm_sframes_t) snd_pcm_status_get_avail(status);
+    *delay = snd_pcm_status_get_delay(status);
+
     k = (ssize_t) *delay * (ssize_t) pa_frame_size(ss);
 
     abs_k = k >= 0 ? (size_t) k : (size_t) -k;
@@ -1234,6 +1247,57 @@ int pa_alsa_safe_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delay, size_t hwbuf_si
     return 0;
 }
 
+/* The timestamp stored in the PCM status is taken by the driver at the
+ * same moment as the hardware pointer it reports, so pairing it with the
+ * delay from the same snapshot keeps our own scheduling latency out of the
+ * smoother. What we accumulate here is how far our clock has moved on by
+ * the time we read the snapshot, i.e. the error a pa_rtclock_now() read
+ * would have introduced. */
+void pa_alsa_tstamp_jitter_reset(pa_alsa_tstamp_jitter *j) {
+    pa_assert(j);
+
+    j->n = 0;
+}
+
+pa_bool_t pa_alsa_tstamp_jitter_update(pa_alsa_tstamp_jitter *j, pa_usec_t tstamp, pa_usec_t now, pa_usec_t period, pa_usec_t *avg, pa_usec_t *max) {
+    pa_usec_t jitter;
+
+    pa_assert(j);
+    pa_assert(avg);
+    pa_assert(max);
+
+    jitter = now > tstamp ? now - tstamp : 0;
+
+    if (j->n == 0) {
+        j->sum = j->max = 0;
+        j->since = now;
+    }
+
+    j->sum += jitter;
+    j->max = PA_MAX(j->max, jitter);
+    j->n++;
+
+    if (j->since + period > now)
+        return FALSE;
+
+    *avg = j->sum / j->n;
+    *max = j->max;
+
+    pa_log_debug("Timestamp jitter over %u updates: avg %0.2f ms, max %0.2f ms",
+                 j->n, (double) *avg / PA_USEC_PER_MSEC, (double) *max / PA_USEC_PER_MSEC);
+
+    j->n = 0;
+
+    return TRUE;
+}
+
+void pa_alsa_tstamp_jitter_proplist(pa_proplist *p, pa_usec_t avg, pa_usec_t max) {
+    pa_assert(p);
+
+    pa_proplist_setf(p, "alsa.timestamp_jitter.avg_usec", "%llu", (unsigned long long) avg);
+    pa_proplist_setf(p, "alsa.timestamp_jitter.max_usec", "%llu", (unsigned long long) max);
+}
+
 int pa_alsa_safe_mmap_begin(snd_pcm_t *pcm, const snd_pcm_channel_area_t **areas, snd_pcm_uframes_t *offset, snd_pcm_uframes_t *frames, size_t hwbuf_size, const pa_sample_spec *ss) {
     int r;
     snd_pcm_uframes_t before;
@@ -79,7 +79,7 @@ snd_pcm_t *pa_alsa_open_by_device_id_mapping(
         pa_bool_t *use_tsched,            /* modified at return */
         pa_alsa_mapping *mapping);
 
-/* Opens the explicit ALSA device */
+/* Opens the explicit ALSA device, sets errno on failure */
 snd_pcm_t *pa_alsa_open_by_device_string(
         const char *dir,
         char **dev,                       /* modified at return */
@@ -93,7 +93,8 @@ snd_pcm_t *pa_alsa_open_by_device_string(
         pa_bool_t *use_tsched,            /* modified at return */
         pa_bool_t require_exact_channel_number);
 
-/* Opens the explicit ALSA device with a fallback list */
+/* Opens the explicit ALSA device with a fallback list, sets errno to
+ * the error of the last device tried on failure */
 snd_pcm_t *pa_alsa_open_by_template(
         char **template,
         const char *dev_id,
@@ -125,7 +126,23 @@ int pa_alsa_recover_from_poll(snd_pcm_t *pcm, int revents);
 pa_rtpoll_item* pa_alsa_build_pollfd(snd_pcm_t *pcm, pa_rtpoll *rtpoll);
 
 snd_pcm_sframes_t pa_alsa_safe_avail(snd_pcm_t *pcm, size_t hwbuf_size, const pa_sample_spec *ss);
-int pa_alsa_safe_delay(snd_pcm_t *pcm, snd_pcm_sframes_t *delay, size_t hwbuf_size, const pa_sample_spec *ss, pa_bool_t capture);
+int pa_alsa_safe_delay(snd_pcm_t *pcm, snd_pcm_status_t *status, snd_pcm_sframes_t *delay, size_t hwbuf_size, const pa_sample_spec *ss, pa_bool_t capture);
+/* Statistics of the distance between the driver timestamps of status
+ * snapshots and our own clock at the time we read them */
+typedef struct pa_alsa_tstamp_jitter {
+    pa_usec_t sum, max, since;
+    unsigned n;
+} pa_alsa_tstamp_jitter;
+
+void pa_alsa_tstamp_jitter_reset(pa_alsa_tstamp_jitter *j);
+
+/* Returns TRUE once every period, filling in the average and maximum
+ * since the last time */
+pa_bool_t pa_alsa_tstamp_jitter_update(pa_alsa_tstamp_jitter *j, pa_usec_t tstamp, pa_usec_t now, pa_usec_t period, pa_usec_t *avg, pa_usec_t *max);
+
+/* Called from main context */
+void pa_alsa_tstamp_jitter_proplist(pa_proplist *p, pa_usec_t avg, pa_usec_t max);
+
 int pa_alsa_safe_mmap_begin(snd_pcm_t *pcm, const snd_pcm_channel_area_t **areas, snd_pcm_uframes_t *offset, snd_pcm_uframes_t *frames, size_t hwbuf_size, const pa_sample_spec *ss);
 
 char *pa_alsa_get_driver_name(int card);
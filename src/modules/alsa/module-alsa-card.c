@@ -23,8 +23,13 @@
 #include <config.h>
 #endif
 
+#include <errno.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
 #include <pulse/xmalloc.h>
 
+#include <pulsecore/core-error.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/i18n.h>
 #include <pulsecore/modargs.h>
@@ -69,6 +74,7 @@ PA_MODULE_USAGE(
         "deferred_volume=<Synchronize software and hardware volume changes to avoid momentary jumps?> "
         "profile_set=<profile set configuration file> "
         "paths_dir=<directory containing the path configuration files> "
+        "probe_cache=<reuse profile probing results from the last start?> "
 );
 
 static const char* const valid_modargs[] = {
@@ -95,6 +101,7 @@ static const char* const valid_modargs[] = {
     "deferred_volume",
     "profile_set",
     "paths_dir",
+    "probe_cache",
     NULL
 };
 
@@ -111,6 +118,9 @@ struct userdata {
     pa_modargs *modargs;
 
     pa_alsa_profile_set *profile_set;
+
+    /* Set if the profile set came from the probe cache */
+    char *probe_cache_file;
 };
 
 struct profile_data {
@@ -172,6 +182,24 @@ static void add_disabled_profile(pa_hashmap *profiles) {
     pa_hashmap_put(profiles, p->name, p);
 }
 
+/* The cache is only trusted as long as the devices it lists actually
+ * work. If one of them fails to open, drop the cache so that the next
+ * start probes the card again. */
+static void invalidate_probe_cache(struct userdata *u, pa_alsa_mapping *am) {
+    pa_assert(u);
+
+    if (!u->probe_cache_file)
+        return;
+
+    pa_log_info("Cached mapping %s failed to open, removing probe cache %s", am->name, u->probe_cache_file);
+
+    if (unlink(u->probe_cache_file) < 0 && errno != ENOENT)
+        pa_log_warn("Failed to remove %s: %s", u->probe_cache_file, pa_cstrerror(errno));
+
+    pa_xfree(u->probe_cache_file);
+    u->probe_cache_file = NULL;
+}
+
 static int card_set_profile(pa_card *c, pa_card_profile *new_profile) {
     struct userdata *u;
     struct profile_data *nd, *od;
@@ -220,7 +248,8 @@ static int card_set_profile(pa_card *c, pa_card_profile *new_profile) {
         PA_IDXSET_FOREACH(am, nd->profile->output_mappings, idx) {
 
             if (!am->sink)
-                am->sink = pa_alsa_sink_new(c->module, u->modargs, __FILE__, c, am);
+                if (!(am->sink = pa_alsa_sink_new(c->module, u->modargs, __FILE__, c, am)))
+                    invalidate_probe_cache(u, am);
 
             if (sink_inputs && am->sink) {
                 pa_sink_move_all_finish(am->sink, sink_inputs, FALSE);
@@ -232,7 +261,8 @@ static int card_set_profile(pa_card *c, pa_card_profile *new_profile) {
         PA_IDXSET_FOREACH(am, nd->profile->input_mappings, idx) {
 
             if (!am->source)
-                am->source = pa_alsa_source_new(c->module, u->modargs, __FILE__, c, am);
+                if (!(am->source = pa_alsa_source_new(c->module, u->modargs, __FILE__, c, am)))
+                    invalidate_probe_cache(u, am);
 
             if (source_outputs && am->source) {
                 pa_source_move_all_finish(am->source, source_outputs, FALSE);
@@ -260,11 +290,87 @@ static void init_profile(struct userdata *u) {
 
     if (d->profile && d->profile->output_mappings)
         PA_IDXSET_FOREACH(am, d->profile->output_mappings, idx)
-            am->sink = pa_alsa_sink_new(u->module, u->modargs, __FILE__, u->card, am);
+            if (!(am->sink = pa_alsa_sink_new(u->module, u->modargs, __FILE__, u->card, am)))
+                invalidate_probe_cache(u, am);
 
     if (d->profile && d->profile->input_mappings)
         PA_IDXSET_FOREACH(am, d->profile->input_mappings, idx)
-            am->source = pa_alsa_source_new(u->module, u->modargs, __FILE__, u->card, am);
+            if (!(am->source = pa_alsa_source_new(u->module, u->modargs, __FILE__, u->card, am)))
+                invalidate_probe_cache(u, am);
+}
+
+/* Everything the probing result depends on: the card itself, the
+ * driver and library versions, the profile set and the parameters the
+ * PCMs are opened with. Returns NULL if the card can't be identified. */
+static char *probe_cache_key(struct userdata *u, int alsa_card_index, const char *profile_set) {
+    snd_ctl_t *ctl;
+    snd_ctl_card_info_t *info;
+    struct utsname un;
+    char *dev, *key;
+    char ss[PA_SAMPLE_SPEC_SNPRINT_MAX];
+    int err;
+
+    snd_ctl_card_info_alloca(&info);
+
+    dev = pa_sprintf_malloc("hw:%i", alsa_card_index);
+    err = snd_ctl_open(&ctl, dev, 0);
+    pa_xfree(dev);
+
+    if (err < 0)
+        return NULL;
+
+    if (snd_ctl_card_info(ctl, info) < 0 || uname(&un) < 0) {
+        snd_ctl_close(ctl);
+        return NULL;
+    }
+
+    key = pa_sprintf_malloc("%s|%s|%s|%s|%s|%s|alsa-lib %s|%s|%s|%s|%u|%u",
+                            snd_ctl_card_info_get_id(info),
+                            snd_ctl_card_info_get_driver(info),
+                            snd_ctl_card_info_get_name(info),
+                            snd_ctl_card_info_get_mixername(info),
+                            snd_ctl_card_info_get_components(info),
+                            un.release,
+                            snd_asoundlib_version(),
+                            PACKAGE_VERSION,
+                            profile_set ? profile_set : "default",
+                            pa_sample_spec_snprint(ss, sizeof(ss), &u->core->default_sample_spec),
+                            u->core->default_n_fragments,
+                            u->core->default_fragment_size_msec);
+
+    snd_ctl_close(ctl);
+
+    /* The key is stored as a single line */
+    for (dev = key; *dev; dev++)
+        if (*dev == '\n')
+            *dev = ' ';
+
+    return key;
+}
+
+static void probe_profile_set(struct userdata *u, int alsa_card_index, const char *profile_set, pa_bool_t use_cache) {
+    char *key = NULL, *fn = NULL, *t;
+
+    pa_assert(u);
+
+    if (use_cache && (key = probe_cache_key(u, alsa_card_index, profile_set))) {
+        t = pa_sprintf_malloc("alsa-probe-cache.%i", alsa_card_index);
+        fn = pa_state_path(t, TRUE);
+        pa_xfree(t);
+    }
+
+    if (fn && pa_alsa_profile_set_probe_from_cache(u->profile_set, fn, key) >= 0) {
+        u->probe_cache_file = fn;
+        fn = NULL;
+    } else {
+        pa_alsa_profile_set_probe(u->profile_set, u->device_id, &u->core->default_sample_spec, u->core->default_n_fragments, u->core->default_fragment_size_msec);
+
+        if (fn)
+            pa_alsa_profile_set_save_probe_cache(u->profile_set, fn, key);
+    }
+
+    pa_xfree(fn);
+    pa_xfree(key);
 }
 
 static void set_card_name(pa_card_new_data *data, pa_modargs *ma, const char *device_id) {
@@ -297,7 +403,7 @@ int pa__init(pa_module *m) {
     pa_card_new_data data;
     pa_modargs *ma;
     int alsa_card_index;
-    pa_bool_t ignore_dB = FALSE;
+    pa_bool_t ignore_dB = FALSE, probe_cache = TRUE;
     struct userdata *u;
     pa_reserve_wrapper *reserve = NULL;
     const char *description;
@@ -319,6 +425,11 @@ int pa__init(pa_module *m) {
         goto fail;
     }
 
+    if (pa_modargs_get_value_boolean(ma, "probe_cache", &probe_cache) < 0) {
+        pa_log("Failed to parse probe_cache argument.");
+        goto fail;
+    }
+
     m->userdata = u = pa_xnew0(struct userdata, 1);
     u->core = m->core;
     u->module = m;
@@ -352,14 +463,17 @@ int pa__init(pa_module *m) {
     }
 
     u->profile_set = pa_alsa_profile_set_new(fn, &u->core->default_channel_map);
-    pa_xfree(fn);
+
+    if (!u->profile_set) {
+        pa_xfree(fn);
+        goto fail;
+    }
 
     u->profile_set->ignore_dB = ignore_dB;
 
-    if (!u->profile_set)
-        goto fail;
+    probe_profile_set(u, alsa_card_index, fn, probe_cache);
+    pa_xfree(fn);
 
-    pa_alsa_profile_set_probe(u->profile_set, u->device_id, &m->core->default_sample_spec, m->core->default_n_fragments, m->core->default_fragment_size_msec);
     pa_alsa_profile_set_dump(u->profile_set);
 
     pa_card_new_data_init(&data);
@@ -492,6 +606,7 @@ void pa__done(pa_module*m) {
     if (u->profile_set)
         pa_alsa_profile_set_free(u->profile_set);
 
+    pa_xfree(u->probe_cache_file);
     pa_xfree(u->device_id);
     pa_xfree(u);
 
@@ -64,6 +64,9 @@ extern "C" {
 #define SBC_LE			0x00
 #define SBC_BE			0x01
 
+/* flags for sbc_init() and sbc_reinit() */
+#define SBC_FLAG_NO_SIMD	0x01	/* only use the generic C primitives */
+
 struct sbc_struct {
 	unsigned long flags;
 
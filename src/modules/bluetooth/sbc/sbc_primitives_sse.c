@@ -0,0 +1,309 @@
+/*
+ *
+ *  Bluetooth low-complexity, subband codec (SBC) library
+ *
+ *  Copyright (C) 2008-2010  Nokia Corporation
+ *  Copyright (C) 2004-2010  Marcel Holtmann <marcel@holtmann.org>
+ *  Copyright (C) 2004-2005  Henryk Ploetz <henryk@ploetzli.ch>
+ *  Copyright (C) 2005-2006  Brad Midgley <bmidgley@xmission.com>
+ *
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+
+#include <stdint.h>
+#include <limits.h>
+#include "sbc.h"
+#include "sbc_math.h"
+#include "sbc_tables.h"
+
+#include "sbc_primitives_sse.h"
+
+/*
+ * SSE2 optimizations
+ *
+ * Same algorithm as the MMX version, but a whole row of four subbands
+ * (or half a row of eight) fits into one register, so every pmaddwd
+ * does twice the work and no emms is needed.
+ */
+
+#ifdef SBC_BUILD_WITH_SSE_SUPPORT
+
+static inline void sbc_analyze_four_sse(const int16_t *in, int32_t *out,
+					const FIXED_T *consts)
+{
+	static const SBC_ALIGNED int32_t round_c[4] = {
+		1 << (SBC_PROTO_FIXED4_SCALE - 1),
+		1 << (SBC_PROTO_FIXED4_SCALE - 1),
+		1 << (SBC_PROTO_FIXED4_SCALE - 1),
+		1 << (SBC_PROTO_FIXED4_SCALE - 1),
+	};
+	__asm__ volatile (
+		"movdqu      (%0), %%xmm0\n"
+		"movdqu    16(%0), %%xmm1\n"
+		"pmaddwd     (%1), %%xmm0\n"
+		"pmaddwd   16(%1), %%xmm1\n"
+		"paddd       (%2), %%xmm0\n"
+		"paddd     %%xmm1, %%xmm0\n"
+		"\n"
+		"movdqu    32(%0), %%xmm1\n"
+		"movdqu    48(%0), %%xmm2\n"
+		"pmaddwd   32(%1), %%xmm1\n"
+		"pmaddwd   48(%1), %%xmm2\n"
+		"paddd     %%xmm1, %%xmm0\n"
+		"paddd     %%xmm2, %%xmm0\n"
+		"\n"
+		"movdqu    64(%0), %%xmm1\n"
+		"pmaddwd   64(%1), %%xmm1\n"
+		"paddd     %%xmm1, %%xmm0\n"
+		"\n"
+		"psrad         %4, %%xmm0\n"
+		"packssdw  %%xmm0, %%xmm0\n"
+		"\n"
+		"pshufd $0x00, %%xmm0, %%xmm1\n"
+		"pshufd $0x55, %%xmm0, %%xmm2\n"
+		"pmaddwd   80(%1), %%xmm1\n"
+		"pmaddwd   96(%1), %%xmm2\n"
+		"paddd     %%xmm2, %%xmm1\n"
+		"\n"
+		"movdqu    %%xmm1, (%3)\n"
+		:
+		: "r" (in), "r" (consts), "r" (&round_c), "r" (out),
+			"i" (SBC_PROTO_FIXED4_SCALE)
+		: "cc", "memory", "xmm0", "xmm1", "xmm2");
+}
+
+static inline void sbc_analyze_eight_sse(const int16_t *in, int32_t *out,
+							const FIXED_T *consts)
+{
+	static const SBC_ALIGNED int32_t round_c[4] = {
+		1 << (SBC_PROTO_FIXED8_SCALE - 1),
+		1 << (SBC_PROTO_FIXED8_SCALE - 1),
+		1 << (SBC_PROTO_FIXED8_SCALE - 1),
+		1 << (SBC_PROTO_FIXED8_SCALE - 1),
+	};
+	__asm__ volatile (
+		"movdqu      (%0), %%xmm0\n"
+		"movdqu    16(%0), %%xmm1\n"
+		"movdqu    32(%0), %%xmm2\n"
+		"movdqu    48(%0), %%xmm3\n"
+		"pmaddwd     (%1), %%xmm0\n"
+		"pmaddwd   16(%1), %%xmm1\n"
+		"pmaddwd   32(%1), %%xmm2\n"
+		"pmaddwd   48(%1), %%xmm3\n"
+		"paddd       (%2), %%xmm0\n"
+		"paddd       (%2), %%xmm1\n"
+		"paddd     %%xmm2, %%xmm0\n"
+		"paddd     %%xmm3, %%xmm1\n"
+		"\n"
+		"movdqu    64(%0), %%xmm2\n"
+		"movdqu    80(%0), %%xmm3\n"
+		"movdqu    96(%0), %%xmm4\n"
+		"movdqu   112(%0), %%xmm5\n"
+		"pmaddwd   64(%1), %%xmm2\n"
+		"pmaddwd   80(%1), %%xmm3\n"
+		"pmaddwd   96(%1), %%xmm4\n"
+		"pmaddwd  112(%1), %%xmm5\n"
+		"paddd     %%xmm2, %%xmm0\n"
+		"paddd     %%xmm3, %%xmm1\n"
+		"paddd     %%xmm4, %%xmm0\n"
+		"paddd     %%xmm5, %%xmm1\n"
+		"\n"
+		"movdqu   128(%0), %%xmm2\n"
+		"movdqu   144(%0), %%xmm3\n"
+		"pmaddwd  128(%1), %%xmm2\n"
+		"pmaddwd  144(%1), %%xmm3\n"
+		"paddd     %%xmm2, %%xmm0\n"
+		"paddd     %%xmm3, %%xmm1\n"
+		"\n"
+		"psrad         %4, %%xmm0\n"
+		"psrad         %4, %%xmm1\n"
+		"packssdw  %%xmm1, %%xmm0\n"
+		"\n"
+		"pshufd $0x00, %%xmm0, %%xmm2\n"
+		"movdqa    %%xmm2, %%xmm3\n"
+		"pmaddwd  160(%1), %%xmm2\n"
+		"pmaddwd  176(%1), %%xmm3\n"
+		"\n"
+		"pshufd $0x55, %%xmm0, %%xmm4\n"
+		"movdqa    %%xmm4, %%xmm5\n"
+		"pmaddwd  192(%1), %%xmm4\n"
+		"pmaddwd  208(%1), %%xmm5\n"
+		"paddd     %%xmm4, %%xmm2\n"
+		"paddd     %%xmm5, %%xmm3\n"
+		"\n"
+		"pshufd $0xaa, %%xmm0, %%xmm4\n"
+		"movdqa    %%xmm4, %%xmm5\n"
+		"pmaddwd  224(%1), %%xmm4\n"
+		"pmaddwd  240(%1), %%xmm5\n"
+		"paddd     %%xmm4, %%xmm2\n"
+		"paddd     %%xmm5, %%xmm3\n"
+		"\n"
+		"pshufd $0xff, %%xmm0, %%xmm4\n"
+		"movdqa    %%xmm4, %%xmm5\n"
+		"pmaddwd  256(%1), %%xmm4\n"
+		"pmaddwd  272(%1), %%xmm5\n"
+		"paddd     %%xmm4, %%xmm2\n"
+		"paddd     %%xmm5, %%xmm3\n"
+		"\n"
+		"movdqu    %%xmm2, (%3)\n"
+		"movdqu    %%xmm3, 16(%3)\n"
+		:
+		: "r" (in), "r" (consts), "r" (&round_c), "r" (out),
+			"i" (SBC_PROTO_FIXED8_SCALE)
+		: "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4",
+			"xmm5");
+}
+
+static inline void sbc_analyze_4b_4s_sse(int16_t *x, int32_t *out,
+						int out_stride)
+{
+	/* Analyze blocks */
+	sbc_analyze_four_sse(x + 12, out, analysis_consts_fixed4_simd_odd);
+	out += out_stride;
+	sbc_analyze_four_sse(x + 8, out, analysis_consts_fixed4_simd_even);
+	out += out_stride;
+	sbc_analyze_four_sse(x + 4, out, analysis_consts_fixed4_simd_odd);
+	out += out_stride;
+	sbc_analyze_four_sse(x + 0, out, analysis_consts_fixed4_simd_even);
+}
+
+static inline void sbc_analyze_4b_8s_sse(int16_t *x, int32_t *out,
+						int out_stride)
+{
+	/* Analyze blocks */
+	sbc_analyze_eight_sse(x + 24, out, analysis_consts_fixed8_simd_odd);
+	out += out_stride;
+	sbc_analyze_eight_sse(x + 16, out, analysis_consts_fixed8_simd_even);
+	out += out_stride;
+	sbc_analyze_eight_sse(x + 8, out, analysis_consts_fixed8_simd_odd);
+	out += out_stride;
+	sbc_analyze_eight_sse(x + 0, out, analysis_consts_fixed8_simd_even);
+}
+
+static void sbc_calc_scalefactors_sse(
+	int32_t sb_sample_f[16][2][8],
+	uint32_t scale_factor[2][8],
+	int blocks, int channels, int subbands)
+{
+	static const SBC_ALIGNED int32_t consts[4] = {
+		1 << SCALE_OUT_BITS,
+		1 << SCALE_OUT_BITS,
+		1 << SCALE_OUT_BITS,
+		1 << SCALE_OUT_BITS,
+	};
+	int ch, sb;
+	intptr_t blk;
+	for (ch = 0; ch < channels; ch++) {
+		for (sb = 0; sb < subbands; sb += 4) {
+			blk = (blocks - 1) * (((char *) &sb_sample_f[1][0][0] -
+				(char *) &sb_sample_f[0][0][0]));
+			__asm__ volatile (
+				"movdqa       (%4), %%xmm0\n"
+				"pxor        %%xmm2, %%xmm2\n"
+			"1:\n"
+				"movdqu   (%1, %0), %%xmm1\n"
+				"movdqa      %%xmm1, %%xmm3\n"
+				"pcmpgtd     %%xmm2, %%xmm1\n"
+				"paddd       %%xmm3, %%xmm1\n"
+				"movdqa      %%xmm2, %%xmm3\n"
+				"pcmpgtd     %%xmm1, %%xmm3\n"
+				"pxor        %%xmm3, %%xmm1\n"
+
+				"por         %%xmm1, %%xmm0\n"
+
+				"sub            %2, %0\n"
+				"jns            1b\n"
+
+				"movd        %%xmm0, %k0\n"
+				"bsrl          %k0, %k0\n"
+				"subl           %5, %k0\n"
+				"movl          %k0, (%3)\n"
+
+				"pshufd $0x39, %%xmm0, %%xmm0\n"
+				"movd        %%xmm0, %k0\n"
+				"bsrl          %k0, %k0\n"
+				"subl           %5, %k0\n"
+				"movl          %k0, 4(%3)\n"
+
+				"pshufd $0x39, %%xmm0, %%xmm0\n"
+				"movd        %%xmm0, %k0\n"
+				"bsrl          %k0, %k0\n"
+				"subl           %5, %k0\n"
+				"movl          %k0, 8(%3)\n"
+
+				"pshufd $0x39, %%xmm0, %%xmm0\n"
+				"movd        %%xmm0, %k0\n"
+				"bsrl          %k0, %k0\n"
+				"subl           %5, %k0\n"
+				"movl          %k0, 12(%3)\n"
+			: "+r" (blk)
+			: "r" (&sb_sample_f[0][ch][sb]),
+				"i" ((char *) &sb_sample_f[1][0][0] -
+					(char *) &sb_sample_f[0][0][0]),
+				"r" (&scale_factor[ch][sb]),
+				"r" (&consts),
+				"i" (SCALE_OUT_BITS)
+			: "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3");
+		}
+	}
+}
+
+static int check_sse2_support(void)
+{
+#ifdef __amd64__
+	return 1; /* SSE2 is part of the 64-bit instruction set */
+#else
+	int cpuid_feature_information;
+	__asm__ volatile (
+		/* According to Intel manual, CPUID instruction is supported
+		 * if the value of ID bit (bit 21) in EFLAGS can be modified */
+		"pushf\n"
+		"movl     (%%esp),   %0\n"
+		"xorl     $0x200000, (%%esp)\n" /* try to modify ID bit */
+		"popf\n"
+		"pushf\n"
+		"xorl     (%%esp),   %0\n"      /* check if ID bit changed */
+		"jz       1f\n"
+		"push     %%eax\n"
+		"push     %%ebx\n"
+		"push     %%ecx\n"
+		"mov      $1,        %%eax\n"
+		"cpuid\n"
+		"pop      %%ecx\n"
+		"pop      %%ebx\n"
+		"pop      %%eax\n"
+		"1:\n"
+		"popf\n"
+		: "=d" (cpuid_feature_information)
+		:
+		: "cc");
+    return cpuid_feature_information & (1 << 26);
+#endif
+}
+
+void sbc_init_primitives_sse(struct sbc_encoder_state *state)
+{
+	if (check_sse2_support()) {
+		state->sbc_analyze_4b_4s = sbc_analyze_4b_4s_sse;
+		state->sbc_analyze_4b_8s = sbc_analyze_4b_8s_sse;
+		state->sbc_calc_scalefactors = sbc_calc_scalefactors_sse;
+		state->implementation_info = "SSE2";
+	}
+}
+
+#endif
@@ -51,6 +51,11 @@ struct userdata {
     pa_time_event *time_event;
     char *sink_filename, *source_filename;
     pa_bool_t modified;
+
+    /* Saved defaults that didn't exist yet when we were loaded, for
+     * example because cards are probed after startup */
+    char *pending_sink, *pending_source;
+    pa_hook_slot *sink_put_slot, *source_put_slot;
 };
 
 static void load(struct userdata *u) {
@@ -73,8 +78,10 @@ static void load(struct userdata *u) {
         else if ((s = pa_namereg_get(u->core, ln, PA_NAMEREG_SINK))) {
             pa_namereg_set_default_sink(u->core, s);
             pa_log_info("Restored default sink '%s'.", ln);
-        } else
-            pa_log_info("Saved default sink '%s' not existent, not restoring default sink setting.", ln);
+        } else {
+            pa_log_info("Saved default sink '%s' not existent, restoring default sink setting once it appears.", ln);
+            u->pending_sink = pa_xstrdup(ln);
+        }
 
     } else if (errno != ENOENT)
         pa_log("Failed to load default sink: %s", pa_cstrerror(errno));
@@ -94,8 +101,10 @@ static void load(struct userdata *u) {
         else if ((s = pa_namereg_get(u->core, ln, PA_NAMEREG_SOURCE))) {
             pa_namereg_set_default_source(u->core, s);
             pa_log_info("Restored default source '%s'.", ln);
-        } else
-            pa_log_info("Saved default source '%s' not existent, not restoring default source setting.", ln);
+        } else {
+            pa_log_info("Saved default source '%s' not existent, restoring default source setting once it appears.", ln);
+            u->pending_source = pa_xstrdup(ln);
+        }
 
     } else if (errno != ENOENT)
             pa_log("Failed to load default sink: %s", pa_cstrerror(errno));
@@ -110,7 +119,12 @@ static void save(struct userdata *u) {
     if (u->sink_filename) {
         if ((f = pa_fopen_cloexec(u->sink_filename, "w"))) {
             pa_sink *s = pa_namereg_get_default_sink(u->core);
-            fprintf(f, "%s\n", s ? s->name : "");
+
+            /* Don't forget a saved default that is yet to appear */
+            if (u->pending_sink && !u->core->default_sink)
+                fprintf(f, "%s\n", u->pending_sink);
+            else
+                fprintf(f, "%s\n", s ? s->name : "");
             fclose(f);
         } else
             pa_log("Failed to save default sink: %s", pa_cstrerror(errno));
@@ -119,7 +133,11 @@ static void save(struct userdata *u) {
     if (u->source_filename) {
         if ((f = pa_fopen_cloexec(u->source_filename, "w"))) {
             pa_source *s = pa_namereg_get_default_source(u->core);
-            fprintf(f, "%s\n", s ? s->name : "");
+
+            if (u->pending_source && !u->core->default_source)
+                fprintf(f, "%s\n", u->pending_source);
+            else
+                fprintf(f, "%s\n", s ? s->name : "");
             fclose(f);
         } else
             pa_log("Failed to save default source: %s", pa_cstrerror(errno));
@@ -151,6 +169,44 @@ static void subscribe_cb(pa_core *c, pa_subscription_event_type_t t, uint32_t id
         u->time_event = pa_core_rttime_new(u->core, pa_rtclock_now() + SAVE_INTERVAL, time_cb, u);
 }
 
+static pa_hook_result_t sink_put_hook_cb(pa_core *c, pa_sink *sink, struct userdata *u) {
+    pa_assert(u);
+
+    if (!u->pending_sink || !pa_streq(sink->name, u->pending_sink))
+        return PA_HOOK_OK;
+
+    pa_xfree(u->pending_sink);
+    u->pending_sink = NULL;
+
+    if (c->default_sink)
+        pa_log_info("Manually configured default sink, not overwriting.");
+    else {
+        pa_namereg_set_default_sink(c, sink);
+        pa_log_info("Restored default sink '%s'.", sink->name);
+    }
+
+    return PA_HOOK_OK;
+}
+
+static pa_hook_result_t source_put_hook_cb(pa_core *c, pa_source *source, struct userdata *u) {
+    pa_assert(u);
+
+    if (!u->pending_source || !pa_streq(source->name, u->pending_source))
+        return PA_HOOK_OK;
+
+    pa_xfree(u->pending_source);
+    u->pending_source = NULL;
+
+    if (c->default_source)
+        pa_log_info("Manually configured default source, not overwriting.");
+    else {
+        pa_namereg_set_default_source(c, source);
+        pa_log_info("Restored default source '%s'.", source->name);
+    }
+
+    return PA_HOOK_OK;
+}
+
 int pa__init(pa_module *m) {
     struct userdata *u;
 
@@ -167,6 +223,9 @@ int pa__init(pa_module *m) {
 
     load(u);
 
+    u->sink_put_slot = pa_hook_connect(&m->core->hooks[PA_CORE_HOOK_SINK_PUT], PA_HOOK_LATE, (pa_hook_cb_t) sink_put_hook_cb, u);
+    u->source_put_slot = pa_hook_connect(&m->core->hooks[PA_CORE_HOOK_SOURCE_PUT], PA_HOOK_LATE, (pa_hook_cb_t) source_put_hook_cb, u);
+
     u->subscription = pa_subscription_new(u->core, PA_SUBSCRIPTION_MASK_SERVER, subscribe_cb, u);
 
     return 0;
@@ -193,6 +252,14 @@ void pa__done(pa_module*m) {
     if (u->time_event)
         m->core->mainloop->time_free(u->time_event);
 
+    if (u->sink_put_slot)
+        pa_hook_slot_free(u->sink_put_slot);
+
+    if (u->source_put_slot)
+        pa_hook_slot_free(u->source_put_slot);
+
+    pa_xfree(u->pending_sink);
+    pa_xfree(u->pending_source);
     pa_xfree(u->sink_filename);
     pa_xfree(u->source_filename);
     pa_xfree(u);
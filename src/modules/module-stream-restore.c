@@ -52,6 +52,7 @@
 #include <pulsecore/database.h>
 #include <pulsecore/tagstruct.h>
 #include <pulsecore/proplist-util.h>
+#include <pulsecore/llist.h>
 
 #ifdef HAVE_DBUS
 #include <pulsecore/dbus-util.h>
@@ -70,10 +71,12 @@ PA_MODULE_USAGE(
         "restore_muted=<Save/restore muted states?> "
         "on_hotplug=<When new device becomes available, recheck streams?> "
         "on_rescue=<When device becomes unavailable, recheck streams?> "
-        "fallback_table=<filename>");
+        "fallback_table=<filename> "
+        "cache_size=<Number of decoded entries to keep in memory>");
 
 #define SAVE_INTERVAL (10 * PA_USEC_PER_SEC)
 #define IDENTIFICATION_PROPERTY "module-stream-restore.id"
+#define DEFAULT_CACHE_SIZE 1024
 
 #define DEFAULT_FALLBACK_FILE PA_DEFAULT_CONFIG_DIR"/stream-restore.table"
 #define DEFAULT_FALLBACK_FILE_USER "stream-restore.table"
@@ -87,6 +90,7 @@ static const char* const valid_modargs[] = {
     "on_hotplug",
     "on_rescue",
     "fallback_table",
+    "cache_size",
     NULL
 };
 
@@ -116,6 +120,14 @@ struct userdata {
     pa_native_protocol *protocol;
     pa_idxset *subscribed;
 
+    /* Decoded entries by name, most recently used first. Names that
+     * aren't in the database are cached too, with a NULL entry. */
+    pa_hashmap *cache;
+    PA_LLIST_HEAD(struct cache_entry, cache_lru);
+    struct cache_entry *cache_lru_tail;
+    uint32_t cache_size;
+    uint64_t cache_hits, cache_misses;
+
 #ifdef HAVE_DBUS
     pa_dbus_protocol *dbus_protocol;
     pa_hashmap *dbus_entries;
@@ -135,13 +147,20 @@ struct entry {
     char* card;
 };
 
+struct cache_entry {
+    char *name;
+    struct entry *entry;
+    PA_LLIST_FIELDS(struct cache_entry);
+};
+
 enum {
     SUBCOMMAND_TEST,
     SUBCOMMAND_READ,
     SUBCOMMAND_WRITE,
     SUBCOMMAND_DELETE,
     SUBCOMMAND_SUBSCRIBE,
-    SUBCOMMAND_EVENT
+    SUBCOMMAND_EVENT,
+    SUBCOMMAND_GET_STATS
 };
 
 
@@ -152,6 +171,8 @@ static pa_bool_t entry_write(struct userdata *u, const char *name, const struct
 static struct entry* entry_copy(const struct entry *e);
 static void entry_apply(struct userdata *u, const char *name, struct entry *e);
 static void trigger_save(struct userdata *u);
+static void cache_remove(struct userdata *u, const char *name);
+static void cache_clear(struct userdata *u);
 
 #ifdef HAVE_DBUS
 
@@ -945,6 +966,7 @@ static void handle_entry_remove(DBusConnection *conn, DBusMessage *msg, void *us
     key.size = strlen(de->entry_name);
 
     pa_assert_se(pa_database_unset(de->userdata->database, &key) == 0);
+    cache_remove(de->userdata, de->entry_name);
 
     send_entry_removed_signal(de);
     trigger_save(de->userdata);
@@ -986,6 +1008,95 @@ static void entry_free(struct entry* e) {
     pa_xfree(e);
 }
 
+static void cache_entry_free(struct userdata *u, struct cache_entry *c) {
+    pa_assert(u);
+    pa_assert(c);
+
+    if (u->cache_lru_tail == c)
+        u->cache_lru_tail = c->prev;
+    PA_LLIST_REMOVE(struct cache_entry, u->cache_lru, c);
+
+    if (c->entry)
+        entry_free(c->entry);
+    pa_xfree(c->name);
+    pa_xfree(c);
+}
+
+static struct cache_entry *cache_get(struct userdata *u, const char *name) {
+    struct cache_entry *c;
+
+    pa_assert(u);
+    pa_assert(name);
+
+    if (!u->cache || !(c = pa_hashmap_get(u->cache, name)))
+        return NULL;
+
+    /* Move to the front */
+    if (c != u->cache_lru) {
+        if (u->cache_lru_tail == c)
+            u->cache_lru_tail = c->prev;
+        PA_LLIST_REMOVE(struct cache_entry, u->cache_lru, c);
+        PA_LLIST_PREPEND(struct cache_entry, u->cache_lru, c);
+    }
+
+    return c;
+}
+
+/* Stores a copy of e, or remembers that there is no entry if e is NULL */
+static void cache_put(struct userdata *u, const char *name, const struct entry *e) {
+    struct cache_entry *c;
+
+    pa_assert(u);
+    pa_assert(name);
+
+    if (!u->cache)
+        return;
+
+    if ((c = cache_get(u, name))) {
+        if (c->entry)
+            entry_free(c->entry);
+        c->entry = e ? entry_copy(e) : NULL;
+        return;
+    }
+
+    if (pa_hashmap_size(u->cache) >= u->cache_size) {
+        pa_assert(u->cache_lru_tail);
+        pa_assert_se(pa_hashmap_remove(u->cache, u->cache_lru_tail->name));
+        cache_entry_free(u, u->cache_lru_tail);
+    }
+
+    c = pa_xnew(struct cache_entry, 1);
+    c->name = pa_xstrdup(name);
+    c->entry = e ? entry_copy(e) : NULL;
+    PA_LLIST_PREPEND(struct cache_entry, u->cache_lru, c);
+    if (!u->cache_lru_tail)
+        u->cache_lru_tail = c;
+
+    pa_assert_se(pa_hashmap_put(u->cache, c->name, c) == 0);
+}
+
+static void cache_remove(struct userdata *u, const char *name) {
+    struct cache_entry *c;
+
+    pa_assert(u);
+    pa_assert(name);
+
+    if (u->cache && (c = pa_hashmap_remove(u->cache, name)))
+        cache_entry_free(u, c);
+}
+
+static void cache_clear(struct userdata *u) {
+    struct cache_entry *c;
+
+    pa_assert(u);
+
+    if (!u->cache)
+        return;
+
+    while ((c = pa_hashmap_steal_first(u->cache)))
+        cache_entry_free(u, c);
+}
+
 static pa_bool_t entry_write(struct userdata *u, const char *name, const struct entry *e, pa_bool_t replace) {
     pa_tagstruct *t;
     pa_datum key, data;
@@ -1016,6 +1127,9 @@ static pa_bool_t entry_write(struct userdata *u, const char *name, const struct
 
     pa_tagstruct_free(t);
 
+    if (r)
+        cache_put(u, name, e);
+
     return r;
 }
 
@@ -1094,7 +1208,7 @@ static struct entry* legacy_entry_read(struct userdata *u, pa_datum *data) {
 }
 #endif
 
-static struct entry *entry_read(struct userdata *u, const char *name) {
+static struct entry *entry_read_database(struct userdata *u, const char *name) {
     pa_datum key, data;
     struct entry *e = NULL;
     pa_tagstruct *t = NULL;
@@ -1185,6 +1299,26 @@ fail:
     return NULL;
 }
 
+static struct entry *entry_read(struct userdata *u, const char *name) {
+    struct cache_entry *c;
+    struct entry *e;
+
+    pa_assert(u);
+    pa_assert(name);
+
+    if ((c = cache_get(u, name))) {
+        u->cache_hits++;
+        return c->entry ? entry_copy(c->entry) : NULL;
+    }
+
+    u->cache_misses++;
+
+    e = entry_read_database(u, name);
+    cache_put(u, name, e);
+
+    return e;
+}
+
 static struct entry* entry_copy(const struct entry *e) {
     struct entry* r;
 
@@ -1846,8 +1980,10 @@ static int fill_db(struct userdata *u, const char *filename) {
                 data.data = (void *) &e;
                 data.size = sizeof(e);
 
-                if (pa_database_set(u->database, &key, &data, FALSE) == 0)
+                if (pa_database_set(u->database, &key, &data, FALSE) == 0) {
+                    cache_remove(u, ln);
                     pa_log_debug("Setting %s to %0.2f dB.", ln, db);
+                }
             } else
                 pa_log_warn("[%s:%u] Positive dB values are not allowed, not setting entry %s.", fn, n, ln);
         } else
@@ -1989,7 +2125,7 @@ PA_GCC_UNUSED static void stream_restore_dump_database(struct userdata *u) {
         name = pa_xstrndup(key.data, key.size);
         pa_datum_free(&key);
 
-        if ((e = entry_read(u, name))) {
+        if ((e = entry_read_database(u, name))) {
             char t[256];
             pa_log("name=%s", name);
             pa_log("device=%s %s", e->device, pa_yes_no(e->device_valid));
@@ -2006,7 +2142,7 @@ PA_GCC_UNUSED static void stream_restore_dump_database(struct userdata *u) {
 }
 #endif
 
-#define EXT_VERSION 1
+#define EXT_VERSION 2
 
 static int extension_cb(pa_native_protocol *p, pa_module *m, pa_native_connection *c, uint32_t tag, pa_tagstruct *t) {
     struct userdata *u;
@@ -2055,7 +2191,9 @@ static int extension_cb(pa_native_protocol *p, pa_module *m, pa_native_connectio
                 name = pa_xstrndup(key.data, key.size);
                 pa_datum_free(&key);
 
-                if ((e = entry_read(u, name))) {
+                /* Don't let a full scan push out the entries of the
+                 * streams that are actually in use */
+                if ((e = entry_read_database(u, name))) {
                     pa_cvolume r;
                     pa_channel_map cm;
 
@@ -2100,6 +2238,7 @@ static int extension_cb(pa_native_protocol *p, pa_module *m, pa_native_connectio
                 }
 #endif
                 pa_database_clear(u->database);
+                cache_clear(u);
             }
 
             while (!pa_tagstruct_eof(t)) {
@@ -2216,12 +2355,24 @@ static int extension_cb(pa_native_protocol *p, pa_module *m, pa_native_connectio
                 key.size = strlen(name);
 
                 pa_database_unset(u->database, &key);
+                cache_remove(u, name);
             }
 
             trigger_save(u);
 
             break;
 
+        case SUBCOMMAND_GET_STATS: {
+            if (!pa_tagstruct_eof(t))
+                goto fail;
+
+            pa_tagstruct_putu64(reply, u->cache_hits);
+            pa_tagstruct_putu64(reply, u->cache_misses);
+            pa_tagstruct_putu32(reply, u->cache ? pa_hashmap_size(u->cache) : 0);
+            pa_tagstruct_putu32(reply, u->cache_size);
+            break;
+        }
+
         case SUBCOMMAND_SUBSCRIBE: {
 
             pa_bool_t enabled;
@@ -2270,6 +2421,7 @@ int pa__init(pa_module*m) {
     pa_source_output *so;
     uint32_t idx;
     pa_bool_t restore_device = TRUE, restore_volume = TRUE, restore_muted = TRUE, on_hotplug = TRUE, on_rescue = TRUE;
+    uint32_t cache_size = DEFAULT_CACHE_SIZE;
 #ifdef HAVE_DBUS
     pa_datum key;
     pa_bool_t done;
@@ -2291,6 +2443,11 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    if (pa_modargs_get_value_u32(ma, "cache_size", &cache_size) < 0) {
+        pa_log("cache_size= expects a non-negative integer argument");
+        goto fail;
+    }
+
     if (!restore_muted && !restore_volume && !restore_device)
         pa_log_warn("Neither restoring volume, nor restoring muted, nor restoring device enabled!");
 
@@ -2304,6 +2461,9 @@ int pa__init(pa_module*m) {
     u->on_rescue = on_rescue;
     u->subscribed = pa_idxset_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
 
+    if ((u->cache_size = cache_size) > 0)
+        u->cache = pa_hashmap_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func);
+
     u->protocol = pa_native_protocol_get(m->core);
     pa_native_protocol_install_ext(u->protocol, m, extension_cb);
 
@@ -2369,8 +2529,8 @@ int pa__init(pa_module*m) {
         name = pa_xstrndup(key.data, key.size);
         pa_datum_free(&key);
 
-        /* Use entry_read() for checking that the entry is valid. */
-        if ((e = entry_read(u, name))) {
+        /* Use entry_read_database() for checking that the entry is valid. */
+        if ((e = entry_read_database(u, name))) {
             de = dbus_entry_new(u, name);
             pa_assert_se(pa_hashmap_put(u->dbus_entries, de->entry_name, de) == 0);
             entry_free(e);
@@ -2470,5 +2630,14 @@ void pa__done(pa_module*m) {
     if (u->subscribed)
         pa_idxset_free(u->subscribed, NULL, NULL);
 
+    if (u->cache) {
+        pa_log_debug("Entry cache: %llu hits, %llu misses.",
+                     (unsigned long long) u->cache_hits,
+                     (unsigned long long) u->cache_misses);
+
+        cache_clear(u);
+        pa_hashmap_free(u->cache, NULL, NULL);
+    }
+
     pa_xfree(u);
 }
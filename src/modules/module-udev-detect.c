@@ -47,7 +47,8 @@ PA_MODULE_USAGE(
         "tsched=<enable system timer based scheduling mode?> "
         "fixed_latency_range=<disable latency range changes on underrun?> "
         "ignore_dB=<ignore dB information from the device?> "
-        "deferred_volume=<syncronize sw and hw volume changes in IO-thread?>");
+        "deferred_volume=<syncronize sw and hw volume changes in IO-thread?> "
+        "defer_probe=<probe cards from the main loop after startup?>");
 
 struct device {
     char *path;
@@ -56,6 +57,7 @@ struct device {
     char *args;
     uint32_t module;
     pa_ratelimit ratelimit;
+    pa_bool_t probe_pending;
 };
 
 struct userdata {
@@ -66,6 +68,9 @@ struct userdata {
     pa_bool_t fixed_latency_range:1;
     pa_bool_t ignore_dB:1;
     pa_bool_t deferred_volume:1;
+    pa_bool_t defer_probe:1;
+
+    pa_defer_event *probe_event;
 
     struct udev* udev;
     struct udev_monitor *monitor;
@@ -80,6 +85,7 @@ static const char* const valid_modargs[] = {
     "fixed_latency_range",
     "ignore_dB",
     "deferred_volume",
+    "defer_probe",
     NULL
 };
 
@@ -282,6 +288,8 @@ static void verify_access(struct userdata *u, struct device *d) {
     pa_assert(u);
     pa_assert(d);
 
+    d->probe_pending = FALSE;
+
     cd = pa_sprintf_malloc("%s/snd/controlC%s", udev_get_dev_path(u->udev), path_get_card_id(d->path));
     accessible = access(cd, R_OK|W_OK) >= 0;
     pa_log_debug("%s is accessible: %s", cd, pa_yes_no(accessible));
@@ -406,9 +414,34 @@ static void card_changed(struct userdata *u, struct udev_device *dev) {
 
     pa_hashmap_put(u->devices, d->path, d);
 
+    if (u->defer_probe) {
+        /* Probing a card can take a while, so we do it from the main
+         * loop, one card per iteration. That way the rest of the
+         * startup script and the clients don't wait for all cards. */
+        d->probe_pending = TRUE;
+        u->core->mainloop->defer_enable(u->probe_event, 1);
+        return;
+    }
+
     verify_access(u, d);
 }
 
+static void probe_cb(pa_mainloop_api *a, pa_defer_event *e, void *userdata) {
+    struct userdata *u = userdata;
+    struct device *d;
+    void *state;
+
+    pa_assert(u);
+
+    PA_HASHMAP_FOREACH(d, u->devices, state)
+        if (d->probe_pending) {
+            verify_access(u, d);
+            return;
+        }
+
+    a->defer_enable(e, 0);
+}
+
 static void remove_card(struct userdata *u, struct udev_device *dev) {
     struct device *d;
 
@@ -670,7 +703,7 @@ int pa__init(pa_module *m) {
     struct udev_enumerate *enumerate = NULL;
     struct udev_list_entry *item = NULL, *first = NULL;
     int fd;
-    pa_bool_t use_tsched = TRUE, fixed_latency_range = FALSE, ignore_dB = FALSE, deferred_volume = m->core->deferred_volume;
+    pa_bool_t use_tsched = TRUE, fixed_latency_range = FALSE, ignore_dB = FALSE, deferred_volume = m->core->deferred_volume, defer_probe = FALSE;
 
 
     pa_assert(m);
@@ -709,6 +742,17 @@ int pa__init(pa_module *m) {
     }
     u->deferred_volume = deferred_volume;
 
+    if (pa_modargs_get_value_boolean(ma, "defer_probe", &defer_probe) < 0) {
+        pa_log("Failed to parse defer_probe= argument.");
+        goto fail;
+    }
+    u->defer_probe = defer_probe;
+
+    if (u->defer_probe) {
+        pa_assert_se(u->probe_event = m->core->mainloop->defer_new(m->core->mainloop, probe_cb, u));
+        m->core->mainloop->defer_enable(u->probe_event, 0);
+    }
+
     if (!(u->udev = udev_new())) {
         pa_log("Failed to initialize udev library.");
         goto fail;
@@ -765,7 +809,7 @@ int pa__init(pa_module *m) {
 
     udev_enumerate_unref(enumerate);
 
-    pa_log_info("Found %u cards.", pa_hashmap_size(u->devices));
+    pa_log_info("Found %u cards%s.", pa_hashmap_size(u->devices), u->defer_probe ? ", probing them later" : "");
 
     pa_modargs_free(ma);
 
@@ -792,6 +836,9 @@ void pa__done(pa_module *m) {
     if (!(u = m->userdata))
         return;
 
+    if (u->probe_event)
+        m->core->mainloop->defer_free(u->probe_event);
+
     if (u->udev_io)
         m->core->mainloop->io_free(u->udev_io);
 
@@ -0,0 +1,157 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include <pulsecore/endianmacros.h>
+#include <pulsecore/macro.h>
+
+#include "raop_packet.h"
+
+#define HEADER_SIZE 16
+
+/* The ALAC frame header is 55 bits long, 7 bytes with the last bit
+ * taken by the first sample */
+#define ALAC_HEADER_SIZE 7
+
+static const uint8_t header[HEADER_SIZE] = {
+    0x24, 0x00, 0x00, 0x00,
+    0xF0, 0xFF, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00,
+};
+
+size_t pa_raop_packet_size(size_t n_frames) {
+    return HEADER_SIZE + ALAC_HEADER_SIZE + n_frames * 4;
+}
+
+/* As the samples sit 7 bits into a byte, every 16 bit word written
+ * holds the last 7 bits of one sample and the first 9 of the next.
+ * prev is what goes before s[0], the last 7 bits of the frame size.
+ * Returns how many words were written. */
+static size_t pack_samples(uint16_t *d, const uint16_t *s, size_t n, uint16_t prev) {
+    size_t k;
+
+    if (n <= 0)
+        return 0;
+
+    d[0] = PA_UINT16_TO_BE((uint16_t) (prev << 9) | (s[0] >> 7));
+    k = 1;
+
+#if defined (__amd64__)
+    /* Eight at a time, the second load picks up the samples before
+     * the ones that are shifted in. No need to check for SSE2, all
+     * x86-64 CPUs have it. */
+    if (n >= 9) {
+        uint16_t *dp = d + 1;
+        const uint16_t *sp = s + 1;
+        size_t blocks = (n - 1) / 8;
+
+        k += blocks * 8;
+
+        __asm__ __volatile__ (
+            "1:                             \n\t"
+            " movdqu (%1), %%xmm0           \n\t"
+            " movdqu -2(%1), %%xmm1         \n\t"
+            " psrlw $7, %%xmm0              \n\t"
+            " psllw $9, %%xmm1              \n\t"
+            " por %%xmm1, %%xmm0            \n\t"
+            " movdqa %%xmm0, %%xmm1         \n\t" /* byte swap */
+            " psrlw $8, %%xmm0              \n\t"
+            " psllw $8, %%xmm1              \n\t"
+            " por %%xmm1, %%xmm0            \n\t"
+            " movdqu %%xmm0, (%0)           \n\t"
+            " add $16, %0                   \n\t"
+            " add $16, %1                   \n\t"
+            " dec %2                        \n\t"
+            " jnz 1b                        \n\t"
+            : "+r" (dp), "+r" (sp), "+r" (blocks)
+            :
+            : "xmm0", "xmm1", "memory", "cc"
+        );
+    }
+#endif
+
+    for (; k < n; k++)
+        d[k] = PA_UINT16_TO_BE((uint16_t) (s[k-1] << 9) | (s[k] >> 7));
+
+    return k;
+}
+
+size_t pa_raop_packet_write(uint8_t *dst, const void *src, size_t n_frames) {
+    uint8_t *a;
+    size_t n;
+    uint32_t bsize;
+
+    pa_assert(dst);
+    pa_assert(src || n_frames <= 0);
+    pa_assert(n_frames <= 0xFFFFFFFFU);
+
+    memcpy(dst, header, HEADER_SIZE);
+
+    /* The length of everything but the first four bytes */
+    n = pa_raop_packet_size(n_frames) - 4;
+    dst[2] = (uint8_t) (n >> 8);
+    dst[3] = (uint8_t) n;
+
+    a = dst + HEADER_SIZE;
+    bsize = (uint32_t) n_frames;
+
+    /* 3 bits channels (1: stereo), 4+8+4 bits unknown, 1 bit has-size,
+     * 2 bits unused, 1 bit is-not-compressed, then the 32 bit number of
+     * frames and the samples, big endian */
+    a[0] = 0x20;
+    a[1] = 0x00;
+    a[2] = (uint8_t) (0x12 | (bsize >> 31));
+    a[3] = (uint8_t) (bsize >> 23);
+    a[4] = (uint8_t) (bsize >> 15);
+    a[5] = (uint8_t) (bsize >> 7);
+
+    n = pack_samples((uint16_t*) (a + 6), src, n_frames * 2, (uint16_t) bsize);
+
+    /* The last 7 bits of the last sample */
+    a[6 + n * 2] = (uint8_t) ((n > 0 ? ((const uint16_t*) src)[n-1] : bsize) << 1);
+
+    return pa_raop_packet_size(n_frames);
+}
+
+void pa_raop_packet_encrypt(EVP_CIPHER_CTX *ctx, const uint8_t iv[PA_RAOP_AES_CHUNKSIZE], uint8_t *packet, size_t size) {
+    uint8_t *d;
+    int l;
+
+    pa_assert(ctx);
+    pa_assert(iv);
+    pa_assert(packet);
+    pa_assert(size >= HEADER_SIZE);
+
+    d = packet + HEADER_SIZE;
+    size = (size - HEADER_SIZE) & ~(size_t) (PA_RAOP_AES_CHUNKSIZE - 1);
+
+    if (size <= 0)
+        return;
+
+    /* Keeps the key schedule, only the chaining starts over */
+    pa_assert_se(EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, iv) == 1);
+    pa_assert_se(EVP_EncryptUpdate(ctx, d, &l, d, (int) size) == 1);
+    pa_assert((size_t) l == size);
+}
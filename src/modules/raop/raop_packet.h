@@ -0,0 +1,48 @@
+#ifndef fooraoppackethfoo
+#define fooraoppackethfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <inttypes.h>
+#include <sys/types.h>
+
+#include <openssl/evp.h>
+
+/* Audio packets as AirTunes receivers take them over the TCP data
+ * connection: a 16 byte header followed by one ALAC frame holding
+ * 16 bit stereo samples "verbatim", i.e. uncompressed, AES encrypted. */
+
+#define PA_RAOP_AES_CHUNKSIZE 16
+
+/* The size of the packet holding n_frames frames */
+size_t pa_raop_packet_size(size_t n_frames);
+
+/* Writes the header and the ALAC frame for n_frames frames of S16NE
+ * stereo to dst, which has to be pa_raop_packet_size() bytes long.
+ * Returns the number of bytes written. */
+size_t pa_raop_packet_write(uint8_t *dst, const void *src, size_t n_frames);
+
+/* Encrypts the ALAC frame of the packet in place with AES-128-CBC,
+ * starting over from iv. ctx has to be set up for that cipher with
+ * padding disabled. A trailing partial block stays unencrypted, as
+ * receivers expect. */
+void pa_raop_packet_encrypt(EVP_CIPHER_CTX *ctx, const uint8_t iv[PA_RAOP_AES_CHUNKSIZE], uint8_t *packet, size_t size);
+
+#endif
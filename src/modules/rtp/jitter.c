@@ -0,0 +1,317 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <math.h>
+
+#include <pulse/timeval.h>
+#include <pulse/volume.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/sample-util.h>
+
+#include "jitter.h"
+
+/* How much of the audio played last is kept around to fill holes with,
+ * and over how long such a fill is faded out before it turns into
+ * silence */
+#define HISTORY_USEC (20*PA_USEC_PER_MSEC)
+#define CONCEAL_FADE_USEC (40*PA_USEC_PER_MSEC)
+
+/* The latency asked for is this many times the jitter on top of the
+ * minimum */
+#define JITTER_FACTOR 4
+
+struct pa_jitter_buffer {
+    pa_memblockq *memblockq;
+    pa_mempool *mempool;
+    pa_sample_spec sample_spec;
+    size_t frame_size;
+
+    pa_usec_t min_latency, max_latency, latency;
+
+    /* The memblockq index of the frame with (unwrapped) timestamp 0,
+     * and the end of what was written so far */
+    pa_bool_t synced;
+    uint32_t timestamp;
+    int64_t ext_timestamp;
+    int64_t base, end;
+
+    /* The interarrival jitter as in RFC 3550, in usec */
+    double transit, jitter;
+
+    uint8_t *history;
+    size_t history_length, history_max;
+    size_t conceal_index, concealed, conceal_max;
+
+    pa_jitter_buffer_stats stats;
+};
+
+pa_jitter_buffer* pa_jitter_buffer_new(
+        pa_memblockq *q,
+        pa_mempool *pool,
+        const pa_sample_spec *ss,
+        pa_usec_t min_latency,
+        pa_usec_t max_latency) {
+
+    pa_jitter_buffer *j;
+
+    pa_assert(q);
+    pa_assert(pool);
+    pa_assert(ss);
+    pa_assert(pa_sample_spec_valid(ss));
+    pa_assert(min_latency <= max_latency);
+
+    j = pa_xnew0(pa_jitter_buffer, 1);
+    j->memblockq = q;
+    j->mempool = pool;
+    j->sample_spec = *ss;
+    j->frame_size = pa_frame_size(ss);
+    j->min_latency = min_latency;
+    j->max_latency = max_latency;
+    j->latency = min_latency;
+
+    j->history_max = pa_usec_to_bytes(HISTORY_USEC, ss);
+    j->history = pa_xmalloc(j->history_max);
+    j->conceal_max = pa_usec_to_bytes(CONCEAL_FADE_USEC, ss);
+
+    pa_memblockq_set_prebuf(q, pa_usec_to_bytes(j->latency, ss));
+    pa_memblockq_prebuf_force(q);
+
+    return j;
+}
+
+void pa_jitter_buffer_free(pa_jitter_buffer *j) {
+    pa_assert(j);
+
+    pa_xfree(j->history);
+    pa_xfree(j);
+}
+
+void pa_jitter_buffer_reset(pa_jitter_buffer *j) {
+    pa_assert(j);
+
+    j->synced = FALSE;
+    j->history_length = 0;
+}
+
+/* Make timestamp land at the write index */
+static void sync_to(pa_jitter_buffer *j, uint32_t timestamp) {
+    j->timestamp = timestamp;
+    j->ext_timestamp = 0;
+    j->end = pa_memblockq_get_write_index(j->memblockq);
+    j->base = j->end;
+    j->synced = TRUE;
+}
+
+static void update_jitter(pa_jitter_buffer *j, int64_t ext, pa_usec_t arrival) {
+    double transit, d;
+
+    transit = (double) arrival - (double) ext * PA_USEC_PER_SEC / j->sample_spec.rate;
+
+    if (j->stats.packets > 1) {
+        d = fabs(transit - j->transit);
+
+        /* RFC 3550 smoothes with 1/16 either way. Going up faster gets
+         * the latency up before a burst of late packets, coming down
+         * slower keeps it from bouncing between bursts. */
+        j->jitter += (d - j->jitter) / (d > j->jitter ? 4 : 64);
+    }
+
+    j->transit = transit;
+
+    j->latency = PA_CLAMP(j->min_latency + (pa_usec_t) (JITTER_FACTOR * j->jitter), j->min_latency, j->max_latency);
+    pa_memblockq_set_prebuf(j->memblockq, pa_usec_to_bytes(j->latency, &j->sample_spec));
+}
+
+int pa_jitter_buffer_push(pa_jitter_buffer *j, uint32_t timestamp, pa_usec_t arrival, const pa_memchunk *chunk) {
+    pa_memchunk c;
+    int64_t ext, index, read_index, max_jump;
+
+    pa_assert(j);
+    pa_assert(chunk);
+    pa_assert(chunk->memblock);
+    pa_assert(chunk->length % j->frame_size == 0);
+
+    if (!j->synced)
+        sync_to(j, timestamp);
+
+    ext = j->ext_timestamp + (int32_t) (timestamp - j->timestamp);
+    index = j->base + ext * (int64_t) j->frame_size;
+    read_index = pa_memblockq_get_read_index(j->memblockq);
+    max_jump = (int64_t) pa_usec_to_bytes(j->max_latency, &j->sample_spec);
+
+    /* Either the sender started over or we lost it for a while. Or the
+     * reader ran dry and is waiting for the queue to fill up again, no
+     * point in making it wait for the hole in front too. */
+    if (index > j->end + max_jump ||
+        index + (int64_t) chunk->length < read_index - max_jump ||
+        (index > j->end && pa_memblockq_get_length(j->memblockq) <= 0)) {
+
+        sync_to(j, timestamp);
+        ext = 0;
+        index = j->base;
+    }
+
+    j->stats.packets++;
+
+    if (ext < j->ext_timestamp)
+        j->stats.reordered++;
+    else {
+        j->ext_timestamp = ext;
+        j->timestamp = timestamp;
+    }
+
+    update_jitter(j, ext, arrival);
+
+    if (index + (int64_t) chunk->length <= read_index) {
+        j->stats.late++;
+        return -1;
+    }
+
+    c = *chunk;
+
+    /* Only the end of it is still of any use */
+    if (index < read_index) {
+        c.index += (size_t) (read_index - index);
+        c.length -= (size_t) (read_index - index);
+        index = read_index;
+    }
+
+    pa_memblockq_seek(j->memblockq, index, PA_SEEK_ABSOLUTE, TRUE);
+
+    if (pa_memblockq_push(j->memblockq, &c) < 0) {
+        pa_log_warn("Queue overrun");
+        pa_memblockq_seek(j->memblockq, j->end, PA_SEEK_ABSOLUTE, TRUE);
+        return -1;
+    }
+
+    /* The write index always stays at the end of the newest packet, so
+     * that the latency can be read off the memblockq as usual */
+    if (index + (int64_t) c.length > j->end)
+        j->end = index + (int64_t) c.length;
+    else
+        pa_memblockq_seek(j->memblockq, j->end, PA_SEEK_ABSOLUTE, TRUE);
+
+    return 0;
+}
+
+static void remember(pa_jitter_buffer *j, const pa_memchunk *chunk) {
+    const uint8_t *d;
+    size_t l;
+
+    l = PA_MIN(chunk->length, j->history_max);
+    d = (const uint8_t*) pa_memblock_acquire(chunk->memblock) + chunk->index + chunk->length - l;
+
+    if (j->history_length + l > j->history_max) {
+        size_t keep = j->history_max - l;
+
+        memmove(j->history, j->history + j->history_length - keep, keep);
+        j->history_length = keep;
+    }
+
+    memcpy(j->history + j->history_length, d, l);
+    j->history_length += l;
+
+    pa_memblock_release(chunk->memblock);
+}
+
+/* Repeats the audio played last, fading it out a bit more with every
+ * piece, until it has gone on for long enough and only silence is
+ * left */
+static void conceal(pa_jitter_buffer *j, size_t length, pa_memchunk *chunk) {
+    void *d;
+
+    if (j->concealed < j->conceal_max && j->history_length > 0) {
+        pa_cvolume v;
+        double gain;
+
+        if (j->conceal_index >= j->history_length)
+            j->conceal_index = 0;
+
+        length = PA_MIN(length, j->history_length - j->conceal_index);
+        gain = 1.0 - (double) j->concealed / (double) j->conceal_max;
+
+        chunk->memblock = pa_memblock_new(j->mempool, length);
+        chunk->index = 0;
+        chunk->length = length;
+
+        d = pa_memblock_acquire(chunk->memblock);
+        memcpy(d, j->history + j->conceal_index, length);
+        pa_memblock_release(chunk->memblock);
+
+        pa_cvolume_set(&v, j->sample_spec.channels, pa_sw_volume_from_linear(gain));
+        pa_volume_memchunk(chunk, &j->sample_spec, &v);
+
+        j->conceal_index += length;
+    } else {
+        length = PA_MIN(length, pa_mempool_block_size_max(j->mempool));
+        length = pa_frame_align(length, &j->sample_spec);
+
+        chunk->memblock = pa_memblock_new(j->mempool, length);
+        chunk->index = 0;
+        chunk->length = length;
+
+        d = pa_memblock_acquire(chunk->memblock);
+        pa_silence_memory(d, length, &j->sample_spec);
+        pa_memblock_release(chunk->memblock);
+    }
+
+    j->concealed += length;
+    j->stats.concealed += length;
+}
+
+int pa_jitter_buffer_pop(pa_jitter_buffer *j, pa_memchunk *chunk) {
+    pa_assert(j);
+    pa_assert(chunk);
+
+    if (pa_memblockq_peek(j->memblockq, chunk) < 0)
+        return -1;
+
+    if (chunk->memblock) {
+        remember(j, chunk);
+        j->concealed = 0;
+        j->conceal_index = 0;
+    } else
+        conceal(j, chunk->length, chunk);
+
+    pa_memblockq_drop(j->memblockq, chunk->length);
+
+    return 0;
+}
+
+pa_usec_t pa_jitter_buffer_get_latency(pa_jitter_buffer *j) {
+    pa_assert(j);
+
+    return j->latency;
+}
+
+void pa_jitter_buffer_get_stats(pa_jitter_buffer *j, pa_jitter_buffer_stats *stats) {
+    pa_assert(j);
+    pa_assert(stats);
+
+    *stats = j->stats;
+    stats->jitter = (pa_usec_t) j->jitter;
+}
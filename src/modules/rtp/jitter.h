@@ -0,0 +1,74 @@
+#ifndef foojitterhfoo
+#define foojitterhfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <inttypes.h>
+
+#include <pulse/sample.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/memblockq.h>
+#include <pulsecore/memchunk.h>
+
+/* Puts RTP payloads into a memblockq at the position their timestamp
+ * says, so that packets arriving out of order end up in order, fills
+ * the holes lost packets leave behind with the audio played before,
+ * and estimates how much buffering the network jitter calls for. The
+ * memblockq stays owned by the caller, who may rewind it and query it
+ * as usual, but should only write to it through this. */
+
+typedef struct pa_jitter_buffer pa_jitter_buffer;
+
+typedef struct pa_jitter_buffer_stats {
+    uint64_t packets;
+    uint64_t reordered;
+    uint64_t late;
+    uint64_t concealed;
+    pa_usec_t jitter;
+} pa_jitter_buffer_stats;
+
+pa_jitter_buffer* pa_jitter_buffer_new(
+        pa_memblockq *q,
+        pa_mempool *pool,
+        const pa_sample_spec *ss,
+        pa_usec_t min_latency,
+        pa_usec_t max_latency);
+
+void pa_jitter_buffer_free(pa_jitter_buffer *j);
+
+/* Forget the timestamp mapping, the next packet starts over at the
+ * write index */
+void pa_jitter_buffer_reset(pa_jitter_buffer *j);
+
+/* arrival is the local time the packet came in. Returns -1 if the
+ * packet was dropped, because it came too late or didn't fit. */
+int pa_jitter_buffer_push(pa_jitter_buffer *j, uint32_t timestamp, pa_usec_t arrival, const pa_memchunk *chunk);
+
+/* Like pa_memblockq_peek() followed by pa_memblockq_drop(), but holes
+ * come back concealed instead of as silence */
+int pa_jitter_buffer_pop(pa_jitter_buffer *j, pa_memchunk *chunk);
+
+/* The amount of buffering the jitter seen so far calls for, between
+ * min_latency and max_latency. It is also used as prebuf. */
+pa_usec_t pa_jitter_buffer_get_latency(pa_jitter_buffer *j);
+
+void pa_jitter_buffer_get_stats(pa_jitter_buffer *j, pa_jitter_buffer_stats *stats);
+
+#endif
@@ -58,6 +58,7 @@
 #include "module-rtp-recv-symdef.h"
 
 #include "rtp.h"
+#include "jitter.h"
 #include "sdp.h"
 #include "sap.h"
 
@@ -77,6 +78,7 @@ PA_MODULE_USAGE(
 #define DEATH_TIMEOUT 20
 #define RATE_UPDATE_INTERVAL (5*PA_USEC_PER_SEC)
 #define LATENCY_USEC (500*PA_USEC_PER_MSEC)
+#define MIN_LATENCY_USEC (20*PA_USEC_PER_MSEC)
 
 static const char* const valid_modargs[] = {
     "sink",
@@ -90,10 +92,10 @@ struct session {
 
     pa_sink_input *sink_input;
     pa_memblockq *memblockq;
+    pa_jitter_buffer *jitter_buffer;
 
     pa_bool_t first_packet;
     uint32_t ssrc;
-    uint32_t offset;
 
     struct pa_sdp_info sdp_info;
 
@@ -152,12 +154,7 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t length, pa_memchunk *chunk
     pa_sink_input_assert_ref(i);
     pa_assert_se(s = i->userdata);
 
-    if (pa_memblockq_peek(s->memblockq, chunk) < 0)
-        return -1;
-
-    pa_memblockq_drop(s->memblockq, chunk->length);
-
-    return 0;
+    return pa_jitter_buffer_pop(s->jitter_buffer, chunk);
 }
 
 /* Called from I/O thread context */
@@ -197,17 +194,53 @@ static void sink_input_suspend_within_thread(pa_sink_input* i, pa_bool_t b) {
 
     if (b)
         pa_memblockq_flush_read(s->memblockq);
-    else
+    else {
         s->first_packet = FALSE;
+        pa_jitter_buffer_reset(s->jitter_buffer);
+    }
+}
+
+/* Called from I/O thread context */
+static pa_bool_t push_packet(struct session *s, pa_rtp_packet *packet, struct timeval *now) {
+    if (s->sdp_info.payload != packet->payload ||
+        !PA_SINK_IS_OPENED(s->sink_input->sink->thread_info.state))
+        return FALSE;
+
+    if (!s->first_packet) {
+        s->first_packet = TRUE;
+
+        s->ssrc = packet->ssrc;
+
+        if (s->ssrc == s->userdata->module->core->cookie)
+            pa_log_warn("Detected RTP packet loop!");
+    } else {
+        if (s->ssrc != packet->ssrc)
+            return FALSE;
+    }
+
+    *now = packet->tstamp;
+
+    if (now->tv_sec == 0) {
+        PA_ONCE_BEGIN {
+            pa_log_warn("Using artificial time instead of timestamp");
+        } PA_ONCE_END;
+        pa_rtclock_get(now);
+    } else
+        pa_rtclock_from_wallclock(now);
+
+    pa_jitter_buffer_push(s->jitter_buffer, packet->timestamp, pa_timeval_load(now), &packet->chunk);
+
+    return TRUE;
 }
 
 /* Called from I/O thread context */
 static int rtpoll_work_cb(pa_rtpoll_item *i) {
-    pa_memchunk chunk;
-    int64_t k, j, delta;
+    pa_rtp_packet packets[PA_RTP_BATCH_MAX];
     struct timeval now = { 0, 0 };
+    pa_bool_t pushed = FALSE;
     struct session *s;
     struct pollfd *p;
+    int n, k;
 
     pa_assert_se(s = pa_rtpoll_item_get_userdata(i));
 
@@ -223,60 +256,18 @@ static int rtpoll_work_cb(pa_rtpoll_item *i) {
 
     p->revents = 0;
 
-    if (pa_rtp_recv(&s->rtp_context, &chunk, s->userdata->module->core->mempool, &now) < 0)
-        return 0;
-
-    if (s->sdp_info.payload != s->rtp_context.payload ||
-        !PA_SINK_IS_OPENED(s->sink_input->sink->thread_info.state)) {
-        pa_memblock_unref(chunk.memblock);
-        return 0;
-    }
-
-    if (!s->first_packet) {
-        s->first_packet = TRUE;
+    /* Take everything that is waiting, with 1ms packets that is a lot
+     * fewer syscalls than one per packet */
+    while ((n = pa_rtp_recv_batch(&s->rtp_context, packets, PA_RTP_BATCH_MAX, s->userdata->module->core->mempool)) > 0)
+        for (k = 0; k < n; k++) {
+            if (push_packet(s, &packets[k], &now))
+                pushed = TRUE;
 
-        s->ssrc = s->rtp_context.ssrc;
-        s->offset = s->rtp_context.timestamp;
-
-        if (s->ssrc == s->userdata->module->core->cookie)
-            pa_log_warn("Detected RTP packet loop!");
-    } else {
-        if (s->ssrc != s->rtp_context.ssrc) {
-            pa_memblock_unref(chunk.memblock);
-            return 0;
+            pa_memblock_unref(packets[k].chunk.memblock);
         }
-    }
-
-    /* Check whether there was a timestamp overflow */
-    k = (int64_t) s->rtp_context.timestamp - (int64_t) s->offset;
-    j = (int64_t) 0x100000000LL - (int64_t) s->offset + (int64_t) s->rtp_context.timestamp;
-
-    if ((k < 0 ? -k : k) < (j < 0 ? -j : j))
-        delta = k;
-    else
-        delta = j;
-
-    pa_memblockq_seek(s->memblockq, delta * (int64_t) s->rtp_context.frame_size, PA_SEEK_RELATIVE, TRUE);
-
-    if (now.tv_sec == 0) {
-        PA_ONCE_BEGIN {
-            pa_log_warn("Using artificial time instead of timestamp");
-        } PA_ONCE_END;
-        pa_rtclock_get(&now);
-    } else
-        pa_rtclock_from_wallclock(&now);
-
-    if (pa_memblockq_push(s->memblockq, &chunk) < 0) {
-        pa_log_warn("Queue overrun");
-        pa_memblockq_seek(s->memblockq, (int64_t) chunk.length, PA_SEEK_RELATIVE, TRUE);
-    }
-
-/*     pa_log("blocks in q: %u", pa_memblockq_get_nblocks(s->memblockq)); */
-
-    pa_memblock_unref(chunk.memblock);
 
-    /* The next timestamp we expect */
-    s->offset = s->rtp_context.timestamp + (uint32_t) (chunk.length / s->rtp_context.frame_size);
+    if (!pushed)
+        return 0;
 
     pa_atomic_store(&s->timestamp, (int) now.tv_sec);
 
@@ -289,6 +280,8 @@ static int rtpoll_work_cb(pa_rtpoll_item *i) {
 
         pa_log_debug("Updating sample rate");
 
+        s->intended_latency = s->sink_latency + pa_jitter_buffer_get_latency(s->jitter_buffer);
+
         wi = pa_bytes_to_usec((uint64_t) pa_memblockq_get_write_index(s->memblockq), &s->sink_input->sample_spec);
         ri = pa_bytes_to_usec((uint64_t) pa_memblockq_get_read_index(s->memblockq), &s->sink_input->sample_spec);
 
@@ -477,7 +470,6 @@ static struct session *session_new(struct userdata *u, const pa_sdp_info *sdp_in
     struct session *s = NULL;
     pa_sink *sink;
     int fd = -1;
-    pa_memchunk silence;
     pa_sink_input_new_data data;
     struct timeval now;
 
@@ -548,25 +540,29 @@ static struct session *session_new(struct userdata *u, const pa_sdp_info *sdp_in
     s->sink_input->detach = sink_input_detach;
     s->sink_input->suspend_within_thread = sink_input_suspend_within_thread;
 
-    pa_sink_input_get_silence(s->sink_input, &silence);
-
     s->sink_latency = pa_sink_input_set_requested_latency(s->sink_input, s->intended_latency/2);
 
-    if (s->intended_latency < s->sink_latency*2)
-        s->intended_latency = s->sink_latency*2;
-
+    /* No silence, the jitter buffer needs to see the holes */
     s->memblockq = pa_memblockq_new(
             "module-rtp-recv memblockq",
             0,
             MEMBLOCKQ_MAXLENGTH,
             MEMBLOCKQ_MAXLENGTH,
             &s->sink_input->sample_spec,
-            pa_usec_to_bytes(s->intended_latency - s->sink_latency, &s->sink_input->sample_spec),
             0,
             0,
-            &silence);
+            0,
+            NULL);
+
+    s->jitter_buffer = pa_jitter_buffer_new(
+            s->memblockq,
+            u->module->core->mempool,
+            &s->sink_input->sample_spec,
+            PA_MAX(MIN_LATENCY_USEC, s->sink_latency),
+            LATENCY_USEC);
 
-    pa_memblock_unref(silence.memblock);
+    s->intended_latency = s->sink_latency + pa_jitter_buffer_get_latency(s->jitter_buffer);
+    s->last_latency = s->intended_latency;
 
     pa_rtp_context_init_recv(&s->rtp_context, fd, pa_frame_size(&s->sdp_info.sample_spec));
 
@@ -602,6 +598,7 @@ static void session_free(struct session *s) {
     s->userdata->n_sessions--;
     pa_hashmap_remove(s->userdata->by_origin, s->sdp_info.origin);
 
+    pa_jitter_buffer_free(s->jitter_buffer);
     pa_memblockq_free(s->memblockq);
     pa_sdp_info_destroy(&s->sdp_info);
     pa_rtp_context_destroy(&s->rtp_context);
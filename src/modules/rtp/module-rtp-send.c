@@ -66,6 +66,8 @@ PA_MODULE_USAGE(
         "destination=<destination IP address> "
         "port=<port number> "
         "mtu=<maximum transfer unit> "
+        "packet_time=<milliseconds of audio per packet> "
+        "latency_msec=<milliseconds to collect before sending> "
         "loop=<loopback to local host?> "
         "ttl=<ttl value>"
 );
@@ -76,6 +78,7 @@ PA_MODULE_USAGE(
 #define DEFAULT_DESTINATION "224.0.0.56"
 #define MEMBLOCKQ_MAXLENGTH (1024*170)
 #define DEFAULT_MTU 1280
+#define PACKET_OVERHEAD (12+8+40)
 #define SAP_INTERVAL (5*PA_USEC_PER_SEC)
 
 static const char* const valid_modargs[] = {
@@ -86,6 +89,8 @@ static const char* const valid_modargs[] = {
     "destination",
     "port",
     "mtu" ,
+    "packet_time",
+    "latency_msec",
     "loop",
     "ttl",
     NULL
@@ -164,8 +169,9 @@ int pa__init(pa_module*m) {
     struct userdata *u;
     pa_modargs *ma = NULL;
     const char *dest;
-    uint32_t port = DEFAULT_PORT, mtu;
+    uint32_t port = DEFAULT_PORT, mtu, packet_time = 0, latency_msec = 0;
     uint32_t ttl = DEFAULT_TTL;
+    pa_usec_t latency;
     sa_family_t af;
     int fd = -1, sap_fd = -1;
     pa_source *s;
@@ -227,6 +233,28 @@ int pa__init(pa_module*m) {
         goto fail;
     }
 
+    /* Smaller packets than the MTU allows, for receivers that want low
+     * latency */
+    if (pa_modargs_get_value_u32(ma, "packet_time", &packet_time) < 0) {
+        pa_log("packet_time= expects a numerical argument.");
+        goto fail;
+    }
+
+    if (packet_time > 0)
+        mtu = (uint32_t) PA_MIN(mtu, PA_MAX(pa_usec_to_bytes(packet_time * PA_USEC_PER_MSEC, &ss), pa_frame_size(&ss)));
+
+    /* Collecting more than one packet before sending means fewer wakeups,
+     * the packets then go out together */
+    latency = pa_bytes_to_usec(mtu, &ss);
+
+    if (pa_modargs_get_value_u32(ma, "latency_msec", &latency_msec) < 0) {
+        pa_log("latency_msec= expects a numerical argument.");
+        goto fail;
+    }
+
+    if (latency_msec * PA_USEC_PER_MSEC > latency)
+        latency = latency_msec * PA_USEC_PER_MSEC;
+
     port = DEFAULT_PORT + ((uint32_t) (rand() % 512) << 1);
     if (pa_modargs_get_value_u32(ma, "port", &port) < 0 || port < 1 || port > 0xFFFF) {
         pa_log("port= expects a numerical argument between 1 and 65535.");
@@ -315,10 +343,25 @@ int pa__init(pa_module*m) {
     pa_make_fd_nonblock(fd);
     pa_make_udp_socket_low_delay(fd);
 
+#ifdef SO_MAX_PACING_RATE
+    /* Have the packets collected over one wakeup spread out over most
+     * of the time until the next one instead of going out in a burst.
+     * This needs the fq qdisc, without it nothing changes. */
+    if (latency > pa_bytes_to_usec(mtu, &ss)) {
+        uint32_t rate;
+
+        rate = (uint32_t) ((mtu + PACKET_OVERHEAD) * pa_bytes_per_second(&ss) / mtu * 3 / 2);
+
+        if (setsockopt(fd, SOL_SOCKET, SO_MAX_PACING_RATE, &rate, sizeof(rate)) < 0)
+            pa_log_debug("SO_MAX_PACING_RATE failed: %s", pa_cstrerror(errno));
+    }
+#endif
+
     pa_source_output_new_data_init(&data);
     pa_proplist_sets(data.proplist, PA_PROP_MEDIA_NAME, "RTP Monitor Stream");
     pa_proplist_sets(data.proplist, "rtp.destination", dest);
     pa_proplist_setf(data.proplist, "rtp.mtu", "%lu", (unsigned long) mtu);
+    pa_proplist_setf(data.proplist, "rtp.packet_time", "%0.2f", (double) pa_bytes_to_usec(mtu, &ss) / PA_USEC_PER_MSEC);
     pa_proplist_setf(data.proplist, "rtp.port", "%lu", (unsigned long) port);
     pa_proplist_setf(data.proplist, "rtp.ttl", "%lu", (unsigned long) ttl);
     data.driver = __FILE__;
@@ -341,7 +384,7 @@ int pa__init(pa_module*m) {
     o->kill = source_output_kill;
 
     pa_log_info("Configured source latency of %llu ms.",
-                (unsigned long long) pa_source_output_set_requested_latency(o, pa_bytes_to_usec(mtu, &o->sample_spec)) / PA_USEC_PER_MSEC);
+                (unsigned long long) pa_source_output_set_requested_latency(o, latency) / PA_USEC_PER_MSEC);
 
     m->userdata = o->userdata = u = pa_xnew(struct userdata, 1);
     u->module = m;
@@ -55,6 +55,7 @@ pa_rtp_context* pa_rtp_context_init_send(pa_rtp_context *c, int fd, uint32_t ssr
     c->ssrc = ssrc ? ssrc : (uint32_t) (rand()*rand());
     c->payload = (uint8_t) (payload & 127U);
     c->frame_size = frame_size;
+    c->slot_size = 0;
 
     pa_memchunk_reset(&c->memchunk);
 
@@ -63,92 +64,127 @@ pa_rtp_context* pa_rtp_context_init_send(pa_rtp_context *c, int fd, uint32_t ssr
 
 #define MAX_IOVECS 16
 
-int pa_rtp_send(pa_rtp_context *c, size_t size, pa_memblockq *q) {
-    struct iovec iov[MAX_IOVECS];
-    pa_memblock* mb[MAX_IOVECS];
-    int iov_idx = 1;
-    size_t n = 0;
+/* Sends the first n packets set up in m, returns -1 if they couldn't all
+ * be sent */
+static int send_packets(pa_rtp_context *c, struct msghdr *m[], unsigned n) {
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr mm[PA_RTP_BATCH_MAX];
+    unsigned i, sent = 0;
 
-    pa_assert(c);
-    pa_assert(size > 0);
-    pa_assert(q);
+    for (i = 0; i < n; i++) {
+        mm[i].msg_hdr = *m[i];
+        mm[i].msg_len = 0;
+    }
 
-    if (pa_memblockq_get_length(q) < size)
-        return 0;
+    while (sent < n) {
+        int k;
 
-    for (;;) {
-        int r;
-        pa_memchunk chunk;
+        if ((k = sendmmsg(c->fd, mm + sent, n - sent, MSG_DONTWAIT)) < 0)
+            break;
 
-        pa_memchunk_reset(&chunk);
+        sent += (unsigned) k;
+    }
 
-        if ((r = pa_memblockq_peek(q, &chunk)) >= 0) {
+    if (sent >= n)
+        return 0;
+#else
+    unsigned i;
 
-            size_t k = n + chunk.length > size ? size - n : chunk.length;
+    for (i = 0; i < n; i++)
+        if (sendmsg(c->fd, m[i], MSG_DONTWAIT) < 0)
+            break;
 
-            pa_assert(chunk.memblock);
+    if (i >= n)
+        return 0;
+#endif
 
-            iov[iov_idx].iov_base = ((uint8_t*) pa_memblock_acquire(chunk.memblock) + chunk.index);
-            iov[iov_idx].iov_len = k;
-            mb[iov_idx] = chunk.memblock;
-            iov_idx ++;
+    if (errno != EAGAIN && errno != EINTR) /* If the queue is full, just ignore it */
+        pa_log("sendmsg() failed: %s", pa_cstrerror(errno));
 
-            n += k;
-            pa_memblockq_drop(q, k);
-        }
+    return -1;
+}
 
-        pa_assert(n % c->frame_size == 0);
+int pa_rtp_send(pa_rtp_context *c, size_t size, pa_memblockq *q) {
+    struct iovec iov[PA_RTP_BATCH_MAX][MAX_IOVECS];
+    uint32_t header[PA_RTP_BATCH_MAX][3];
+    struct msghdr mh[PA_RTP_BATCH_MAX], *m[PA_RTP_BATCH_MAX];
+    pa_memblock *mb[PA_RTP_BATCH_MAX * MAX_IOVECS];
+    unsigned n_mb = 0, i, j;
+    int ret = 0;
+
+    pa_assert(c);
+    pa_assert(size > 0);
+    pa_assert(q);
 
-        if (r < 0 || n >= size || iov_idx >= MAX_IOVECS) {
-            uint32_t header[3];
-            struct msghdr m;
-            ssize_t k;
-            int i;
+    /* Everything that makes up full packets goes out with as few calls
+     * as possible, the payloads are sent straight from the memblocks
+     * they were recorded into */
+    while (pa_memblockq_get_length(q) >= size) {
 
-            if (n > 0) {
-                header[0] = htonl(((uint32_t) 2 << 30) | ((uint32_t) c->payload << 16) | ((uint32_t) c->sequence));
-                header[1] = htonl(c->timestamp);
-                header[2] = htonl(c->ssrc);
+        for (i = 0; i < PA_RTP_BATCH_MAX && pa_memblockq_get_length(q) >= size; i++) {
+            int iov_idx = 1;
+            size_t n = 0;
 
-                iov[0].iov_base = (void*)header;
-                iov[0].iov_len = sizeof(header);
+            while (n < size && iov_idx < MAX_IOVECS) {
+                pa_memchunk chunk;
+                size_t k;
 
-                m.msg_name = NULL;
-                m.msg_namelen = 0;
-                m.msg_iov = iov;
-                m.msg_iovlen = (size_t) iov_idx;
-                m.msg_control = NULL;
-                m.msg_controllen = 0;
-                m.msg_flags = 0;
+                pa_memchunk_reset(&chunk);
 
-                k = sendmsg(c->fd, &m, MSG_DONTWAIT);
+                if (pa_memblockq_peek(q, &chunk) < 0)
+                    break;
 
-                for (i = 1; i < iov_idx; i++) {
-                    pa_memblock_release(mb[i]);
-                    pa_memblock_unref(mb[i]);
-                }
+                pa_assert(chunk.memblock);
 
-                c->sequence++;
-            } else
-                k = 0;
+                k = n + chunk.length > size ? size - n : chunk.length;
 
-            c->timestamp += (unsigned) (n/c->frame_size);
+                iov[i][iov_idx].iov_base = ((uint8_t*) pa_memblock_acquire(chunk.memblock) + chunk.index);
+                iov[i][iov_idx].iov_len = k;
+                mb[n_mb++] = chunk.memblock;
+                iov_idx++;
 
-            if (k < 0) {
-                if (errno != EAGAIN && errno != EINTR) /* If the queue is full, just ignore it */
-                    pa_log("sendmsg() failed: %s", pa_cstrerror(errno));
-                return -1;
+                n += k;
+                pa_memblockq_drop(q, k);
             }
 
-            if (r < 0 || pa_memblockq_get_length(q) < size)
-                break;
+            pa_assert(n > 0);
+            pa_assert(n % c->frame_size == 0);
+
+            header[i][0] = htonl(((uint32_t) 2 << 30) | ((uint32_t) c->payload << 16) | ((uint32_t) c->sequence));
+            header[i][1] = htonl(c->timestamp);
+            header[i][2] = htonl(c->ssrc);
+
+            iov[i][0].iov_base = (void*) header[i];
+            iov[i][0].iov_len = sizeof(header[i]);
 
-            n = 0;
-            iov_idx = 1;
+            m[i] = &mh[i];
+            m[i]->msg_name = NULL;
+            m[i]->msg_namelen = 0;
+            m[i]->msg_iov = iov[i];
+            m[i]->msg_iovlen = (size_t) iov_idx;
+            m[i]->msg_control = NULL;
+            m[i]->msg_controllen = 0;
+            m[i]->msg_flags = 0;
+
+            c->sequence++;
+            c->timestamp += (unsigned) (n/c->frame_size);
         }
+
+        if (send_packets(c, m, i) < 0)
+            ret = -1;
+
+        for (j = 0; j < n_mb; j++) {
+            pa_memblock_release(mb[j]);
+            pa_memblock_unref(mb[j]);
+        }
+
+        n_mb = 0;
+
+        if (ret < 0)
+            break;
     }
 
-    return 0;
+    return ret;
 }
 
 pa_rtp_context* pa_rtp_context_init_recv(pa_rtp_context *c, int fd, size_t frame_size) {
@@ -156,146 +192,224 @@ pa_rtp_context* pa_rtp_context_init_recv(pa_rtp_context *c, int fd, size_t frame
 
     c->fd = fd;
     c->frame_size = frame_size;
+    c->slot_size = 0;
 
     pa_memchunk_reset(&c->memchunk);
     return c;
 }
 
-int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct timeval *tstamp) {
-    int size;
-    struct msghdr m;
-    struct cmsghdr *cm;
-    struct iovec iov;
+/* Checks the header of the packet received at data and narrows the
+ * chunk down to the payload */
+static int parse_packet(pa_rtp_context *c, pa_rtp_packet *p, const uint8_t *data, size_t size) {
     uint32_t header;
     unsigned cc;
-    ssize_t r;
-    uint8_t aux[1024];
-    pa_bool_t found_tstamp = FALSE;
 
-    pa_assert(c);
-    pa_assert(chunk);
+    if (size < 12) {
+        pa_log_warn("RTP packet too short.");
+        return -1;
+    }
 
-    pa_memchunk_reset(chunk);
+    memcpy(&header, data, sizeof(uint32_t));
+    memcpy(&p->timestamp, data + 4, sizeof(uint32_t));
+    memcpy(&p->ssrc, data + 8, sizeof(uint32_t));
+
+    header = ntohl(header);
+    p->timestamp = ntohl(p->timestamp);
+    p->ssrc = ntohl(p->ssrc);
+
+    if ((header >> 30) != 2) {
+        pa_log_warn("Unsupported RTP version.");
+        return -1;
+    }
+
+    if ((header >> 29) & 1) {
+        pa_log_warn("RTP padding not supported.");
+        return -1;
+    }
+
+    if ((header >> 28) & 1) {
+        pa_log_warn("RTP header extensions not supported.");
+        return -1;
+    }
+
+    cc = (header >> 24) & 0xF;
+    p->payload = (uint8_t) ((header >> 16) & 127U);
+    p->sequence = (uint16_t) (header & 0xFFFFU);
+
+    if (12 + cc*4 > size) {
+        pa_log_warn("RTP packet too short. (CSRC)");
+        return -1;
+    }
+
+    p->chunk.index += 12 + cc*4;
+    p->chunk.length = size - (12 + cc*4);
+
+    if (p->chunk.length <= 0 || p->chunk.length % c->frame_size != 0) {
+        pa_log_warn("Bad RTP packet size.");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void find_tstamp(struct msghdr *m, struct timeval *tstamp) {
+    struct cmsghdr *cm;
+
+    for (cm = CMSG_FIRSTHDR(m); cm; cm = CMSG_NXTHDR(m, cm))
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_TIMESTAMP) {
+            memcpy(tstamp, CMSG_DATA(cm), sizeof(struct timeval));
+            return;
+        }
+
+    pa_log_warn("Couldn't find SO_TIMESTAMP data in auxiliary recvmsg() data!");
+    memset(tstamp, 0, sizeof(*tstamp));
+}
+
+int pa_rtp_recv_batch(pa_rtp_context *c, pa_rtp_packet *packets, unsigned n, pa_mempool *pool) {
+    struct iovec iov[PA_RTP_BATCH_MAX];
+#ifdef HAVE_RECVMMSG
+    struct mmsghdr mm[PA_RTP_BATCH_MAX];
+#else
+    struct msghdr mh[PA_RTP_BATCH_MAX];
+#endif
+    struct msghdr *m[PA_RTP_BATCH_MAX];
+    size_t len[PA_RTP_BATCH_MAX];
+    uint8_t aux[PA_RTP_BATCH_MAX][CMSG_SPACE(sizeof(struct timeval))];
+    uint8_t *d;
+    unsigned i, received = 0, k = 0;
+    int size;
+
+    pa_assert(c);
+    pa_assert(packets);
+    pa_assert(n > 0);
+    pa_assert(n <= PA_RTP_BATCH_MAX);
+    pa_assert(pool);
 
     if (ioctl(c->fd, FIONREAD, &size) < 0) {
         pa_log_warn("FIONREAD failed: %s", pa_cstrerror(errno));
-        goto fail;
+        return -1;
     }
 
     if (size <= 0)
         return 0;
 
-    if (c->memchunk.length < (unsigned) size) {
-        size_t l;
+    /* FIONREAD only tells the size of the first packet waiting. The
+     * packets of a stream are usually all the same size, so the pool
+     * block is cut into slots of the biggest size seen so far. Bigger
+     * ones arriving later in the same batch get truncated and dropped,
+     * the next call makes room for them. */
+    if ((size_t) size > c->slot_size)
+        c->slot_size = PA_MIN((size_t) size, pa_mempool_block_size_max(pool));
 
+    if (c->memchunk.length < c->slot_size) {
         if (c->memchunk.memblock)
             pa_memblock_unref(c->memchunk.memblock);
 
-        l = PA_MAX((size_t) size, pa_mempool_block_size_max(pool));
-
-        c->memchunk.memblock = pa_memblock_new(pool, l);
+        c->memchunk.memblock = pa_memblock_new(pool, (size_t) -1);
         c->memchunk.index = 0;
         c->memchunk.length = pa_memblock_get_length(c->memchunk.memblock);
     }
 
-    pa_assert(c->memchunk.length >= (size_t) size);
+    n = PA_MIN(n, (unsigned) (c->memchunk.length / c->slot_size));
+    d = (uint8_t*) pa_memblock_acquire(c->memchunk.memblock) + c->memchunk.index;
 
-    chunk->memblock = pa_memblock_ref(c->memchunk.memblock);
-    chunk->index = c->memchunk.index;
+    for (i = 0; i < n; i++) {
+#ifdef HAVE_RECVMMSG
+        m[i] = &mm[i].msg_hdr;
+#else
+        m[i] = &mh[i];
+#endif
+        iov[i].iov_base = d + i * c->slot_size;
+        iov[i].iov_len = c->slot_size;
+
+        m[i]->msg_name = NULL;
+        m[i]->msg_namelen = 0;
+        m[i]->msg_iov = &iov[i];
+        m[i]->msg_iovlen = 1;
+        m[i]->msg_control = aux[i];
+        m[i]->msg_controllen = sizeof(aux[i]);
+        m[i]->msg_flags = 0;
+    }
 
-    iov.iov_base = (uint8_t*) pa_memblock_acquire(chunk->memblock) + chunk->index;
-    iov.iov_len = (size_t) size;
+#ifdef HAVE_RECVMMSG
+    {
+        int r;
 
-    m.msg_name = NULL;
-    m.msg_namelen = 0;
-    m.msg_iov = &iov;
-    m.msg_iovlen = 1;
-    m.msg_control = aux;
-    m.msg_controllen = sizeof(aux);
-    m.msg_flags = 0;
+        if ((r = recvmmsg(c->fd, mm, n, MSG_DONTWAIT, NULL)) > 0) {
+            received = (unsigned) r;
 
-    r = recvmsg(c->fd, &m, 0);
-    pa_memblock_release(chunk->memblock);
+            for (i = 0; i < received; i++)
+                len[i] = mm[i].msg_len;
+        }
+    }
+#else
+    for (; received < n; received++) {
+        ssize_t r;
 
-    if (r != size) {
-        if (r < 0 && errno != EAGAIN && errno != EINTR)
-            pa_log_warn("recvmsg() failed: %s", r < 0 ? pa_cstrerror(errno) : "size mismatch");
+        if ((r = recvmsg(c->fd, m[received], MSG_DONTWAIT)) < 0)
+            break;
 
-        goto fail;
+        len[received] = (size_t) r;
     }
+#endif
 
-    if (size < 12) {
-        pa_log_warn("RTP packet too short.");
-        goto fail;
-    }
+    if (received <= 0) {
+        pa_memblock_release(c->memchunk.memblock);
 
-    memcpy(&header, iov.iov_base, sizeof(uint32_t));
-    memcpy(&c->timestamp, (uint8_t*) iov.iov_base + 4, sizeof(uint32_t));
-    memcpy(&c->ssrc, (uint8_t*) iov.iov_base + 8, sizeof(uint32_t));
+        if (errno == EAGAIN || errno == EINTR)
+            return 0;
 
-    header = ntohl(header);
-    c->timestamp = ntohl(c->timestamp);
-    c->ssrc = ntohl(c->ssrc);
-
-    if ((header >> 30) != 2) {
-        pa_log_warn("Unsupported RTP version.");
-        goto fail;
+        pa_log_warn("recvmsg() failed: %s", pa_cstrerror(errno));
+        return -1;
     }
 
-    if ((header >> 29) & 1) {
-        pa_log_warn("RTP padding not supported.");
-        goto fail;
-    }
+    for (i = 0; i < received; i++) {
+        pa_rtp_packet *p = &packets[k];
 
-    if ((header >> 28) & 1) {
-        pa_log_warn("RTP header extensions not supported.");
-        goto fail;
-    }
+        if (m[i]->msg_flags & MSG_TRUNC) {
+            pa_log_warn("RTP packet bigger than %lu bytes, dropped.", (unsigned long) c->slot_size);
+            continue;
+        }
 
-    cc = (header >> 24) & 0xF;
-    c->payload = (uint8_t) ((header >> 16) & 127U);
-    c->sequence = (uint16_t) (header & 0xFFFFU);
+        p->chunk.memblock = c->memchunk.memblock;
+        p->chunk.index = c->memchunk.index + i * c->slot_size;
 
-    if (12 + cc*4 > (unsigned) size) {
-        pa_log_warn("RTP packet too short. (CSRC)");
-        goto fail;
+        if (parse_packet(c, p, iov[i].iov_base, len[i]) < 0)
+            continue;
+
+        pa_memblock_ref(p->chunk.memblock);
+        find_tstamp(m[i], &p->tstamp);
+        k++;
     }
 
-    chunk->index += 12 + cc*4;
-    chunk->length = (size_t) size - 12 + cc*4;
+    pa_memblock_release(c->memchunk.memblock);
 
-    if (chunk->length % c->frame_size != 0) {
-        pa_log_warn("Bad RTP packet size.");
-        goto fail;
-    }
+    c->memchunk.index += received * c->slot_size;
+    c->memchunk.length -= received * c->slot_size;
 
-    c->memchunk.index = chunk->index + chunk->length;
-    c->memchunk.length = pa_memblock_get_length(c->memchunk.memblock) - c->memchunk.index;
+    return (int) k;
+}
 
-    if (c->memchunk.length <= 0) {
-        pa_memblock_unref(c->memchunk.memblock);
-        pa_memchunk_reset(&c->memchunk);
-    }
+int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct timeval *tstamp) {
+    pa_rtp_packet p;
 
-    for (cm = CMSG_FIRSTHDR(&m); cm; cm = CMSG_NXTHDR(&m, cm))
-        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_TIMESTAMP) {
-            memcpy(tstamp, CMSG_DATA(cm), sizeof(struct timeval));
-            found_tstamp = TRUE;
-            break;
-        }
+    pa_assert(c);
+    pa_assert(chunk);
+    pa_assert(tstamp);
 
-    if (!found_tstamp) {
-        pa_log_warn("Couldn't find SO_TIMESTAMP data in auxiliary recvmsg() data!");
-        memset(tstamp, 0, sizeof(tstamp));
-    }
+    pa_memchunk_reset(chunk);
 
-    return 0;
+    if (pa_rtp_recv_batch(c, &p, 1, pool) <= 0)
+        return -1;
 
-fail:
-    if (chunk->memblock)
-        pa_memblock_unref(chunk->memblock);
+    *chunk = p.chunk;
+    *tstamp = p.tstamp;
+    c->sequence = p.sequence;
+    c->timestamp = p.timestamp;
+    c->ssrc = p.ssrc;
+    c->payload = p.payload;
 
-    return -1;
+    return 0;
 }
 
 uint8_t pa_rtp_payload_from_sample_spec(const pa_sample_spec *ss) {
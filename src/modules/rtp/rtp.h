@@ -25,6 +25,7 @@
 #include <inttypes.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/time.h>
 #include <pulsecore/memblockq.h>
 #include <pulsecore/memchunk.h>
 
@@ -36,9 +37,24 @@ typedef struct pa_rtp_context {
     uint8_t payload;
     size_t frame_size;
 
+    /* The pool block packets are received into, and the size of the
+     * slots it is divided into */
     pa_memchunk memchunk;
+    size_t slot_size;
 } pa_rtp_context;
 
+/* A packet as returned by pa_rtp_recv_batch() */
+typedef struct pa_rtp_packet {
+    pa_memchunk chunk;
+    uint16_t sequence;
+    uint32_t timestamp;
+    uint32_t ssrc;
+    uint8_t payload;
+    struct timeval tstamp;
+} pa_rtp_packet;
+
+#define PA_RTP_BATCH_MAX 32
+
 pa_rtp_context* pa_rtp_context_init_send(pa_rtp_context *c, int fd, uint32_t ssrc, uint8_t payload, size_t frame_size);
 
 /* If the memblockq doesn't have a silence memchunk set, then the caller must
@@ -48,6 +64,12 @@ int pa_rtp_send(pa_rtp_context *c, size_t size, pa_memblockq *q);
 pa_rtp_context* pa_rtp_context_init_recv(pa_rtp_context *c, int fd, size_t frame_size);
 int pa_rtp_recv(pa_rtp_context *c, pa_memchunk *chunk, pa_mempool *pool, struct timeval *tstamp);
 
+/* Receives up to n (at most PA_RTP_BATCH_MAX) packets that are already
+ * waiting on the socket, without blocking. Returns how many were stored
+ * in packets, or -1 on error. The chunks all point into the same pool
+ * block and need to be unreferenced by the caller. */
+int pa_rtp_recv_batch(pa_rtp_context *c, pa_rtp_packet *packets, unsigned n, pa_mempool *pool);
+
 void pa_rtp_context_destroy(pa_rtp_context *c);
 
 pa_sample_spec* pa_rtp_sample_spec_fixup(pa_sample_spec *ss);
@@ -106,6 +106,29 @@ void pa_ext_stream_restore_set_subscribe_cb(
         pa_ext_stream_restore_subscribe_cb_t cb,
         void *userdata);
 
+/** Statistics of the cache of decoded entries that
+ * module-stream-restore keeps in memory. \since 3.0 */
+typedef struct pa_ext_stream_restore_stats {
+    uint64_t cache_hits;         /**< Lookups that were answered from the cache */
+    uint64_t cache_misses;       /**< Lookups that had to go to the database */
+    uint32_t cache_entries;      /**< Number of entries currently cached */
+    uint32_t cache_size;         /**< Maximum number of cached entries, 0 if the cache is disabled */
+} pa_ext_stream_restore_stats;
+
+/** Callback prototype for pa_ext_stream_restore_get_stats(). stats
+ * is NULL if the request failed. \since 3.0 */
+typedef void (*pa_ext_stream_restore_get_stats_cb_t)(
+        pa_context *c,
+        const pa_ext_stream_restore_stats *stats,
+        void *userdata);
+
+/** Query the entry cache statistics of the stream database. Requires
+ * extension version 2. \since 3.0 */
+pa_operation *pa_ext_stream_restore_get_stats(
+        pa_context *c,
+        pa_ext_stream_restore_get_stats_cb_t cb,
+        void *userdata);
+
 PA_C_DECL_END
 
 #endif
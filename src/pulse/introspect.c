@@ -1676,6 +1676,196 @@ pa_operation* pa_context_get_sample_info_list(pa_context *c, pa_sample_info_cb_t
     return pa_context_send_simple_command(c, PA_COMMAND_GET_SAMPLE_INFO_LIST, context_get_sample_info_callback, (pa_operation_cb_t) cb, userdata);
 }
 
+/*** Snapshots ***/
+
+struct snapshot_data {
+    pa_operation *o;
+    pa_snapshot_entry entry;
+};
+
+static void snapshot_emit(pa_context *c, struct snapshot_data *d, pa_subscription_event_type_t facility, uint32_t idx) {
+    pa_snapshot_entry e;
+
+    e = d->entry;
+    e.facility = facility;
+    e.index = idx;
+
+    if (d->o->callback) {
+        pa_snapshot_cb_t cb = (pa_snapshot_cb_t) d->o->callback;
+        cb(c, &e, 0, d->o->userdata);
+    }
+}
+
+#define SNAPSHOT_CB(name, type, facility)                                       \
+    static void snapshot_##name##_cb(pa_context *c, const type *i, int eol, void *userdata) { \
+        struct snapshot_data *d = userdata;                                     \
+        if (eol)                                                                \
+            return;                                                             \
+        d->entry.name = i;                                                      \
+        snapshot_emit(c, d, facility, i->index);                                \
+        d->entry.name = NULL;                                                   \
+    }
+
+SNAPSHOT_CB(module, pa_module_info, PA_SUBSCRIPTION_EVENT_MODULE)
+SNAPSHOT_CB(client, pa_client_info, PA_SUBSCRIPTION_EVENT_CLIENT)
+SNAPSHOT_CB(card, pa_card_info, PA_SUBSCRIPTION_EVENT_CARD)
+SNAPSHOT_CB(sink, pa_sink_info, PA_SUBSCRIPTION_EVENT_SINK)
+SNAPSHOT_CB(source, pa_source_info, PA_SUBSCRIPTION_EVENT_SOURCE)
+SNAPSHOT_CB(sink_input, pa_sink_input_info, PA_SUBSCRIPTION_EVENT_SINK_INPUT)
+SNAPSHOT_CB(source_output, pa_source_output_info, PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT)
+SNAPSHOT_CB(sample, pa_sample_info, PA_SUBSCRIPTION_EVENT_SAMPLE_CACHE)
+
+#undef SNAPSHOT_CB
+
+/* Each section of a snapshot reply has the same layout as the reply to
+ * the matching GET_*_INFO_LIST command, so we reuse those parsers */
+static const struct {
+    pa_pdispatch_cb_t parse;
+    pa_operation_cb_t cb;
+} snapshot_sections[] = {
+    { context_get_module_info_callback, (pa_operation_cb_t) snapshot_module_cb },
+    { context_get_client_info_callback, (pa_operation_cb_t) snapshot_client_cb },
+    { context_get_card_info_callback, (pa_operation_cb_t) snapshot_card_cb },
+    { context_get_sink_info_callback, (pa_operation_cb_t) snapshot_sink_cb },
+    { context_get_source_info_callback, (pa_operation_cb_t) snapshot_source_cb },
+    { context_get_sink_input_info_callback, (pa_operation_cb_t) snapshot_sink_input_cb },
+    { context_get_source_output_info_callback, (pa_operation_cb_t) snapshot_source_output_cb },
+    { context_get_sample_info_callback, (pa_operation_cb_t) snapshot_sample_cb }
+};
+
+static int snapshot_parse_removed(pa_context *c, struct snapshot_data *d, pa_tagstruct *t) {
+
+    while (!pa_tagstruct_eof(t)) {
+        pa_subscription_event_type_t facility;
+        uint32_t idx;
+
+        if (pa_tagstruct_getu32(t, &facility) < 0 ||
+            pa_tagstruct_getu32(t, &idx) < 0)
+            return -1;
+
+        d->entry.removed = 1;
+        snapshot_emit(c, d, facility, idx);
+        d->entry.removed = 0;
+
+        if (!d->o->context)
+            break;
+    }
+
+    return 0;
+}
+
+static void context_get_snapshot_callback(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_operation *o = userdata;
+    struct snapshot_data d;
+    int eol = 1;
+
+    pa_assert(pd);
+    pa_assert(o);
+    pa_assert(PA_REFCNT_VALUE(o) >= 1);
+
+    if (!o->context)
+        goto finish;
+
+    pa_zero(d);
+    d.o = o;
+
+    if (command != PA_COMMAND_REPLY) {
+        if (pa_context_handle_error(o->context, command, t, FALSE) < 0)
+            goto finish;
+
+        eol = -1;
+    } else {
+        pa_bool_t full;
+        unsigned k;
+
+        if (pa_tagstruct_getu64(t, &d.entry.generation) < 0 ||
+            pa_tagstruct_get_boolean(t, &full) < 0) {
+            pa_context_fail(o->context, PA_ERR_PROTOCOL);
+            goto finish;
+        }
+
+        d.entry.full = (int) full;
+
+        /* The object sections, followed by the list of removed objects */
+        for (k = 0; k <= PA_ELEMENTSOF(snapshot_sections); k++) {
+            pa_tagstruct *section;
+            const void *data;
+            uint32_t length;
+
+            if (pa_tagstruct_getu32(t, &length) < 0 ||
+                pa_tagstruct_get_arbitrary(t, &data, length) < 0) {
+                pa_context_fail(o->context, PA_ERR_PROTOCOL);
+                goto finish;
+            }
+
+            if (length == 0)
+                continue;
+
+            section = pa_tagstruct_new(data, length);
+
+            if (k < PA_ELEMENTSOF(snapshot_sections)) {
+                pa_operation *so;
+
+                /* The parser finishes and releases the operation we hand it */
+                so = pa_operation_new(o->context, NULL, snapshot_sections[k].cb, &d);
+                snapshot_sections[k].parse(pd, PA_COMMAND_REPLY, tag, section, pa_operation_ref(so));
+                pa_operation_unref(so);
+
+            } else if (snapshot_parse_removed(o->context, &d, section) < 0) {
+                pa_tagstruct_free(section);
+                pa_context_fail(o->context, PA_ERR_PROTOCOL);
+                goto finish;
+            }
+
+            pa_tagstruct_free(section);
+
+            /* The context might have failed while parsing, or the
+             * operation might have been cancelled from a callback */
+            if (!o->context)
+                goto finish;
+        }
+
+        if (!pa_tagstruct_eof(t)) {
+            pa_context_fail(o->context, PA_ERR_PROTOCOL);
+            goto finish;
+        }
+    }
+
+    if (o->callback) {
+        pa_snapshot_cb_t cb = (pa_snapshot_cb_t) o->callback;
+        cb(o->context, eol > 0 ? &d.entry : NULL, eol, o->userdata);
+    }
+
+finish:
+    pa_operation_done(o);
+    pa_operation_unref(o);
+}
+
+pa_operation* pa_context_get_snapshot(pa_context *c, uint64_t since, pa_subscription_mask_t m, pa_snapshot_cb_t cb, void *userdata) {
+    pa_tagstruct *t;
+    pa_operation *o;
+    uint32_t tag;
+
+    pa_assert(c);
+    pa_assert(PA_REFCNT_VALUE(c) >= 1);
+    pa_assert(cb);
+
+    PA_CHECK_VALIDITY_RETURN_NULL(c, !pa_detect_fork(), PA_ERR_FORKED);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->state == PA_CONTEXT_READY, PA_ERR_BADSTATE);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, (m & ~PA_SUBSCRIPTION_MASK_ALL) == 0, PA_ERR_INVALID);
+    PA_CHECK_VALIDITY_RETURN_NULL(c, c->version >= 26, PA_ERR_NOTSUPPORTED);
+
+    o = pa_operation_new(c, NULL, (pa_operation_cb_t) cb, userdata);
+
+    t = pa_tagstruct_command(c, PA_COMMAND_GET_SNAPSHOT, &tag);
+    pa_tagstruct_putu64(t, since);
+    pa_tagstruct_putu32(t, m);
+    pa_pstream_send_tagstruct(c->pstream, t);
+    pa_pdispatch_register_reply(c->pdispatch, tag, DEFAULT_TIMEOUT, context_get_snapshot_callback, pa_operation_ref(o), (pa_free_cb_t) pa_operation_unref);
+
+    return o;
+}
+
 static pa_operation* command_kill(pa_context *c, uint32_t command, uint32_t idx, pa_context_success_cb_t cb, void *userdata) {
     pa_operation *o;
     pa_tagstruct *t;
@@ -136,6 +136,14 @@
  * either pa_context_get_client_info() or pa_context_get_client_info_list().
  * The information structure is called pa_client_info.
  *
+ * \subsection snapshot_subsec Snapshots
+ *
+ * pa_context_get_snapshot() retrieves modules, clients, cards, sinks,
+ * sources, sink inputs, source outputs and samples with a single round
+ * trip. Every snapshot carries a generation number. When that number is
+ * passed to the next call, only objects that changed in the meantime
+ * are returned, together with the indexes of objects that were removed.
+ *
  * \section ctrl_sec Control
  *
  * Some parts of the server are only possible to read, but most can also be
@@ -645,6 +653,42 @@ pa_operation* pa_context_get_sample_info_list(pa_context *c, pa_sample_info_cb_t
 
 /** @} */
 
+/** @{ \name Snapshots */
+
+/** Stores one object of a snapshot. Exactly one of the information
+ * pointers is set, unless the object has been removed. Please note
+ * that this structure can be extended as part of evolutionary API
+ * updates at any time in any new release. \since 3.0 */
+typedef struct pa_snapshot_entry {
+    uint64_t generation;                       /**< Generation of the snapshot. Pass this to the next pa_context_get_snapshot() call to only get the changes. */
+    int full;                                  /**< Non-zero if this is a full snapshot. In that case all objects the client knew about and that are not part of it are gone. */
+    pa_subscription_event_type_t facility;     /**< Facility of the object, e.g. PA_SUBSCRIPTION_EVENT_SINK */
+    uint32_t index;                            /**< Index of the object */
+    int removed;                               /**< Non-zero if the object has been removed */
+    const pa_module_info *module;              /**< Set if this is a module */
+    const pa_client_info *client;              /**< Set if this is a client */
+    const pa_card_info *card;                  /**< Set if this is a card */
+    const pa_sink_info *sink;                  /**< Set if this is a sink */
+    const pa_source_info *source;              /**< Set if this is a source */
+    const pa_sink_input_info *sink_input;      /**< Set if this is a sink input */
+    const pa_source_output_info *source_output; /**< Set if this is a source output */
+    const pa_sample_info *sample;              /**< Set if this is a sample cache entry */
+} pa_snapshot_entry;
+
+/** Callback prototype for pa_context_get_snapshot(). The terminating
+ * call (eol > 0) passes an entry where only generation and full are
+ * set, so that the generation is available even if nothing changed.
+ * \since 3.0 */
+typedef void (*pa_snapshot_cb_t)(pa_context *c, const pa_snapshot_entry *e, int eol, void *userdata);
+
+/** Get all objects selected by the subscription mask m that changed
+ * after the generation since, or all of them if since is 0. If the
+ * server does not know anymore what happened since that generation a
+ * full snapshot is sent. \since 3.0 */
+pa_operation* pa_context_get_snapshot(pa_context *c, uint64_t since, pa_subscription_mask_t m, pa_snapshot_cb_t cb, void *userdata);
+
+/** @} */
+
 /** \cond fulldocs */
 
 /** @{ \name Autoload Entries */
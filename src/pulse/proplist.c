@@ -30,19 +30,141 @@
 #include <pulse/utf8.h>
 
 #include <pulsecore/hashmap.h>
+#include <pulsecore/refcnt.h>
 #include <pulsecore/strbuf.h>
 #include <pulsecore/core-util.h>
 
 #include "proplist.h"
 
+/* Properties are immutable once created and refcounted, so that copies
+ * of a property list can share them. Setting a property replaces it
+ * with a new one. The value (always NUL terminated) and, unless it is
+ * one of the well-known keys, the key are allocated in one block
+ * together with the struct. */
 struct property {
-    char *key;
-    void *value;
+    PA_REFCNT_DECLARE;
+
+    const char *key;
     size_t nbytes;
 };
 
-#define MAKE_HASHMAP(p) ((pa_hashmap*) (p))
-#define MAKE_PROPLIST(p) ((pa_proplist*) (p))
+#define PROPERTY_VALUE(prop) ((uint8_t*) (prop) + PA_ALIGN(sizeof(struct property)))
+
+/* The hashmap of a property list. Copies of a property list share it
+ * until one of them is modified. */
+struct proplist_map {
+    PA_REFCNT_DECLARE;
+
+    pa_hashmap *hashmap;
+};
+
+struct pa_proplist {
+    /* NULL while the list is empty */
+    struct proplist_map *map;
+};
+
+/* Keys of properties created with one of these names point to this
+ * table instead of a copy of their own. Keep sorted by value. */
+static const char * const well_known_keys[] = {
+    PA_PROP_APPLICATION_ICON,
+    PA_PROP_APPLICATION_ICON_NAME,
+    PA_PROP_APPLICATION_ID,
+    PA_PROP_APPLICATION_LANGUAGE,
+    PA_PROP_APPLICATION_NAME,
+    PA_PROP_APPLICATION_PROCESS_BINARY,
+    PA_PROP_APPLICATION_PROCESS_HOST,
+    PA_PROP_APPLICATION_PROCESS_ID,
+    PA_PROP_APPLICATION_PROCESS_MACHINE_ID,
+    PA_PROP_APPLICATION_PROCESS_SESSION_ID,
+    PA_PROP_APPLICATION_PROCESS_USER,
+    PA_PROP_APPLICATION_VERSION,
+    PA_PROP_DEVICE_ACCESS_MODE,
+    PA_PROP_DEVICE_API,
+    PA_PROP_DEVICE_BUFFERING_BUFFER_SIZE,
+    PA_PROP_DEVICE_BUFFERING_FRAGMENT_SIZE,
+    PA_PROP_DEVICE_BUS,
+    PA_PROP_DEVICE_BUS_PATH,
+    PA_PROP_DEVICE_CLASS,
+    PA_PROP_DEVICE_DESCRIPTION,
+    PA_PROP_DEVICE_FORM_FACTOR,
+    PA_PROP_DEVICE_ICON,
+    PA_PROP_DEVICE_ICON_NAME,
+    PA_PROP_DEVICE_INTENDED_ROLES,
+    PA_PROP_DEVICE_MASTER_DEVICE,
+    PA_PROP_DEVICE_PRODUCT_ID,
+    PA_PROP_DEVICE_PRODUCT_NAME,
+    PA_PROP_DEVICE_PROFILE_DESCRIPTION,
+    PA_PROP_DEVICE_PROFILE_NAME,
+    PA_PROP_DEVICE_SERIAL,
+    PA_PROP_DEVICE_STRING,
+    PA_PROP_DEVICE_VENDOR_ID,
+    PA_PROP_DEVICE_VENDOR_NAME,
+    PA_PROP_EVENT_DESCRIPTION,
+    PA_PROP_EVENT_ID,
+    PA_PROP_EVENT_MOUSE_BUTTON,
+    PA_PROP_EVENT_MOUSE_HPOS,
+    PA_PROP_EVENT_MOUSE_VPOS,
+    PA_PROP_EVENT_MOUSE_X,
+    PA_PROP_EVENT_MOUSE_Y,
+    PA_PROP_FILTER_APPLY,
+    PA_PROP_FILTER_SUPPRESS,
+    PA_PROP_FILTER_WANT,
+    PA_PROP_FORMAT_CHANNEL_MAP,
+    PA_PROP_FORMAT_CHANNELS,
+    PA_PROP_FORMAT_RATE,
+    PA_PROP_FORMAT_SAMPLE_FORMAT,
+    PA_PROP_MEDIA_ARTIST,
+    PA_PROP_MEDIA_COPYRIGHT,
+    PA_PROP_MEDIA_FILENAME,
+    PA_PROP_MEDIA_ICON,
+    PA_PROP_MEDIA_ICON_NAME,
+    PA_PROP_MEDIA_LANGUAGE,
+    PA_PROP_MEDIA_NAME,
+    PA_PROP_MEDIA_ROLE,
+    PA_PROP_MEDIA_SOFTWARE,
+    PA_PROP_MEDIA_TITLE,
+    PA_PROP_MODULE_AUTHOR,
+    PA_PROP_MODULE_DESCRIPTION,
+    PA_PROP_MODULE_USAGE,
+    PA_PROP_MODULE_VERSION,
+    PA_PROP_WINDOW_DESKTOP,
+    PA_PROP_WINDOW_HEIGHT,
+    PA_PROP_WINDOW_HPOS,
+    PA_PROP_WINDOW_ICON,
+    PA_PROP_WINDOW_ICON_NAME,
+    PA_PROP_WINDOW_ID,
+    PA_PROP_WINDOW_NAME,
+    PA_PROP_WINDOW_VPOS,
+    PA_PROP_WINDOW_WIDTH,
+    PA_PROP_WINDOW_X,
+    PA_PROP_WINDOW_X11_DISPLAY,
+    PA_PROP_WINDOW_X11_MONITOR,
+    PA_PROP_WINDOW_X11_SCREEN,
+    PA_PROP_WINDOW_X11_XID,
+    PA_PROP_WINDOW_Y,
+};
+
+static const char *lookup_well_known_key(const char *key, size_t key_length) {
+    unsigned l = 0, r = PA_ELEMENTSOF(well_known_keys);
+
+    while (l < r) {
+        unsigned m = (l + r) / 2;
+        int c;
+
+        if ((c = strncmp(key, well_known_keys[m], key_length)) == 0)
+            c = well_known_keys[m][key_length] == 0 ? 0 : -1;
+
+        if (c == 0)
+            return well_known_keys[m];
+
+        if (c < 0)
+            r = m;
+        else
+            l = m + 1;
+    }
+
+    return NULL;
+}
 
 static pa_bool_t property_name_valid(const char *key) {
 
@@ -55,29 +177,153 @@ static pa_bool_t property_name_valid(const char *key) {
     return TRUE;
 }
 
-static void property_free(struct property *prop) {
+/* Creates a property with room for nbytes of value, which the caller
+ * fills in */
+static struct property *property_new(const char *key, size_t key_length, size_t nbytes) {
+    struct property *prop;
+    const char *k;
+    size_t l;
+
+    l = PA_ALIGN(sizeof(struct property)) + nbytes + 1;
+
+    if ((k = lookup_well_known_key(key, key_length)))
+        prop = pa_xmalloc(l);
+    else {
+        char *t;
+
+        prop = pa_xmalloc(l + key_length + 1);
+        t = (char*) prop + l;
+        memcpy(t, key, key_length);
+        t[key_length] = 0;
+        k = t;
+    }
+
+    PA_REFCNT_INIT(prop);
+    prop->key = k;
+    prop->nbytes = nbytes;
+    PROPERTY_VALUE(prop)[nbytes] = 0;
+
+    return prop;
+}
+
+static struct property *property_ref(struct property *prop) {
+    pa_assert(prop);
+    pa_assert(PA_REFCNT_VALUE(prop) >= 1);
+
+    PA_REFCNT_INC(prop);
+    return prop;
+}
+
+static void property_unref(struct property *prop) {
     pa_assert(prop);
+    pa_assert(PA_REFCNT_VALUE(prop) >= 1);
+
+    if (PA_REFCNT_DEC(prop) <= 0)
+        pa_xfree(prop);
+}
+
+static void property_free_cb(void *p, void *userdata) {
+    property_unref(p);
+}
+
+static struct proplist_map *map_new(void) {
+    struct proplist_map *m;
+
+    m = pa_xnew(struct proplist_map, 1);
+    PA_REFCNT_INIT(m);
+    m->hashmap = pa_hashmap_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func);
+
+    return m;
+}
+
+static void map_unref(struct proplist_map *m) {
+    pa_assert(m);
+    pa_assert(PA_REFCNT_VALUE(m) >= 1);
+
+    if (PA_REFCNT_DEC(m) > 0)
+        return;
+
+    pa_hashmap_free(m->hashmap, property_free_cb, NULL);
+    pa_xfree(m);
+}
+
+static pa_hashmap *get_hashmap(pa_proplist *p) {
+    pa_assert(p);
+
+    return p->map ? p->map->hashmap : NULL;
+}
+
+/* Makes sure we have a hashmap of our own that may be modified. The
+ * properties themselves stay shared, so pointers to values handed out
+ * earlier stay valid for as long as the property isn't changed. */
+static pa_hashmap *make_writable(pa_proplist *p) {
+    struct proplist_map *m;
+    struct property *prop;
+    void *state;
 
-    pa_xfree(prop->key);
-    pa_xfree(prop->value);
-    pa_xfree(prop);
+    pa_assert(p);
+
+    if (!p->map) {
+        p->map = map_new();
+        return p->map->hashmap;
+    }
+
+    if (PA_REFCNT_VALUE(p->map) <= 1)
+        return p->map->hashmap;
+
+    m = map_new();
+
+    PA_HASHMAP_FOREACH(prop, p->map->hashmap, state)
+        pa_hashmap_put(m->hashmap, prop->key, property_ref(prop));
+
+    map_unref(p->map);
+    p->map = m;
+
+    return m->hashmap;
+}
+
+/* Takes over the reference to prop */
+static void put_property(pa_proplist *p, struct property *prop) {
+    pa_hashmap *h;
+    struct property *old;
+
+    h = make_writable(p);
+
+    if ((old = pa_hashmap_remove(h, prop->key)))
+        property_unref(old);
+
+    pa_assert_se(pa_hashmap_put(h, prop->key, prop) == 0);
+}
+
+static struct property *get_property(pa_proplist *p, const char *key) {
+    pa_hashmap *h;
+
+    if (!(h = get_hashmap(p)))
+        return NULL;
+
+    return pa_hashmap_get(h, key);
 }
 
 pa_proplist* pa_proplist_new(void) {
-    return MAKE_PROPLIST(pa_hashmap_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func));
+    pa_proplist *p;
+
+    p = pa_xnew(pa_proplist, 1);
+    p->map = NULL;
+
+    return p;
 }
 
 void pa_proplist_free(pa_proplist* p) {
     pa_assert(p);
 
     pa_proplist_clear(p);
-    pa_hashmap_free(MAKE_HASHMAP(p), NULL, NULL);
+    pa_xfree(p);
 }
 
 /** Will accept only valid UTF-8 */
 int pa_proplist_sets(pa_proplist *p, const char *key, const char *value) {
     struct property *prop;
-    pa_bool_t add = FALSE;
+    size_t l;
 
     pa_assert(p);
     pa_assert(key);
@@ -86,18 +332,10 @@ int pa_proplist_sets(pa_proplist *p, const char *key, const char *value) {
     if (!property_name_valid(key) || !pa_utf8_valid(value))
         return -1;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = pa_xstrdup(key);
-        add = TRUE;
-    } else
-        pa_xfree(prop->value);
-
-    prop->value = pa_xstrdup(value);
-    prop->nbytes = strlen(value)+1;
-
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
+    l = strlen(value);
+    prop = property_new(key, strlen(key), l + 1);
+    memcpy(PROPERTY_VALUE(prop), value, l + 1);
+    put_property(p, prop);
 
     return 0;
 }
@@ -105,7 +343,6 @@ int pa_proplist_sets(pa_proplist *p, const char *key, const char *value) {
 /** Will accept only valid UTF-8 */
 static int proplist_setn(pa_proplist *p, const char *key, size_t key_length, const char *value, size_t value_length) {
     struct property *prop;
-    pa_bool_t add = FALSE;
     char *k, *v;
 
     pa_assert(p);
@@ -121,20 +358,13 @@ static int proplist_setn(pa_proplist *p, const char *key, size_t key_length, con
         return -1;
     }
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), k))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = k;
-        add = TRUE;
-    } else {
-        pa_xfree(prop->value);
-        pa_xfree(k);
-    }
-
-    prop->value = v;
-    prop->nbytes = strlen(v)+1;
+    value_length = strlen(v);
+    prop = property_new(k, strlen(k), value_length + 1);
+    memcpy(PROPERTY_VALUE(prop), v, value_length + 1);
+    put_property(p, prop);
 
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
+    pa_xfree(k);
+    pa_xfree(v);
 
     return 0;
 }
@@ -156,7 +386,6 @@ int pa_proplist_setp(pa_proplist *p, const char *pair) {
 
 static int proplist_sethex(pa_proplist *p, const char *key, size_t key_length, const char *value, size_t value_length) {
     struct property *prop;
-    pa_bool_t add = FALSE;
     char *k, *v;
     uint8_t *d;
     size_t dn;
@@ -184,21 +413,12 @@ static int proplist_sethex(pa_proplist *p, const char *key, size_t key_length, c
 
     pa_xfree(v);
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), k))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = k;
-        add = TRUE;
-    } else {
-        pa_xfree(prop->value);
-        pa_xfree(k);
-    }
-
-    d[dn] = 0;
-    prop->value = d;
-    prop->nbytes = dn;
+    prop = property_new(k, strlen(k), dn);
+    memcpy(PROPERTY_VALUE(prop), d, dn);
+    put_property(p, prop);
 
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
+    pa_xfree(k);
+    pa_xfree(d);
 
     return 0;
 }
@@ -206,9 +426,9 @@ static int proplist_sethex(pa_proplist *p, const char *key, size_t key_length, c
 /** Will accept only valid UTF-8 */
 int pa_proplist_setf(pa_proplist *p, const char *key, const char *format, ...) {
     struct property *prop;
-    pa_bool_t add = FALSE;
     va_list ap;
     char *v;
+    size_t l;
 
     pa_assert(p);
     pa_assert(key);
@@ -224,19 +444,12 @@ int pa_proplist_setf(pa_proplist *p, const char *key, const char *format, ...) {
     if (!pa_utf8_valid(v))
         goto fail;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = pa_xstrdup(key);
-        add = TRUE;
-    } else
-        pa_xfree(prop->value);
-
-    prop->value = v;
-    prop->nbytes = strlen(v)+1;
-
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
+    l = strlen(v);
+    prop = property_new(key, strlen(key), l + 1);
+    memcpy(PROPERTY_VALUE(prop), v, l + 1);
+    put_property(p, prop);
 
+    pa_xfree(v);
     return 0;
 
 fail:
@@ -246,7 +459,6 @@ fail:
 
 int pa_proplist_set(pa_proplist *p, const char *key, const void *data, size_t nbytes) {
     struct property *prop;
-    pa_bool_t add = FALSE;
 
     pa_assert(p);
     pa_assert(key);
@@ -255,21 +467,10 @@ int pa_proplist_set(pa_proplist *p, const char *key, const void *data, size_t nb
     if (!property_name_valid(key))
         return -1;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key))) {
-        prop = pa_xnew(struct property, 1);
-        prop->key = pa_xstrdup(key);
-        add = TRUE;
-    } else
-        pa_xfree(prop->value);
-
-    prop->value = pa_xmalloc(nbytes+1);
+    prop = property_new(key, strlen(key), nbytes);
     if (nbytes > 0)
-        memcpy(prop->value, data, nbytes);
-    ((char*) prop->value)[nbytes] = 0;
-    prop->nbytes = nbytes;
-
-    if (add)
-        pa_hashmap_put(MAKE_HASHMAP(p), prop->key, prop);
+        memcpy(PROPERTY_VALUE(prop), data, nbytes);
+    put_property(p, prop);
 
     return 0;
 }
@@ -283,22 +484,22 @@ const char *pa_proplist_gets(pa_proplist *p, const char *key) {
     if (!property_name_valid(key))
         return NULL;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key)))
+    if (!(prop = get_property(p, key)))
         return NULL;
 
     if (prop->nbytes <= 0)
         return NULL;
 
-    if (((char*) prop->value)[prop->nbytes-1] != 0)
+    if (PROPERTY_VALUE(prop)[prop->nbytes-1] != 0)
         return NULL;
 
-    if (strlen((char*) prop->value) != prop->nbytes-1)
+    if (strlen((char*) PROPERTY_VALUE(prop)) != prop->nbytes-1)
         return NULL;
 
-    if (!pa_utf8_valid((char*) prop->value))
+    if (!pa_utf8_valid((char*) PROPERTY_VALUE(prop)))
         return NULL;
 
-    return (char*) prop->value;
+    return (char*) PROPERTY_VALUE(prop);
 }
 
 int pa_proplist_get(pa_proplist *p, const char *key, const void **data, size_t *nbytes) {
@@ -312,10 +513,10 @@ int pa_proplist_get(pa_proplist *p, const char *key, const void **data, size_t *
     if (!property_name_valid(key))
         return -1;
 
-    if (!(prop = pa_hashmap_get(MAKE_HASHMAP(p), key)))
+    if (!(prop = get_property(p, key)))
         return -1;
 
-    *data = prop->value;
+    *data = PROPERTY_VALUE(prop);
     *nbytes = prop->nbytes;
 
     return 0;
@@ -323,21 +524,34 @@ int pa_proplist_get(pa_proplist *p, const char *key, const void **data, size_t *
 
 void pa_proplist_update(pa_proplist *p, pa_update_mode_t mode, pa_proplist *other) {
     struct property *prop;
-    void *state = NULL;
+    void *state;
 
     pa_assert(p);
     pa_assert(mode == PA_UPDATE_SET || mode == PA_UPDATE_MERGE || mode == PA_UPDATE_REPLACE);
     pa_assert(other);
 
+    if (p == other)
+        return;
+
     if (mode == PA_UPDATE_SET)
         pa_proplist_clear(p);
 
-    while ((prop = pa_hashmap_iterate(MAKE_HASHMAP(other), &state, NULL))) {
+    if (!other->map)
+        return;
+
+    /* Updating an empty list is just a copy, share the whole map */
+    if (!p->map) {
+        PA_REFCNT_INC(other->map);
+        p->map = other->map;
+        return;
+    }
+
+    PA_HASHMAP_FOREACH(prop, other->map->hashmap, state) {
 
-        if (mode == PA_UPDATE_MERGE && pa_proplist_contains(p, prop->key))
+        if (mode == PA_UPDATE_MERGE && get_property(p, prop->key))
             continue;
 
-        pa_assert_se(pa_proplist_set(p, prop->key, prop->value, prop->nbytes) == 0);
+        put_property(p, property_ref(prop));
     }
 }
 
@@ -350,10 +564,11 @@ int pa_proplist_unset(pa_proplist *p, const char *key) {
     if (!property_name_valid(key))
         return -1;
 
-    if (!(prop = pa_hashmap_remove(MAKE_HASHMAP(p), key)))
+    if (!get_property(p, key))
         return -2;
 
-    property_free(prop);
+    pa_assert_se(prop = pa_hashmap_remove(make_writable(p), key));
+    property_unref(prop);
     return 0;
 }
 
@@ -377,8 +592,12 @@ int pa_proplist_unset_many(pa_proplist *p, const char * const keys[]) {
 
 const char *pa_proplist_iterate(pa_proplist *p, void **state) {
     struct property *prop;
+    pa_hashmap *h;
+
+    if (!(h = get_hashmap(p)))
+        return NULL;
 
-    if (!(prop = pa_hashmap_iterate(MAKE_HASHMAP(p), state, NULL)))
+    if (!(prop = pa_hashmap_iterate(h, state, NULL)))
         return NULL;
 
     return prop->key;
@@ -630,7 +849,7 @@ pa_proplist *pa_proplist_from_string(const char *s) {
     }
 
 success:
-    return MAKE_PROPLIST(pl);
+    return pl;
 
 fail:
     pa_proplist_free(pl);
@@ -644,18 +863,19 @@ int pa_proplist_contains(pa_proplist *p, const char *key) {
     if (!property_name_valid(key))
         return -1;
 
-    if (!(pa_hashmap_get(MAKE_HASHMAP(p), key)))
+    if (!get_property(p, key))
         return 0;
 
     return 1;
 }
 
 void pa_proplist_clear(pa_proplist *p) {
-    struct property *prop;
     pa_assert(p);
 
-    while ((prop = pa_hashmap_steal_first(MAKE_HASHMAP(p))))
-        property_free(prop);
+    if (p->map) {
+        map_unref(p->map);
+        p->map = NULL;
+    }
 }
 
 pa_proplist* pa_proplist_copy(pa_proplist *template) {
@@ -672,13 +892,13 @@ pa_proplist* pa_proplist_copy(pa_proplist *template) {
 unsigned pa_proplist_size(pa_proplist *p) {
     pa_assert(p);
 
-    return pa_hashmap_size(MAKE_HASHMAP(p));
+    return p->map ? pa_hashmap_size(p->map->hashmap) : 0;
 }
 
 int pa_proplist_isempty(pa_proplist *p) {
     pa_assert(p);
 
-    return pa_hashmap_isempty(MAKE_HASHMAP(p));
+    return pa_proplist_size(p) == 0;
 }
 
 int pa_proplist_equal(pa_proplist *a, pa_proplist *b) {
@@ -690,20 +910,26 @@ int pa_proplist_equal(pa_proplist *a, pa_proplist *b) {
     pa_assert(a);
     pa_assert(b);
 
-    if (a == b)
+    if (a == b || a->map == b->map)
         return 1;
 
     if (pa_proplist_size(a) != pa_proplist_size(b))
         return 0;
 
-    while ((a_prop = pa_hashmap_iterate(MAKE_HASHMAP(a), &state, &key))) {
-        if (!(b_prop = pa_hashmap_get(MAKE_HASHMAP(b), key)))
+    if (!a->map)
+        return 1;
+
+    while ((a_prop = pa_hashmap_iterate(a->map->hashmap, &state, &key))) {
+        if (!(b_prop = get_property(b, key)))
             return 0;
 
+        if (a_prop == b_prop)
+            continue;
+
         if (a_prop->nbytes != b_prop->nbytes)
             return 0;
 
-        if (memcmp(a_prop->value, b_prop->value, a_prop->nbytes) != 0)
+        if (memcmp(PROPERTY_VALUE(a_prop), PROPERTY_VALUE(b_prop), a_prop->nbytes) != 0)
             return 0;
     }
 
@@ -390,7 +390,9 @@ int pa_proplist_contains(pa_proplist *p, const char *key);
 void pa_proplist_clear(pa_proplist *p);
 
 /** Allocate a new property list and copy over every single entry from
- * the specific list. \since 0.9.11 */
+ * the specific list. Since 3.0 the entries are shared with the
+ * original list until either of them is modified, so this is cheap.
+ * \since 0.9.11 */
 pa_proplist* pa_proplist_copy(pa_proplist *p);
 
 /** Return the number of entries in the property list. \since 0.9.15 */
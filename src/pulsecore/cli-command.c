@@ -371,9 +371,20 @@ static int pa_cli_command_stat(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_b
                      (unsigned) pa_atomic_load(&mstat->n_exported),
                      pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) pa_atomic_load(&mstat->exported_size)));
 
+    pa_strbuf_printf(buf, "Subscription events posted: %llu, coalesced: %llu, dispatched: %llu.\n",
+                     (unsigned long long) c->n_subscription_events_posted,
+                     (unsigned long long) c->n_subscription_events_coalesced,
+                     (unsigned long long) c->n_subscription_events_dispatched);
+
     pa_strbuf_printf(buf, "Total sample cache size: %s.\n",
                      pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) pa_scache_total_size(c)));
 
+    pa_strbuf_printf(buf, "Converted sample cache entries: %u, size: %s",
+                     c->n_scache_converted,
+                     pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) c->scache_converted_size));
+    pa_strbuf_printf(buf, " of %s.\n",
+                     pa_bytes_snprint(bytes, sizeof(bytes), (unsigned) c->scache_converted_size_max));
+
     pa_strbuf_printf(buf, "Default sample spec: %s\n",
                      pa_sample_spec_snprint(ss, sizeof(ss), &c->default_sample_spec));
 
@@ -1167,7 +1178,7 @@ static int pa_cli_command_play_file(pa_core *c, pa_tokenizer *t, pa_strbuf *buf,
     }
 
 
-    return pa_play_file(sink, fname, NULL);
+    return pa_play_file(sink, fname, NULL, NULL, 0, NULL);
 }
 
 static int pa_cli_command_list_shared_props(pa_core *c, pa_tokenizer *t, pa_strbuf *buf, pa_bool_t *fail) {
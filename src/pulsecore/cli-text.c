@@ -57,12 +57,16 @@ char *pa_module_list_to_string(pa_core *c) {
                          "\tname: <%s>\n"
                          "\targument: <%s>\n"
                          "\tused: %i\n"
-                         "\tload once: %s\n",
+                         "\tload once: %s\n"
+                         "\tload time: %0.1f ms (open %0.1f ms, init %0.1f ms)\n",
                          m->index,
                          m->name,
                          pa_strempty(m->argument),
                          pa_module_get_n_used(m),
-                         pa_yes_no(m->load_once));
+                         pa_yes_no(m->load_once),
+                         (double) (m->open_usec + m->init_usec) / PA_USEC_PER_MSEC,
+                         (double) m->open_usec / PA_USEC_PER_MSEC,
+                         (double) m->init_usec / PA_USEC_PER_MSEC);
 
         t = pa_proplist_to_string_sep(m->proplist, "\n\t\t");
         pa_strbuf_printf(s, "\tproperties:\n\t\t%s\n", t);
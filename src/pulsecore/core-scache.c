@@ -51,9 +51,11 @@
 
 #include <pulsecore/sink-input.h>
 #include <pulsecore/play-memchunk.h>
+#include <pulsecore/resampler.h>
 #include <pulsecore/core-subscribe.h>
 #include <pulsecore/namereg.h>
 #include <pulsecore/sound-file.h>
+#include <pulsecore/sound-file-stream.h>
 #include <pulsecore/core-rtclock.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/log.h>
@@ -64,6 +66,18 @@
 
 #define UNLOAD_POLL_TIME (60 * PA_USEC_PER_SEC)
 
+/* An entry is converted for a sink once it is played there for the
+ * second time */
+#define CONVERT_MIN_PLAYS 2
+
+struct pa_scache_converted {
+    pa_sample_spec sample_spec;
+    pa_channel_map channel_map;
+    pa_memchunk memchunk;
+    pa_usec_t last_used;
+    PA_LLIST_FIELDS(pa_scache_converted);
+};
+
 static void timeout_callback(pa_mainloop_api *m, pa_time_event *e, const struct timeval *t, void *userdata) {
     pa_core *c = userdata;
 
@@ -76,9 +90,40 @@ static void timeout_callback(pa_mainloop_api *m, pa_time_event *e, const struct
     pa_core_rttime_restart(c, e, pa_rtclock_now() + UNLOAD_POLL_TIME);
 }
 
+/* Lazy entries and converted copies are dropped again by a periodic
+ * check, which is started by the first of them */
+static void start_auto_unload(pa_core *c) {
+    pa_assert(c);
+
+    if (!c->scache_auto_unload_event)
+        c->scache_auto_unload_event = pa_core_rttime_new(c, pa_rtclock_now() + UNLOAD_POLL_TIME, timeout_callback, c);
+}
+
+static void free_converted(pa_scache_entry *e, pa_scache_converted *v) {
+    pa_assert(e);
+    pa_assert(v);
+
+    PA_LLIST_REMOVE(pa_scache_converted, e->converted, v);
+
+    pa_assert(e->core->scache_converted_size >= v->memchunk.length);
+    e->core->scache_converted_size -= v->memchunk.length;
+    e->core->n_scache_converted--;
+
+    pa_memblock_unref(v->memchunk.memblock);
+    pa_xfree(v);
+}
+
+static void free_all_converted(pa_scache_entry *e) {
+    pa_assert(e);
+
+    while (e->converted)
+        free_converted(e, e->converted);
+}
+
 static void free_entry(pa_scache_entry *e) {
     pa_assert(e);
 
+    free_all_converted(e);
     pa_namereg_unregister(e->core, e->name);
     pa_subscription_post(e->core, PA_SUBSCRIPTION_EVENT_SAMPLE_CACHE|PA_SUBSCRIPTION_EVENT_REMOVE, e->index);
     pa_xfree(e->name);
@@ -102,6 +147,7 @@ static pa_scache_entry* scache_add_item(pa_core *c, const char *name) {
 
         pa_xfree(e->filename);
         pa_proplist_clear(e->proplist);
+        free_all_converted(e);
 
         pa_assert(e->core == c);
 
@@ -117,6 +163,7 @@ static pa_scache_entry* scache_add_item(pa_core *c, const char *name) {
         e->name = pa_xstrdup(name);
         e->core = c;
         e->proplist = pa_proplist_new();
+        PA_LLIST_HEAD_INIT(pa_scache_converted, e->converted);
 
         pa_idxset_put(c->scache, e, &e->index);
 
@@ -127,7 +174,9 @@ static pa_scache_entry* scache_add_item(pa_core *c, const char *name) {
     pa_memchunk_reset(&e->memchunk);
     e->filename = NULL;
     e->lazy = FALSE;
+    e->stream = FALSE;
     e->last_used_time = 0;
+    e->n_played = 0;
 
     pa_sample_spec_init(&e->sample_spec);
     pa_channel_map_init(&e->channel_map);
@@ -254,8 +303,7 @@ int pa_scache_add_file_lazy(pa_core *c, const char *name, const char *filename,
 
     pa_proplist_sets(e->proplist, PA_PROP_MEDIA_FILENAME, filename);
 
-    if (!c->scache_auto_unload_event)
-        c->scache_auto_unload_event = pa_core_rttime_new(c, pa_rtclock_now() + UNLOAD_POLL_TIME, timeout_callback, c);
+    start_auto_unload(c);
 
     if (idx)
         *idx = e->index;
@@ -295,8 +343,134 @@ void pa_scache_free_all(pa_core *c) {
     }
 }
 
+static pa_scache_converted *find_converted(pa_scache_entry *e, pa_sink *sink) {
+    pa_scache_converted *v;
+
+    PA_LLIST_FOREACH(v, e->converted)
+        if (pa_sample_spec_equal(&v->sample_spec, &sink->sample_spec) &&
+            pa_channel_map_equal(&v->channel_map, &sink->channel_map))
+            return v;
+
+    return NULL;
+}
+
+/* Drops the least recently played converted copies until another size
+ * bytes fit into the budget */
+static pa_bool_t make_room(pa_core *c, size_t size) {
+
+    if (size > c->scache_converted_size_max)
+        return FALSE;
+
+    while (c->scache_converted_size + size > c->scache_converted_size_max) {
+        pa_scache_entry *e, *oldest_e = NULL;
+        pa_scache_converted *v, *oldest = NULL;
+        uint32_t idx;
+
+        PA_IDXSET_FOREACH(e, c->scache, idx)
+            PA_LLIST_FOREACH(v, e->converted)
+                if (!oldest || v->last_used < oldest->last_used) {
+                    oldest = v;
+                    oldest_e = e;
+                }
+
+        pa_assert(oldest);
+        free_converted(oldest_e, oldest);
+    }
+
+    return TRUE;
+}
+
+static pa_scache_converted *convert(pa_scache_entry *e, pa_sink *sink) {
+    pa_core *c = e->core;
+    pa_resampler *r;
+    pa_scache_converted *v;
+    size_t block, allocated, length = 0, done = 0;
+    uint8_t *data;
+    char st[PA_SAMPLE_SPEC_SNPRINT_MAX];
+
+    if (!(r = pa_resampler_new(c->mempool,
+                               &e->sample_spec, &e->channel_map,
+                               &sink->sample_spec, &sink->channel_map,
+                               c->resample_method,
+                               (c->disable_remixing ? PA_RESAMPLER_NO_REMIX : 0) |
+                               (c->disable_lfe_remixing ? PA_RESAMPLER_NO_LFE : 0))))
+        return NULL;
+
+    allocated = pa_resampler_result(r, e->memchunk.length);
+
+    if (allocated > c->scache_converted_size_max) {
+        pa_resampler_free(r);
+        return NULL;
+    }
+
+    data = pa_xmalloc(allocated);
+    block = pa_resampler_max_block_size(r);
+
+    while (done < e->memchunk.length) {
+        pa_memchunk in, out;
+        void *p;
+
+        in = e->memchunk;
+        in.index += done;
+        in.length = PA_MIN(e->memchunk.length - done, block);
+        done += in.length;
+
+        pa_resampler_run(r, &in, &out);
+
+        if (!out.memblock)
+            continue;
+
+        if (length + out.length > allocated)
+            data = pa_xrealloc(data, allocated = length + out.length);
+
+        p = pa_memblock_acquire(out.memblock);
+        memcpy(data + length, (uint8_t*) p + out.index, out.length);
+        pa_memblock_release(out.memblock);
+        pa_memblock_unref(out.memblock);
+
+        length += out.length;
+    }
+
+    pa_resampler_free(r);
+
+    if (length <= 0) {
+        pa_xfree(data);
+        return NULL;
+    }
+
+    /* Only evict other copies now that this one exists */
+    if (!make_room(c, length)) {
+        pa_xfree(data);
+        return NULL;
+    }
+
+    if (length < allocated)
+        data = pa_xrealloc(data, length);
+
+    v = pa_xnew(pa_scache_converted, 1);
+    v->sample_spec = sink->sample_spec;
+    v->channel_map = sink->channel_map;
+    v->memchunk.memblock = pa_memblock_new_malloced(c->mempool, data, length);
+    v->memchunk.index = 0;
+    v->memchunk.length = length;
+    v->last_used = 0;
+    PA_LLIST_PREPEND(pa_scache_converted, e->converted, v);
+
+    c->scache_converted_size += length;
+    c->n_scache_converted++;
+
+    start_auto_unload(c);
+
+    pa_log_debug("Converted sample \"%s\" to %s for sink \"%s\", %lu bytes",
+                 e->name, pa_sample_spec_snprint(st, sizeof(st), &v->sample_spec),
+                 sink->name, (unsigned long) length);
+
+    return v;
+}
+
 int pa_scache_play_item(pa_core *c, const char *name, pa_sink *sink, pa_volume_t volume, pa_proplist *p, uint32_t *sink_input_idx) {
     pa_scache_entry *e;
+    pa_scache_converted *v;
     pa_cvolume r;
     pa_proplist *merged;
     pa_bool_t pass_volume;
@@ -312,10 +486,18 @@ int pa_scache_play_item(pa_core *c, const char *name, pa_sink *sink, pa_volume_t
     pa_proplist_sets(merged, PA_PROP_MEDIA_NAME, name);
     pa_proplist_sets(merged, PA_PROP_EVENT_ID, name);
 
-    if (e->lazy && !e->memchunk.memblock) {
+    /* With a converted copy for this sink we don't even need to load
+     * lazy entries */
+    v = find_converted(e, sink);
+
+    if (!v && e->lazy && !e->memchunk.memblock && !e->stream) {
         pa_channel_map old_channel_map = e->channel_map;
 
-        if (pa_sound_file_load(c->mempool, e->filename, &e->sample_spec, &e->channel_map, &e->memchunk, merged) < 0)
+        /* Big files that can't be mapped are streamed from disk on
+         * each play instead of being decoded into memory */
+        if (pa_sound_file_too_big_to_cache(e->filename, &e->sample_spec, &e->channel_map) > 0)
+            e->stream = TRUE;
+        else if (pa_sound_file_load(c->mempool, e->filename, &e->sample_spec, &e->channel_map, &e->memchunk, merged) < 0)
             goto fail;
 
         pa_subscription_post(c, PA_SUBSCRIPTION_EVENT_SAMPLE_CACHE|PA_SUBSCRIPTION_EVENT_CHANGE, e->index);
@@ -328,10 +510,20 @@ int pa_scache_play_item(pa_core *c, const char *name, pa_sink *sink, pa_volume_t
         }
     }
 
-    if (!e->memchunk.memblock)
+    if (!v && !e->memchunk.memblock && !e->stream)
         goto fail;
 
-    pa_log_debug("Playing sample \"%s\" on \"%s\"", name, sink->name);
+    e->n_played++;
+
+    if (!v &&
+        !e->stream &&
+        e->n_played >= CONVERT_MIN_PLAYS &&
+        c->scache_converted_size_max > 0 &&
+        (!pa_sample_spec_equal(&e->sample_spec, &sink->sample_spec) ||
+         !pa_channel_map_equal(&e->channel_map, &sink->channel_map)))
+        v = convert(e, sink);
+
+    pa_log_debug("Playing sample \"%s\" on \"%s\"%s", name, sink->name, v ? " (converted)" : e->stream ? " (streamed)" : "");
 
     pass_volume = TRUE;
 
@@ -350,12 +542,26 @@ int pa_scache_play_item(pa_core *c, const char *name, pa_sink *sink, pa_volume_t
     if (p)
         pa_proplist_update(merged, PA_UPDATE_REPLACE, p);
 
-    if (pa_play_memchunk(sink,
-                         &e->sample_spec, &e->channel_map,
-                         &e->memchunk,
+    if (v) {
+        if (pass_volume)
+            pa_cvolume_remap(&r, &e->channel_map, &v->channel_map);
+
+        v->last_used = pa_rtclock_now();
+    }
+
+    if (e->stream) {
+        if (pa_play_file(sink, e->filename,
                          pass_volume ? &r : NULL,
                          merged,
                          PA_SINK_INPUT_NO_CREATE_ON_SUSPEND|PA_SINK_INPUT_KILL_ON_SUSPEND, sink_input_idx) < 0)
+            goto fail;
+    } else if (pa_play_memchunk(sink,
+                                v ? &v->sample_spec : &e->sample_spec,
+                                v ? &v->channel_map : &e->channel_map,
+                                v ? &v->memchunk : &e->memchunk,
+                                pass_volume ? &r : NULL,
+                                merged,
+                                PA_SINK_INPUT_NO_CREATE_ON_SUSPEND|PA_SINK_INPUT_KILL_ON_SUSPEND, sink_input_idx) < 0)
         goto fail;
 
     pa_proplist_free(merged);
@@ -420,12 +626,13 @@ size_t pa_scache_total_size(pa_core *c) {
         if (e->memchunk.memblock)
             sum += e->memchunk.length;
 
-    return sum;
+    return sum + c->scache_converted_size;
 }
 
 void pa_scache_unload_unused(pa_core *c) {
     pa_scache_entry *e;
     time_t now;
+    pa_usec_t now_usec;
     uint32_t idx;
 
     pa_assert(c);
@@ -434,8 +641,14 @@ void pa_scache_unload_unused(pa_core *c) {
         return;
 
     time(&now);
+    now_usec = pa_rtclock_now();
 
     for (e = pa_idxset_first(c->scache, &idx); e; e = pa_idxset_next(c->scache, &idx)) {
+        pa_scache_converted *v, *n;
+
+        PA_LLIST_FOREACH_SAFE(v, n, e->converted)
+            if (v->last_used + (pa_usec_t) c->scache_idle_time * PA_USEC_PER_SEC <= now_usec)
+                free_converted(e, v);
 
         if (!e->lazy || !e->memchunk.memblock)
             continue;
@@ -26,9 +26,16 @@
 #include <pulsecore/core.h>
 #include <pulsecore/memchunk.h>
 #include <pulsecore/sink.h>
+#include <pulsecore/llist.h>
 
 #define PA_SCACHE_ENTRY_SIZE_MAX (1024*1024*16)
 
+/* Lazy entries that would decode to more than this and can't be
+ * mapped from disk are streamed instead of cached */
+#define PA_SCACHE_ENTRY_STREAM_SIZE (1024*1024)
+
+typedef struct pa_scache_converted pa_scache_converted;
+
 typedef struct pa_scache_entry {
     uint32_t index;
     pa_core *core;
@@ -44,9 +51,15 @@ typedef struct pa_scache_entry {
     char *filename;
 
     pa_bool_t lazy;
+    pa_bool_t stream;
     time_t last_used_time;
 
     pa_proplist *proplist;
+
+    /* Copies converted to the sample spec of the sinks the entry has
+     * been played on */
+    unsigned n_played;
+    PA_LLIST_HEAD(pa_scache_converted, converted);
 } pa_scache_entry;
 
 int pa_scache_add_item(pa_core *c, const char *name, const pa_sample_spec *ss, const pa_channel_map *map, const pa_memchunk *chunk, pa_proplist *p, uint32_t *idx);
@@ -25,8 +25,10 @@
 
 #include <stdio.h>
 
+#include <pulse/rtclock.h>
 #include <pulse/xmalloc.h>
 
+#include <pulsecore/hashmap.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
 
@@ -37,7 +39,13 @@
  * register a callback function that is called whenever an event
  * matching a subscription mask happens. The execution of the callback
  * function is postponed to the next main loop iteration, i.e. is not
- * called from within the stack frame the entity was created in. */
+ * called from within the stack frame the entity was created in.
+ *
+ * At most one event per entity is queued at any time. If
+ * subscription_coalesce_usec is set, "change" events for an entity
+ * that was reported less than that time ago are held back until the
+ * interval has passed, so that a burst of changes results in only a
+ * few events. */
 
 struct pa_subscription {
     pa_core *core;
@@ -56,11 +64,90 @@ struct pa_subscription_event {
     pa_subscription_event_type_t type;
     uint32_t index;
 
+    /* Held back events are not in the queue but only referenced from
+     * their entity */
+    pa_bool_t held;
+    struct entity *entity;
+
     PA_LLIST_FIELDS(pa_subscription_event);
 };
 
+/* Book-keeping for an entity that has an event pending or was reported
+ * recently */
+struct entity {
+    pa_subscription_event_type_t facility;
+    uint32_t index;
+
+    pa_subscription_event *event;
+    pa_usec_t last_dispatch;
+};
+
+/* Remembers the generation in which an object was last reported. Entries
+ * of removed objects are kept in a list, oldest first, and are dropped
+ * once there are more than MAX_REMOVED_OBJECTS of them. */
+struct pa_object_generation {
+    pa_subscription_event_type_t facility;
+    uint32_t index;
+
+    uint64_t generation;
+    pa_bool_t removed;
+
+    PA_LLIST_FIELDS(pa_object_generation);
+};
+
+#define MAX_REMOVED_OBJECTS 1024
+
 static void sched_event(pa_core *c);
 
+static unsigned entity_hash_func(const void *p) {
+    const struct entity *e = p;
+
+    return (unsigned) e->index * 31U + (unsigned) e->facility;
+}
+
+static int entity_compare_func(const void *a, const void *b) {
+    const struct entity *x = a, *y = b;
+
+    if (x->facility != y->facility)
+        return x->facility < y->facility ? -1 : 1;
+
+    if (x->index != y->index)
+        return x->index < y->index ? -1 : 1;
+
+    return 0;
+}
+
+static unsigned object_generation_hash_func(const void *p) {
+    const pa_object_generation *o = p;
+
+    return (unsigned) o->index * 31U + (unsigned) o->facility;
+}
+
+static int object_generation_compare_func(const void *a, const void *b) {
+    const pa_object_generation *x = a, *y = b;
+
+    if (x->facility != y->facility)
+        return x->facility < y->facility ? -1 : 1;
+
+    if (x->index != y->index)
+        return x->index < y->index ? -1 : 1;
+
+    return 0;
+}
+
+static void free_object_generation(void *p, void *userdata) {
+    pa_xfree(p);
+}
+
+static void free_entity(pa_core *c, struct entity *en) {
+    pa_assert(c);
+    pa_assert(en);
+    pa_assert(!en->event);
+
+    pa_assert_se(pa_hashmap_remove(c->subscription_entities, en) == en);
+    pa_xfree(en);
+}
+
 /* Allocate a new subscription object for the given subscription mask. Use the specified callback function and user data */
 pa_subscription* pa_subscription_new(pa_core *c, pa_subscription_mask_t m, pa_subscription_cb_t callback, void *userdata) {
     pa_subscription *s;
@@ -101,13 +188,86 @@ static void free_event(pa_subscription_event *s) {
     pa_assert(s);
     pa_assert(s->core);
 
-    if (!s->next)
-        s->core->subscription_event_last = s->prev;
+    if (s->entity && s->entity->event == s)
+        s->entity->event = NULL;
+
+    if (!s->held) {
+        if (!s->next)
+            s->core->subscription_event_last = s->prev;
+
+        PA_LLIST_REMOVE(pa_subscription_event, s->core->subscription_event_queue, s);
+    }
 
-    PA_LLIST_REMOVE(pa_subscription_event, s->core->subscription_event_queue, s);
     pa_xfree(s);
 }
 
+static void queue_event(pa_subscription_event *e) {
+    pa_core *c;
+
+    pa_assert(e);
+    pa_assert_se(c = e->core);
+
+    e->held = FALSE;
+
+    PA_LLIST_INSERT_AFTER(pa_subscription_event, c->subscription_event_queue, c->subscription_event_last, e);
+    c->subscription_event_last = e;
+
+    sched_event(c);
+}
+
+/* Walks all entities: queues held back events that are due and forgets
+ * entities that weren't reported for a while. Returns when this needs
+ * to be done next, or 0. */
+static pa_usec_t process_entities(pa_core *c, pa_usec_t now) {
+    struct entity *en;
+    void *state;
+    pa_usec_t next = 0;
+
+    pa_assert(c);
+
+    PA_HASHMAP_FOREACH(en, c->subscription_entities, state) {
+        pa_usec_t due = en->last_dispatch + c->subscription_coalesce_usec;
+
+        if (due <= now) {
+            if (!en->event)
+                free_entity(c, en);
+            else if (en->event->held) {
+                queue_event(en->event);
+                pa_log_debug("Releasing held back subscription event.");
+            }
+
+            continue;
+        }
+
+        if (next == 0 || due < next)
+            next = due;
+    }
+
+    return next;
+}
+
+static void coalesce_cb(pa_mainloop_api *m, pa_time_event *te, const struct timeval *tv, void *userdata) {
+    pa_core *c = userdata;
+    pa_usec_t next;
+
+    pa_assert(c);
+    pa_assert(c->subscription_coalesce_event == te);
+
+    if ((next = process_entities(c, pa_rtclock_now())) > 0)
+        pa_core_rttime_restart(c, te, next);
+    else {
+        c->mainloop->time_free(c->subscription_coalesce_event);
+        c->subscription_coalesce_event = NULL;
+    }
+}
+
+static void sched_coalesce(pa_core *c, pa_usec_t when) {
+    pa_assert(c);
+
+    if (!c->subscription_coalesce_event)
+        c->subscription_coalesce_event = pa_core_rttime_new(c, when, coalesce_cb, c);
+}
+
 /* Free all subscription objects */
 void pa_subscription_free_all(pa_core *c) {
     pa_assert(c);
@@ -118,10 +278,38 @@ void pa_subscription_free_all(pa_core *c) {
     while (c->subscription_event_queue)
         free_event(c->subscription_event_queue);
 
+    if (c->subscription_entities) {
+        struct entity *en;
+
+        while ((en = pa_hashmap_first(c->subscription_entities))) {
+            if (en->event)
+                free_event(en->event);
+
+            free_entity(c, en);
+        }
+
+        pa_hashmap_free(c->subscription_entities, NULL, NULL);
+        c->subscription_entities = NULL;
+    }
+
     if (c->subscription_defer_event) {
         c->mainloop->defer_free(c->subscription_defer_event);
         c->subscription_defer_event = NULL;
     }
+
+    if (c->subscription_coalesce_event) {
+        c->mainloop->time_free(c->subscription_coalesce_event);
+        c->subscription_coalesce_event = NULL;
+    }
+
+    if (c->object_generations) {
+        pa_hashmap_free(c->object_generations, free_object_generation, NULL);
+        c->object_generations = NULL;
+    }
+
+    PA_LLIST_HEAD_INIT(pa_object_generation, c->removed_objects);
+    c->removed_objects_last = NULL;
+    c->n_removed_objects = 0;
 }
 
 #ifdef DEBUG
@@ -156,6 +344,7 @@ static void dump_event(const char * prefix, pa_subscription_event*e) {
 static void defer_cb(pa_mainloop_api *m, pa_defer_event *de, void *userdata) {
     pa_core *c = userdata;
     pa_subscription *s;
+    pa_usec_t now = 0;
 
     pa_assert(c->mainloop == m);
     pa_assert(c);
@@ -167,17 +356,36 @@ static void defer_cb(pa_mainloop_api *m, pa_defer_event *de, void *userdata) {
 
     while (c->subscription_event_queue) {
         pa_subscription_event *e = c->subscription_event_queue;
+        pa_subscription_event_type_t t = e->type;
+        struct entity *en = e->entity;
 
         for (s = c->subscriptions; s; s = s->next) {
 
-            if (!s->dead && pa_subscription_match_flags(s->mask, e->type))
+            if (!s->dead && pa_subscription_match_flags(s->mask, e->type)) {
                 s->callback(c, e->type, e->index, s->userdata);
+                c->n_subscription_events_dispatched++;
+            }
         }
 
 #ifdef DEBUG
         dump_event("Dispatched", e);
 #endif
         free_event(e);
+
+        if (!en || en->event)
+            continue;
+
+        /* Remember when we reported this entity, unless it is gone */
+        if (c->subscription_coalesce_usec > 0 &&
+            (t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) != PA_SUBSCRIPTION_EVENT_REMOVE) {
+
+            if (now == 0)
+                now = pa_rtclock_now();
+
+            en->last_dispatch = now;
+            sched_coalesce(c, now + c->subscription_coalesce_usec);
+        } else
+            free_entity(c, en);
     }
 
     /* Remove dead subscriptions */
@@ -203,61 +411,187 @@ static void sched_event(pa_core *c) {
     c->mainloop->defer_enable(c->subscription_defer_event, 1);
 }
 
+static void update_generation(pa_core *c, pa_subscription_event_type_t t, uint32_t idx) {
+    pa_object_generation *o, key;
+
+    pa_assert(c);
+
+    c->generation++;
+
+    if (!c->object_generations)
+        c->object_generations = pa_hashmap_new(object_generation_hash_func, object_generation_compare_func);
+
+    key.facility = t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+    key.index = idx;
+
+    if (!(o = pa_hashmap_get(c->object_generations, &key))) {
+        o = pa_xnew0(pa_object_generation, 1);
+        o->facility = key.facility;
+        o->index = idx;
+        pa_hashmap_put(c->object_generations, o, o);
+    }
+
+    o->generation = c->generation;
+
+    if (o->removed) {
+        /* The index has been reused, or the object was reported once
+         * more after its removal */
+        if (!o->next)
+            c->removed_objects_last = o->prev;
+
+        PA_LLIST_REMOVE(pa_object_generation, c->removed_objects, o);
+        c->n_removed_objects--;
+        o->removed = FALSE;
+    }
+
+    if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) != PA_SUBSCRIPTION_EVENT_REMOVE)
+        return;
+
+    o->removed = TRUE;
+    PA_LLIST_INSERT_AFTER(pa_object_generation, c->removed_objects, c->removed_objects_last, o);
+    c->removed_objects_last = o;
+
+    if (++c->n_removed_objects <= MAX_REMOVED_OBJECTS)
+        return;
+
+    /* Forget the oldest removal. Clients that last synced before it
+     * happened need to start over. */
+    o = c->removed_objects;
+    c->generation_horizon = o->generation;
+
+    if (!o->next)
+        c->removed_objects_last = o->prev;
+
+    PA_LLIST_REMOVE(pa_object_generation, c->removed_objects, o);
+    c->n_removed_objects--;
+
+    pa_assert_se(pa_hashmap_remove(c->object_generations, o) == o);
+    pa_xfree(o);
+}
+
+uint64_t pa_subscription_get_generation(pa_core *c) {
+    pa_assert(c);
+
+    return c->generation;
+}
+
+uint64_t pa_subscription_get_horizon(pa_core *c) {
+    pa_assert(c);
+
+    return c->generation_horizon;
+}
+
+uint64_t pa_subscription_get_object_generation(pa_core *c, pa_subscription_event_type_t facility, uint32_t idx) {
+    pa_object_generation *o, key;
+
+    pa_assert(c);
+
+    if (!c->object_generations)
+        return 0;
+
+    key.facility = facility & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+    key.index = idx;
+
+    if (!(o = pa_hashmap_get(c->object_generations, &key)))
+        return 0;
+
+    return o->generation;
+}
+
+void pa_subscription_foreach_removed(pa_core *c, uint64_t since, pa_subscription_removed_cb_t cb, void *userdata) {
+    pa_object_generation *o;
+
+    pa_assert(c);
+    pa_assert(cb);
+
+    /* Newest removals are at the end of the list */
+    for (o = c->removed_objects_last; o && o->generation > since; o = o->prev)
+        cb(c, o->facility, o->index, userdata);
+}
+
 /* Append a new subscription event to the subscription event queue and schedule a main loop event */
 void pa_subscription_post(pa_core *c, pa_subscription_event_type_t t, uint32_t idx) {
     pa_subscription_event *e;
+    struct entity *en, key;
     pa_assert(c);
 
+    update_generation(c, t, idx);
+
     /* No need for queuing subscriptions of no one is listening */
     if (!c->subscriptions)
         return;
 
-    if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) != PA_SUBSCRIPTION_EVENT_NEW) {
-        pa_subscription_event *i, *n;
+    c->n_subscription_events_posted++;
 
-        /* Check for duplicates */
-        for (i = c->subscription_event_last; i; i = n) {
-            n = i->prev;
+    /* A new entity is a copy of the key */
+    pa_zero(key);
+    key.facility = t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+    key.index = idx;
 
-            /* not the same object type */
-            if (((t ^ i->type) & PA_SUBSCRIPTION_EVENT_FACILITY_MASK))
-                continue;
+    if (!c->subscription_entities)
+        c->subscription_entities = pa_hashmap_new(entity_hash_func, entity_compare_func);
 
-            /* not the same object */
-            if (i->index != idx)
-                continue;
+    en = pa_hashmap_get(c->subscription_entities, &key);
 
-            if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE) {
-                /* This object is being removed, hence there is no
-                 * point in keeping the old events regarding this
-                 * entry in the queue. */
+    if (en && en->event && (t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) != PA_SUBSCRIPTION_EVENT_NEW) {
 
-                free_event(i);
-                pa_log_debug("Dropped redundant event due to remove event.");
-                continue;
-            }
+        if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE) {
+            /* This object is being removed, hence there is no
+             * point in keeping the old events regarding this
+             * entry in the queue. */
 
-            if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_CHANGE) {
-                /* This object has changed. If a "new" or "change" event for
-                 * this object is still in the queue we can exit. */
+            free_event(en->event);
+            c->n_subscription_events_coalesced++;
+            pa_log_debug("Dropped redundant event due to remove event.");
 
-                pa_log_debug("Dropped redundant event due to change event.");
-                return;
-            }
+        } else {
+            /* This object has changed. If a "new" or "change" event for
+             * this object is still in the queue we can exit. */
+
+            c->n_subscription_events_coalesced++;
+            pa_log_debug("Dropped redundant event due to change event.");
+            return;
         }
     }
 
+    if (!en) {
+        en = pa_xnew0(struct entity, 1);
+        *en = key;
+        pa_hashmap_put(c->subscription_entities, en, en);
+    } else if (en->event && en->event->held) {
+        /* A "new" event replaces the one we track for this entity. A
+         * queued event stays in the queue anyway, but a held back one
+         * would be lost, so let it go out first. */
+        queue_event(en->event);
+        pa_log_debug("Releasing held back subscription event.");
+    }
+
     e = pa_xnew(pa_subscription_event, 1);
     e->core = c;
     e->type = t;
     e->index = idx;
+    e->entity = en;
+    en->event = e;
 
-    PA_LLIST_INSERT_AFTER(pa_subscription_event, c->subscription_event_queue, c->subscription_event_last, e);
-    c->subscription_event_last = e;
+    if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_CHANGE &&
+        en->last_dispatch > 0 &&
+        en->last_dispatch + c->subscription_coalesce_usec > pa_rtclock_now()) {
+
+        /* We reported this entity only a moment ago, so let's wait
+         * a bit and collect further changes before reporting it
+         * again. */
+        e->held = TRUE;
+        sched_coalesce(c, en->last_dispatch + c->subscription_coalesce_usec);
 
 #ifdef DEBUG
-    dump_event("Queued", e);
+        dump_event("Held back", e);
 #endif
+        return;
+    }
 
-    sched_event(c);
+    queue_event(e);
+
+#ifdef DEBUG
+    dump_event("Queued", e);
+#endif
 }
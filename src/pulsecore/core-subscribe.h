@@ -24,6 +24,7 @@
 
 typedef struct pa_subscription pa_subscription;
 typedef struct pa_subscription_event pa_subscription_event;
+typedef struct pa_object_generation pa_object_generation;
 
 #include <pulsecore/core.h>
 #include <pulsecore/native-common.h>
@@ -36,4 +37,16 @@ void pa_subscription_free_all(pa_core *c);
 
 void pa_subscription_post(pa_core *c, pa_subscription_event_type_t t, uint32_t idx);
 
+/* Every posted event bumps the core generation counter. These allow
+ * finding out which objects changed or went away since a given
+ * generation. Removals are only remembered for a limited time: if
+ * 'since' is older than the value returned by
+ * pa_subscription_get_horizon() the caller needs to do a full resync. */
+uint64_t pa_subscription_get_generation(pa_core *c);
+uint64_t pa_subscription_get_horizon(pa_core *c);
+uint64_t pa_subscription_get_object_generation(pa_core *c, pa_subscription_event_type_t facility, uint32_t idx);
+
+typedef void (*pa_subscription_removed_cb_t)(pa_core *c, pa_subscription_event_type_t facility, uint32_t idx, void *userdata);
+void pa_subscription_foreach_removed(pa_core *c, uint64_t since, pa_subscription_removed_cb_t cb, void *userdata);
+
 #endif
@@ -123,6 +123,15 @@ pa_core* pa_core_new(pa_mainloop_api *m, pa_bool_t shared, size_t shm_size) {
     PA_LLIST_HEAD_INIT(pa_subscription, c->subscriptions);
     PA_LLIST_HEAD_INIT(pa_subscription_event, c->subscription_event_queue);
     c->subscription_event_last = NULL;
+    c->subscription_entities = NULL;
+    c->subscription_coalesce_event = NULL;
+    c->subscription_coalesce_usec = 0;
+    c->n_subscription_events_posted = c->n_subscription_events_coalesced = c->n_subscription_events_dispatched = 0;
+    c->generation = c->generation_horizon = 0;
+    c->object_generations = NULL;
+    PA_LLIST_HEAD_INIT(pa_object_generation, c->removed_objects);
+    c->removed_objects_last = NULL;
+    c->n_removed_objects = 0;
 
     c->mempool = pool;
     pa_silence_cache_init(&c->silence_cache);
@@ -131,6 +140,9 @@ pa_core* pa_core_new(pa_mainloop_api *m, pa_bool_t shared, size_t shm_size) {
 
     c->exit_idle_time = -1;
     c->scache_idle_time = 20;
+    c->scache_converted_size = 0;
+    c->scache_converted_size_max = 4*1024*1024;
+    c->n_scache_converted = 0;
 
     c->flat_volumes = TRUE;
     c->disallow_module_loading = FALSE;
@@ -142,6 +154,8 @@ pa_core* pa_core_new(pa_mainloop_api *m, pa_bool_t shared, size_t shm_size) {
     c->disable_lfe_remixing = FALSE;
     c->deferred_volume = TRUE;
     c->resample_method = PA_RESAMPLER_SPEEX_FLOAT_BASE + 3;
+    c->volume_ramp_usec = 0;
+    c->volume_ramp_type = PA_VOLUME_RAMP_CUBIC;
 
     for (j = 0; j < PA_CORE_HOOK_MAX; j++)
         pa_hook_init(&c->hooks[j], c);
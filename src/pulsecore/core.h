@@ -155,6 +155,17 @@ struct pa_core {
     PA_LLIST_HEAD(pa_subscription, subscriptions);
     PA_LLIST_HEAD(pa_subscription_event, subscription_event_queue);
     pa_subscription_event *subscription_event_last;
+    pa_hashmap *subscription_entities;
+    pa_time_event *subscription_coalesce_event;
+    pa_usec_t subscription_coalesce_usec;
+    uint64_t n_subscription_events_posted, n_subscription_events_coalesced, n_subscription_events_dispatched;
+
+    /* Change tracking for snapshots */
+    uint64_t generation, generation_horizon;
+    pa_hashmap *object_generations;
+    PA_LLIST_HEAD(pa_object_generation, removed_objects);
+    pa_object_generation *removed_objects_last;
+    unsigned n_removed_objects;
 
     pa_mempool *mempool;
     pa_silence_cache silence_cache;
@@ -164,6 +175,10 @@ struct pa_core {
 
     int exit_idle_time, scache_idle_time;
 
+    /* Sample cache entries converted to the sample spec of a sink */
+    size_t scache_converted_size, scache_converted_size_max;
+    unsigned n_scache_converted;
+
     pa_bool_t flat_volumes:1;
     pa_bool_t disallow_module_loading:1;
     pa_bool_t disallow_exit:1;
@@ -176,6 +191,11 @@ struct pa_core {
     pa_resample_method_t resample_method;
     int realtime_priority;
 
+    /* Sink input volume changes are ramped over this instead of
+     * rewinding, 0 disables that */
+    pa_usec_t volume_ramp_usec;
+    pa_volume_ramp_type_t volume_ramp_type;
+
     pa_server_type_t server_type;
     pa_cpu_info cpu_info;
 
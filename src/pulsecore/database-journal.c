@@ -0,0 +1,865 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#include <pulse/xmalloc.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/core-error.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/mutex.h>
+#include <pulsecore/thread.h>
+
+#include "database.h"
+
+/* A database that keeps everything in memory and makes changes
+ * persistent by appending them to a journal file. The journal is
+ * written by a background thread, so pa_database_sync() only hands the
+ * changes since the last call over to that thread and never blocks on
+ * the disk. Once the journal has grown larger than the data it
+ * describes, the thread also loads snapshot and journal on its own,
+ * writes out a fresh snapshot and truncates the journal, so compaction
+ * costs the main loop nothing either.
+ *
+ * On open the snapshot is mapped into memory and the entries point
+ * straight into the mapping; the journal is replayed on top. A torn
+ * record at the end of the journal (because we crashed while writing
+ * it) is detected by its checksum and dropped.
+ *
+ * Both files use the same record format and are not arch independent,
+ * hence the host name in the file name. */
+
+#define SNAPSHOT_MAGIC "PAJ1"
+#define SNAPSHOT_MAGIC_SIZE 4
+
+/* Don't bother compacting journals smaller than this */
+#define COMPACT_MIN_SIZE (256*1024)
+
+enum {
+    RECORD_SET = 'S',
+    RECORD_UNSET = 'U',
+    RECORD_CLEAR = 'C'
+};
+
+/* A record is the op, the key and data sizes, key, data and a checksum
+ * over all that */
+#define RECORD_HEADER_SIZE (1 + 2*sizeof(uint32_t))
+#define RECORD_SIZE(k, d) (RECORD_HEADER_SIZE + (k) + (d) + sizeof(uint32_t))
+
+typedef struct entry {
+    pa_datum key;
+    pa_datum data;
+    PA_LLIST_FIELDS(struct entry);
+} entry;
+
+typedef enum job_type {
+    JOB_APPEND,
+    JOB_COMPACT
+} job_type;
+
+typedef struct job {
+    job_type type;
+    uint8_t *buffer;
+    size_t length;
+    PA_LLIST_FIELDS(struct job);
+} job;
+
+typedef struct journal_data {
+    char *filename;
+    char *journal_filename;
+    char *tmp_filename;
+    pa_bool_t read_only;
+
+    pa_hashmap *map;
+    PA_LLIST_HEAD(entry, entries);
+
+    /* The snapshot we loaded on open, entries may point into it */
+    void *snapshot;
+    size_t snapshot_size;
+    pa_bool_t snapshot_mapped;
+
+    /* Size of a snapshot of the current contents and of the journal
+     * including what has not been handed to the thread yet */
+    size_t data_size;
+    size_t journal_size;
+
+    /* Records not yet handed to the writer thread */
+    uint8_t *pending;
+    size_t pending_length, pending_allocated;
+
+    /* Shared with the writer thread, protected by the mutex */
+    pa_thread *thread;
+    pa_mutex *mutex;
+    pa_cond *cond;
+    PA_LLIST_HEAD(job, jobs);
+    job *jobs_tail;
+    pa_bool_t quit;
+    pa_bool_t failed;
+
+    /* Only touched by the writer thread */
+    int journal_fd;
+} journal_data;
+
+void pa_datum_free(pa_datum *d) {
+    pa_assert(d);
+
+    pa_xfree(d->data);
+    d->data = NULL;
+    d->size = 0;
+}
+
+static int compare_func(const void *a, const void *b) {
+    const pa_datum *aa, *bb;
+
+    aa = (const pa_datum*)a;
+    bb = (const pa_datum*)b;
+
+    if (aa->size != bb->size)
+        return aa->size > bb->size ? 1 : -1;
+
+    return memcmp(aa->data, bb->data, aa->size);
+}
+
+static unsigned hash_func(const void *p) {
+    const pa_datum *d;
+    unsigned hash = 0;
+    const uint8_t *c;
+    size_t i;
+
+    d = (const pa_datum*)p;
+    c = d->data;
+
+    for (i = 0; i < d->size; i++)
+        hash = 31 * hash + c[i];
+
+    return hash;
+}
+
+/* FNV-1a, only used to detect torn or garbled records */
+static uint32_t checksum(const uint8_t *p, size_t l) {
+    uint32_t h = 2166136261U;
+
+    for (; l > 0; l--, p++)
+        h = (h ^ *p) * 16777619U;
+
+    return h;
+}
+
+/* Either copies key and data into the entry's own block or makes the
+ * entry point to them, which is what we do for the snapshot mapping */
+static entry* new_entry(const pa_datum *key, const pa_datum *data, pa_bool_t copy) {
+    entry *e;
+
+    if (copy) {
+        uint8_t *p;
+
+        e = pa_xmalloc(PA_ALIGN(sizeof(entry)) + key->size + data->size);
+        p = (uint8_t*) e + PA_ALIGN(sizeof(entry));
+
+        memcpy(p, key->data, key->size);
+        e->key.data = p;
+        memcpy(p + key->size, data->data, data->size);
+        e->data.data = p + key->size;
+    } else {
+        e = pa_xnew(entry, 1);
+        e->key.data = key->data;
+        e->data.data = data->data;
+    }
+
+    e->key.size = key->size;
+    e->data.size = data->size;
+    PA_LLIST_INIT(entry, e);
+
+    return e;
+}
+
+static void remove_entry(journal_data *db, entry *e) {
+    PA_LLIST_REMOVE(entry, db->entries, e);
+    db->data_size -= RECORD_SIZE(e->key.size, e->data.size);
+    pa_xfree(e);
+}
+
+static void put_entry(journal_data *db, entry *e) {
+    entry *old;
+
+    if ((old = pa_hashmap_remove(db->map, &e->key)))
+        remove_entry(db, old);
+
+    pa_assert_se(pa_hashmap_put(db->map, &e->key, e) >= 0);
+    PA_LLIST_PREPEND(entry, db->entries, e);
+    db->data_size += RECORD_SIZE(e->key.size, e->data.size);
+}
+
+static void clear_entries(journal_data *db) {
+    entry *e;
+
+    while ((e = pa_hashmap_steal_first(db->map)))
+        remove_entry(db, e);
+}
+
+static uint8_t* write_record(uint8_t *p, uint8_t op, const pa_datum *key, const pa_datum *data) {
+    uint8_t *start = p;
+    uint32_t u, sum;
+
+    *(p++) = op;
+    u = (uint32_t) (key ? key->size : 0);
+    memcpy(p, &u, sizeof(u));
+    p += sizeof(u);
+    u = (uint32_t) (data ? data->size : 0);
+    memcpy(p, &u, sizeof(u));
+    p += sizeof(u);
+
+    if (key && key->size > 0) {
+        memcpy(p, key->data, key->size);
+        p += key->size;
+    }
+
+    if (data && data->size > 0) {
+        memcpy(p, data->data, data->size);
+        p += data->size;
+    }
+
+    sum = checksum(start, (size_t) (p - start));
+    memcpy(p, &sum, sizeof(sum));
+
+    return p + sizeof(sum);
+}
+
+/* Returns the size of the record at p, 0 if there is no complete and
+ * valid record. The snapshot is written to a temporary file and renamed
+ * into place, it can't be torn and we skip the checksums there. */
+static size_t read_record(const uint8_t *p, size_t l, pa_bool_t verify, uint8_t *op, pa_datum *key, pa_datum *data) {
+    uint32_t k, d, sum;
+    size_t n;
+
+    if (l < RECORD_HEADER_SIZE)
+        return 0;
+
+    *op = p[0];
+    memcpy(&k, p + 1, sizeof(k));
+    memcpy(&d, p + 1 + sizeof(k), sizeof(d));
+
+    if (k > l || d > l || RECORD_SIZE(k, d) > l)
+        return 0;
+
+    n = RECORD_SIZE(k, d);
+
+    if (verify) {
+        memcpy(&sum, p + n - sizeof(sum), sizeof(sum));
+
+        if (sum != checksum(p, n - sizeof(sum)))
+            return 0;
+    }
+
+    key->data = (void*) (p + RECORD_HEADER_SIZE);
+    key->size = k;
+    data->data = (void*) (p + RECORD_HEADER_SIZE + k);
+    data->size = d;
+
+    return n;
+}
+
+static void append_pending(journal_data *db, uint8_t op, const pa_datum *key, const pa_datum *data) {
+    size_t l;
+
+    l = RECORD_SIZE(key ? key->size : 0, data ? data->size : 0);
+
+    if (db->pending_length + l > db->pending_allocated) {
+        db->pending_allocated = PA_MAX(db->pending_length + l, db->pending_allocated * 2);
+        db->pending = pa_xrealloc(db->pending, db->pending_allocated);
+    }
+
+    write_record(db->pending + db->pending_length, op, key, data);
+    db->pending_length += l;
+    db->journal_size += l;
+}
+
+static int load_file(const char *fn, void **data, size_t *size, pa_bool_t *mapped) {
+    int fd;
+    struct stat st;
+    int ret = -1;
+
+    *data = NULL;
+    *size = 0;
+    *mapped = FALSE;
+
+    if ((fd = pa_open_cloexec(fn, O_RDONLY, 0)) < 0)
+        return errno == ENOENT ? 0 : -1;
+
+    if (fstat(fd, &st) < 0)
+        goto finish;
+
+    if (st.st_size <= 0) {
+        ret = 0;
+        goto finish;
+    }
+
+#ifdef HAVE_SYS_MMAN_H
+    if ((*data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) != MAP_FAILED) {
+        *size = (size_t) st.st_size;
+        *mapped = TRUE;
+        ret = 0;
+        goto finish;
+    }
+#endif
+
+    *data = pa_xmalloc((size_t) st.st_size);
+
+    if (pa_loop_read(fd, *data, (size_t) st.st_size, NULL) != (ssize_t) st.st_size) {
+        pa_xfree(*data);
+        *data = NULL;
+        goto finish;
+    }
+
+    *size = (size_t) st.st_size;
+    ret = 0;
+
+finish:
+    pa_close(fd);
+    return ret;
+}
+
+static void unload_file(void *data, size_t size, pa_bool_t mapped) {
+    if (!data)
+        return;
+
+#ifdef HAVE_SYS_MMAN_H
+    if (mapped) {
+        munmap(data, size);
+        return;
+    }
+#endif
+
+    pa_xfree(data);
+}
+
+/* Returns -1 if the snapshot couldn't be read completely. Whatever
+ * could be read is loaded anyway. */
+static int load_snapshot(journal_data *db) {
+    const uint8_t *p;
+    size_t l, n;
+    uint8_t op;
+    pa_datum key, data;
+
+    if (load_file(db->filename, &db->snapshot, &db->snapshot_size, &db->snapshot_mapped) < 0) {
+        pa_log_warn("Failed to read %s: %s", db->filename, pa_cstrerror(errno));
+        return -1;
+    }
+
+    if (!db->snapshot)
+        return 0;
+
+    if (db->snapshot_size < SNAPSHOT_MAGIC_SIZE || memcmp(db->snapshot, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE)) {
+        pa_log_warn("%s is not a database snapshot, ignoring.", db->filename);
+        return -1;
+    }
+
+    p = (const uint8_t*) db->snapshot + SNAPSHOT_MAGIC_SIZE;
+    l = db->snapshot_size - SNAPSHOT_MAGIC_SIZE;
+
+    /* The entries point into the snapshot, no copying */
+    while ((n = read_record(p, l, FALSE, &op, &key, &data)) > 0 && op == RECORD_SET) {
+        put_entry(db, new_entry(&key, &data, FALSE));
+        p += n;
+        l -= n;
+    }
+
+    if (l > 0) {
+        pa_log_warn("%s is corrupt, ignoring the last %lu bytes.", db->filename, (unsigned long) l);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int replay_journal(journal_data *db) {
+    void *journal;
+    size_t size, l, n;
+    pa_bool_t mapped;
+    const uint8_t *p;
+    uint8_t op;
+    pa_datum key, data;
+    entry *e;
+
+    if (load_file(db->journal_filename, &journal, &size, &mapped) < 0) {
+        pa_log_warn("Failed to read %s: %s", db->journal_filename, pa_cstrerror(errno));
+        return -1;
+    }
+
+    p = journal;
+    l = size;
+
+    while ((n = read_record(p, l, TRUE, &op, &key, &data)) > 0) {
+        switch (op) {
+            case RECORD_SET:
+                put_entry(db, new_entry(&key, &data, TRUE));
+                break;
+
+            case RECORD_UNSET:
+                if ((e = pa_hashmap_remove(db->map, &key)))
+                    remove_entry(db, e);
+                break;
+
+            case RECORD_CLEAR:
+                clear_entries(db);
+                break;
+
+            default:
+                n = 0;
+                break;
+        }
+
+        if (n == 0)
+            break;
+
+        p += n;
+        l -= n;
+    }
+
+    db->journal_size = size - l;
+
+    /* Cut off whatever we couldn't read, so that new records are
+     * appended right behind the last good one */
+    if (l > 0) {
+        pa_log_warn("%s has a torn record at the end, dropping %lu bytes.", db->journal_filename, (unsigned long) l);
+
+        if (!db->read_only && truncate(db->journal_filename, (off_t) db->journal_size) < 0)
+            pa_log_warn("Failed to truncate %s: %s", db->journal_filename, pa_cstrerror(errno));
+    }
+
+    unload_file(journal, size, mapped);
+    return 0;
+}
+
+static uint8_t* make_snapshot(journal_data *db, size_t *length) {
+    uint8_t *buffer, *p;
+    entry *e;
+
+    *length = SNAPSHOT_MAGIC_SIZE + db->data_size;
+    p = buffer = pa_xmalloc(*length);
+
+    memcpy(p, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE);
+    p += SNAPSHOT_MAGIC_SIZE;
+
+    PA_LLIST_FOREACH(e, db->entries)
+        p = write_record(p, RECORD_SET, &e->key, &e->data);
+
+    pa_assert(p == buffer + *length);
+
+    return buffer;
+}
+
+static int write_all(int fd, const uint8_t *p, size_t l) {
+    ssize_t r;
+
+    if ((r = pa_loop_write(fd, p, l, NULL)) < 0 || (size_t) r != l) {
+        if (r >= 0)
+            errno = EIO;
+        return -1;
+    }
+
+    return 0;
+}
+
+static int thread_append(journal_data *db, const job *j) {
+
+    if (db->journal_fd < 0 &&
+        (db->journal_fd = pa_open_cloexec(db->journal_filename, O_WRONLY|O_CREAT|O_APPEND, 0600)) < 0) {
+        pa_log_warn("Failed to open %s: %s", db->journal_filename, pa_cstrerror(errno));
+        return -1;
+    }
+
+    if (write_all(db->journal_fd, j->buffer, j->length) < 0 || fsync(db->journal_fd) < 0) {
+        pa_log_warn("Failed to write to %s: %s", db->journal_filename, pa_cstrerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+/* The new snapshot contains everything that was appended to the
+ * journal before it, so once it is in place the journal can start over.
+ * If we crash in between, replaying the old journal on top of the new
+ * snapshot does no harm. */
+static int thread_compact(journal_data *db) {
+    journal_data c;
+    uint8_t *buffer = NULL;
+    size_t length;
+    int fd, r = -1;
+
+    /* Load the files into a private copy, the thread must not touch
+     * the entries of the main thread */
+    memset(&c, 0, sizeof(c));
+    c.filename = db->filename;
+    c.journal_filename = db->journal_filename;
+    c.read_only = TRUE;
+    c.map = pa_hashmap_new(hash_func, compare_func);
+
+    /* If we couldn't read everything, writing out what we have and
+     * truncating the journal would lose the rest for good */
+    if (load_snapshot(&c) >= 0 && replay_journal(&c) >= 0)
+        buffer = make_snapshot(&c, &length);
+
+    clear_entries(&c);
+    pa_hashmap_free(c.map, NULL, NULL);
+    unload_file(c.snapshot, c.snapshot_size, c.snapshot_mapped);
+
+    if (!buffer) {
+        pa_log_warn("Not compacting %s, it could not be read completely.", db->filename);
+        return -1;
+    }
+
+    if ((fd = pa_open_cloexec(db->tmp_filename, O_WRONLY|O_CREAT|O_TRUNC, 0600)) < 0) {
+        pa_log_warn("Failed to open %s: %s", db->tmp_filename, pa_cstrerror(errno));
+        goto finish;
+    }
+
+    if (write_all(fd, buffer, length) < 0 || fsync(fd) < 0) {
+        pa_log_warn("Failed to write to %s: %s", db->tmp_filename, pa_cstrerror(errno));
+        pa_close(fd);
+        unlink(db->tmp_filename);
+        goto finish;
+    }
+
+    pa_close(fd);
+
+    if (rename(db->tmp_filename, db->filename) < 0) {
+        pa_log_warn("Failed to rename %s: %s", db->tmp_filename, pa_cstrerror(errno));
+        unlink(db->tmp_filename);
+        goto finish;
+    }
+
+    if (db->journal_fd >= 0) {
+        if (ftruncate(db->journal_fd, 0) < 0) {
+            pa_log_warn("Failed to truncate %s: %s", db->journal_filename, pa_cstrerror(errno));
+            goto finish;
+        }
+    } else if (truncate(db->journal_filename, 0) < 0 && errno != ENOENT) {
+        pa_log_warn("Failed to truncate %s: %s", db->journal_filename, pa_cstrerror(errno));
+        goto finish;
+    }
+
+    r = 0;
+
+finish:
+    pa_xfree(buffer);
+    return r;
+}
+
+static void thread_func(void *userdata) {
+    journal_data *db = userdata;
+
+    pa_mutex_lock(db->mutex);
+
+    for (;;) {
+        job *j;
+        int r;
+
+        if (!(j = db->jobs)) {
+            if (db->quit)
+                break;
+
+            pa_cond_wait(db->cond, db->mutex);
+            continue;
+        }
+
+        PA_LLIST_REMOVE(job, db->jobs, j);
+        if (db->jobs_tail == j)
+            db->jobs_tail = NULL;
+
+        pa_mutex_unlock(db->mutex);
+
+        if (j->type == JOB_APPEND)
+            r = thread_append(db, j);
+        else
+            r = thread_compact(db);
+
+        pa_xfree(j->buffer);
+        pa_xfree(j);
+
+        pa_mutex_lock(db->mutex);
+
+        if (r < 0)
+            db->failed = TRUE;
+    }
+
+    pa_mutex_unlock(db->mutex);
+
+    if (db->journal_fd >= 0) {
+        pa_close(db->journal_fd);
+        db->journal_fd = -1;
+    }
+}
+
+static void queue_job(journal_data *db, job_type type, uint8_t *buffer, size_t length) {
+    job *j;
+
+    j = pa_xnew(job, 1);
+    j->type = type;
+    j->buffer = buffer;
+    j->length = length;
+    PA_LLIST_INIT(job, j);
+
+    if (!db->mutex) {
+        db->mutex = pa_mutex_new(FALSE, FALSE);
+        db->cond = pa_cond_new();
+
+        if (!(db->thread = pa_thread_new("database-journal", thread_func, db)))
+            pa_log_warn("Failed to create the database writer thread, writing synchronously.");
+    }
+
+    pa_mutex_lock(db->mutex);
+
+    PA_LLIST_INSERT_AFTER(job, db->jobs, db->jobs_tail, j);
+    db->jobs_tail = j;
+
+    /* Without a thread we do the work ourselves */
+    if (!db->thread) {
+        db->quit = TRUE;
+        pa_mutex_unlock(db->mutex);
+        thread_func(db);
+        return;
+    }
+
+    pa_cond_signal(db->cond, 0);
+    pa_mutex_unlock(db->mutex);
+}
+
+pa_database* pa_database_open(const char *fn, pa_bool_t for_write) {
+    journal_data *db;
+
+    pa_assert(fn);
+
+    db = pa_xnew0(journal_data, 1);
+    db->filename = pa_sprintf_malloc("%s."CANONICAL_HOST".journal", fn);
+    db->journal_filename = pa_sprintf_malloc("%s.log", db->filename);
+    db->tmp_filename = pa_sprintf_malloc("%s.tmp", db->filename);
+    db->read_only = !for_write;
+    db->map = pa_hashmap_new(hash_func, compare_func);
+    db->journal_fd = -1;
+
+    /* Use whatever we could read, compaction will leave the files
+     * alone until they are readable again */
+    load_snapshot(db);
+    replay_journal(db);
+
+    return (pa_database*) db;
+}
+
+void pa_database_close(pa_database *database) {
+    journal_data *db = (journal_data*)database;
+
+    pa_assert(db);
+
+    pa_database_sync(database);
+
+    /* We wait for the thread anyway, so leave a compact database
+     * behind that is quick to open next time */
+    if (!db->read_only && db->journal_size > db->data_size / 4)
+        queue_job(db, JOB_COMPACT, NULL, 0);
+
+    /* Let the thread write out everything that is still queued */
+    if (db->thread) {
+        pa_mutex_lock(db->mutex);
+        db->quit = TRUE;
+        pa_cond_signal(db->cond, 0);
+        pa_mutex_unlock(db->mutex);
+
+        pa_thread_free(db->thread);
+    }
+
+    if (db->mutex) {
+        pa_cond_free(db->cond);
+        pa_mutex_free(db->mutex);
+    }
+
+    clear_entries(db);
+    pa_hashmap_free(db->map, NULL, NULL);
+    unload_file(db->snapshot, db->snapshot_size, db->snapshot_mapped);
+
+    pa_xfree(db->pending);
+    pa_xfree(db->filename);
+    pa_xfree(db->journal_filename);
+    pa_xfree(db->tmp_filename);
+    pa_xfree(db);
+}
+
+pa_datum* pa_database_get(pa_database *database, const pa_datum *key, pa_datum* data) {
+    journal_data *db = (journal_data*)database;
+    entry *e;
+
+    pa_assert(db);
+    pa_assert(key);
+    pa_assert(data);
+
+    if (!(e = pa_hashmap_get(db->map, key)))
+        return NULL;
+
+    data->data = e->data.size > 0 ? pa_xmemdup(e->data.data, e->data.size) : NULL;
+    data->size = e->data.size;
+
+    return data;
+}
+
+int pa_database_set(pa_database *database, const pa_datum *key, const pa_datum* data, pa_bool_t overwrite) {
+    journal_data *db = (journal_data*)database;
+
+    pa_assert(db);
+    pa_assert(key);
+    pa_assert(data);
+
+    if (db->read_only)
+        return -1;
+
+    if (!overwrite && pa_hashmap_get(db->map, key))
+        return -1;
+
+    put_entry(db, new_entry(key, data, TRUE));
+    append_pending(db, RECORD_SET, key, data);
+
+    return 0;
+}
+
+int pa_database_unset(pa_database *database, const pa_datum *key) {
+    journal_data *db = (journal_data*)database;
+    entry *e;
+
+    pa_assert(db);
+    pa_assert(key);
+
+    if (db->read_only)
+        return -1;
+
+    if (!(e = pa_hashmap_remove(db->map, key)))
+        return -1;
+
+    remove_entry(db, e);
+    append_pending(db, RECORD_UNSET, key, NULL);
+
+    return 0;
+}
+
+int pa_database_clear(pa_database *database) {
+    journal_data *db = (journal_data*)database;
+
+    pa_assert(db);
+
+    if (db->read_only)
+        return -1;
+
+    clear_entries(db);
+    append_pending(db, RECORD_CLEAR, NULL, NULL);
+
+    return 0;
+}
+
+signed pa_database_size(pa_database *database) {
+    journal_data *db = (journal_data*)database;
+    pa_assert(db);
+
+    return (signed) pa_hashmap_size(db->map);
+}
+
+static pa_datum* copy_entry(entry *e, pa_datum *key, pa_datum *data) {
+    key->data = e->key.size > 0 ? pa_xmemdup(e->key.data, e->key.size) : NULL;
+    key->size = e->key.size;
+
+    if (data) {
+        data->data = e->data.size > 0 ? pa_xmemdup(e->data.data, e->data.size) : NULL;
+        data->size = e->data.size;
+    }
+
+    return key;
+}
+
+pa_datum* pa_database_first(pa_database *database, pa_datum *key, pa_datum *data) {
+    journal_data *db = (journal_data*)database;
+
+    pa_assert(db);
+    pa_assert(key);
+
+    if (!db->entries)
+        return NULL;
+
+    return copy_entry(db->entries, key, data);
+}
+
+pa_datum* pa_database_next(pa_database *database, const pa_datum *key, pa_datum *next, pa_datum *data) {
+    journal_data *db = (journal_data*)database;
+    entry *e;
+
+    pa_assert(db);
+    pa_assert(next);
+
+    if (!key)
+        return pa_database_first(database, next, data);
+
+    if (!(e = pa_hashmap_get(db->map, key)) || !e->next)
+        return NULL;
+
+    return copy_entry(e->next, next, data);
+}
+
+int pa_database_sync(pa_database *database) {
+    journal_data *db = (journal_data*)database;
+    pa_bool_t failed = FALSE;
+
+    pa_assert(db);
+
+    if (db->read_only)
+        return 0;
+
+    if (db->pending_length > 0) {
+        queue_job(db, JOB_APPEND, db->pending, db->pending_length);
+        db->pending = NULL;
+        db->pending_length = db->pending_allocated = 0;
+    }
+
+    if (db->journal_size > COMPACT_MIN_SIZE && db->journal_size > db->data_size) {
+        queue_job(db, JOB_COMPACT, NULL, 0);
+        db->journal_size = 0;
+    }
+
+    /* Errors of the writer thread show up on the next sync */
+    if (db->mutex) {
+        pa_mutex_lock(db->mutex);
+        failed = db->failed;
+        db->failed = FALSE;
+        pa_mutex_unlock(db->mutex);
+    }
+
+    return failed ? -1 : 0;
+}
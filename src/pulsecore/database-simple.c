@@ -241,7 +241,7 @@ pa_database* pa_database_open(const char *fn, pa_bool_t for_write) {
         db = pa_xnew0(simple_data, 1);
         db->map = pa_hashmap_new(hash_func, compare_func);
         db->filename = pa_xstrdup(path);
-        db->tmp_filename = pa_sprintf_malloc(".%s.tmp", db->filename);
+        db->tmp_filename = pa_sprintf_malloc("%s.tmp", db->filename);
         db->read_only = !for_write;
 
         if (f) {
@@ -32,12 +32,18 @@
 
 #include "hashmap.h"
 
+/* The initial number of buckets. The table is grown whenever there are
+ * more entries than buckets. */
 #define NBUCKETS 127
 
 struct hashmap_entry {
     const void *key;
     void *value;
 
+    /* The full hash value, so that we don't need to call hash_func
+     * when removing the entry or resizing the table */
+    unsigned hash;
+
     struct hashmap_entry *bucket_next, *bucket_previous;
     struct hashmap_entry *iterate_next, *iterate_previous;
 };
@@ -48,9 +54,15 @@ struct pa_hashmap {
 
     struct hashmap_entry *iterate_list_head, *iterate_list_tail;
     unsigned n_entries;
+
+    /* Points to the initial buckets allocated together with the
+     * hashmap, or to a separately allocated, larger array */
+    struct hashmap_entry **buckets;
+    unsigned n_buckets;
 };
 
-#define BY_HASH(h) ((struct hashmap_entry**) ((uint8_t*) (h) + PA_ALIGN(sizeof(pa_hashmap))))
+#define INITIAL_BUCKETS(h) ((struct hashmap_entry**) ((uint8_t*) (h) + PA_ALIGN(sizeof(pa_hashmap))))
+#define BY_HASH(h) ((h)->buckets)
 
 PA_STATIC_FLIST_DECLARE(entries, 0, pa_xfree);
 
@@ -65,9 +77,41 @@ pa_hashmap *pa_hashmap_new(pa_hash_func_t hash_func, pa_compare_func_t compare_f
     h->n_entries = 0;
     h->iterate_list_head = h->iterate_list_tail = NULL;
 
+    h->buckets = INITIAL_BUCKETS(h);
+    h->n_buckets = NBUCKETS;
+
     return h;
 }
 
+static void bucket_insert(pa_hashmap *h, struct hashmap_entry *e) {
+    unsigned hash = e->hash % h->n_buckets;
+
+    e->bucket_next = BY_HASH(h)[hash];
+    e->bucket_previous = NULL;
+    if (BY_HASH(h)[hash])
+        BY_HASH(h)[hash]->bucket_previous = e;
+    BY_HASH(h)[hash] = e;
+}
+
+/* Grows the bucket array and redistributes all entries. This only
+ * touches the bucket lists, the iteration list and hence the iteration
+ * order as well as any iteration state held by the caller stay
+ * valid. */
+static void grow(pa_hashmap *h) {
+    struct hashmap_entry *e;
+
+    pa_assert(h);
+
+    if (h->buckets != INITIAL_BUCKETS(h))
+        pa_xfree(h->buckets);
+
+    h->n_buckets = h->n_buckets * 2 + 1;
+    h->buckets = pa_xnew0(struct hashmap_entry*, h->n_buckets);
+
+    for (e = h->iterate_list_head; e; e = e->iterate_next)
+        bucket_insert(h, e);
+}
+
 static void remove_entry(pa_hashmap *h, struct hashmap_entry *e) {
     pa_assert(h);
     pa_assert(e);
@@ -89,10 +133,8 @@ static void remove_entry(pa_hashmap *h, struct hashmap_entry *e) {
 
     if (e->bucket_previous)
         e->bucket_previous->bucket_next = e->bucket_next;
-    else {
-        unsigned hash = h->hash_func(e->key) % NBUCKETS;
-        BY_HASH(h)[hash] = e->bucket_next;
-    }
+    else
+        BY_HASH(h)[e->hash % h->n_buckets] = e->bucket_next;
 
     if (pa_flist_push(PA_STATIC_FLIST_GET(entries), e) < 0)
         pa_xfree(e);
@@ -113,16 +155,18 @@ void pa_hashmap_free(pa_hashmap*h, pa_free2_cb_t free_cb, void *userdata) {
             free_cb(data, userdata);
     }
 
+    if (h->buckets != INITIAL_BUCKETS(h))
+        pa_xfree(h->buckets);
+
     pa_xfree(h);
 }
 
 static struct hashmap_entry *hash_scan(pa_hashmap *h, unsigned hash, const void *key) {
     struct hashmap_entry *e;
     pa_assert(h);
-    pa_assert(hash < NBUCKETS);
 
-    for (e = BY_HASH(h)[hash]; e; e = e->bucket_next)
-        if (h->compare_func(e->key, key) == 0)
+    for (e = BY_HASH(h)[hash % h->n_buckets]; e; e = e->bucket_next)
+        if (e->hash == hash && h->compare_func(e->key, key) == 0)
             return e;
 
     return NULL;
@@ -134,7 +178,7 @@ int pa_hashmap_put(pa_hashmap *h, const void *key, void *value) {
 
     pa_assert(h);
 
-    hash = h->hash_func(key) % NBUCKETS;
+    hash = h->hash_func(key);
 
     if (hash_scan(h, hash, key))
         return -1;
@@ -144,13 +188,10 @@ int pa_hashmap_put(pa_hashmap *h, const void *key, void *value) {
 
     e->key = key;
     e->value = value;
+    e->hash = hash;
 
     /* Insert into hash table */
-    e->bucket_next = BY_HASH(h)[hash];
-    e->bucket_previous = NULL;
-    if (BY_HASH(h)[hash])
-        BY_HASH(h)[hash]->bucket_previous = e;
-    BY_HASH(h)[hash] = e;
+    bucket_insert(h, e);
 
     /* Insert into iteration list */
     e->iterate_previous = h->iterate_list_tail;
@@ -167,6 +208,9 @@ int pa_hashmap_put(pa_hashmap *h, const void *key, void *value) {
     h->n_entries++;
     pa_assert(h->n_entries >= 1);
 
+    if (h->n_entries > h->n_buckets)
+        grow(h);
+
     return 0;
 }
 
@@ -176,7 +220,7 @@ void* pa_hashmap_get(pa_hashmap *h, const void *key) {
 
     pa_assert(h);
 
-    hash = h->hash_func(key) % NBUCKETS;
+    hash = h->hash_func(key);
 
     if (!(e = hash_scan(h, hash, key)))
         return NULL;
@@ -191,7 +235,7 @@ void* pa_hashmap_remove(pa_hashmap *h, const void *key) {
 
     pa_assert(h);
 
-    hash = h->hash_func(key) % NBUCKETS;
+    hash = h->hash_func(key);
 
     if (!(e = hash_scan(h, hash, key)))
         return NULL;
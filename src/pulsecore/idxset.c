@@ -34,12 +34,18 @@
 
 #include "idxset.h"
 
+/* The initial number of buckets. The tables are grown whenever there
+ * are more entries than buckets. */
 #define NBUCKETS 127
 
 struct idxset_entry {
     uint32_t idx;
     void *data;
 
+    /* The full hash value of data, so that we don't need to call
+     * hash_func when removing the entry or resizing the tables */
+    unsigned hash;
+
     struct idxset_entry *data_next, *data_previous;
     struct idxset_entry *index_next, *index_previous;
     struct idxset_entry *iterate_next, *iterate_previous;
@@ -53,10 +59,17 @@ struct pa_idxset {
 
     struct idxset_entry *iterate_list_head, *iterate_list_tail;
     unsigned n_entries;
+
+    /* Points to the initial buckets allocated together with the idxset,
+     * or to a separately allocated, larger array. The first half is
+     * indexed by data hash, the second half by index. */
+    struct idxset_entry **buckets;
+    unsigned n_buckets;
 };
 
-#define BY_DATA(i) ((struct idxset_entry**) ((uint8_t*) (i) + PA_ALIGN(sizeof(pa_idxset))))
-#define BY_INDEX(i) (BY_DATA(i) + NBUCKETS)
+#define INITIAL_BUCKETS(i) ((struct idxset_entry**) ((uint8_t*) (i) + PA_ALIGN(sizeof(pa_idxset))))
+#define BY_DATA(i) ((i)->buckets)
+#define BY_INDEX(i) ((i)->buckets + (i)->n_buckets)
 
 PA_STATIC_FLIST_DECLARE(entries, 0, pa_xfree);
 
@@ -94,9 +107,51 @@ pa_idxset* pa_idxset_new(pa_hash_func_t hash_func, pa_compare_func_t compare_fun
     s->n_entries = 0;
     s->iterate_list_head = s->iterate_list_tail = NULL;
 
+    s->buckets = INITIAL_BUCKETS(s);
+    s->n_buckets = NBUCKETS;
+
     return s;
 }
 
+static void bucket_insert(pa_idxset *s, struct idxset_entry *e) {
+    unsigned hash;
+
+    /* Insert into data hash table */
+    hash = e->hash % s->n_buckets;
+    e->data_next = BY_DATA(s)[hash];
+    e->data_previous = NULL;
+    if (BY_DATA(s)[hash])
+        BY_DATA(s)[hash]->data_previous = e;
+    BY_DATA(s)[hash] = e;
+
+    /* Insert into index hash table */
+    hash = e->idx % s->n_buckets;
+    e->index_next = BY_INDEX(s)[hash];
+    e->index_previous = NULL;
+    if (BY_INDEX(s)[hash])
+        BY_INDEX(s)[hash]->index_previous = e;
+    BY_INDEX(s)[hash] = e;
+}
+
+/* Grows both hash tables and redistributes all entries. The iteration
+ * list is left alone, so iteration order and any iteration state held
+ * by the caller, as used by pa_idxset_rrobin() and pa_idxset_next(),
+ * stay valid. */
+static void grow(pa_idxset *s) {
+    struct idxset_entry *e;
+
+    pa_assert(s);
+
+    if (s->buckets != INITIAL_BUCKETS(s))
+        pa_xfree(s->buckets);
+
+    s->n_buckets = s->n_buckets * 2 + 1;
+    s->buckets = pa_xnew0(struct idxset_entry*, s->n_buckets * 2);
+
+    for (e = s->iterate_list_head; e; e = e->iterate_next)
+        bucket_insert(s, e);
+}
+
 static void remove_entry(pa_idxset *s, struct idxset_entry *e) {
     pa_assert(s);
     pa_assert(e);
@@ -118,10 +173,8 @@ static void remove_entry(pa_idxset *s, struct idxset_entry *e) {
 
     if (e->data_previous)
         e->data_previous->data_next = e->data_next;
-    else {
-        unsigned hash = s->hash_func(e->data) % NBUCKETS;
-        BY_DATA(s)[hash] = e->data_next;
-    }
+    else
+        BY_DATA(s)[e->hash % s->n_buckets] = e->data_next;
 
     /* Remove from index hash table */
     if (e->index_next)
@@ -130,7 +183,7 @@ static void remove_entry(pa_idxset *s, struct idxset_entry *e) {
     if (e->index_previous)
         e->index_previous->index_next = e->index_next;
     else
-        BY_INDEX(s)[e->idx % NBUCKETS] = e->index_next;
+        BY_INDEX(s)[e->idx % s->n_buckets] = e->index_next;
 
     if (pa_flist_push(PA_STATIC_FLIST_GET(entries), e) < 0)
         pa_xfree(e);
@@ -151,28 +204,29 @@ void pa_idxset_free(pa_idxset *s, pa_free2_cb_t free_cb, void *userdata) {
             free_cb(data, userdata);
     }
 
+    if (s->buckets != INITIAL_BUCKETS(s))
+        pa_xfree(s->buckets);
+
     pa_xfree(s);
 }
 
 static struct idxset_entry* data_scan(pa_idxset *s, unsigned hash, const void *p) {
     struct idxset_entry *e;
     pa_assert(s);
-    pa_assert(hash < NBUCKETS);
     pa_assert(p);
 
-    for (e = BY_DATA(s)[hash]; e; e = e->data_next)
-        if (s->compare_func(e->data, p) == 0)
+    for (e = BY_DATA(s)[hash % s->n_buckets]; e; e = e->data_next)
+        if (e->hash == hash && s->compare_func(e->data, p) == 0)
             return e;
 
     return NULL;
 }
 
-static struct idxset_entry* index_scan(pa_idxset *s, unsigned hash, uint32_t idx) {
+static struct idxset_entry* index_scan(pa_idxset *s, uint32_t idx) {
     struct idxset_entry *e;
     pa_assert(s);
-    pa_assert(hash < NBUCKETS);
 
-    for (e = BY_INDEX(s)[hash]; e; e = e->index_next)
+    for (e = BY_INDEX(s)[idx % s->n_buckets]; e; e = e->index_next)
         if (e->idx == idx)
             return e;
 
@@ -185,7 +239,7 @@ int pa_idxset_put(pa_idxset*s, void *p, uint32_t *idx) {
 
     pa_assert(s);
 
-    hash = s->hash_func(p) % NBUCKETS;
+    hash = s->hash_func(p);
 
     if ((e = data_scan(s, hash, p))) {
         if (idx)
@@ -199,22 +253,9 @@ int pa_idxset_put(pa_idxset*s, void *p, uint32_t *idx) {
 
     e->data = p;
     e->idx = s->current_index++;
+    e->hash = hash;
 
-    /* Insert into data hash table */
-    e->data_next = BY_DATA(s)[hash];
-    e->data_previous = NULL;
-    if (BY_DATA(s)[hash])
-        BY_DATA(s)[hash]->data_previous = e;
-    BY_DATA(s)[hash] = e;
-
-    hash = e->idx % NBUCKETS;
-
-    /* Insert into index hash table */
-    e->index_next = BY_INDEX(s)[hash];
-    e->index_previous = NULL;
-    if (BY_INDEX(s)[hash])
-        BY_INDEX(s)[hash]->index_previous = e;
-    BY_INDEX(s)[hash] = e;
+    bucket_insert(s, e);
 
     /* Insert into iteration list */
     e->iterate_previous = s->iterate_list_tail;
@@ -231,6 +272,9 @@ int pa_idxset_put(pa_idxset*s, void *p, uint32_t *idx) {
     s->n_entries++;
     pa_assert(s->n_entries >= 1);
 
+    if (s->n_entries > s->n_buckets)
+        grow(s);
+
     if (idx)
         *idx = e->idx;
 
@@ -238,14 +282,11 @@ int pa_idxset_put(pa_idxset*s, void *p, uint32_t *idx) {
 }
 
 void* pa_idxset_get_by_index(pa_idxset*s, uint32_t idx) {
-    unsigned hash;
     struct idxset_entry *e;
 
     pa_assert(s);
 
-    hash = idx % NBUCKETS;
-
-    if (!(e = index_scan(s, hash, idx)))
+    if (!(e = index_scan(s, idx)))
         return NULL;
 
     return e->data;
@@ -257,7 +298,7 @@ void* pa_idxset_get_by_data(pa_idxset*s, const void *p, uint32_t *idx) {
 
     pa_assert(s);
 
-    hash = s->hash_func(p) % NBUCKETS;
+    hash = s->hash_func(p);
 
     if (!(e = data_scan(s, hash, p)))
         return NULL;
@@ -270,14 +311,11 @@ void* pa_idxset_get_by_data(pa_idxset*s, const void *p, uint32_t *idx) {
 
 void* pa_idxset_remove_by_index(pa_idxset*s, uint32_t idx) {
     struct idxset_entry *e;
-    unsigned hash;
     void *data;
 
     pa_assert(s);
 
-    hash = idx % NBUCKETS;
-
-    if (!(e = index_scan(s, hash, idx)))
+    if (!(e = index_scan(s, idx)))
         return NULL;
 
     data = e->data;
@@ -293,7 +331,7 @@ void* pa_idxset_remove_by_data(pa_idxset*s, const void *data, uint32_t *idx) {
 
     pa_assert(s);
 
-    hash = s->hash_func(data) % NBUCKETS;
+    hash = s->hash_func(data);
 
     if (!(e = data_scan(s, hash, data)))
         return NULL;
@@ -309,15 +347,12 @@ void* pa_idxset_remove_by_data(pa_idxset*s, const void *data, uint32_t *idx) {
 }
 
 void* pa_idxset_rrobin(pa_idxset *s, uint32_t *idx) {
-    unsigned hash;
     struct idxset_entry *e;
 
     pa_assert(s);
     pa_assert(idx);
 
-    hash = *idx % NBUCKETS;
-
-    e = index_scan(s, hash, *idx);
+    e = index_scan(s, *idx);
 
     if (e && e->iterate_next)
         e = e->iterate_next;
@@ -399,7 +434,6 @@ void* pa_idxset_first(pa_idxset *s, uint32_t *idx) {
 
 void *pa_idxset_next(pa_idxset *s, uint32_t *idx) {
     struct idxset_entry *e;
-    unsigned hash;
 
     pa_assert(s);
     pa_assert(idx);
@@ -407,9 +441,7 @@ void *pa_idxset_next(pa_idxset *s, uint32_t *idx) {
     if (*idx == PA_IDXSET_INVALID)
         return NULL;
 
-    hash = *idx % NBUCKETS;
-
-    if ((e = index_scan(s, hash, *idx))) {
+    if ((e = index_scan(s, *idx))) {
 
         e = e->iterate_next;
 
@@ -428,9 +460,7 @@ void *pa_idxset_next(pa_idxset *s, uint32_t *idx) {
 
         for ((*idx)++; *idx < s->current_index; (*idx)++) {
 
-            hash = *idx % NBUCKETS;
-
-            if ((e = index_scan(s, hash, *idx))) {
+            if ((e = index_scan(s, *idx))) {
                 *idx = e->idx;
                 return e->data;
             }
@@ -31,6 +31,8 @@
 
 #include <pulse/xmalloc.h>
 #include <pulse/proplist.h>
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
 
 #include <pulsecore/core-subscribe.h>
 #include <pulsecore/log.h>
@@ -52,6 +54,7 @@ pa_module* pa_module_load(pa_core *c, const char *name, const char *argument) {
     pa_bool_t (*load_once)(void);
     const char* (*get_deprecated)(void);
     pa_modinfo *mi;
+    pa_usec_t start;
 
     pa_assert(c);
     pa_assert(name);
@@ -65,11 +68,15 @@ pa_module* pa_module_load(pa_core *c, const char *name, const char *argument) {
     m->load_once = FALSE;
     m->proplist = pa_proplist_new();
 
+    start = pa_rtclock_now();
+
     if (!(m->dl = lt_dlopenext(name))) {
         pa_log("Failed to open module \"%s\": %s", name, lt_dlerror());
         goto fail;
     }
 
+    m->open_usec = pa_rtclock_now() - start;
+
     if ((load_once = (pa_bool_t (*)(void)) pa_load_sym(m->dl, name, PA_SYMBOL_LOAD_ONCE))) {
 
         m->load_once = load_once();
@@ -106,15 +113,23 @@ pa_module* pa_module_load(pa_core *c, const char *name, const char *argument) {
     m->core = c;
     m->unload_requested = FALSE;
 
+    start = pa_rtclock_now();
+
     if (m->init(m) < 0) {
         pa_log_error("Failed to load module \"%s\" (argument: \"%s\"): initialization failed.", name, argument ? argument : "");
         goto fail;
     }
 
+    m->init_usec = pa_rtclock_now() - start;
+
     pa_assert_se(pa_idxset_put(c->modules, m, &m->index) >= 0);
     pa_assert(m->index != PA_IDXSET_INVALID);
 
-    pa_log_info("Loaded \"%s\" (index: #%u; argument: \"%s\").", m->name, m->index, m->argument ? m->argument : "");
+    pa_log_info("Loaded \"%s\" (index: #%u; argument: \"%s\") in %0.1f ms (open %0.1f ms, init %0.1f ms).",
+                m->name, m->index, m->argument ? m->argument : "",
+                (double) (m->open_usec + m->init_usec) / PA_USEC_PER_MSEC,
+                (double) m->open_usec / PA_USEC_PER_MSEC,
+                (double) m->init_usec / PA_USEC_PER_MSEC);
 
     pa_subscription_post(c, PA_SUBSCRIPTION_EVENT_MODULE|PA_SUBSCRIPTION_EVENT_NEW, m->index);
 
@@ -48,6 +48,10 @@ struct pa_module {
     pa_bool_t unload_requested:1;
 
     pa_proplist *proplist;
+
+    /* How long opening the shared object and initializing the module
+     * took, the latter includes any modules loaded by it */
+    pa_usec_t open_usec, init_usec;
 };
 
 pa_module* pa_module_load(pa_core *c, const char *name, const char*argument);
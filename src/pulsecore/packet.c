@@ -27,9 +27,14 @@
 
 #include <pulse/xmalloc.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/flist.h>
 
 #include "packet.h"
 
+/* Only packets that don't carry their data appended have a fixed size
+ * and can be recycled */
+PA_STATIC_FLIST_DECLARE(dynamic_packets, 0, pa_xfree);
+
 pa_packet* pa_packet_new(size_t length) {
     pa_packet *p;
 
@@ -50,7 +55,9 @@ pa_packet* pa_packet_new_dynamic(void* data, size_t length) {
     pa_assert(data);
     pa_assert(length > 0);
 
-    p = pa_xnew(pa_packet, 1);
+    if (!(p = pa_flist_pop(PA_STATIC_FLIST_GET(dynamic_packets))))
+        p = pa_xnew(pa_packet, 1);
+
     PA_REFCNT_INIT(p);
     p->length = length;
     p->data = data;
@@ -72,8 +79,13 @@ void pa_packet_unref(pa_packet *p) {
     pa_assert(PA_REFCNT_VALUE(p) >= 1);
 
     if (PA_REFCNT_DEC(p) <= 0) {
-        if (p->type == PA_PACKET_DYNAMIC)
+        if (p->type == PA_PACKET_DYNAMIC) {
             pa_xfree(p->data);
+
+            if (pa_flist_push(PA_STATIC_FLIST_GET(dynamic_packets), p) >= 0)
+                return;
+        }
+
         pa_xfree(p);
     }
 }
@@ -190,6 +190,9 @@ static const char *command_names[PA_COMMAND_MAX] = {
     [PA_COMMAND_SET_SOURCE_OUTPUT_VOLUME] = "SET_SOURCE_OUTPUT_VOLUME",
     [PA_COMMAND_SET_SOURCE_OUTPUT_MUTE] = "SET_SOURCE_OUTPUT_MUTE",
 
+    /* Supported since protocol v26 (3.0) */
+    [PA_COMMAND_GET_SNAPSHOT] = "GET_SNAPSHOT",
+
 };
 
 #endif
@@ -284,27 +287,37 @@ static void run_action(pa_pdispatch *pd, struct reply_info *r, uint32_t command,
     pa_pdispatch_unref(pd);
 }
 
-int pa_pdispatch_run(pa_pdispatch *pd, pa_packet*packet, const pa_creds *creds, void *userdata) {
-    uint32_t tag, command;
-    pa_tagstruct *ts = NULL;
-    int ret = -1;
+pa_tagstruct *pa_pdispatch_parse(pa_packet *packet, uint32_t *command, uint32_t *tag) {
+    pa_tagstruct *ts;
 
-    pa_assert(pd);
-    pa_assert(PA_REFCNT_VALUE(pd) >= 1);
     pa_assert(packet);
     pa_assert(PA_REFCNT_VALUE(packet) >= 1);
     pa_assert(packet->data);
-
-    pa_pdispatch_ref(pd);
+    pa_assert(command);
+    pa_assert(tag);
 
     if (packet->length <= 8)
-        goto finish;
+        return NULL;
 
     ts = pa_tagstruct_new(packet->data, packet->length);
 
-    if (pa_tagstruct_getu32(ts, &command) < 0 ||
-        pa_tagstruct_getu32(ts, &tag) < 0)
-        goto finish;
+    if (pa_tagstruct_getu32(ts, command) < 0 ||
+        pa_tagstruct_getu32(ts, tag) < 0) {
+        pa_tagstruct_free(ts);
+        return NULL;
+    }
+
+    return ts;
+}
+
+int pa_pdispatch_run_tagstruct(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *ts, const pa_creds *creds, void *userdata) {
+    int ret = -1;
+
+    pa_assert(pd);
+    pa_assert(PA_REFCNT_VALUE(pd) >= 1);
+    pa_assert(ts);
+
+    pa_pdispatch_ref(pd);
 
 #ifdef DEBUG_OPCODES
 {
@@ -344,14 +357,30 @@ int pa_pdispatch_run(pa_pdispatch *pd, pa_packet*packet, const pa_creds *creds,
 finish:
     pd->creds = NULL;
 
-    if (ts)
-        pa_tagstruct_free(ts);
-
     pa_pdispatch_unref(pd);
 
     return ret;
 }
 
+int pa_pdispatch_run(pa_pdispatch *pd, pa_packet*packet, const pa_creds *creds, void *userdata) {
+    uint32_t tag, command;
+    pa_tagstruct *ts;
+    int ret;
+
+    pa_assert(pd);
+    pa_assert(PA_REFCNT_VALUE(pd) >= 1);
+    pa_assert(packet);
+
+    if (!(ts = pa_pdispatch_parse(packet, &command, &tag)))
+        return -1;
+
+    ret = pa_pdispatch_run_tagstruct(pd, command, tag, ts, creds, userdata);
+
+    pa_tagstruct_free(ts);
+
+    return ret;
+}
+
 static void timeout_callback(pa_mainloop_api*m, pa_time_event*e, const struct timeval *t, void *userdata) {
     struct reply_info*r = userdata;
 
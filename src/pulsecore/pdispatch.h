@@ -43,6 +43,12 @@ pa_pdispatch* pa_pdispatch_ref(pa_pdispatch *pd);
 
 int pa_pdispatch_run(pa_pdispatch *pd, pa_packet*p, const pa_creds *creds, void *userdata);
 
+/* pa_pdispatch_run() in two steps. The first one only looks at the
+ * packet and may be called from any thread. The tagstruct refers to
+ * the packet data, and is left positioned after command and tag. */
+pa_tagstruct *pa_pdispatch_parse(pa_packet *p, uint32_t *command, uint32_t *tag);
+int pa_pdispatch_run_tagstruct(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *ts, const pa_creds *creds, void *userdata);
+
 void pa_pdispatch_register_reply(pa_pdispatch *pd, uint32_t tag, int timeout, pa_pdispatch_cb_t callback, void *userdata, pa_free_cb_t free_cb);
 
 int pa_pdispatch_is_pending(pa_pdispatch *pd);
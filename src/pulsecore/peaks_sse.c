@@ -0,0 +1,217 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "cpu-x86.h"
+#include "resampler.h"
+
+#if !defined(__APPLE__) && defined (__i386__) || defined (__amd64__)
+
+/* The interleaved samples are cut into rows of lcm(channels, vector
+ * size) samples, so that every lane of a vector always sees the same
+ * channel. Each pass runs down one vector wide column of the rows.
+ * Mono and stereo take a single pass, many channels one pass per
+ * vector of channels. */
+
+static unsigned row_length(unsigned channels, unsigned width) {
+    unsigned l = channels;
+
+    while (l % width)
+        l += channels;
+
+    return l;
+}
+
+static const PA_DECLARE_ALIGNED (16, uint32_t, abs_mask[4]) = { 0x7FFFFFFF, 0x7FFFFFFF, 0x7FFFFFFF, 0x7FFFFFFF };
+
+/* Largest and smallest value of each lane over n rows, two rows per
+ * round. Taking the absolute value at the end avoids the overflow of
+ * -0x8000, and SSE2 has no pabsw anyway. */
+static void column_s16_sse2(const int16_t *s, unsigned n, unsigned stride, int16_t *max, int16_t *min) {
+    pa_reg_x86 rounds = n / 2, st = stride;
+
+    __asm__ __volatile__ (
+        " pxor %%xmm0, %%xmm0           \n\t"
+        " pxor %%xmm1, %%xmm1           \n\t"
+        " pxor %%xmm2, %%xmm2           \n\t"
+        " pxor %%xmm3, %%xmm3           \n\t"
+        " test %0, %0                   \n\t"
+        " jz 2f                         \n\t"
+
+        "1:                             \n\t"
+        " movdqu (%1), %%xmm4           \n\t"
+        " add %2, %1                    \n\t"
+        " movdqu (%1), %%xmm5           \n\t"
+        " add %2, %1                    \n\t"
+        " pmaxsw %%xmm4, %%xmm0         \n\t"
+        " pminsw %%xmm4, %%xmm1         \n\t"
+        " pmaxsw %%xmm5, %%xmm2         \n\t"
+        " pminsw %%xmm5, %%xmm3         \n\t"
+        " dec %0                        \n\t"
+        " jnz 1b                        \n\t"
+
+        "2:                             \n\t"
+        " pmaxsw %%xmm2, %%xmm0         \n\t"
+        " pminsw %%xmm3, %%xmm1         \n\t"
+        " movdqu %%xmm0, (%3)           \n\t"
+        " movdqu %%xmm1, (%4)           \n\t"
+
+        : "+r" (rounds), "+r" (s), "+r" (st)
+        : "r" (max), "r" (min)
+        : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5"
+    );
+
+    if (n & 1) {
+        unsigned j;
+
+        for (j = 0; j < 8; j++) {
+            max[j] = PA_MAX(max[j], s[j]);
+            min[j] = PA_MIN(min[j], s[j]);
+        }
+    }
+}
+
+static void peaks_s16_sse2(const int16_t *s, unsigned n_frames, unsigned channels, int16_t *peak) {
+    int16_t max[8], min[8];
+    unsigned l, n_rows, v, j, c;
+
+    l = row_length(channels, 8);
+    n_rows = (n_frames * channels) / l;
+
+    for (v = 0; n_rows > 0 && v < l; v += 8) {
+        column_s16_sse2(s + v, n_rows, l * sizeof(int16_t), max, min);
+
+        for (j = 0; j < 8; j++) {
+            int16_t n = (int16_t) PA_MAX(max[j], PA_MIN(-min[j], 0x7FFF));
+
+            c = (v + j) % channels;
+
+            if (n > peak[c])
+                peak[c] = n;
+        }
+    }
+
+    /* The frames that do not fill a row */
+    s += n_rows * l;
+    n_frames -= n_rows * (l / channels);
+
+    for (; n_frames > 0; n_frames--)
+        for (c = 0; c < channels; c++) {
+            int16_t n = (int16_t) PA_MIN(abs(*s++), 0x7FFF);
+
+            if (n > peak[c])
+                peak[c] = n;
+        }
+}
+
+static void column_float_sse(const float *s, unsigned n, unsigned stride, float *max) {
+    pa_reg_x86 rounds = n / 2, st = stride;
+
+    __asm__ __volatile__ (
+        " movaps %4, %%xmm6             \n\t"
+        " xorps %%xmm0, %%xmm0          \n\t"
+        " xorps %%xmm1, %%xmm1          \n\t"
+        " test %0, %0                   \n\t"
+        " jz 2f                         \n\t"
+
+        "1:                             \n\t"
+        " movups (%1), %%xmm2           \n\t"
+        " add %2, %1                    \n\t"
+        " movups (%1), %%xmm3           \n\t"
+        " add %2, %1                    \n\t"
+        " andps %%xmm6, %%xmm2          \n\t" /* clear the sign */
+        " andps %%xmm6, %%xmm3          \n\t"
+        " maxps %%xmm2, %%xmm0          \n\t"
+        " maxps %%xmm3, %%xmm1          \n\t"
+        " dec %0                        \n\t"
+        " jnz 1b                        \n\t"
+
+        "2:                             \n\t"
+        " maxps %%xmm1, %%xmm0          \n\t"
+        " movups %%xmm0, (%3)           \n\t"
+
+        : "+r" (rounds), "+r" (s), "+r" (st)
+        : "r" (max), "m" (*abs_mask)
+        : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm6"
+    );
+
+    if (n & 1) {
+        unsigned j;
+
+        for (j = 0; j < 4; j++)
+            max[j] = PA_MAX(max[j], fabsf(s[j]));
+    }
+}
+
+static void peaks_float_sse(const float *s, unsigned n_frames, unsigned channels, float *peak) {
+    float max[4];
+    unsigned l, n_rows, v, j, c;
+
+    l = row_length(channels, 4);
+    n_rows = (n_frames * channels) / l;
+
+    for (v = 0; n_rows > 0 && v < l; v += 4) {
+        column_float_sse(s + v, n_rows, l * sizeof(float), max);
+
+        for (j = 0; j < 4; j++) {
+            c = (v + j) % channels;
+
+            if (max[j] > peak[c])
+                peak[c] = max[j];
+        }
+    }
+
+    s += n_rows * l;
+    n_frames -= n_rows * (l / channels);
+
+    for (; n_frames > 0; n_frames--)
+        for (c = 0; c < channels; c++) {
+            float n = fabsf(*s++);
+
+            if (n > peak[c])
+                peak[c] = n;
+        }
+}
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+void pa_peaks_func_init_sse(pa_cpu_x86_flag_t flags) {
+#if !defined(__APPLE__) && defined (__i386__) || defined (__amd64__)
+
+    if (flags & PA_CPU_X86_SSE) {
+        pa_log_info("Initialising SSE optimized peak detection.");
+        pa_set_peaks_float_func(peaks_float_sse);
+    }
+
+    if (flags & PA_CPU_X86_SSE2) {
+        pa_log_info("Initialising SSE2 optimized peak detection.");
+        pa_set_peaks_s16_func(peaks_s16_sse2);
+    }
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+}
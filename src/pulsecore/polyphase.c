@@ -0,0 +1,590 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/mutex.h>
+
+#include "polyphase.h"
+
+/* Rate pairs whose reduced output rate is at most MAX_EXACT_PHASES get
+ * a bank with a phase for every output position, so nominal rates need
+ * no interpolation. There are always at least MIN_PHASES, to keep the
+ * interpolation between phases clean after a rate change. Other rate
+ * pairs get INTERP_PHASES. */
+#define MIN_PHASES 128
+#define MAX_EXACT_PHASES 1024
+#define INTERP_PHASES 256
+
+/* Unused banks kept around for the next stream */
+#define MAX_IDLE_BANKS 8
+
+/* How far the rate ratio may move away from the one the bank was made
+ * for before its cutoff no longer fits */
+#define RATIO_TOLERANCE 0.05
+
+static const struct {
+    unsigned n_taps;
+    double beta;     /* Kaiser window */
+    double rolloff;  /* cutoff relative to the Nyquist frequency */
+} quality_table[PA_POLYPHASE_QUALITY_MAX + 1] = {
+    { 16,  5.0, 0.80 },
+    { 24,  6.5, 0.83 },
+    { 32,  8.0, 0.85 },
+    { 64, 10.0, 0.90 },
+};
+
+typedef struct bank bank;
+
+struct bank {
+    uint32_t in_rate, out_rate;
+    unsigned quality;
+
+    /* n_phases + 1 rows of n_taps taps, the last row is the first one
+     * shifted by one input frame, for interpolating past the last phase */
+    unsigned n_taps, n_phases;
+    float *h_float;
+    int16_t *h_s16;
+
+    unsigned ref;
+    PA_LLIST_FIELDS(bank);
+};
+
+struct pa_polyphase {
+    pa_sample_format_t format;
+    unsigned channels;
+    unsigned quality;
+
+    bank *bank;
+    unsigned n_taps, n_phases;
+
+    /* The rates reduced by their gcd. One output frame advances the
+     * position by step_idx input frames, step_phase phases and
+     * step_rem/out_rate of a phase. */
+    uint32_t in_rate, out_rate;
+    unsigned step_idx, step_phase, step_rem;
+
+    /* The position of the next output frame: between input frames idx
+     * and idx+1 of the history, phase phases and rem/out_rate of a phase
+     * after idx */
+    unsigned idx, phase, rem;
+
+    /* Planar history, a row of buf_size frames per channel */
+    void *buf;
+    unsigned buf_size, buf_fill;
+
+    /* Taps interpolated between two phases */
+    void *h_interp;
+};
+
+static PA_LLIST_HEAD(bank, banks) = NULL;
+static pa_static_mutex banks_mutex = PA_STATIC_MUTEX_INIT;
+
+static float dot_float_c(const float *x, const float *h, unsigned n) {
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    unsigned i;
+
+    for (i = 0; i < n; i += 4) {
+        s0 += x[i] * h[i];
+        s1 += x[i+1] * h[i+1];
+        s2 += x[i+2] * h[i+2];
+        s3 += x[i+3] * h[i+3];
+    }
+
+    return (s0 + s1) + (s2 + s3);
+}
+
+static int32_t dot_s16_c(const int16_t *x, const int16_t *h, unsigned n) {
+    int32_t s = 0;
+    unsigned i;
+
+    for (i = 0; i < n; i++)
+        s += (int32_t) x[i] * (int32_t) h[i];
+
+    return s;
+}
+
+static pa_polyphase_dot_float_func_t dot_float_func = dot_float_c;
+static pa_polyphase_dot_s16_func_t dot_s16_func = dot_s16_c;
+
+pa_polyphase_dot_float_func_t pa_get_polyphase_dot_float_func(void) {
+    return dot_float_func;
+}
+
+void pa_set_polyphase_dot_float_func(pa_polyphase_dot_float_func_t func) {
+    pa_assert(func);
+
+    dot_float_func = func;
+}
+
+pa_polyphase_dot_s16_func_t pa_get_polyphase_dot_s16_func(void) {
+    return dot_s16_func;
+}
+
+void pa_set_polyphase_dot_s16_func(pa_polyphase_dot_s16_func_t func) {
+    pa_assert(func);
+
+    dot_s16_func = func;
+}
+
+static double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+    unsigned k;
+
+    for (k = 1; term > sum * 1e-12; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+static bank *bank_new(uint32_t in_rate, uint32_t out_rate, unsigned quality) {
+    bank *b;
+    double fc, beta, i0_beta, *h;
+    unsigned p, k, half;
+
+    b = pa_xnew0(bank, 1);
+    b->in_rate = in_rate;
+    b->out_rate = out_rate;
+    b->quality = quality;
+
+    /* Cutoff in cycles per input frame. When downsampling it moves
+     * down to the output's Nyquist frequency, and the filter gets
+     * longer to keep the transition band as steep. */
+    fc = 0.5 * quality_table[quality].rolloff;
+    b->n_taps = quality_table[quality].n_taps;
+
+    if (out_rate < in_rate) {
+        fc = fc * out_rate / in_rate;
+        b->n_taps = (unsigned) ceil((double) b->n_taps * in_rate / out_rate);
+        b->n_taps = (b->n_taps + 7) & ~7U;
+    }
+
+    if (out_rate <= MAX_EXACT_PHASES)
+        b->n_phases = out_rate * ((MIN_PHASES + out_rate - 1) / out_rate);
+    else
+        b->n_phases = INTERP_PHASES;
+
+    b->h_float = pa_xnew(float, (b->n_phases + 1) * b->n_taps);
+    b->h_s16 = pa_xnew(int16_t, (b->n_phases + 1) * b->n_taps);
+    h = pa_xnew(double, b->n_taps);
+
+    half = b->n_taps / 2;
+    beta = quality_table[quality].beta;
+    i0_beta = bessel_i0(beta);
+
+    for (p = 0; p <= b->n_phases; p++) {
+        float *hf = b->h_float + p * b->n_taps;
+        int16_t *hs = b->h_s16 + p * b->n_taps;
+        double sum = 0;
+        int32_t isum = 0;
+        unsigned center = 0;
+
+        for (k = 0; k < b->n_taps; k++) {
+            /* Distance of the tap's input frame from the output frame */
+            double t = (double) k - half + 1 - (double) p / b->n_phases;
+            double r = t / half, x = 2.0 * fc * t;
+
+            h[k] = 2.0 * fc * (x == 0 ? 1.0 : sin(M_PI * x) / (M_PI * x));
+            h[k] *= r >= 1.0 || r <= -1.0 ? 0.0 : bessel_i0(beta * sqrt(1.0 - r * r)) / i0_beta;
+            sum += h[k];
+
+            if (h[k] > h[center])
+                center = k;
+        }
+
+        /* Every phase gets unity gain at DC. The rounding error of the
+         * Q15 taps goes to the largest one, so the sum is exact. */
+        for (k = 0; k < b->n_taps; k++) {
+            long v;
+
+            hf[k] = (float) (h[k] / sum);
+
+            v = lrint(h[k] / sum * 0x8000);
+            hs[k] = (int16_t) PA_CLAMP_UNLIKELY(v, -0x7FFF, 0x7FFF);
+            isum += hs[k];
+        }
+
+        hs[center] = (int16_t) PA_CLAMP_UNLIKELY(hs[center] + 0x8000 - isum, -0x7FFF, 0x7FFF);
+    }
+
+    pa_xfree(h);
+
+    pa_log_debug("Computed polyphase filter bank for %u:%u, quality %u: %u phases of %u taps.",
+                 in_rate, out_rate, quality, b->n_phases, b->n_taps);
+
+    return b;
+}
+
+static void bank_free(bank *b) {
+    pa_assert(b);
+    pa_assert(b->ref <= 0);
+
+    pa_xfree(b->h_float);
+    pa_xfree(b->h_s16);
+    pa_xfree(b);
+}
+
+/* Rates are reduced */
+static bank *bank_get(uint32_t in_rate, uint32_t out_rate, unsigned quality) {
+    pa_mutex *m;
+    bank *b;
+
+    m = pa_static_mutex_get(&banks_mutex, FALSE, TRUE);
+    pa_mutex_lock(m);
+
+    PA_LLIST_FOREACH(b, banks)
+        if (b->in_rate == in_rate && b->out_rate == out_rate && b->quality == quality)
+            break;
+
+    if (b)
+        PA_LLIST_REMOVE(bank, banks, b);
+    else
+        b = bank_new(in_rate, out_rate, quality);
+
+    /* Most recently used first */
+    PA_LLIST_PREPEND(bank, banks, b);
+    b->ref++;
+
+    pa_mutex_unlock(m);
+
+    return b;
+}
+
+static void bank_put(bank *b) {
+    pa_mutex *m;
+    bank *i, *n;
+    unsigned n_idle = 0;
+
+    pa_assert(b);
+
+    m = pa_static_mutex_get(&banks_mutex, FALSE, TRUE);
+    pa_mutex_lock(m);
+
+    pa_assert(b->ref >= 1);
+
+    if (--b->ref <= 0)
+        PA_LLIST_FOREACH_SAFE(i, n, banks) {
+            if (i->ref > 0)
+                continue;
+
+            if (++n_idle > MAX_IDLE_BANKS) {
+                PA_LLIST_REMOVE(bank, banks, i);
+                bank_free(i);
+            }
+        }
+
+    pa_mutex_unlock(m);
+}
+
+static size_t sample_size(pa_polyphase *p) {
+    return p->format == PA_SAMPLE_FLOAT32NE ? sizeof(float) : sizeof(int16_t);
+}
+
+/* Makes room for n more frames of history per channel */
+static void ensure_space(pa_polyphase *p, unsigned n) {
+    size_t sz = sample_size(p);
+    unsigned c, size;
+    uint8_t *buf;
+
+    if (p->buf_fill + n <= p->buf_size)
+        return;
+
+    size = PA_MAX(p->buf_fill + n, p->buf_size * 2);
+    buf = pa_xmalloc(size * sz * p->channels);
+
+    if (p->buf_fill > 0)
+        for (c = 0; c < p->channels; c++)
+            memcpy(buf + c * size * sz, (uint8_t*) p->buf + c * p->buf_size * sz, p->buf_fill * sz);
+
+    pa_xfree(p->buf);
+    p->buf = buf;
+    p->buf_size = size;
+}
+
+static void calc_steps(pa_polyphase *p) {
+    uint64_t f;
+
+    f = (uint64_t) (p->in_rate % p->out_rate) * p->n_phases;
+
+    p->step_idx = p->in_rate / p->out_rate;
+    p->step_phase = (unsigned) (f / p->out_rate);
+    p->step_rem = (unsigned) (f % p->out_rate);
+}
+
+static void set_bank(pa_polyphase *p, bank *b) {
+    size_t sz = sample_size(p);
+    unsigned old_half, half, c;
+
+    pa_assert(b);
+
+    old_half = p->n_taps / 2;
+    half = b->n_taps / 2;
+
+    /* A longer filter reaches further back than the history goes */
+    if (p->bank && half > old_half) {
+        unsigned d = half - old_half;
+
+        ensure_space(p, d);
+
+        for (c = 0; c < p->channels; c++) {
+            uint8_t *row = (uint8_t*) p->buf + c * p->buf_size * sz;
+
+            memmove(row + d * sz, row, p->buf_fill * sz);
+            memset(row, 0, d * sz);
+        }
+
+        p->buf_fill += d;
+        p->idx += d;
+    }
+
+    if (p->bank)
+        bank_put(p->bank);
+
+    p->bank = b;
+    p->n_taps = b->n_taps;
+    p->n_phases = b->n_phases;
+
+    pa_xfree(p->h_interp);
+    p->h_interp = pa_xmalloc(p->n_taps * sz);
+}
+
+pa_polyphase *pa_polyphase_new(pa_sample_format_t format, unsigned channels, uint32_t in_rate, uint32_t out_rate, unsigned quality) {
+    pa_polyphase *p;
+    unsigned g;
+
+    pa_assert(format == PA_SAMPLE_FLOAT32NE || format == PA_SAMPLE_S16NE);
+    pa_assert(channels > 0);
+    pa_assert(in_rate > 0);
+    pa_assert(out_rate > 0);
+    pa_assert(quality <= PA_POLYPHASE_QUALITY_MAX);
+
+    g = pa_gcd(in_rate, out_rate);
+
+    p = pa_xnew0(pa_polyphase, 1);
+    p->format = format;
+    p->channels = channels;
+    p->quality = quality;
+    p->in_rate = in_rate / g;
+    p->out_rate = out_rate / g;
+
+    set_bank(p, bank_get(p->in_rate, p->out_rate, quality));
+    calc_steps(p);
+    pa_polyphase_reset(p);
+
+    return p;
+}
+
+void pa_polyphase_free(pa_polyphase *p) {
+    pa_assert(p);
+
+    bank_put(p->bank);
+
+    pa_xfree(p->buf);
+    pa_xfree(p->h_interp);
+    pa_xfree(p);
+}
+
+void pa_polyphase_set_rates(pa_polyphase *p, uint32_t in_rate, uint32_t out_rate) {
+    unsigned g;
+    double ratio, pos;
+
+    pa_assert(p);
+    pa_assert(in_rate > 0);
+    pa_assert(out_rate > 0);
+
+    g = pa_gcd(in_rate, out_rate);
+    in_rate /= g;
+    out_rate /= g;
+
+    if (in_rate == p->in_rate && out_rate == p->out_rate)
+        return;
+
+    /* Where between two input frames the next output frame lies */
+    pos = ((double) p->phase + (double) p->rem / p->out_rate) / p->n_phases;
+
+    ratio = ((double) in_rate * p->bank->out_rate) / ((double) out_rate * p->bank->in_rate);
+
+    if (ratio < 1.0 - RATIO_TOLERANCE || ratio > 1.0 + RATIO_TOLERANCE)
+        set_bank(p, bank_get(in_rate, out_rate, p->quality));
+
+    p->in_rate = in_rate;
+    p->out_rate = out_rate;
+
+    pos *= p->n_phases;
+    p->phase = PA_MIN((unsigned) pos, p->n_phases - 1);
+    p->rem = PA_MIN((unsigned) ((pos - p->phase) * out_rate), out_rate - 1);
+
+    calc_steps(p);
+}
+
+void pa_polyphase_reset(pa_polyphase *p) {
+    unsigned half;
+
+    pa_assert(p);
+
+    /* Start on a history of silence, so that output comes right away,
+     * delayed by half the filter length like the other resamplers */
+    half = p->n_taps / 2;
+
+    p->buf_fill = 0;
+    ensure_space(p, p->n_taps - 1);
+    memset(p->buf, 0, p->buf_size * sample_size(p) * p->channels);
+
+    p->buf_fill = p->n_taps - 1;
+    p->idx = half - 1;
+    p->phase = p->rem = 0;
+}
+
+static inline void advance(pa_polyphase *p) {
+    p->rem += p->step_rem;
+    if (p->rem >= p->out_rate) {
+        p->rem -= p->out_rate;
+        p->phase++;
+    }
+
+    p->phase += p->step_phase;
+    if (p->phase >= p->n_phases) {
+        p->phase -= p->n_phases;
+        p->idx++;
+    }
+
+    p->idx += p->step_idx;
+}
+
+static unsigned run_float(pa_polyphase *p, float *dst, unsigned out_max) {
+    pa_polyphase_dot_float_func_t dot = dot_float_func;
+    unsigned half = p->n_taps / 2, n, c, k;
+
+    for (n = 0; n < out_max && p->idx + half < p->buf_fill; n++) {
+        const float *h = p->bank->h_float + p->phase * p->n_taps;
+        const float *x = (const float*) p->buf + p->idx + 1 - half;
+
+        if (p->rem > 0) {
+            float mu = (float) p->rem / (float) p->out_rate;
+            float *hi = p->h_interp;
+
+            for (k = 0; k < p->n_taps; k++)
+                hi[k] = h[k] + mu * (h[k + p->n_taps] - h[k]);
+
+            h = hi;
+        }
+
+        for (c = 0; c < p->channels; c++, x += p->buf_size)
+            *(dst++) = dot(x, h, p->n_taps);
+
+        advance(p);
+    }
+
+    return n;
+}
+
+static unsigned run_s16(pa_polyphase *p, int16_t *dst, unsigned out_max) {
+    pa_polyphase_dot_s16_func_t dot = dot_s16_func;
+    unsigned half = p->n_taps / 2, n, c, k;
+
+    for (n = 0; n < out_max && p->idx + half < p->buf_fill; n++) {
+        const int16_t *h = p->bank->h_s16 + p->phase * p->n_taps;
+        const int16_t *x = (const int16_t*) p->buf + p->idx + 1 - half;
+
+        if (p->rem > 0) {
+            int32_t mu = (int32_t) (((uint64_t) p->rem << 15) / p->out_rate);
+            int16_t *hi = p->h_interp;
+
+            for (k = 0; k < p->n_taps; k++)
+                hi[k] = (int16_t) (h[k] + ((((int32_t) h[k + p->n_taps] - h[k]) * mu) >> 15));
+
+            h = hi;
+        }
+
+        for (c = 0; c < p->channels; c++, x += p->buf_size) {
+            int32_t s = (dot(x, h, p->n_taps) + 0x4000) >> 15;
+            *(dst++) = (int16_t) PA_CLAMP_UNLIKELY(s, -0x8000, 0x7FFF);
+        }
+
+        advance(p);
+    }
+
+    return n;
+}
+
+unsigned pa_polyphase_run(pa_polyphase *p, const void *src, unsigned in_frames, void *dst, unsigned out_max) {
+    size_t sz;
+    unsigned half, n, c, i, consumed;
+
+    pa_assert(p);
+    pa_assert(src || in_frames <= 0);
+    pa_assert(dst || out_max <= 0);
+
+    sz = sample_size(p);
+    ensure_space(p, in_frames);
+
+    if (p->format == PA_SAMPLE_FLOAT32NE) {
+        for (c = 0; c < p->channels; c++) {
+            const float *s = (const float*) src + c;
+            float *d = (float*) p->buf + c * p->buf_size + p->buf_fill;
+
+            for (i = 0; i < in_frames; i++, s += p->channels)
+                d[i] = *s;
+        }
+
+        p->buf_fill += in_frames;
+        n = run_float(p, dst, out_max);
+
+    } else {
+        for (c = 0; c < p->channels; c++) {
+            const int16_t *s = (const int16_t*) src + c;
+            int16_t *d = (int16_t*) p->buf + c * p->buf_size + p->buf_fill;
+
+            for (i = 0; i < in_frames; i++, s += p->channels)
+                d[i] = *s;
+        }
+
+        p->buf_fill += in_frames;
+        n = run_s16(p, dst, out_max);
+    }
+
+    /* Drop the history no output frame reaches back to anymore */
+    half = p->n_taps / 2;
+    consumed = PA_MIN(p->idx + 1 - half, p->buf_fill);
+
+    if (consumed > 0) {
+        for (c = 0; c < p->channels; c++) {
+            uint8_t *row = (uint8_t*) p->buf + c * p->buf_size * sz;
+            memmove(row, row + consumed * sz, (p->buf_fill - consumed) * sz);
+        }
+
+        p->buf_fill -= consumed;
+        p->idx -= consumed;
+    }
+
+    return n;
+}
@@ -0,0 +1,59 @@
+#ifndef foopolyphasehfoo
+#define foopolyphasehfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#include <inttypes.h>
+
+#include <pulse/sample.h>
+
+/* A polyphase FIR resampler working on S16NE or FLOAT32NE. The filter
+ * banks are computed once per (input rate, output rate, quality) and
+ * shared read-only between all resamplers of the process. Changing the
+ * rates by a small amount, as drift correction does, keeps the bank and
+ * interpolates between its phases. */
+
+typedef struct pa_polyphase pa_polyphase;
+
+#define PA_POLYPHASE_QUALITY_MAX 3
+
+/* Dot products of n samples with n filter taps, n is a multiple of 8.
+ * The S16 version returns the sum unscaled, taps are Q15. */
+typedef float (*pa_polyphase_dot_float_func_t)(const float *x, const float *h, unsigned n);
+typedef int32_t (*pa_polyphase_dot_s16_func_t)(const int16_t *x, const int16_t *h, unsigned n);
+
+pa_polyphase_dot_float_func_t pa_get_polyphase_dot_float_func(void);
+void pa_set_polyphase_dot_float_func(pa_polyphase_dot_float_func_t func);
+
+pa_polyphase_dot_s16_func_t pa_get_polyphase_dot_s16_func(void);
+void pa_set_polyphase_dot_s16_func(pa_polyphase_dot_s16_func_t func);
+
+pa_polyphase *pa_polyphase_new(pa_sample_format_t format, unsigned channels, uint32_t in_rate, uint32_t out_rate, unsigned quality);
+void pa_polyphase_free(pa_polyphase *p);
+
+void pa_polyphase_set_rates(pa_polyphase *p, uint32_t in_rate, uint32_t out_rate);
+void pa_polyphase_reset(pa_polyphase *p);
+
+/* Resamples in_frames interleaved frames from src into dst, writing at
+ * most out_max frames. Returns the number of frames written. Input the
+ * filter cannot use yet is kept for the next call. */
+unsigned pa_polyphase_run(pa_polyphase *p, const void *src, unsigned in_frames, void *dst, unsigned out_max);
+
+#endif
@@ -0,0 +1,120 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "cpu-x86.h"
+#include "polyphase.h"
+
+#if !defined(__APPLE__) && defined (__i386__) || defined (__amd64__)
+
+/* Both take 8 taps per round, n is always a multiple of 8. The history
+ * rows start at any frame, so all loads are unaligned. */
+
+static float dot_float_sse(const float *x, const float *h, unsigned n) {
+    pa_reg_x86 i = n / 8;
+    float r;
+
+    __asm__ __volatile__ (
+        " xorps %%xmm0, %%xmm0          \n\t"
+        " xorps %%xmm1, %%xmm1          \n\t"
+
+        "1:                             \n\t"
+        " movups (%1), %%xmm2           \n\t"
+        " movups 16(%1), %%xmm3         \n\t"
+        " movups (%2), %%xmm4           \n\t"
+        " movups 16(%2), %%xmm5         \n\t"
+        " mulps %%xmm4, %%xmm2          \n\t"
+        " mulps %%xmm5, %%xmm3          \n\t"
+        " addps %%xmm2, %%xmm0          \n\t"
+        " addps %%xmm3, %%xmm1          \n\t"
+        " add $32, %1                   \n\t"
+        " add $32, %2                   \n\t"
+        " dec %0                        \n\t"
+        " jnz 1b                        \n\t"
+
+        " addps %%xmm1, %%xmm0          \n\t" /* horizontal sum */
+        " movhlps %%xmm0, %%xmm1        \n\t"
+        " addps %%xmm1, %%xmm0          \n\t"
+        " movaps %%xmm0, %%xmm1         \n\t"
+        " shufps $0x55, %%xmm1, %%xmm1  \n\t"
+        " addss %%xmm1, %%xmm0          \n\t"
+        " movss %%xmm0, %3              \n\t"
+
+        : "+r" (i), "+r" (x), "+r" (h), "=m" (r)
+        :
+        : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5"
+    );
+
+    return r;
+}
+
+static int32_t dot_s16_sse2(const int16_t *x, const int16_t *h, unsigned n) {
+    pa_reg_x86 i = n / 8;
+    int32_t r;
+
+    __asm__ __volatile__ (
+        " pxor %%xmm0, %%xmm0           \n\t"
+
+        "1:                             \n\t"
+        " movdqu (%1), %%xmm1           \n\t"
+        " movdqu (%2), %%xmm2           \n\t"
+        " pmaddwd %%xmm2, %%xmm1        \n\t" /* 4 sums of 2 products */
+        " paddd %%xmm1, %%xmm0          \n\t"
+        " add $16, %1                   \n\t"
+        " add $16, %2                   \n\t"
+        " dec %0                        \n\t"
+        " jnz 1b                        \n\t"
+
+        " pshufd $0x4e, %%xmm0, %%xmm1  \n\t" /* horizontal sum */
+        " paddd %%xmm1, %%xmm0          \n\t"
+        " pshufd $0xb1, %%xmm0, %%xmm1  \n\t"
+        " paddd %%xmm1, %%xmm0          \n\t"
+        " movd %%xmm0, %3               \n\t"
+
+        : "+r" (i), "+r" (x), "+r" (h), "=r" (r)
+        :
+        : "cc", "memory", "xmm0", "xmm1", "xmm2"
+    );
+
+    return r;
+}
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+
+void pa_polyphase_func_init_sse(pa_cpu_x86_flag_t flags) {
+#if !defined(__APPLE__) && defined (__i386__) || defined (__amd64__)
+
+    if (flags & PA_CPU_X86_SSE) {
+        pa_log_info("Initialising SSE optimized polyphase filter.");
+        pa_set_polyphase_dot_float_func(dot_float_sse);
+    }
+
+    if (flags & PA_CPU_X86_SSE2) {
+        pa_log_info("Initialising SSE2 optimized polyphase filter.");
+        pa_set_polyphase_dot_s16_func(dot_s16_sse2);
+    }
+
+#endif /* defined (__i386__) || defined (__amd64__) */
+}
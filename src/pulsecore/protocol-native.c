@@ -29,6 +29,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include <pulse/mainloop.h>
 #include <pulse/rtclock.h>
 #include <pulse/timeval.h>
 #include <pulse/version.h>
@@ -37,6 +38,8 @@
 #include <pulse/xmalloc.h>
 #include <pulse/internal.h>
 
+#include <pulsecore/asyncq.h>
+#include <pulsecore/flist.h>
 #include <pulsecore/native-common.h>
 #include <pulsecore/packet.h>
 #include <pulsecore/client.h>
@@ -57,6 +60,9 @@
 #include <pulsecore/core-util.h>
 #include <pulsecore/ipacl.h>
 #include <pulsecore/thread-mq.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/mutex.h>
+#include <pulsecore/poll.h>
 
 #include "protocol-native.h"
 
@@ -65,7 +71,7 @@
 /* Kick a client if it doesn't authenticate within this time */
 #define AUTH_TIMEOUT (60 * PA_USEC_PER_SEC)
 
-/* Don't accept more connection than this */
+/* Don't accept more connection than this, unless configured otherwise */
 #define MAX_CONNECTIONS 64
 
 #define MAX_MEMBLOCKQ_LENGTH (4*1024*1024) /* 4MB */
@@ -73,8 +79,39 @@
 #define DEFAULT_PROCESS_MSEC 20   /* 20ms */
 #define DEFAULT_FRAGSIZE_MSEC DEFAULT_TLENGTH_MSEC
 
+/* Captured data is handed from the IO thread to the main thread
+ * through a per-stream ring. The main thread is only woken up once this
+ * much data (or a fragment, whichever is smaller) has accumulated. */
+#define RECORD_RING_BATCH_USEC (10*PA_USEC_PER_MSEC) /* 10ms */
+
+/* Data below the batch size is passed on when nothing arrived in the
+ * ring for this long */
+#define RECORD_RING_FLUSH_USEC (20*PA_USEC_PER_MSEC) /* 20ms */
+
+/* Don't put more subscription events than this into one packet */
+#define SUBSCRIPTION_BATCH_MAX 256
+
 struct pa_native_protocol;
 
+/* A thread running its own main loop in which the pstreams of some
+ * connections do their socket I/O. Everything it receives is passed on
+ * to the main loop through outq. The mutex is held by the thread
+ * except while it polls, so the main loop may touch these pstreams
+ * whenever it holds the mutex. */
+typedef struct native_worker {
+    PA_REFCNT_DECLARE;
+
+    pa_mainloop_api *core_mainloop;
+    pa_mainloop *mainloop;
+    pa_mutex *mutex;
+    pa_thread *thread;
+
+    pa_asyncmsgq *outq;
+    pa_io_event *read_event;
+
+    unsigned n_connections;
+} native_worker;
+
 typedef struct record_stream {
     pa_msgobject parent;
 
@@ -96,6 +133,16 @@ typedef struct record_stream {
     pa_usec_t configured_source_latency;
     size_t drop_initial;
 
+    /* Chunks pushed by the IO thread, drained by the main thread */
+    pa_asyncq *ring;
+    pa_atomic_t ring_batch;
+    pa_atomic_t ring_notified;
+    pa_atomic_t ring_bypassed;
+    pa_atomic_t ring_idle;
+    pa_time_event *ring_flush_event;
+    /* Only accessed from IO thread */
+    size_t ring_unnotified;
+
     /* Only updated after SOURCE_OUTPUT_MESSAGE_UPDATE_LATENCY */
     size_t on_the_fly_snapshot;
     pa_usec_t current_monitor_latency;
@@ -105,6 +152,8 @@ typedef struct record_stream {
 #define RECORD_STREAM(o) (record_stream_cast(o))
 PA_DEFINE_PRIVATE_CLASS(record_stream, pa_msgobject);
 
+PA_STATIC_FLIST_DECLARE(record_chunks, 0, pa_xfree);
+
 typedef struct output_stream {
     pa_msgobject parent;
 } output_stream;
@@ -180,7 +229,11 @@ struct pa_native_connection {
     pa_idxset *record_streams, *output_streams;
     uint32_t rrobin_index;
     pa_subscription *subscription;
+    pa_tagstruct *subscription_batch;
+    unsigned n_subscription_batch;
+    pa_defer_event *subscription_defer_event;
     pa_time_event *auth_timeout_event;
+    native_worker *worker;
 };
 
 #define PA_NATIVE_CONNECTION(o) (pa_native_connection_cast(o))
@@ -196,6 +249,9 @@ struct pa_native_protocol {
     pa_hook hooks[PA_NATIVE_HOOK_MAX];
 
     pa_hashmap *extensions;
+
+    native_worker **workers;
+    unsigned n_workers;
 };
 
 enum {
@@ -223,12 +279,32 @@ enum {
 };
 
 enum {
-    RECORD_STREAM_MESSAGE_POST_DATA         /* data from source output to main loop */
+    RECORD_STREAM_MESSAGE_POST_DATA         /* data from source output to main loop, either in the message or in the ring */
 };
 
 enum {
     CONNECTION_MESSAGE_RELEASE,
-    CONNECTION_MESSAGE_REVOKE
+    CONNECTION_MESSAGE_REVOKE,
+    CONNECTION_MESSAGE_PACKET,      /* packet received in a worker thread */
+    CONNECTION_MESSAGE_MEMBLOCK,    /* memory block received in a worker thread */
+    CONNECTION_MESSAGE_DRAIN,
+    CONNECTION_MESSAGE_DIE
+};
+
+struct received_packet {
+    pa_packet *packet;
+    pa_tagstruct *tagstruct; /* NULL if the header didn't parse */
+    uint32_t command, tag;
+#ifdef HAVE_CREDS
+    pa_bool_t with_creds;
+    pa_creds creds;
+#endif
+};
+
+struct received_memblock {
+    uint32_t channel;
+    pa_seek_mode_t seek;
+    size_t length;
 };
 
 static int sink_input_pop_cb(pa_sink_input *i, size_t length, pa_memchunk *chunk);
@@ -241,6 +317,9 @@ static void sink_input_update_max_request_cb(pa_sink_input *i, size_t nbytes);
 static void sink_input_send_event_cb(pa_sink_input *i, const char *event, pa_proplist *pl);
 
 static void native_connection_send_memblock(pa_native_connection *c);
+static void native_connection_unlink(pa_native_connection *c);
+static void native_connection_receive_memblock(pa_native_connection *c, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk);
+static void native_worker_unref(native_worker *w);
 static void playback_stream_request_bytes(struct playback_stream*s);
 
 static void source_output_kill_cb(pa_source_output *o);
@@ -271,6 +350,7 @@ static void command_remove_sample(pa_pdispatch *pd, uint32_t command, uint32_t t
 static void command_get_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_get_server_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
+static void command_get_snapshot(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_subscribe(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_set_volume(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
 static void command_set_mute(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata);
@@ -345,6 +425,8 @@ static const pa_pdispatch_cb_t command_table[PA_COMMAND_MAX] = {
     [PA_COMMAND_SET_SOURCE_MUTE] = command_set_mute,
     [PA_COMMAND_SET_SOURCE_OUTPUT_MUTE] = command_set_mute,
 
+    [PA_COMMAND_GET_SNAPSHOT] = command_get_snapshot,
+
     [PA_COMMAND_SUSPEND_SINK] = command_suspend,
     [PA_COMMAND_SUSPEND_SOURCE] = command_suspend,
 
@@ -474,11 +556,25 @@ static void record_stream_unlink(record_stream *s) {
         s->source_output = NULL;
     }
 
+    if (s->ring_flush_event) {
+        s->connection->protocol->core->mainloop->time_free(s->ring_flush_event);
+        s->ring_flush_event = NULL;
+    }
+
     pa_assert_se(pa_idxset_remove_by_data(s->connection->record_streams, s, NULL) == s);
     s->connection = NULL;
     record_stream_unref(s);
 }
 
+static void record_chunk_free(pa_memchunk *chunk) {
+    pa_assert(chunk);
+
+    pa_memblock_unref(chunk->memblock);
+
+    if (pa_flist_push(PA_STATIC_FLIST_GET(record_chunks), chunk) < 0)
+        pa_xfree(chunk);
+}
+
 /* Called from main context */
 static void record_stream_free(pa_object *o) {
     record_stream *s = RECORD_STREAM(o);
@@ -486,10 +582,102 @@ static void record_stream_free(pa_object *o) {
 
     record_stream_unlink(s);
 
+    if (s->ring)
+        pa_asyncq_free(s->ring, (pa_free_cb_t) record_chunk_free);
+
     pa_memblockq_free(s->memblockq);
     pa_xfree(s);
 }
 
+/* Called from main context */
+static int record_stream_push(record_stream *s, const pa_memchunk *chunk) {
+    pa_assert(s);
+    pa_assert(chunk);
+
+    /* We try to keep up to date with how many bytes are
+     * currently on the fly */
+    pa_atomic_sub(&s->on_the_fly, (int) chunk->length);
+
+    if (pa_memblockq_push_align(s->memblockq, chunk) < 0) {
+/*         pa_log_warn("Failed to push data into output queue."); */
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Called from main context */
+static unsigned record_stream_drain_ring(record_stream *s) {
+    pa_memchunk *chunk;
+    unsigned n = 0;
+
+    pa_assert(s);
+
+    /* Clear the flag before draining, so that anything the IO thread
+     * pushes from now on will trigger a new notification */
+    pa_atomic_store(&s->ring_notified, 0);
+
+    if (!s->ring)
+        return 0;
+
+    while ((chunk = pa_asyncq_pop(s->ring, FALSE))) {
+        record_stream_push(s, chunk);
+        record_chunk_free(chunk);
+        n++;
+    }
+
+    return n;
+}
+
+/* Called from main context */
+static void record_stream_flush_ring(record_stream *s) {
+    pa_assert(s);
+
+    /* The IO thread won't wake us up for data below the batch size, so
+     * pass on whatever is left when the stream stops producing. */
+    record_stream_drain_ring(s);
+
+    if (s->connection && !pa_pstream_is_pending(s->connection->pstream))
+        native_connection_send_memblock(s->connection);
+}
+
+/* Called from main context */
+static void record_stream_arm_ring_flush(record_stream *s) {
+    pa_assert(s);
+
+    if (s->connection && s->ring_flush_event)
+        pa_core_rttime_restart(s->connection->protocol->core, s->ring_flush_event, pa_rtclock_now() + RECORD_RING_FLUSH_USEC);
+}
+
+/* Called from main context */
+static void record_ring_flush_cb(pa_mainloop_api *m, pa_time_event *e, const struct timeval *t, void *userdata) {
+    record_stream *s = RECORD_STREAM(userdata);
+
+    record_stream_assert_ref(s);
+    pa_assert(s->ring_flush_event == e);
+
+    /* Nothing made the IO thread notify us for a while, so the source
+     * stopped producing or produces less than a batch at a time. */
+    if (record_stream_drain_ring(s) > 0) {
+        record_stream_flush_ring(s);
+        record_stream_arm_ring_flush(s);
+        return;
+    }
+
+    /* The ring has run dry. The IO thread notifies us right away for
+     * the next chunk, which arms the timer again. A chunk pushed
+     * before it saw the flag has to be picked up here. */
+    pa_core_rttime_restart(s->connection->protocol->core, e, PA_USEC_INVALID);
+    pa_atomic_store(&s->ring_idle, 1);
+
+    if (record_stream_drain_ring(s) > 0) {
+        record_stream_flush_ring(s);
+
+        if (pa_atomic_cmpxchg(&s->ring_idle, 1, 0))
+            record_stream_arm_ring_flush(s);
+    }
+}
+
 /* Called from main context */
 static int record_stream_process_msg(pa_msgobject *o, int code, void*userdata, int64_t offset, pa_memchunk *chunk) {
     record_stream *s = RECORD_STREAM(o);
@@ -502,13 +690,16 @@ static int record_stream_process_msg(pa_msgobject *o, int code, void*userdata, i
 
         case RECORD_STREAM_MESSAGE_POST_DATA:
 
-            /* We try to keep up to date with how many bytes are
-             * currently on the fly */
-            pa_atomic_sub(&s->on_the_fly, chunk->length);
+            /* Whatever is in the ring was captured before the chunk
+             * that might have been passed along with the message */
+            record_stream_drain_ring(s);
+            record_stream_arm_ring_flush(s);
 
-            if (pa_memblockq_push_align(s->memblockq, chunk) < 0) {
-/*                 pa_log_warn("Failed to push data into output queue."); */
-                return -1;
+            if (chunk) {
+                pa_atomic_dec(&s->ring_bypassed);
+
+                if (record_stream_push(s, chunk) < 0)
+                    return -1;
             }
 
             if (!pa_pstream_is_pending(s->connection->pstream))
@@ -623,6 +814,8 @@ static void fix_record_buffer_attr_post(record_stream *s) {
 
     if (s->buffer_attr.fragsize > s->buffer_attr.maxlength)
         s->buffer_attr.fragsize = s->buffer_attr.maxlength;
+
+    pa_atomic_store(&s->ring_batch, (int) PA_MIN(s->buffer_attr.fragsize, pa_usec_to_bytes(RECORD_RING_BATCH_USEC, &s->source_output->sample_spec)));
 }
 
 /* Called from main context */
@@ -699,6 +892,12 @@ static record_stream* record_stream_new(
     s->adjust_latency = adjust_latency;
     s->early_requests = early_requests;
     pa_atomic_store(&s->on_the_fly, 0);
+    s->ring = pa_asyncq_new(0);
+    pa_atomic_store(&s->ring_notified, 0);
+    pa_atomic_store(&s->ring_bypassed, 0);
+    pa_atomic_store(&s->ring_idle, 1);
+    s->ring_flush_event = pa_core_rttime_new(c->protocol->core, PA_USEC_INVALID, record_ring_flush_cb, s);
+    s->ring_unnotified = 0;
 
     s->source_output->parent.process_msg = source_output_process_msg;
     s->source_output->push = source_output_push_cb;
@@ -1284,6 +1483,45 @@ static int native_connection_process_msg(pa_msgobject *o, int code, void*userdat
         case CONNECTION_MESSAGE_RELEASE:
             pa_pstream_send_release(c->pstream, PA_PTR_TO_UINT(userdata));
             break;
+
+        case CONNECTION_MESSAGE_PACKET: {
+            struct received_packet *r = userdata;
+            const pa_creds *creds = NULL;
+
+#ifdef HAVE_CREDS
+            if (r->with_creds)
+                creds = &r->creds;
+#endif
+
+            if (!r->tagstruct || pa_pdispatch_run_tagstruct(c->pdispatch, r->command, r->tag, r->tagstruct, creds, c) < 0) {
+                pa_log("invalid packet.");
+                native_connection_unlink(c);
+            }
+            break;
+        }
+
+        case CONNECTION_MESSAGE_MEMBLOCK: {
+            struct received_memblock *m = userdata;
+            pa_memchunk hole;
+
+            if (!chunk->memblock) {
+                pa_memchunk_reset(&hole);
+                hole.length = m->length;
+                chunk = &hole;
+            }
+
+            native_connection_receive_memblock(c, m->channel, offset, m->seek, chunk);
+            break;
+        }
+
+        case CONNECTION_MESSAGE_DRAIN:
+            native_connection_send_memblock(c);
+            break;
+
+        case CONNECTION_MESSAGE_DIE:
+            native_connection_unlink(c);
+            pa_log_info("Connection died.");
+            break;
     }
 
     return 0;
@@ -1316,6 +1554,16 @@ static void native_connection_unlink(pa_native_connection *c) {
     if (c->subscription)
         pa_subscription_free(c->subscription);
 
+    if (c->subscription_batch) {
+        pa_tagstruct_free(c->subscription_batch);
+        c->subscription_batch = NULL;
+    }
+
+    if (c->subscription_defer_event) {
+        c->protocol->core->mainloop->defer_free(c->subscription_defer_event);
+        c->subscription_defer_event = NULL;
+    }
+
     if (c->pstream)
         pa_pstream_unlink(c->pstream);
 
@@ -1324,6 +1572,9 @@ static void native_connection_unlink(pa_native_connection *c) {
         c->auth_timeout_event = NULL;
     }
 
+    if (c->worker)
+        c->worker->n_connections--;
+
     pa_assert_se(pa_idxset_remove_by_data(c->protocol->connections, c, NULL) == c);
     c->protocol = NULL;
     pa_native_connection_unref(c);
@@ -1344,9 +1595,87 @@ static void native_connection_free(pa_object *o) {
     pa_pstream_unref(c->pstream);
     pa_client_free(c->client);
 
+    /* The pstream lives in the worker's main loop, so drop the worker
+     * only after the pstream is gone */
+    if (c->worker)
+        native_worker_unref(c->worker);
+
     pa_xfree(c);
 }
 
+/* Called from main context */
+static void native_connection_receive_memblock(pa_native_connection *c, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk) {
+    output_stream *stream;
+
+    pa_native_connection_assert_ref(c);
+    pa_assert(chunk);
+
+    if (!(stream = OUTPUT_STREAM(pa_idxset_get_by_index(c->output_streams, channel)))) {
+        pa_log_debug("Client sent block for invalid stream.");
+        /* Ignoring */
+        return;
+    }
+
+#ifdef PROTOCOL_NATIVE_DEBUG
+    pa_log("got %lu bytes from client", (unsigned long) chunk->length);
+#endif
+
+    if (playback_stream_isinstance(stream)) {
+        playback_stream *ps = PLAYBACK_STREAM(stream);
+
+        pa_atomic_inc(&ps->seek_or_post_in_queue);
+        if (chunk->memblock) {
+            if (seek != PA_SEEK_RELATIVE || offset != 0)
+                pa_asyncmsgq_post(ps->sink_input->sink->asyncmsgq, PA_MSGOBJECT(ps->sink_input), SINK_INPUT_MESSAGE_SEEK, PA_UINT_TO_PTR(seek), offset, chunk, NULL);
+            else
+                pa_asyncmsgq_post(ps->sink_input->sink->asyncmsgq, PA_MSGOBJECT(ps->sink_input), SINK_INPUT_MESSAGE_POST_DATA, NULL, 0, chunk, NULL);
+        } else
+            pa_asyncmsgq_post(ps->sink_input->sink->asyncmsgq, PA_MSGOBJECT(ps->sink_input), SINK_INPUT_MESSAGE_SEEK, PA_UINT_TO_PTR(seek), offset+chunk->length, NULL, NULL);
+
+    } else {
+        upload_stream *u = UPLOAD_STREAM(stream);
+        size_t l;
+
+        if (!u->memchunk.memblock) {
+            if (u->length == chunk->length && chunk->memblock) {
+                u->memchunk = *chunk;
+                pa_memblock_ref(u->memchunk.memblock);
+                u->length = 0;
+            } else {
+                u->memchunk.memblock = pa_memblock_new(c->protocol->core->mempool, u->length);
+                u->memchunk.index = u->memchunk.length = 0;
+            }
+        }
+
+        pa_assert(u->memchunk.memblock);
+
+        l = u->length;
+        if (l > chunk->length)
+            l = chunk->length;
+
+        if (l > 0) {
+            void *dst;
+            dst = pa_memblock_acquire(u->memchunk.memblock);
+
+            if (chunk->memblock) {
+                void *src;
+                src = pa_memblock_acquire(chunk->memblock);
+
+                memcpy((uint8_t*) dst + u->memchunk.index + u->memchunk.length,
+                       (uint8_t*) src + chunk->index, l);
+
+                pa_memblock_release(chunk->memblock);
+            } else
+                pa_silence_memory((uint8_t*) dst + u->memchunk.index + u->memchunk.length, l, &u->sample_spec);
+
+            pa_memblock_release(u->memchunk.memblock);
+
+            u->memchunk.length += l;
+            u->length -= l;
+        }
+    }
+}
+
 /* Called from main context */
 static void native_connection_send_memblock(pa_native_connection *c) {
     uint32_t start;
@@ -1785,13 +2114,50 @@ static int source_output_process_msg(pa_msgobject *_o, int code, void *userdata,
 /* Called from thread context */
 static void source_output_push_cb(pa_source_output *o, const pa_memchunk *chunk) {
     record_stream *s;
+    pa_memchunk *c;
+    pa_bool_t idle;
 
     pa_source_output_assert_ref(o);
     s = RECORD_STREAM(o->userdata);
     record_stream_assert_ref(s);
     pa_assert(chunk);
 
-    pa_atomic_add(&s->on_the_fly, chunk->length);
+    pa_atomic_add(&s->on_the_fly, (int) chunk->length);
+
+    /* As long as chunks that didn't fit into the ring are still
+     * queued as messages we keep using messages to preserve order */
+    if (!s->ring || pa_atomic_load(&s->ring_bypassed) > 0)
+        goto bypass;
+
+    if (!(c = pa_flist_pop(PA_STATIC_FLIST_GET(record_chunks))))
+        c = pa_xnew(pa_memchunk, 1);
+
+    *c = *chunk;
+    pa_memblock_ref(c->memblock);
+
+    if (pa_asyncq_push(s->ring, c, FALSE) < 0) {
+        record_chunk_free(c);
+        goto bypass;
+    }
+
+    /* Wake up the main thread only once enough data accumulated, or
+     * for the first chunk after the ring ran dry, and only if it
+     * hasn't been notified already */
+    s->ring_unnotified += chunk->length;
+
+    idle = pa_atomic_load(&s->ring_idle) && pa_atomic_cmpxchg(&s->ring_idle, 1, 0);
+
+    if ((idle || s->ring_unnotified >= (size_t) pa_atomic_load(&s->ring_batch)) &&
+        pa_atomic_cmpxchg(&s->ring_notified, 0, 1)) {
+        s->ring_unnotified = 0;
+        pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(s), RECORD_STREAM_MESSAGE_POST_DATA, NULL, 0, NULL, NULL);
+    }
+
+    return;
+
+bypass:
+    pa_atomic_inc(&s->ring_bypassed);
+    s->ring_unnotified = 0;
     pa_asyncmsgq_post(pa_thread_mq_get()->outq, PA_MSGOBJECT(s), RECORD_STREAM_MESSAGE_POST_DATA, NULL, 0, chunk, NULL);
 }
 
@@ -1848,6 +2214,9 @@ static void source_output_suspend_cb(pa_source_output *o, pa_bool_t suspend) {
     s = RECORD_STREAM(o->userdata);
     record_stream_assert_ref(s);
 
+    if (suspend)
+        record_stream_flush_ring(s);
+
     if (s->connection->version < 12)
       return;
 
@@ -1871,6 +2240,8 @@ static void source_output_moving_cb(pa_source_output *o, pa_source *dest) {
     if (!dest)
         return;
 
+    record_stream_flush_ring(s);
+
     fix_record_buffer_attr_pre(s);
     pa_memblockq_set_maxlength(s->memblockq, s->buffer_attr.maxlength);
     pa_memblockq_get_attr(s->memblockq, &s->buffer_attr);
@@ -3553,6 +3924,141 @@ static void command_get_info_list(pa_pdispatch *pd, uint32_t command, uint32_t t
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
 
+/* The order of the sections in a snapshot reply */
+static const pa_subscription_event_type_t snapshot_facilities[] = {
+    PA_SUBSCRIPTION_EVENT_MODULE,
+    PA_SUBSCRIPTION_EVENT_CLIENT,
+    PA_SUBSCRIPTION_EVENT_CARD,
+    PA_SUBSCRIPTION_EVENT_SINK,
+    PA_SUBSCRIPTION_EVENT_SOURCE,
+    PA_SUBSCRIPTION_EVENT_SINK_INPUT,
+    PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT,
+    PA_SUBSCRIPTION_EVENT_SAMPLE_CACHE
+};
+
+static void snapshot_put_section(pa_tagstruct *reply, pa_tagstruct *section) {
+    const uint8_t *data;
+    size_t length;
+
+    data = pa_tagstruct_data(section, &length);
+    pa_tagstruct_putu32(reply, (uint32_t) length);
+    pa_tagstruct_put_arbitrary(reply, length > 0 ? data : (const uint8_t*) "", length);
+    pa_tagstruct_free(section);
+}
+
+struct snapshot_removed_data {
+    pa_tagstruct *section;
+    pa_subscription_mask_t mask;
+};
+
+static void snapshot_removed_cb(pa_core *core, pa_subscription_event_type_t facility, uint32_t idx, void *userdata) {
+    struct snapshot_removed_data *d = userdata;
+
+    if (!(d->mask & (1 << facility)))
+        return;
+
+    pa_tagstruct_putu32(d->section, facility);
+    pa_tagstruct_putu32(d->section, idx);
+}
+
+static void command_get_snapshot(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+    pa_core *core;
+    pa_tagstruct *reply, *section;
+    pa_subscription_mask_t m;
+    uint64_t since, generation;
+    pa_bool_t full;
+    unsigned k;
+
+    pa_native_connection_assert_ref(c);
+    pa_assert(t);
+
+    if (pa_tagstruct_getu64(t, &since) < 0 ||
+        pa_tagstruct_getu32(t, &m) < 0 ||
+        !pa_tagstruct_eof(t)) {
+        protocol_error(c);
+        return;
+    }
+
+    CHECK_VALIDITY(c->pstream, c->authorized, tag, PA_ERR_ACCESS);
+    CHECK_VALIDITY(c->pstream, (m & ~PA_SUBSCRIPTION_MASK_ALL) == 0, tag, PA_ERR_INVALID);
+
+    core = c->protocol->core;
+    generation = pa_subscription_get_generation(core);
+
+    /* We can only send a delta if we still know about everything that
+     * was removed since the client's last snapshot */
+    full = since == 0 || since < pa_subscription_get_horizon(core) || since > generation;
+
+    reply = reply_new(tag);
+    pa_tagstruct_putu64(reply, generation);
+    pa_tagstruct_put_boolean(reply, full);
+
+    for (k = 0; k < PA_ELEMENTSOF(snapshot_facilities); k++) {
+        pa_subscription_event_type_t facility = snapshot_facilities[k];
+        pa_idxset *i;
+        uint32_t idx;
+        void *p;
+
+        section = pa_tagstruct_new(NULL, 0);
+
+        if (!(m & (1 << facility))) {
+            snapshot_put_section(reply, section);
+            continue;
+        }
+
+        switch (facility) {
+            case PA_SUBSCRIPTION_EVENT_MODULE: i = core->modules; break;
+            case PA_SUBSCRIPTION_EVENT_CLIENT: i = core->clients; break;
+            case PA_SUBSCRIPTION_EVENT_CARD: i = core->cards; break;
+            case PA_SUBSCRIPTION_EVENT_SINK: i = core->sinks; break;
+            case PA_SUBSCRIPTION_EVENT_SOURCE: i = core->sources; break;
+            case PA_SUBSCRIPTION_EVENT_SINK_INPUT: i = core->sink_inputs; break;
+            case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT: i = core->source_outputs; break;
+            default:
+                pa_assert(facility == PA_SUBSCRIPTION_EVENT_SAMPLE_CACHE);
+                i = core->scache;
+                break;
+        }
+
+        if (i) {
+            PA_IDXSET_FOREACH(p, i, idx) {
+
+                if (!full && pa_subscription_get_object_generation(core, facility, idx) <= since)
+                    continue;
+
+                switch (facility) {
+                    case PA_SUBSCRIPTION_EVENT_MODULE: module_fill_tagstruct(c, section, p); break;
+                    case PA_SUBSCRIPTION_EVENT_CLIENT: client_fill_tagstruct(c, section, p); break;
+                    case PA_SUBSCRIPTION_EVENT_CARD: card_fill_tagstruct(c, section, p); break;
+                    case PA_SUBSCRIPTION_EVENT_SINK: sink_fill_tagstruct(c, section, p); break;
+                    case PA_SUBSCRIPTION_EVENT_SOURCE: source_fill_tagstruct(c, section, p); break;
+                    case PA_SUBSCRIPTION_EVENT_SINK_INPUT: sink_input_fill_tagstruct(c, section, p); break;
+                    case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT: source_output_fill_tagstruct(c, section, p); break;
+                    default: scache_fill_tagstruct(c, section, p); break;
+                }
+            }
+        }
+
+        snapshot_put_section(reply, section);
+    }
+
+    /* Last section: (facility, index) pairs of objects that went away */
+    section = pa_tagstruct_new(NULL, 0);
+
+    if (!full) {
+        struct snapshot_removed_data d;
+
+        d.section = section;
+        d.mask = m;
+        pa_subscription_foreach_removed(core, since, snapshot_removed_cb, &d);
+    }
+
+    snapshot_put_section(reply, section);
+
+    pa_pstream_send_tagstruct(c->pstream, reply);
+}
+
 static void command_get_server_info(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
     pa_tagstruct *reply;
@@ -3599,18 +4105,57 @@ static void command_get_server_info(pa_pdispatch *pd, uint32_t command, uint32_t
     pa_pstream_send_tagstruct(c->pstream, reply);
 }
 
+static void subscription_flush(pa_native_connection *c) {
+    pa_native_connection_assert_ref(c);
+
+    if (c->subscription_defer_event)
+        c->protocol->core->mainloop->defer_enable(c->subscription_defer_event, 0);
+
+    if (!c->subscription_batch)
+        return;
+
+    pa_pstream_send_tagstruct(c->pstream, c->subscription_batch);
+    c->subscription_batch = NULL;
+    c->n_subscription_batch = 0;
+}
+
+static void subscription_defer_cb(pa_mainloop_api *m, pa_defer_event *e, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+
+    pa_native_connection_assert_ref(c);
+    pa_assert(c->subscription_defer_event == e);
+
+    subscription_flush(c);
+}
+
 static void subscription_cb(pa_core *core, pa_subscription_event_type_t e, uint32_t idx, void *userdata) {
-    pa_tagstruct *t;
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
 
     pa_native_connection_assert_ref(c);
 
-    t = pa_tagstruct_new(NULL, 0);
-    pa_tagstruct_putu32(t, PA_COMMAND_SUBSCRIBE_EVENT);
-    pa_tagstruct_putu32(t, (uint32_t) -1);
-    pa_tagstruct_putu32(t, e);
-    pa_tagstruct_putu32(t, idx);
-    pa_pstream_send_tagstruct(c->pstream, t);
+    if (!c->subscription_batch) {
+        c->subscription_batch = pa_tagstruct_new(NULL, 0);
+        pa_tagstruct_putu32(c->subscription_batch, PA_COMMAND_SUBSCRIBE_EVENT);
+        pa_tagstruct_putu32(c->subscription_batch, (uint32_t) -1);
+    }
+
+    pa_tagstruct_putu32(c->subscription_batch, e);
+    pa_tagstruct_putu32(c->subscription_batch, idx);
+    c->n_subscription_batch++;
+
+    /* Older clients expect exactly one event per packet. Newer ones get
+     * all events of one dispatch round in a single packet. The defer
+     * event runs before any further IO is handled, so the events still
+     * arrive in order relative to command replies. */
+    if (c->version < 26 || c->n_subscription_batch >= SUBSCRIPTION_BATCH_MAX) {
+        subscription_flush(c);
+        return;
+    }
+
+    if (!c->subscription_defer_event)
+        c->subscription_defer_event = core->mainloop->defer_new(core->mainloop, subscription_defer_cb, c);
+
+    core->mainloop->defer_enable(c->subscription_defer_event, 1);
 }
 
 static void command_subscribe(pa_pdispatch *pd, uint32_t command, uint32_t tag, pa_tagstruct *t, void *userdata) {
@@ -3919,6 +4464,7 @@ static void command_cork_record_stream(pa_pdispatch *pd, uint32_t command, uint3
     CHECK_VALIDITY(c->pstream, s, tag, PA_ERR_NOENTITY);
 
     pa_source_output_cork(s->source_output, b);
+    record_stream_flush_ring(s);
     pa_memblockq_prebuf_force(s->memblockq);
     pa_pstream_send_simple_ack(c->pstream, tag);
 }
@@ -3941,6 +4487,7 @@ static void command_flush_record_stream(pa_pdispatch *pd, uint32_t command, uint
     s = pa_idxset_get_by_index(c->record_streams, idx);
     CHECK_VALIDITY(c->pstream, s, tag, PA_ERR_NOENTITY);
 
+    record_stream_drain_ring(s);
     pa_memblockq_flush_read(s->memblockq);
     pa_pstream_send_simple_ack(c->pstream, tag);
 }
@@ -4706,130 +5253,302 @@ static void command_set_sink_or_source_port(pa_pdispatch *pd, uint32_t command,
     pa_pstream_send_simple_ack(c->pstream, tag);
 }
 
-/*** pstream callbacks ***/
+/*** worker threads ***/
 
-static void pstream_packet_callback(pa_pstream *p, pa_packet *packet, const pa_creds *creds, void *userdata) {
-    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+PA_STATIC_TLS_DECLARE_NO_FREE(native_worker);
 
-    pa_assert(p);
-    pa_assert(packet);
-    pa_native_connection_assert_ref(c);
+static int worker_poll_func(struct pollfd *ufds, unsigned long nfds, int timeout, void *userdata) {
+    pa_mutex *mutex = userdata;
+    int r;
 
-    if (pa_pdispatch_run(c->pdispatch, packet, creds, c) < 0) {
-        pa_log("invalid packet.");
-        native_connection_unlink(c);
+    pa_assert(mutex);
+
+    /* Let the main loop get at our pstreams while we sleep */
+    pa_mutex_unlock(mutex);
+    r = pa_poll(ufds, nfds, timeout);
+    pa_mutex_lock(mutex);
+
+    return r;
+}
+
+/* Called from worker thread */
+static void worker_thread(void *userdata) {
+    native_worker *w = userdata;
+
+    pa_assert(w);
+
+    PA_STATIC_TLS_SET(native_worker, w);
+
+    pa_mutex_lock(w->mutex);
+    pa_mainloop_run(w->mainloop, NULL);
+    pa_mutex_unlock(w->mutex);
+}
+
+/* Called from main context */
+static void worker_outq_cb(pa_mainloop_api *api, pa_io_event *e, int fd, pa_io_event_flags_t events, void *userdata) {
+    native_worker *w = userdata;
+    pa_asyncmsgq *aq;
+
+    pa_assert(pa_asyncmsgq_read_fd(w->outq) == fd);
+    pa_assert(events == PA_IO_EVENT_INPUT);
+
+    pa_asyncmsgq_ref(aq = w->outq);
+    pa_asyncmsgq_read_after_poll(aq);
+
+    for (;;) {
+        pa_msgobject *object;
+        int code;
+        void *data;
+        int64_t offset;
+        pa_memchunk chunk;
+
+        while (pa_asyncmsgq_get(aq, &object, &code, &data, &offset, &chunk, 0) >= 0) {
+            int ret;
+
+            ret = pa_asyncmsgq_dispatch(object, code, data, offset, &chunk);
+            pa_asyncmsgq_done(aq, ret);
+        }
+
+        if (pa_asyncmsgq_read_before_poll(aq) == 0)
+            break;
     }
+
+    pa_asyncmsgq_unref(aq);
 }
 
-static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
-    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
-    output_stream *stream;
+/* Called from main context */
+static native_worker* native_worker_new(pa_core *core, unsigned idx) {
+    native_worker *w;
+    char name[32];
+
+    pa_assert(core);
+
+    w = pa_xnew0(native_worker, 1);
+    PA_REFCNT_INIT(w);
+    w->core_mainloop = core->mainloop;
+    w->mainloop = pa_mainloop_new();
+    w->mutex = pa_mutex_new(TRUE, FALSE);
+    pa_mainloop_set_poll_func(w->mainloop, worker_poll_func, w->mutex);
+
+    pa_assert_se(w->outq = pa_asyncmsgq_new(0));
+    pa_assert_se(pa_asyncmsgq_read_before_poll(w->outq) == 0);
+    pa_assert_se(w->read_event = core->mainloop->io_new(core->mainloop, pa_asyncmsgq_read_fd(w->outq), PA_IO_EVENT_INPUT, worker_outq_cb, w));
+
+    pa_snprintf(name, sizeof(name), "native-worker-%u", idx);
+    if (!(w->thread = pa_thread_new(name, worker_thread, w))) {
+        pa_log("Failed to create worker thread.");
+        native_worker_unref(w);
+        return NULL;
+    }
 
-    pa_assert(p);
-    pa_assert(chunk);
-    pa_native_connection_assert_ref(c);
+    return w;
+}
 
-    if (!(stream = OUTPUT_STREAM(pa_idxset_get_by_index(c->output_streams, channel)))) {
-        pa_log_debug("Client sent block for invalid stream.");
-        /* Ignoring */
-        return;
+static native_worker* native_worker_ref(native_worker *w) {
+    pa_assert(w);
+    pa_assert(PA_REFCNT_VALUE(w) >= 1);
+
+    PA_REFCNT_INC(w);
+    return w;
+}
+
+/* Called from main context */
+static void native_worker_stop(native_worker *w) {
+    pa_assert(w);
+
+    if (w->thread) {
+        pa_mutex_lock(w->mutex);
+        pa_mainloop_quit(w->mainloop, 0);
+        pa_mutex_unlock(w->mutex);
+
+        pa_thread_free(w->thread);
+        w->thread = NULL;
     }
 
-#ifdef PROTOCOL_NATIVE_DEBUG
-    pa_log("got %lu bytes from client", (unsigned long) chunk->length);
-#endif
+    if (w->read_event) {
+        /* Deliver whatever the thread left behind */
+        if (!pa_asyncmsgq_dispatching(w->outq))
+            pa_asyncmsgq_flush(w->outq, TRUE);
 
-    if (playback_stream_isinstance(stream)) {
-        playback_stream *ps = PLAYBACK_STREAM(stream);
+        w->core_mainloop->io_free(w->read_event);
+        w->read_event = NULL;
+    }
+}
 
-        pa_atomic_inc(&ps->seek_or_post_in_queue);
-        if (chunk->memblock) {
-            if (seek != PA_SEEK_RELATIVE || offset != 0)
-                pa_asyncmsgq_post(ps->sink_input->sink->asyncmsgq, PA_MSGOBJECT(ps->sink_input), SINK_INPUT_MESSAGE_SEEK, PA_UINT_TO_PTR(seek), offset, chunk, NULL);
-            else
-                pa_asyncmsgq_post(ps->sink_input->sink->asyncmsgq, PA_MSGOBJECT(ps->sink_input), SINK_INPUT_MESSAGE_POST_DATA, NULL, 0, chunk, NULL);
-        } else
-            pa_asyncmsgq_post(ps->sink_input->sink->asyncmsgq, PA_MSGOBJECT(ps->sink_input), SINK_INPUT_MESSAGE_SEEK, PA_UINT_TO_PTR(seek), offset+chunk->length, NULL, NULL);
+/* Called from main context */
+static void native_worker_unref(native_worker *w) {
+    pa_assert(w);
+    pa_assert(PA_REFCNT_VALUE(w) >= 1);
 
-    } else {
-        upload_stream *u = UPLOAD_STREAM(stream);
-        size_t l;
+    if (PA_REFCNT_DEC(w) > 0)
+        return;
 
-        if (!u->memchunk.memblock) {
-            if (u->length == chunk->length && chunk->memblock) {
-                u->memchunk = *chunk;
-                pa_memblock_ref(u->memchunk.memblock);
-                u->length = 0;
-            } else {
-                u->memchunk.memblock = pa_memblock_new(c->protocol->core->mempool, u->length);
-                u->memchunk.index = u->memchunk.length = 0;
-            }
+    native_worker_stop(w);
+
+    pa_asyncmsgq_unref(w->outq);
+    pa_mainloop_free(w->mainloop);
+    pa_mutex_free(w->mutex);
+
+    pa_xfree(w);
+}
+
+/* Called from main context. Picks the least busy worker, starting a
+ * new one while there are fewer than max and all are in use. */
+static native_worker* native_protocol_get_worker(pa_native_protocol *p, unsigned max) {
+    native_worker *w = NULL;
+    unsigned i;
+
+    for (i = 0; i < p->n_workers; i++)
+        if (!w || p->workers[i]->n_connections < w->n_connections)
+            w = p->workers[i];
+
+    if (p->n_workers < max && (!w || w->n_connections > 0)) {
+        native_worker *n;
+
+        if ((n = native_worker_new(p->core, p->n_workers))) {
+            p->workers = pa_xrenew(native_worker*, p->workers, p->n_workers + 1);
+            p->workers[p->n_workers++] = w = n;
         }
+    }
 
-        pa_assert(u->memchunk.memblock);
+    if (!w)
+        return NULL;
 
-        l = u->length;
-        if (l > chunk->length)
-            l = chunk->length;
+    w->n_connections++;
+    return native_worker_ref(w);
+}
 
-        if (l > 0) {
-            void *dst;
-            dst = pa_memblock_acquire(u->memchunk.memblock);
+/* Called from any context. Returns the queue through which the main
+ * loop should send something on c's pstream for us, or NULL if this
+ * thread may send directly. */
+static pa_asyncmsgq* native_connection_outq(pa_native_connection *c) {
+    pa_thread_mq *q;
+    native_worker *w;
 
-            if (chunk->memblock) {
-                void *src;
-                src = pa_memblock_acquire(chunk->memblock);
+    if ((q = pa_thread_mq_get()))
+        return q->outq;
 
-                memcpy((uint8_t*) dst + u->memchunk.index + u->memchunk.length,
-                       (uint8_t*) src + chunk->index, l);
+    if ((w = PA_STATIC_TLS_GET(native_worker)) && w != c->worker)
+        return w->outq;
 
-                pa_memblock_release(chunk->memblock);
-            } else
-                pa_silence_memory((uint8_t*) dst + u->memchunk.index + u->memchunk.length, l, &u->sample_spec);
+    return NULL;
+}
 
-            pa_memblock_release(u->memchunk.memblock);
+static void received_packet_free(struct received_packet *r) {
+    pa_assert(r);
 
-            u->memchunk.length += l;
-            u->length -= l;
+    if (r->tagstruct)
+        pa_tagstruct_free(r->tagstruct);
+
+    pa_packet_unref(r->packet);
+    pa_xfree(r);
+}
+
+/*** pstream callbacks ***/
+
+/* Called from main context or, if the connection has a worker, from its thread */
+static void pstream_packet_callback(pa_pstream *p, pa_packet *packet, const pa_creds *creds, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+
+    pa_assert(p);
+    pa_assert(packet);
+    pa_native_connection_assert_ref(c);
+
+    if (c->worker) {
+        struct received_packet *r;
+
+        /* Split off the header here, the handler runs in the main loop */
+        r = pa_xnew0(struct received_packet, 1);
+        r->packet = pa_packet_ref(packet);
+        r->tagstruct = pa_pdispatch_parse(packet, &r->command, &r->tag);
+
+#ifdef HAVE_CREDS
+        if (creds) {
+            r->with_creds = TRUE;
+            r->creds = *creds;
         }
+#endif
+
+        pa_asyncmsgq_post(c->worker->outq, PA_MSGOBJECT(c), CONNECTION_MESSAGE_PACKET, r, 0, NULL, (pa_free_cb_t) received_packet_free);
+        return;
     }
+
+    if (pa_pdispatch_run(c->pdispatch, packet, creds, c) < 0) {
+        pa_log("invalid packet.");
+        native_connection_unlink(c);
+    }
+}
+
+/* Called from main context or, if the connection has a worker, from its thread */
+static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t offset, pa_seek_mode_t seek, const pa_memchunk *chunk, void *userdata) {
+    pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
+
+    pa_assert(p);
+    pa_assert(chunk);
+    pa_native_connection_assert_ref(c);
+
+    if (c->worker) {
+        struct received_memblock *m;
+
+        m = pa_xnew(struct received_memblock, 1);
+        m->channel = channel;
+        m->seek = seek;
+        m->length = chunk->length;
+
+        pa_asyncmsgq_post(c->worker->outq, PA_MSGOBJECT(c), CONNECTION_MESSAGE_MEMBLOCK, m, offset, chunk->memblock ? chunk : NULL, pa_xfree);
+        return;
+    }
+
+    native_connection_receive_memblock(c, channel, offset, seek, chunk);
 }
 
+/* Called from main context or, if the connection has a worker, from its thread */
 static void pstream_die_callback(pa_pstream *p, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
 
     pa_assert(p);
     pa_native_connection_assert_ref(c);
 
+    if (c->worker) {
+        pa_asyncmsgq_post(c->worker->outq, PA_MSGOBJECT(c), CONNECTION_MESSAGE_DIE, NULL, 0, NULL, NULL);
+        return;
+    }
+
     native_connection_unlink(c);
     pa_log_info("Connection died.");
 }
 
+/* Called from main context or, if the connection has a worker, from its thread */
 static void pstream_drain_callback(pa_pstream *p, void *userdata) {
     pa_native_connection *c = PA_NATIVE_CONNECTION(userdata);
 
     pa_assert(p);
     pa_native_connection_assert_ref(c);
 
+    if (c->worker) {
+        pa_asyncmsgq_post(c->worker->outq, PA_MSGOBJECT(c), CONNECTION_MESSAGE_DRAIN, NULL, 0, NULL, NULL);
+        return;
+    }
+
     native_connection_send_memblock(c);
 }
 
 static void pstream_revoke_callback(pa_pstream *p, uint32_t block_id, void *userdata) {
-    pa_thread_mq *q;
+    pa_asyncmsgq *q;
 
-    if (!(q = pa_thread_mq_get()))
+    if (!(q = native_connection_outq(PA_NATIVE_CONNECTION(userdata))))
         pa_pstream_send_revoke(p, block_id);
     else
-        pa_asyncmsgq_post(q->outq, PA_MSGOBJECT(userdata), CONNECTION_MESSAGE_REVOKE, PA_UINT_TO_PTR(block_id), 0, NULL, NULL);
+        pa_asyncmsgq_post(q, PA_MSGOBJECT(userdata), CONNECTION_MESSAGE_REVOKE, PA_UINT_TO_PTR(block_id), 0, NULL, NULL);
 }
 
 static void pstream_release_callback(pa_pstream *p, uint32_t block_id, void *userdata) {
-    pa_thread_mq *q;
+    pa_asyncmsgq *q;
 
-    if (!(q = pa_thread_mq_get()))
+    if (!(q = native_connection_outq(PA_NATIVE_CONNECTION(userdata))))
         pa_pstream_send_release(p, block_id);
     else
-        pa_asyncmsgq_post(q->outq, PA_MSGOBJECT(userdata), CONNECTION_MESSAGE_RELEASE, PA_UINT_TO_PTR(block_id), 0, NULL, NULL);
+        pa_asyncmsgq_post(q, PA_MSGOBJECT(userdata), CONNECTION_MESSAGE_RELEASE, PA_UINT_TO_PTR(block_id), 0, NULL, NULL);
 }
 
 /*** client callbacks ***/
@@ -4885,8 +5604,8 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
     pa_assert(io);
     pa_assert(o);
 
-    if (pa_idxset_size(p->connections)+1 > MAX_CONNECTIONS) {
-        pa_log_warn("Warning! Too many connections (%u), dropping incoming connection.", MAX_CONNECTIONS);
+    if (pa_idxset_size(p->connections)+1 > o->max_connections) {
+        pa_log_warn("Warning! Too many connections (%u), dropping incoming connection.", o->max_connections);
         pa_iochannel_free(io);
         return;
     }
@@ -4936,7 +5655,26 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
     c->client->send_event = client_send_event_cb;
     c->client->userdata = c;
 
-    c->pstream = pa_pstream_new(p->core->mainloop, io, p->core->mempool);
+    if (o->workers > 0 && (c->worker = native_protocol_get_worker(p, o->workers))) {
+        int ifd, ofd;
+
+        /* Move the socket over to the worker's main loop */
+        ifd = pa_iochannel_get_recv_fd(io);
+        ofd = pa_iochannel_get_send_fd(io);
+        pa_iochannel_set_noclose(io, TRUE);
+        pa_iochannel_free(io);
+
+        /* Keep the worker from dispatching until the pstream is set up */
+        pa_mutex_lock(c->worker->mutex);
+
+        io = pa_iochannel_new(pa_mainloop_get_api(c->worker->mainloop), ifd, ofd);
+        c->pstream = pa_pstream_new(pa_mainloop_get_api(c->worker->mainloop), io, p->core->mempool);
+        pa_pstream_set_mutex(c->pstream, c->worker->mutex);
+    } else {
+        c->worker = NULL;
+        c->pstream = pa_pstream_new(p->core->mainloop, io, p->core->mempool);
+    }
+
     pa_pstream_set_receive_packet_callback(c->pstream, pstream_packet_callback, c);
     pa_pstream_set_receive_memblock_callback(c->pstream, pstream_memblock_callback, c);
     pa_pstream_set_die_callback(c->pstream, pstream_die_callback, c);
@@ -4944,6 +5682,14 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
     pa_pstream_set_revoke_callback(c->pstream, pstream_revoke_callback, c);
     pa_pstream_set_release_callback(c->pstream, pstream_release_callback, c);
 
+#ifdef HAVE_CREDS
+    if (pa_iochannel_creds_supported(io))
+        pa_iochannel_creds_enable(io);
+#endif
+
+    if (c->worker)
+        pa_mutex_unlock(c->worker->mutex);
+
     c->pdispatch = pa_pdispatch_new(p->core->mainloop, TRUE, command_table, PA_COMMAND_MAX);
 
     c->record_streams = pa_idxset_new(NULL, NULL);
@@ -4951,14 +5697,12 @@ void pa_native_protocol_connect(pa_native_protocol *p, pa_iochannel *io, pa_nati
 
     c->rrobin_index = PA_IDXSET_INVALID;
     c->subscription = NULL;
+    c->subscription_batch = NULL;
+    c->n_subscription_batch = 0;
+    c->subscription_defer_event = NULL;
 
     pa_idxset_put(p->connections, c, NULL);
 
-#ifdef HAVE_CREDS
-    if (pa_iochannel_creds_supported(io))
-        pa_iochannel_creds_enable(io);
-#endif
-
     pa_hook_fire(&p->hooks[PA_NATIVE_HOOK_CONNECTION_PUT], c);
 }
 
@@ -4987,6 +5731,9 @@ static pa_native_protocol* native_protocol_new(pa_core *c) {
 
     p->servers = NULL;
 
+    p->workers = NULL;
+    p->n_workers = 0;
+
     p->extensions = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
 
     for (h = 0; h < PA_NATIVE_HOOK_MAX; h++)
@@ -5018,6 +5765,7 @@ pa_native_protocol* pa_native_protocol_ref(pa_native_protocol *p) {
 void pa_native_protocol_unref(pa_native_protocol *p) {
     pa_native_connection *c;
     pa_native_hook_t h;
+    unsigned i;
 
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) >= 1);
@@ -5030,6 +5778,12 @@ void pa_native_protocol_unref(pa_native_protocol *p) {
 
     pa_idxset_free(p->connections, NULL, NULL);
 
+    for (i = 0; i < p->n_workers; i++) {
+        native_worker_stop(p->workers[i]);
+        native_worker_unref(p->workers[i]);
+    }
+    pa_xfree(p->workers);
+
     pa_strlist_free(p->servers);
 
     for (h = 0; h < PA_NATIVE_HOOK_MAX; h++)
@@ -5101,6 +5855,8 @@ pa_native_options* pa_native_options_new(void) {
     o = pa_xnew0(pa_native_options, 1);
     PA_REFCNT_INIT(o);
 
+    o->max_connections = MAX_CONNECTIONS;
+
     return o;
 }
 
@@ -5144,6 +5900,16 @@ int pa_native_options_parse(pa_native_options *o, pa_core *c, pa_modargs *ma) {
         return -1;
     }
 
+    if (pa_modargs_get_value_u32(ma, "max-connections", &o->max_connections) < 0 || o->max_connections <= 0) {
+        pa_log("max-connections= expects a positive integer argument.");
+        return -1;
+    }
+
+    if (pa_modargs_get_value_u32(ma, "workers", &o->workers) < 0) {
+        pa_log("workers= expects a non-negative integer argument.");
+        return -1;
+    }
+
     enabled = TRUE;
     if (pa_modargs_get_value_boolean(ma, "auth-group-enable", &enabled) < 0) {
         pa_log("auth-group-enable= expects a boolean argument.");
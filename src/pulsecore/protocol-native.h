@@ -47,6 +47,12 @@ typedef struct pa_native_options {
     char *auth_group;
     pa_ip_acl *auth_ip_acl;
     pa_auth_cookie *auth_cookie;
+
+    uint32_t max_connections;
+
+    /* If non-zero, socket I/O and packet parsing of connections is
+     * spread over up to this many worker threads */
+    uint32_t workers;
 } pa_native_options;
 
 typedef enum pa_native_hook {
@@ -41,6 +41,7 @@
 #include <pulsecore/refcnt.h>
 #include <pulsecore/flist.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/mutex.h>
 
 #include "pstream.h"
 
@@ -113,6 +114,10 @@ struct pa_pstream {
     pa_defer_event *defer_event;
     pa_iochannel *io;
 
+    /* Held by the thread running the mainloop while it dispatches, if
+     * that is not the thread using the pstream */
+    pa_mutex *mutex;
+
     pa_queue *send_queue;
 
     pa_bool_t dead;
@@ -168,6 +173,16 @@ struct pa_pstream {
 static int do_write(pa_pstream *p);
 static int do_read(pa_pstream *p);
 
+static void pstream_lock(pa_pstream *p) {
+    if (p->mutex)
+        pa_mutex_lock(p->mutex);
+}
+
+static void pstream_unlock(pa_pstream *p) {
+    if (p->mutex)
+        pa_mutex_unlock(p->mutex);
+}
+
 static void do_something(pa_pstream *p) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
@@ -236,6 +251,7 @@ pa_pstream *pa_pstream_new(pa_mainloop_api *m, pa_iochannel *io, pa_mempool *poo
     p->dead = FALSE;
 
     p->mainloop = m;
+    p->mutex = NULL;
     p->defer_event = m->defer_new(m, defer_callback, p);
     m->defer_enable(p->defer_event, 0);
 
@@ -298,6 +314,8 @@ static void item_free(void *item) {
 static void pstream_free(pa_pstream *p) {
     pa_assert(p);
 
+    pstream_lock(p);
+
     pa_pstream_unlink(p);
 
     pa_queue_free(p->send_queue, item_free);
@@ -314,6 +332,8 @@ static void pstream_free(pa_pstream *p) {
     if (p->read.packet)
         pa_packet_unref(p->read.packet);
 
+    pstream_unlock(p);
+
     pa_xfree(p);
 }
 
@@ -324,8 +344,12 @@ void pa_pstream_send_packet(pa_pstream*p, pa_packet *packet, const pa_creds *cre
     pa_assert(PA_REFCNT_VALUE(p) > 0);
     pa_assert(packet);
 
-    if (p->dead)
+    pstream_lock(p);
+
+    if (p->dead) {
+        pstream_unlock(p);
         return;
+    }
 
     if (!(i = pa_flist_pop(PA_STATIC_FLIST_GET(items))))
         i = pa_xnew(struct item_info, 1);
@@ -341,6 +365,8 @@ void pa_pstream_send_packet(pa_pstream*p, pa_packet *packet, const pa_creds *cre
     pa_queue_push(p->send_queue, i);
 
     p->mainloop->defer_enable(p->defer_event, 1);
+
+    pstream_unlock(p);
 }
 
 void pa_pstream_send_memblock(pa_pstream*p, uint32_t channel, int64_t offset, pa_seek_mode_t seek_mode, const pa_memchunk *chunk) {
@@ -352,8 +378,12 @@ void pa_pstream_send_memblock(pa_pstream*p, uint32_t channel, int64_t offset, pa
     pa_assert(channel != (uint32_t) -1);
     pa_assert(chunk);
 
-    if (p->dead)
+    pstream_lock(p);
+
+    if (p->dead) {
+        pstream_unlock(p);
         return;
+    }
 
     idx = 0;
     length = chunk->length;
@@ -387,6 +417,8 @@ void pa_pstream_send_memblock(pa_pstream*p, uint32_t channel, int64_t offset, pa
     }
 
     p->mainloop->defer_enable(p->defer_event, 1);
+
+    pstream_unlock(p);
 }
 
 void pa_pstream_send_release(pa_pstream *p, uint32_t block_id) {
@@ -394,8 +426,12 @@ void pa_pstream_send_release(pa_pstream *p, uint32_t block_id) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
-    if (p->dead)
+    pstream_lock(p);
+
+    if (p->dead) {
+        pstream_unlock(p);
         return;
+    }
 
 /*     pa_log("Releasing block %u", block_id); */
 
@@ -409,6 +445,8 @@ void pa_pstream_send_release(pa_pstream *p, uint32_t block_id) {
 
     pa_queue_push(p->send_queue, item);
     p->mainloop->defer_enable(p->defer_event, 1);
+
+    pstream_unlock(p);
 }
 
 /* might be called from thread context */
@@ -432,8 +470,13 @@ void pa_pstream_send_revoke(pa_pstream *p, uint32_t block_id) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
-    if (p->dead)
+    pstream_lock(p);
+
+    if (p->dead) {
+        pstream_unlock(p);
         return;
+    }
+
 /*     pa_log("Revoking block %u", block_id); */
 
     if (!(item = pa_flist_pop(PA_STATIC_FLIST_GET(items))))
@@ -446,6 +489,8 @@ void pa_pstream_send_revoke(pa_pstream *p, uint32_t block_id) {
 
     pa_queue_push(p->send_queue, item);
     p->mainloop->defer_enable(p->defer_event, 1);
+
+    pstream_unlock(p);
 }
 
 /* might be called from thread context */
@@ -886,48 +931,72 @@ void pa_pstream_set_die_callback(pa_pstream *p, pa_pstream_notify_cb_t cb, void
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
+    pstream_lock(p);
+
     p->die_callback = cb;
     p->die_callback_userdata = userdata;
+
+    pstream_unlock(p);
 }
 
 void pa_pstream_set_drain_callback(pa_pstream *p, pa_pstream_notify_cb_t cb, void *userdata) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
+    pstream_lock(p);
+
     p->drain_callback = cb;
     p->drain_callback_userdata = userdata;
+
+    pstream_unlock(p);
 }
 
 void pa_pstream_set_receive_packet_callback(pa_pstream *p, pa_pstream_packet_cb_t cb, void *userdata) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
+    pstream_lock(p);
+
     p->receive_packet_callback = cb;
     p->receive_packet_callback_userdata = userdata;
+
+    pstream_unlock(p);
 }
 
 void pa_pstream_set_receive_memblock_callback(pa_pstream *p, pa_pstream_memblock_cb_t cb, void *userdata) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
+    pstream_lock(p);
+
     p->receive_memblock_callback = cb;
     p->receive_memblock_callback_userdata = userdata;
+
+    pstream_unlock(p);
 }
 
 void pa_pstream_set_release_callback(pa_pstream *p, pa_pstream_block_id_cb_t cb, void *userdata) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
+    pstream_lock(p);
+
     p->release_callback = cb;
     p->release_callback_userdata = userdata;
+
+    pstream_unlock(p);
 }
 
 void pa_pstream_set_revoke_callback(pa_pstream *p, pa_pstream_block_id_cb_t cb, void *userdata) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
+    pstream_lock(p);
+
     p->release_callback = cb;
     p->release_callback_userdata = userdata;
+
+    pstream_unlock(p);
 }
 
 pa_bool_t pa_pstream_is_pending(pa_pstream *p) {
@@ -936,11 +1005,15 @@ pa_bool_t pa_pstream_is_pending(pa_pstream *p) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
+    pstream_lock(p);
+
     if (p->dead)
         b = FALSE;
     else
         b = p->write.current || !pa_queue_isempty(p->send_queue);
 
+    pstream_unlock(p);
+
     return b;
 }
 
@@ -963,8 +1036,12 @@ pa_pstream* pa_pstream_ref(pa_pstream*p) {
 void pa_pstream_unlink(pa_pstream *p) {
     pa_assert(p);
 
-    if (p->dead)
+    pstream_lock(p);
+
+    if (p->dead) {
+        pstream_unlock(p);
         return;
+    }
 
     p->dead = TRUE;
 
@@ -992,12 +1069,16 @@ void pa_pstream_unlink(pa_pstream *p) {
     p->drain_callback = NULL;
     p->receive_packet_callback = NULL;
     p->receive_memblock_callback = NULL;
+
+    pstream_unlock(p);
 }
 
 void pa_pstream_enable_shm(pa_pstream *p, pa_bool_t enable) {
     pa_assert(p);
     pa_assert(PA_REFCNT_VALUE(p) > 0);
 
+    pstream_lock(p);
+
     p->use_shm = enable;
 
     if (enable) {
@@ -1012,6 +1093,8 @@ void pa_pstream_enable_shm(pa_pstream *p, pa_bool_t enable) {
             p->export = NULL;
         }
     }
+
+    pstream_unlock(p);
 }
 
 pa_bool_t pa_pstream_get_shm(pa_pstream *p) {
@@ -1020,3 +1103,10 @@ pa_bool_t pa_pstream_get_shm(pa_pstream *p) {
 
     return p->use_shm;
 }
+
+void pa_pstream_set_mutex(pa_pstream *p, pa_mutex *mutex) {
+    pa_assert(p);
+    pa_assert(PA_REFCNT_VALUE(p) > 0);
+
+    p->mutex = mutex;
+}
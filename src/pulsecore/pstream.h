@@ -34,6 +34,7 @@
 #include <pulsecore/memchunk.h>
 #include <pulsecore/creds.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/mutex.h>
 
 typedef struct pa_pstream pa_pstream;
 
@@ -66,4 +67,10 @@ pa_bool_t pa_pstream_is_pending(pa_pstream *p);
 void pa_pstream_enable_shm(pa_pstream *p, pa_bool_t enable);
 pa_bool_t pa_pstream_get_shm(pa_pstream *p);
 
+/* For a pstream whose mainloop runs in another thread, holding this
+ * (recursive) mutex while it dispatches. All functions above then take
+ * it, so the pstream may be used from any thread. Set it right after
+ * pa_pstream_new(), with the mutex held. */
+void pa_pstream_set_mutex(pa_pstream *p, pa_mutex *mutex);
+
 #endif
@@ -85,6 +85,99 @@ static void remap_mono_to_stereo_c(pa_remap_t *m, void *dst, const void *src, un
     }
 }
 
+static void remap_stereo_to_mono_c(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+    unsigned i;
+
+    switch (*m->format) {
+        case PA_SAMPLE_FLOAT32NE:
+        {
+            float *d;
+            const float *s;
+            float l, r;
+
+            d = (float *) dst;
+            s = (const float *) src;
+            l = m->map_table_f[0][0];
+            r = m->map_table_f[0][1];
+
+            for (i = n; i; i--, s += 2, d++)
+                *d = s[0] * l + s[1] * r;
+            break;
+        }
+        case PA_SAMPLE_S16NE:
+        {
+            int16_t *d;
+            const int16_t *s;
+            int32_t l, r;
+
+            d = (int16_t *) dst;
+            s = (const int16_t *) src;
+            l = m->map_table_i[0][0];
+            r = m->map_table_i[0][1];
+
+            for (i = n; i; i--, s += 2, d++)
+                *d = (int16_t) ((((int32_t) s[0] * l) >> 16) + (((int32_t) s[1] * r) >> 16));
+            break;
+        }
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+/* 5.1 -> stereo, the whole matrix fits in registers */
+static void remap_51_to_stereo_c(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+    unsigned i, ic;
+
+    switch (*m->format) {
+        case PA_SAMPLE_FLOAT32NE:
+        {
+            float *d;
+            const float *s;
+            float l[6], r[6];
+
+            for (ic = 0; ic < 6; ic++) {
+                l[ic] = m->map_table_f[0][ic];
+                r[ic] = m->map_table_f[1][ic];
+            }
+
+            d = (float *) dst;
+            s = (const float *) src;
+
+            for (i = n; i; i--, s += 6, d += 2) {
+                d[0] = s[0] * l[0] + s[1] * l[1] + s[2] * l[2] + s[3] * l[3] + s[4] * l[4] + s[5] * l[5];
+                d[1] = s[0] * r[0] + s[1] * r[1] + s[2] * r[2] + s[3] * r[3] + s[4] * r[4] + s[5] * r[5];
+            }
+            break;
+        }
+        case PA_SAMPLE_S16NE:
+        {
+            int16_t *d;
+            const int16_t *s;
+            int32_t l[6], r[6];
+
+            for (ic = 0; ic < 6; ic++) {
+                l[ic] = m->map_table_i[0][ic];
+                r[ic] = m->map_table_i[1][ic];
+            }
+
+            d = (int16_t *) dst;
+            s = (const int16_t *) src;
+
+            for (i = n; i; i--, s += 6, d += 2) {
+                int32_t s0 = s[0], s1 = s[1], s2 = s[2], s3 = s[3], s4 = s[4], s5 = s[5];
+
+                d[0] = (int16_t) (((s0 * l[0]) >> 16) + ((s1 * l[1]) >> 16) + ((s2 * l[2]) >> 16) +
+                                  ((s3 * l[3]) >> 16) + ((s4 * l[4]) >> 16) + ((s5 * l[5]) >> 16));
+                d[1] = (int16_t) (((s0 * r[0]) >> 16) + ((s1 * r[1]) >> 16) + ((s2 * r[2]) >> 16) +
+                                  ((s3 * r[3]) >> 16) + ((s4 * r[4]) >> 16) + ((s5 * r[5]) >> 16));
+            }
+            break;
+        }
+        default:
+            pa_assert_not_reached();
+    }
+}
+
 static void remap_channels_matrix_c(pa_remap_t *m, void *dst, const void *src, unsigned n) {
     unsigned oc, ic, i;
     unsigned n_ic, n_oc;
@@ -171,12 +264,31 @@ static void init_remap_c(pa_remap_t *m) {
             m->map_table_f[0][0] >= 1.0 && m->map_table_f[1][0] >= 1.0) {
         m->do_remap = (pa_do_remap_func_t) remap_mono_to_stereo_c;
         pa_log_info("Using mono to stereo remapping");
+    } else if (n_ic == 2 && n_oc == 1) {
+        m->do_remap = (pa_do_remap_func_t) remap_stereo_to_mono_c;
+        pa_log_info("Using stereo to mono remapping");
+    } else if (n_ic == 6 && n_oc == 2) {
+        m->do_remap = (pa_do_remap_func_t) remap_51_to_stereo_c;
+        pa_log_info("Using 5.1 to stereo remapping");
     } else {
         m->do_remap = (pa_do_remap_func_t) remap_channels_matrix_c;
         pa_log_info("Using generic matrix remapping");
     }
 }
 
+/* Entries at or below 0 contribute nothing and entries at or above 1
+ * pass the input through unscaled. Clamp the tables once so that none
+ * of the implementations needs to check for that per sample. */
+static void clamp_map_tables(pa_remap_t *m) {
+    unsigned oc, ic;
+
+    for (oc = 0; oc < m->o_ss->channels; oc++)
+        for (ic = 0; ic < m->i_ss->channels; ic++) {
+            m->map_table_f[oc][ic] = PA_CLAMP(m->map_table_f[oc][ic], 0.0f, 1.0f);
+            m->map_table_i[oc][ic] = PA_CLAMP(m->map_table_i[oc][ic], 0, 0x10000);
+        }
+}
+
 
 /* default C implementation */
 static pa_init_remap_func_t remap_func = init_remap_c;
@@ -186,6 +298,8 @@ void pa_init_remap(pa_remap_t *m) {
 
     m->do_remap = NULL;
 
+    clamp_map_tables(m);
+
     /* call the installed remap init function */
     remap_func(m);
 
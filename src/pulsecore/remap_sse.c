@@ -24,6 +24,8 @@
 #include <config.h>
 #endif
 
+#include <string.h>
+
 #include <pulse/sample.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
@@ -129,6 +131,394 @@ static void remap_mono_to_stereo_sse2(pa_remap_t *m, void *dst, const void *src,
     }
 }
 
+/* The s16 tables hold 16:16 factors in [0, 0x10000]. pmulhw only takes
+ * signed 16 bit factors, so the ones from 0x8000 up are split into the
+ * factor minus 0x10000 and a mask that adds the sample once more. The
+ * result matches (s * f) >> 16 exactly. */
+static void s16_factor(int32_t f, int16_t *mul, int16_t *mask) {
+    *mul = (int16_t) (f >= 0x8000 ? f - 0x10000 : f);
+    *mask = f >= 0x8000 ? -1 : 0;
+}
+
+static void remap_stereo_to_mono_sse2(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+    pa_reg_x86 temp;
+    unsigned i;
+
+    switch (*m->format) {
+        case PA_SAMPLE_FLOAT32NE:
+        {
+            PA_DECLARE_ALIGNED(16, float, coef[8]);
+            const float *s;
+            float *d;
+
+            for (i = 0; i < 4; i++) {
+                coef[i] = m->map_table_f[0][0];
+                coef[4 + i] = m->map_table_f[0][1];
+            }
+
+            d = (float *) dst;
+            s = (const float *) src;
+
+            if (n >> 2) {
+                __asm__ __volatile__ (
+                    " movaps (%3), %%xmm6           \n\t"
+                    " movaps 16(%3), %%xmm7         \n\t"
+                    "1:                             \n\t"
+                    " movups (%1), %%xmm0           \n\t" /* | r1 | l1 | r0 | l0 | */
+                    " movups 16(%1), %%xmm1         \n\t" /* | r3 | l3 | r2 | l2 | */
+                    " movaps %%xmm0, %%xmm2         \n\t"
+                    " shufps $0x88, %%xmm1, %%xmm0  \n\t" /* | l3 | l2 | l1 | l0 | */
+                    " shufps $0xdd, %%xmm1, %%xmm2  \n\t" /* | r3 | r2 | r1 | r0 | */
+                    " mulps %%xmm6, %%xmm0          \n\t"
+                    " mulps %%xmm7, %%xmm2          \n\t"
+                    " addps %%xmm2, %%xmm0          \n\t"
+                    " movups %%xmm0, (%0)           \n\t"
+                    " add $32, %1                   \n\t"
+                    " add $16, %0                   \n\t"
+                    " dec %2                        \n\t"
+                    " jne 1b                        \n\t"
+                    : "+r" (d), "+r" (s), "=&r" (temp)
+                    : "r" (coef), "2" ((pa_reg_x86) (n >> 2))
+                    : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm6", "xmm7"
+                );
+            }
+
+            for (i = n & 3; i; i--, s += 2, d++)
+                *d = s[0] * coef[0] + s[1] * coef[4];
+            break;
+        }
+        case PA_SAMPLE_S16NE:
+        {
+            PA_DECLARE_ALIGNED(16, int16_t, coef[32]);
+            const int16_t *s;
+            int16_t *d;
+
+            for (i = 0; i < 8; i++) {
+                s16_factor(m->map_table_i[0][0], &coef[i], &coef[8 + i]);
+                s16_factor(m->map_table_i[0][1], &coef[16 + i], &coef[24 + i]);
+            }
+
+            d = (int16_t *) dst;
+            s = (const int16_t *) src;
+
+            if (n >> 3) {
+                __asm__ __volatile__ (
+                    " movdqa (%3), %%xmm4           \n\t"
+                    " movdqa 16(%3), %%xmm5         \n\t"
+                    " movdqa 32(%3), %%xmm6         \n\t"
+                    " movdqa 48(%3), %%xmm7         \n\t"
+                    "1:                             \n\t"
+                    " movdqu (%1), %%xmm0           \n\t" /* | r3 | l3 | .. | r0 | l0 | */
+                    " movdqu 16(%1), %%xmm1         \n\t" /* | r7 | l7 | .. | r4 | l4 | */
+                    " movdqa %%xmm0, %%xmm2         \n\t"
+                    " movdqa %%xmm1, %%xmm3         \n\t"
+                    " pslld $16, %%xmm0             \n\t"
+                    " pslld $16, %%xmm1             \n\t"
+                    " psrad $16, %%xmm0             \n\t" /* |   l3    | .. |   l0    | */
+                    " psrad $16, %%xmm1             \n\t"
+                    " psrad $16, %%xmm2             \n\t" /* |   r3    | .. |   r0    | */
+                    " psrad $16, %%xmm3             \n\t"
+                    " packssdw %%xmm1, %%xmm0       \n\t" /* | l7 | .. | l0 | */
+                    " packssdw %%xmm3, %%xmm2       \n\t" /* | r7 | .. | r0 | */
+                    " movdqa %%xmm0, %%xmm1         \n\t"
+                    " movdqa %%xmm2, %%xmm3         \n\t"
+                    " pmulhw %%xmm4, %%xmm0         \n\t"
+                    " pand %%xmm5, %%xmm1           \n\t"
+                    " pmulhw %%xmm6, %%xmm2         \n\t"
+                    " pand %%xmm7, %%xmm3           \n\t"
+                    " paddw %%xmm1, %%xmm0          \n\t"
+                    " paddw %%xmm3, %%xmm2          \n\t"
+                    " paddw %%xmm2, %%xmm0          \n\t"
+                    " movdqu %%xmm0, (%0)           \n\t"
+                    " add $32, %1                   \n\t"
+                    " add $16, %0                   \n\t"
+                    " dec %2                        \n\t"
+                    " jne 1b                        \n\t"
+                    : "+r" (d), "+r" (s), "=&r" (temp)
+                    : "r" (coef), "2" ((pa_reg_x86) (n >> 3))
+                    : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"
+                );
+            }
+
+            for (i = n & 7; i; i--, s += 2, d++)
+                *d = (int16_t) ((((int32_t) s[0] * m->map_table_i[0][0]) >> 16) +
+                                (((int32_t) s[1] * m->map_table_i[0][1]) >> 16));
+            break;
+        }
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+static void remap_51_to_stereo_sse2(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+    pa_reg_x86 temp;
+    unsigned i, ic;
+
+    switch (*m->format) {
+        case PA_SAMPLE_FLOAT32NE:
+        {
+            PA_DECLARE_ALIGNED(16, float, coef[24]);
+            const float *s;
+            float *d;
+
+            /* Two frames at a time, each input channel of both frames
+             * spread over | r | l | r | l | */
+            for (ic = 0; ic < 6; ic++) {
+                coef[4 * ic] = coef[4 * ic + 2] = m->map_table_f[0][ic];
+                coef[4 * ic + 1] = coef[4 * ic + 3] = m->map_table_f[1][ic];
+            }
+
+            d = (float *) dst;
+            s = (const float *) src;
+
+            if (n >> 1) {
+                __asm__ __volatile__ (
+                    "1:                             \n\t"
+                    " movups (%1), %%xmm0           \n\t" /* | a3 | a2 | a1 | a0 | */
+                    " movups 16(%1), %%xmm1         \n\t" /* | b1 | b0 | a5 | a4 | */
+                    " movups 32(%1), %%xmm2         \n\t" /* | b5 | b4 | b3 | b2 | */
+                    " movaps %%xmm0, %%xmm3         \n\t"
+                    " shufps $0xa0, %%xmm1, %%xmm3  \n\t" /* | b0 | b0 | a0 | a0 | */
+                    " mulps (%3), %%xmm3            \n\t"
+                    " movaps %%xmm0, %%xmm4         \n\t"
+                    " shufps $0xf5, %%xmm1, %%xmm4  \n\t" /* | b1 | b1 | a1 | a1 | */
+                    " mulps 16(%3), %%xmm4          \n\t"
+                    " addps %%xmm4, %%xmm3          \n\t"
+                    " movaps %%xmm0, %%xmm4         \n\t"
+                    " shufps $0x0a, %%xmm2, %%xmm4  \n\t" /* | b2 | b2 | a2 | a2 | */
+                    " mulps 32(%3), %%xmm4          \n\t"
+                    " addps %%xmm4, %%xmm3          \n\t"
+                    " shufps $0x5f, %%xmm2, %%xmm0  \n\t" /* | b3 | b3 | a3 | a3 | */
+                    " mulps 48(%3), %%xmm0          \n\t"
+                    " addps %%xmm0, %%xmm3          \n\t"
+                    " movaps %%xmm1, %%xmm4         \n\t"
+                    " shufps $0xa0, %%xmm2, %%xmm4  \n\t" /* | b4 | b4 | a4 | a4 | */
+                    " mulps 64(%3), %%xmm4          \n\t"
+                    " addps %%xmm4, %%xmm3          \n\t"
+                    " shufps $0xf5, %%xmm2, %%xmm1  \n\t" /* | b5 | b5 | a5 | a5 | */
+                    " mulps 80(%3), %%xmm1          \n\t"
+                    " addps %%xmm1, %%xmm3          \n\t"
+                    " movups %%xmm3, (%0)           \n\t" /* | rb | lb | ra | la | */
+                    " add $48, %1                   \n\t"
+                    " add $16, %0                   \n\t"
+                    " dec %2                        \n\t"
+                    " jne 1b                        \n\t"
+                    : "+r" (d), "+r" (s), "=&r" (temp)
+                    : "r" (coef), "2" ((pa_reg_x86) (n >> 1))
+                    : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4"
+                );
+            }
+
+            if (n & 1) {
+                d[0] = s[0] * coef[0] + s[1] * coef[4] + s[2] * coef[8] + s[3] * coef[12] + s[4] * coef[16] + s[5] * coef[20];
+                d[1] = s[0] * coef[1] + s[1] * coef[5] + s[2] * coef[9] + s[3] * coef[13] + s[4] * coef[17] + s[5] * coef[21];
+            }
+            break;
+        }
+        case PA_SAMPLE_S16NE:
+        {
+            PA_DECLARE_ALIGNED(16, int16_t, coef[40]);
+            const int16_t *s;
+            int16_t *d;
+
+            /* One frame at a time, loading 8 samples of which the last
+             * two are multiplied by 0. The frame is summed horizontally,
+             * the low 16 bits of the sum are the same as adding up in 16
+             * bits. */
+            memset(coef, 0, sizeof(coef));
+            for (ic = 0; ic < 6; ic++) {
+                s16_factor(m->map_table_i[0][ic], &coef[ic], &coef[8 + ic]);
+                s16_factor(m->map_table_i[1][ic], &coef[16 + ic], &coef[24 + ic]);
+            }
+            for (i = 0; i < 8; i++)
+                coef[32 + i] = 1;
+
+            d = (int16_t *) dst;
+            s = (const int16_t *) src;
+
+            /* The last frame would read past the end */
+            if (n > 1) {
+                __asm__ __volatile__ (
+                    " movdqa (%3), %%xmm4           \n\t"
+                    " movdqa 16(%3), %%xmm5         \n\t"
+                    " movdqa 32(%3), %%xmm6         \n\t"
+                    " movdqa 48(%3), %%xmm7         \n\t"
+                    "1:                             \n\t"
+                    " movdqu (%1), %%xmm0           \n\t" /* | .. | .. | s5 | .. | s0 | */
+                    " movdqa %%xmm0, %%xmm1         \n\t"
+                    " movdqa %%xmm0, %%xmm2         \n\t"
+                    " movdqa %%xmm0, %%xmm3         \n\t"
+                    " pmulhw %%xmm4, %%xmm0         \n\t"
+                    " pand %%xmm5, %%xmm1           \n\t"
+                    " pmulhw %%xmm6, %%xmm2         \n\t"
+                    " pand %%xmm7, %%xmm3           \n\t"
+                    " paddw %%xmm1, %%xmm0          \n\t" /* left terms */
+                    " paddw %%xmm3, %%xmm2          \n\t" /* right terms */
+                    " movdqa 64(%3), %%xmm1         \n\t"
+                    " pmaddwd %%xmm1, %%xmm0        \n\t" /* |  0  | l45 | l23 | l01 | */
+                    " pmaddwd %%xmm1, %%xmm2        \n\t" /* |  0  | r45 | r23 | r01 | */
+                    " movdqa %%xmm0, %%xmm1         \n\t"
+                    " punpckldq %%xmm2, %%xmm0      \n\t" /* | r23 | l23 | r01 | l01 | */
+                    " punpckhdq %%xmm2, %%xmm1      \n\t" /* |  0  |  0  | r45 | l45 | */
+                    " paddd %%xmm1, %%xmm0          \n\t"
+                    " pshufd $0xee, %%xmm0, %%xmm1  \n\t"
+                    " paddd %%xmm1, %%xmm0          \n\t" /* |  .. |  .. |  r  |  l  | */
+                    " pshuflw $0x08, %%xmm0, %%xmm0 \n\t"
+                    " movd %%xmm0, (%0)             \n\t"
+                    " add $12, %1                   \n\t"
+                    " add $4, %0                    \n\t"
+                    " dec %2                        \n\t"
+                    " jne 1b                        \n\t"
+                    : "+r" (d), "+r" (s), "=&r" (temp)
+                    : "r" (coef), "2" ((pa_reg_x86) (n - 1))
+                    : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"
+                );
+            }
+
+            if (n > 0) {
+                int32_t l = 0, r = 0;
+
+                for (ic = 0; ic < 6; ic++) {
+                    l += ((int32_t) s[ic] * m->map_table_i[0][ic]) >> 16;
+                    r += ((int32_t) s[ic] * m->map_table_i[1][ic]) >> 16;
+                }
+
+                d[0] = (int16_t) l;
+                d[1] = (int16_t) r;
+            }
+            break;
+        }
+        default:
+            pa_assert_not_reached();
+    }
+}
+
+/* Up to 8 output channels: every input sample is broadcast and multiplied
+ * with its column of the matrix, so one frame is one pass over the input
+ * channels. The stores write a full vector, overlapping the next frame,
+ * the frames at the very end go through a bounce buffer. */
+static void remap_matrix_float_sse2(pa_remap_t *m, float *d, const float *s, unsigned n, unsigned n_ic, unsigned n_oc) {
+    PA_DECLARE_ALIGNED(16, float, cols[PA_CHANNELS_MAX * 8]);
+    PA_DECLARE_ALIGNED(16, float, bounce[8]);
+    pa_reg_x86 temp;
+    const float *c;
+    unsigned oc, ic, width;
+
+    width = n_oc > 4 ? 8 : 4;
+
+    memset(cols, 0, sizeof(float) * 8 * n_ic);
+    for (ic = 0; ic < n_ic; ic++)
+        for (oc = 0; oc < n_oc; oc++)
+            cols[8 * ic + oc] = m->map_table_f[oc][ic];
+
+    for (; n > 0; n--, d += n_oc) {
+        float *o = width > n_oc * n ? bounce : d;
+
+        c = cols;
+
+        if (width == 4) {
+            __asm__ __volatile__ (
+                " xorps %%xmm0, %%xmm0          \n\t"
+                "1:                             \n\t"
+                " movss (%0), %%xmm2            \n\t"
+                " shufps $0, %%xmm2, %%xmm2     \n\t" /* | s | s | s | s | */
+                " mulps (%1), %%xmm2            \n\t"
+                " addps %%xmm2, %%xmm0          \n\t"
+                " add $4, %0                    \n\t"
+                " add $32, %1                   \n\t"
+                " dec %2                        \n\t"
+                " jne 1b                        \n\t"
+                " movups %%xmm0, (%4)           \n\t"
+                : "+r" (s), "+r" (c), "=&r" (temp)
+                : "2" ((pa_reg_x86) n_ic), "r" (o)
+                : "cc", "memory", "xmm0", "xmm2"
+            );
+        } else {
+            __asm__ __volatile__ (
+                " xorps %%xmm0, %%xmm0          \n\t"
+                " xorps %%xmm1, %%xmm1          \n\t"
+                "1:                             \n\t"
+                " movss (%0), %%xmm2            \n\t"
+                " shufps $0, %%xmm2, %%xmm2     \n\t" /* | s | s | s | s | */
+                " movaps %%xmm2, %%xmm3         \n\t"
+                " mulps (%1), %%xmm2            \n\t"
+                " mulps 16(%1), %%xmm3          \n\t"
+                " addps %%xmm2, %%xmm0          \n\t"
+                " addps %%xmm3, %%xmm1          \n\t"
+                " add $4, %0                    \n\t"
+                " add $32, %1                   \n\t"
+                " dec %2                        \n\t"
+                " jne 1b                        \n\t"
+                " movups %%xmm0, (%4)           \n\t"
+                " movups %%xmm1, 16(%4)         \n\t"
+                : "+r" (s), "+r" (c), "=&r" (temp)
+                : "2" ((pa_reg_x86) n_ic), "r" (o)
+                : "cc", "memory", "xmm0", "xmm1", "xmm2", "xmm3"
+            );
+        }
+
+        if (o == bounce)
+            memcpy(d, bounce, sizeof(float) * n_oc);
+    }
+}
+
+static void remap_matrix_s16_sse2(pa_remap_t *m, int16_t *d, const int16_t *s, unsigned n, unsigned n_ic, unsigned n_oc) {
+    PA_DECLARE_ALIGNED(16, int16_t, cols[PA_CHANNELS_MAX * 16]);
+    PA_DECLARE_ALIGNED(16, int16_t, bounce[8]);
+    pa_reg_x86 temp;
+    const int16_t *c;
+    unsigned oc, ic;
+
+    /* Each column is 8 factors followed by 8 masks */
+    memset(cols, 0, sizeof(int16_t) * 16 * n_ic);
+    for (ic = 0; ic < n_ic; ic++)
+        for (oc = 0; oc < n_oc; oc++)
+            s16_factor(m->map_table_i[oc][ic], &cols[16 * ic + oc], &cols[16 * ic + 8 + oc]);
+
+    for (; n > 0; n--, d += n_oc) {
+        int16_t *o = 8 > n_oc * n ? bounce : d;
+
+        c = cols;
+
+        __asm__ __volatile__ (
+            " pxor %%xmm0, %%xmm0           \n\t"
+            "1:                             \n\t"
+            " pinsrw $0, (%0), %%xmm2       \n\t"
+            " pshuflw $0, %%xmm2, %%xmm2    \n\t"
+            " pshufd $0, %%xmm2, %%xmm2     \n\t" /* | s | .. | s | */
+            " movdqa %%xmm2, %%xmm3         \n\t"
+            " pmulhw (%1), %%xmm2           \n\t"
+            " pand 16(%1), %%xmm3           \n\t"
+            " paddw %%xmm2, %%xmm0          \n\t"
+            " paddw %%xmm3, %%xmm0          \n\t"
+            " add $2, %0                    \n\t"
+            " add $32, %1                   \n\t"
+            " dec %2                        \n\t"
+            " jne 1b                        \n\t"
+            " movdqu %%xmm0, (%4)           \n\t"
+            : "+r" (s), "+r" (c), "=&r" (temp)
+            : "2" ((pa_reg_x86) n_ic), "r" (o)
+            : "cc", "memory", "xmm0", "xmm2", "xmm3"
+        );
+
+        if (o == bounce)
+            memcpy(d, bounce, sizeof(int16_t) * n_oc);
+    }
+}
+
+static void remap_matrix_sse2(pa_remap_t *m, void *dst, const void *src, unsigned n) {
+    switch (*m->format) {
+        case PA_SAMPLE_FLOAT32NE:
+            remap_matrix_float_sse2(m, dst, src, n, m->i_ss->channels, m->o_ss->channels);
+            break;
+        case PA_SAMPLE_S16NE:
+            remap_matrix_s16_sse2(m, dst, src, n, m->i_ss->channels, m->o_ss->channels);
+            break;
+        default:
+            pa_assert_not_reached();
+    }
+}
+
 /* set the function that will execute the remapping based on the matrices */
 static void init_remap_sse2(pa_remap_t *m) {
     unsigned n_oc, n_ic;
@@ -141,6 +531,17 @@ static void init_remap_sse2(pa_remap_t *m) {
             m->map_table_f[0][0] >= 1.0 && m->map_table_f[1][0] >= 1.0) {
         m->do_remap = (pa_do_remap_func_t) remap_mono_to_stereo_sse2;
         pa_log_info("Using SSE mono to stereo remapping");
+    } else if (n_ic == 2 && n_oc == 1) {
+        m->do_remap = (pa_do_remap_func_t) remap_stereo_to_mono_sse2;
+        pa_log_info("Using SSE2 stereo to mono remapping");
+    } else if (n_ic == 6 && n_oc == 2) {
+        m->do_remap = (pa_do_remap_func_t) remap_51_to_stereo_sse2;
+        pa_log_info("Using SSE2 5.1 to stereo remapping");
+    } else if (n_oc >= 3 && n_oc <= 8 && (*m->format == PA_SAMPLE_FLOAT32NE || n_ic <= 2)) {
+        /* For s16 the broadcast costs more than the C version saves on
+         * anything but mono and stereo input */
+        m->do_remap = (pa_do_remap_func_t) remap_matrix_sse2;
+        pa_log_info("Using SSE2 matrix remapping");
     }
 }
 #endif /* defined (__i386__) || defined (__amd64__) */
@@ -39,6 +39,7 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/strbuf.h>
 #include <pulsecore/remap.h>
+#include <pulsecore/polyphase.h>
 
 #include "ffmpeg/avcodec.h"
 
@@ -47,6 +48,9 @@
 /* Number of samples of extra space we allow the resamplers to return */
 #define EXTRA_FRAMES 128
 
+/* Blocks of peaks remembered by a pa_resampler_cache */
+#define CACHE_ENTRIES 4
+
 struct pa_resampler {
     pa_resample_method_t method;
     pa_resample_flags_t flags;
@@ -77,7 +81,7 @@ struct pa_resampler {
         unsigned i_counter;
     } trivial;
 
-    struct { /* data specific to the peak finder pseudo resampler */
+    struct peaks_data { /* data specific to the peak finder pseudo resampler */
         unsigned o_counter;
         unsigned i_counter;
 
@@ -102,6 +106,27 @@ struct pa_resampler {
         struct AVResampleContext *state;
         pa_memchunk buf[PA_CHANNELS_MAX];
     } ffmpeg;
+
+    struct { /* data specific to the polyphase resampler */
+        pa_polyphase *state;
+    } polyphase;
+};
+
+struct cache_entry {
+    /* The configuration of the resampler that ran */
+    pa_sample_spec i_ss, o_ss;
+    pa_channel_map i_cm, o_cm;
+    pa_resample_flags_t flags;
+
+    pa_memchunk in, out;
+
+    /* Its state afterwards */
+    struct peaks_data peaks;
+};
+
+struct pa_resampler_cache {
+    struct cache_entry entries[CACHE_ENTRIES];
+    unsigned next;
 };
 
 static int copy_init(pa_resampler *r);
@@ -111,6 +136,7 @@ static int speex_init(pa_resampler*r);
 #endif
 static int ffmpeg_init(pa_resampler*r);
 static int peaks_init(pa_resampler*r);
+static int polyphase_init(pa_resampler*r);
 #ifdef HAVE_LIBSAMPLERATE
 static int libsamplerate_init(pa_resampler*r);
 #endif
@@ -183,8 +209,21 @@ static int (* const init_table[])(pa_resampler*r) = {
     [PA_RESAMPLER_AUTO]                    = NULL,
     [PA_RESAMPLER_COPY]                    = copy_init,
     [PA_RESAMPLER_PEAKS]                   = peaks_init,
+    [PA_RESAMPLER_POLYPHASE_BASE+0]        = polyphase_init,
+    [PA_RESAMPLER_POLYPHASE_BASE+1]        = polyphase_init,
+    [PA_RESAMPLER_POLYPHASE_BASE+2]        = polyphase_init,
+    [PA_RESAMPLER_POLYPHASE_BASE+3]        = polyphase_init,
 };
 
+static pa_bool_t needs_float(pa_sample_format_t f) {
+
+    return
+        f == PA_SAMPLE_S32NE || f == PA_SAMPLE_S32RE ||
+        f == PA_SAMPLE_FLOAT32NE || f == PA_SAMPLE_FLOAT32RE ||
+        f == PA_SAMPLE_S24NE || f == PA_SAMPLE_S24RE ||
+        f == PA_SAMPLE_S24_32NE || f == PA_SAMPLE_S24_32RE;
+}
+
 pa_resampler* pa_resampler_new(
         pa_mempool *pool,
         const pa_sample_spec *a,
@@ -282,24 +321,16 @@ pa_resampler* pa_resampler_new(
         r->work_format = PA_SAMPLE_S16NE;
     else if (method == PA_RESAMPLER_TRIVIAL || method == PA_RESAMPLER_COPY || method == PA_RESAMPLER_PEAKS) {
 
-        if (r->map_required || a->format != b->format || method == PA_RESAMPLER_PEAKS) {
-
-            if (a->format == PA_SAMPLE_S32NE || a->format == PA_SAMPLE_S32RE ||
-                a->format == PA_SAMPLE_FLOAT32NE || a->format == PA_SAMPLE_FLOAT32RE ||
-                a->format == PA_SAMPLE_S24NE || a->format == PA_SAMPLE_S24RE ||
-                a->format == PA_SAMPLE_S24_32NE || a->format == PA_SAMPLE_S24_32RE ||
-                b->format == PA_SAMPLE_S32NE || b->format == PA_SAMPLE_S32RE ||
-                b->format == PA_SAMPLE_FLOAT32NE || b->format == PA_SAMPLE_FLOAT32RE ||
-                b->format == PA_SAMPLE_S24NE || b->format == PA_SAMPLE_S24RE ||
-                b->format == PA_SAMPLE_S24_32NE || b->format == PA_SAMPLE_S24_32RE)
-                r->work_format = PA_SAMPLE_FLOAT32NE;
-            else
-                r->work_format = PA_SAMPLE_S16NE;
-
-        } else
+        if (r->map_required || a->format != b->format || method == PA_RESAMPLER_PEAKS)
+            r->work_format = needs_float(a->format) || needs_float(b->format) ? PA_SAMPLE_FLOAT32NE : PA_SAMPLE_S16NE;
+        else
             r->work_format = a->format;
 
-    } else
+    } else if (method >= PA_RESAMPLER_POLYPHASE_BASE && method <= PA_RESAMPLER_POLYPHASE_MAX)
+        /* The best quality always works in float, the Q15 taps of the
+         * s16 filter would limit it */
+        r->work_format = method == PA_RESAMPLER_POLYPHASE_MAX || needs_float(a->format) || needs_float(b->format) ? PA_SAMPLE_FLOAT32NE : PA_SAMPLE_S16NE;
+    else
         r->work_format = PA_SAMPLE_FLOAT32NE;
 
     pa_log_info("Using %s as working format.", pa_sample_format_to_string(r->work_format));
@@ -491,7 +522,11 @@ static const char * const resample_methods[] = {
     "ffmpeg",
     "auto",
     "copy",
-    "peaks"
+    "peaks",
+    "polyphase-0",
+    "polyphase-1",
+    "polyphase-2",
+    "polyphase-3"
 };
 
 const char *pa_resample_method_to_string(pa_resample_method_t m) {
@@ -537,6 +572,9 @@ pa_resample_method_t pa_parse_resample_method(const char *string) {
     if (!strcmp(string, "speex-float"))
         return PA_RESAMPLER_SPEEX_FLOAT_BASE + 3;
 
+    if (!strcmp(string, "polyphase"))
+        return PA_RESAMPLER_POLYPHASE_BASE + 2;
+
     return PA_RESAMPLER_INVALID;
 }
 
@@ -1247,6 +1285,106 @@ void pa_resampler_run(pa_resampler *r, const pa_memchunk *in, pa_memchunk *out)
         pa_memchunk_reset(out);
 }
 
+pa_resampler_cache *pa_resampler_cache_new(void) {
+    return pa_xnew0(pa_resampler_cache, 1);
+}
+
+static void cache_entry_done(struct cache_entry *e) {
+    pa_assert(e);
+
+    if (e->in.memblock)
+        pa_memblock_unref(e->in.memblock);
+
+    if (e->out.memblock)
+        pa_memblock_unref(e->out.memblock);
+
+    pa_memchunk_reset(&e->in);
+    pa_memchunk_reset(&e->out);
+}
+
+void pa_resampler_cache_free(pa_resampler_cache *c) {
+    unsigned i;
+
+    pa_assert(c);
+
+    for (i = 0; i < CACHE_ENTRIES; i++)
+        cache_entry_done(&c->entries[i]);
+
+    pa_xfree(c);
+}
+
+static pa_bool_t cache_entry_matches(const struct cache_entry *e, pa_resampler *r, const pa_memchunk *in) {
+
+    /* Holding a reference on the block makes sure the pointer still
+     * means the same data */
+    return
+        e->in.memblock == in->memblock &&
+        e->in.index == in->index &&
+        e->in.length == in->length &&
+        e->flags == r->flags &&
+        pa_sample_spec_equal(&e->i_ss, &r->i_ss) &&
+        pa_sample_spec_equal(&e->o_ss, &r->o_ss) &&
+        pa_channel_map_equal(&e->i_cm, &r->i_cm) &&
+        pa_channel_map_equal(&e->o_cm, &r->o_cm);
+}
+
+void pa_resampler_run_cached(pa_resampler *r, pa_resampler_cache *c, const pa_memchunk *in, pa_memchunk *out) {
+    struct cache_entry *e;
+    unsigned i;
+
+    pa_assert(r);
+    pa_assert(c);
+    pa_assert(in);
+    pa_assert(out);
+
+    if (r->method != PA_RESAMPLER_PEAKS) {
+        pa_resampler_run(r, in, out);
+        return;
+    }
+
+    for (i = 0; i < CACHE_ENTRIES; i++) {
+        e = &c->entries[i];
+
+        if (!cache_entry_matches(e, r, in))
+            continue;
+
+        /* A resampler that started at another time sits at another
+         * phase. Moving it over to the one that computed these peaks
+         * shifts its peak boundaries once, by less than a peak, which
+         * no level meter can show, and from then on it finds its
+         * blocks here. */
+        r->peaks = e->peaks;
+
+        *out = e->out;
+
+        if (out->memblock)
+            pa_memblock_ref(out->memblock);
+
+        return;
+    }
+
+    pa_resampler_run(r, in, out);
+
+    e = &c->entries[c->next];
+    c->next = (c->next + 1) % CACHE_ENTRIES;
+
+    cache_entry_done(e);
+
+    e->i_ss = r->i_ss;
+    e->o_ss = r->o_ss;
+    e->i_cm = r->i_cm;
+    e->o_cm = r->o_cm;
+    e->flags = r->flags;
+    e->peaks = r->peaks;
+
+    e->in = *in;
+    pa_memblock_ref(e->in.memblock);
+
+    e->out = *out;
+    if (e->out.memblock)
+        pa_memblock_ref(e->out.memblock);
+}
+
 /*** libsamplerate based implementation ***/
 
 #ifdef HAVE_LIBSAMPLERATE
@@ -1439,10 +1577,10 @@ static void trivial_resample(pa_resampler *r, const pa_memchunk *input, unsigned
         /* Directly assign some common sample sizes, use memcpy as fallback */
         if (r->w_sz == 2) {
             for (unsigned c = 0; c < r->o_ss.channels; c++)
-                ((uint16_t *) dst)[o_index+c] = ((uint16_t *) src)[i_index+c];
+                ((uint16_t *) dst)[o_index * r->o_ss.channels + c] = ((uint16_t *) src)[i_index * r->o_ss.channels + c];
         } else if (r->w_sz == 4) {
             for (unsigned c = 0; c < r->o_ss.channels; c++)
-                ((uint32_t *) dst)[o_index+c] = ((uint32_t *) src)[i_index+c];
+                ((uint32_t *) dst)[o_index * r->o_ss.channels + c] = ((uint32_t *) src)[i_index * r->o_ss.channels + c];
         } else {
             memcpy((uint8_t *) dst + fz * o_index, (uint8_t *) src + fz * i_index, (int) fz);
         }
@@ -1485,6 +1623,54 @@ static int trivial_init(pa_resampler*r) {
 
 /* Peak finder implementation */
 
+static void peaks_s16_c(const int16_t *s, unsigned n_frames, unsigned channels, int16_t *peak) {
+    unsigned c;
+
+    for (; n_frames > 0; n_frames--)
+        for (c = 0; c < channels; c++) {
+            /* abs(-0x8000) does not fit */
+            int16_t n = (int16_t) PA_MIN(abs(*s++), 0x7FFF);
+
+            if (n > peak[c])
+                peak[c] = n;
+        }
+}
+
+static void peaks_float_c(const float *s, unsigned n_frames, unsigned channels, float *peak) {
+    unsigned c;
+
+    for (; n_frames > 0; n_frames--)
+        for (c = 0; c < channels; c++) {
+            float n = fabsf(*s++);
+
+            if (n > peak[c])
+                peak[c] = n;
+        }
+}
+
+static pa_peaks_s16_func_t peaks_s16_func = peaks_s16_c;
+static pa_peaks_float_func_t peaks_float_func = peaks_float_c;
+
+pa_peaks_s16_func_t pa_get_peaks_s16_func(void) {
+    return peaks_s16_func;
+}
+
+void pa_set_peaks_s16_func(pa_peaks_s16_func_t func) {
+    pa_assert(func);
+
+    peaks_s16_func = func;
+}
+
+pa_peaks_float_func_t pa_get_peaks_float_func(void) {
+    return peaks_float_func;
+}
+
+void pa_set_peaks_float_func(pa_peaks_float_func_t func) {
+    pa_assert(func);
+
+    peaks_float_func = func;
+}
+
 static void peaks_resample(pa_resampler *r, const pa_memchunk *input, unsigned in_n_frames, pa_memchunk *output, unsigned *out_n_frames) {
     unsigned c, o_index = 0;
     unsigned i, i_end = 0;
@@ -1501,40 +1687,24 @@ static void peaks_resample(pa_resampler *r, const pa_memchunk *input, unsigned i
     i = (r->peaks.o_counter * r->i_ss.rate) / r->o_ss.rate;
     i = i > r->peaks.i_counter ? i - r->peaks.i_counter : 0;
 
+    /* Each output frame takes one pass over the input frames it stands
+     * for, however many that are */
     while (i_end < in_n_frames) {
+        unsigned n;
+
         i_end = ((r->peaks.o_counter+1) * r->i_ss.rate) / r->o_ss.rate;
         i_end = i_end > r->peaks.i_counter ? i_end - r->peaks.i_counter : 0;
 
         pa_assert_fp(o_index * r->w_sz * r->o_ss.channels < pa_memblock_get_length(output->memblock));
 
-        /* 1ch float is treated separately, because that is the common case */
-        if (r->o_ss.channels == 1 && r->work_format == PA_SAMPLE_FLOAT32NE) {
-            float *s = (float*) src + i;
-            float *d = (float*) dst + o_index;
-
-            for (; i < i_end && i < in_n_frames; i++) {
-                float n = fabsf(*s++);
+        n = PA_MIN(i_end, in_n_frames);
+        n = n > i ? n - i : 0;
 
-                if (n > r->peaks.max_f[0])
-                    r->peaks.max_f[0] = n;
-            }
-
-            if (i == i_end) {
-                *d = r->peaks.max_f[0];
-                r->peaks.max_f[0] = 0;
-                o_index++, r->peaks.o_counter++;
-            }
-        } else if (r->work_format == PA_SAMPLE_S16NE) {
-            int16_t *s = (int16_t*) src + r->i_ss.channels * i;
+        if (r->work_format == PA_SAMPLE_S16NE) {
             int16_t *d = (int16_t*) dst + r->o_ss.channels * o_index;
 
-            for (; i < i_end && i < in_n_frames; i++)
-                for (c = 0; c < r->o_ss.channels; c++) {
-                    int16_t n = abs(*s++);
-
-                    if (n > r->peaks.max_i[c])
-                        r->peaks.max_i[c] = n;
-                }
+            peaks_s16_func((int16_t*) src + r->o_ss.channels * i, n, r->o_ss.channels, r->peaks.max_i);
+            i += n;
 
             if (i == i_end) {
                 for (c = 0; c < r->o_ss.channels; c++, d++) {
@@ -1544,16 +1714,10 @@ static void peaks_resample(pa_resampler *r, const pa_memchunk *input, unsigned i
                 o_index++, r->peaks.o_counter++;
             }
         } else {
-            float *s = (float*) src + r->i_ss.channels * i;
             float *d = (float*) dst + r->o_ss.channels * o_index;
 
-            for (; i < i_end && i < in_n_frames; i++)
-                for (c = 0; c < r->o_ss.channels; c++) {
-                    float n = fabsf(*s++);
-
-                    if (n > r->peaks.max_f[c])
-                        r->peaks.max_f[c] = n;
-                }
+            peaks_float_func((float*) src + r->o_ss.channels * i, n, r->o_ss.channels, r->peaks.max_f);
+            i += n;
 
             if (i == i_end) {
                 for (c = 0; c < r->o_ss.channels; c++, d++) {
@@ -1720,6 +1884,65 @@ static int ffmpeg_init(pa_resampler *r) {
     return 0;
 }
 
+/*** polyphase implementation ***/
+
+static void polyphase_resample(pa_resampler *r, const pa_memchunk *input, unsigned in_n_frames, pa_memchunk *output, unsigned *out_n_frames) {
+    void *in, *out;
+
+    pa_assert(r);
+    pa_assert(input);
+    pa_assert(output);
+    pa_assert(out_n_frames);
+
+    in = (uint8_t*) pa_memblock_acquire(input->memblock) + input->index;
+    out = (uint8_t*) pa_memblock_acquire(output->memblock) + output->index;
+
+    *out_n_frames = pa_polyphase_run(r->polyphase.state, in, in_n_frames, out, *out_n_frames);
+
+    pa_memblock_release(input->memblock);
+    pa_memblock_release(output->memblock);
+}
+
+static void polyphase_update_rates(pa_resampler *r) {
+    pa_assert(r);
+
+    pa_polyphase_set_rates(r->polyphase.state, r->i_ss.rate, r->o_ss.rate);
+}
+
+static void polyphase_reset(pa_resampler *r) {
+    pa_assert(r);
+
+    pa_polyphase_reset(r->polyphase.state);
+}
+
+static void polyphase_free(pa_resampler *r) {
+    pa_assert(r);
+
+    if (r->polyphase.state)
+        pa_polyphase_free(r->polyphase.state);
+}
+
+static int polyphase_init(pa_resampler *r) {
+    unsigned q;
+
+    pa_assert(r);
+
+    q = (unsigned) (r->method - PA_RESAMPLER_POLYPHASE_BASE);
+
+    pa_log_info("Choosing polyphase quality setting %u.", q);
+
+    /* The filter banks are shared, so this is cheap unless this rate
+     * pair and quality are new to the process */
+    r->polyphase.state = pa_polyphase_new(r->work_format, r->o_ss.channels, r->i_ss.rate, r->o_ss.rate, q);
+
+    r->impl_free = polyphase_free;
+    r->impl_update_rates = polyphase_update_rates;
+    r->impl_resample = polyphase_resample;
+    r->impl_reset = polyphase_reset;
+
+    return 0;
+}
+
 /*** copy (noop) implementation ***/
 
 static int copy_init(pa_resampler *r) {
@@ -45,6 +45,8 @@ typedef enum pa_resample_method {
     PA_RESAMPLER_AUTO, /* automatic select based on sample format */
     PA_RESAMPLER_COPY,
     PA_RESAMPLER_PEAKS,
+    PA_RESAMPLER_POLYPHASE_BASE,
+    PA_RESAMPLER_POLYPHASE_MAX = PA_RESAMPLER_POLYPHASE_BASE + 3,
     PA_RESAMPLER_MAX
 } pa_resample_method_t;
 
@@ -78,6 +80,20 @@ size_t pa_resampler_max_block_size(pa_resampler *r);
 /* Pass the specified memory chunk to the resampler and return the newly resampled data */
 void pa_resampler_run(pa_resampler *r, const pa_memchunk *in, pa_memchunk *out);
 
+/* Remembers the last few blocks of peaks computed for level meters.
+ * Peak detecting resamplers of the same configuration that are fed the
+ * same memory block, like the meters of several clients on one monitor
+ * source, then take the result of the first one instead of scanning the
+ * data again, and adopt its phase. Not thread safe. */
+typedef struct pa_resampler_cache pa_resampler_cache;
+
+pa_resampler_cache *pa_resampler_cache_new(void);
+void pa_resampler_cache_free(pa_resampler_cache *c);
+
+/* Like pa_resampler_run(), but goes through the cache for the peaks
+ * method */
+void pa_resampler_run_cached(pa_resampler *r, pa_resampler_cache *c, const pa_memchunk *in, pa_memchunk *out);
+
 /* Change the input rate of the resampler object */
 void pa_resampler_set_input_rate(pa_resampler *r, uint32_t rate);
 
@@ -99,6 +115,17 @@ const char *pa_resample_method_to_string(pa_resample_method_t m);
 /* Return 1 when the specified resampling method is supported */
 int pa_resample_method_supported(pa_resample_method_t m);
 
+/* Raise peak[c] to the largest absolute value of channel c in the
+ * n_frames interleaved frames at s, used by the peaks method */
+typedef void (*pa_peaks_s16_func_t)(const int16_t *s, unsigned n_frames, unsigned channels, int16_t *peak);
+typedef void (*pa_peaks_float_func_t)(const float *s, unsigned n_frames, unsigned channels, float *peak);
+
+pa_peaks_s16_func_t pa_get_peaks_s16_func(void);
+void pa_set_peaks_s16_func(pa_peaks_s16_func_t func);
+
+pa_peaks_float_func_t pa_get_peaks_float_func(void);
+void pa_set_peaks_float_func(pa_peaks_float_func_t func);
+
 const pa_channel_map* pa_resampler_input_channel_map(pa_resampler *r);
 const pa_sample_spec* pa_resampler_input_sample_spec(pa_resampler *r);
 const pa_channel_map* pa_resampler_output_channel_map(pa_resampler *r);
@@ -731,6 +731,7 @@ void pa_volume_memchunk(
     void *ptr;
     volume_val linear[PA_CHANNELS_MAX + VOLUME_PADDING];
     pa_do_volume_func_t do_volume;
+    unsigned channels;
 
     pa_assert(c);
     pa_assert(spec);
@@ -758,13 +759,190 @@ void pa_volume_memchunk(
 
     calc_volume_table[spec->format] ((void *)linear, volume);
 
+    /* With the same volume on all channels the frames don't matter, the
+     * implementations can run through the samples as if it was mono */
+    channels = spec->channels;
+    if (pa_cvolume_channels_equal_to(volume, volume->values[0]))
+        channels = 1;
+
     ptr = (uint8_t*) pa_memblock_acquire(c->memblock) + c->index;
 
-    do_volume (ptr, (void *)linear, spec->channels, c->length);
+    do_volume (ptr, (void *)linear, channels, c->length);
 
     pa_memblock_release(c->memblock);
 }
 
+void pa_volume_ramp_init(
+        pa_volume_ramp *r,
+        pa_volume_ramp_type_t type,
+        const pa_cvolume *start,
+        const pa_cvolume *end,
+        size_t length) {
+
+    pa_assert(r);
+    pa_assert(start);
+    pa_assert(end);
+    pa_assert(start->channels == end->channels);
+
+    r->type = type;
+    r->start = *start;
+    r->end = *end;
+    r->length = r->left = pa_cvolume_equal(start, end) ? 0 : length;
+    r->past_end = 0;
+}
+
+/* The gain factor pos frames into the ramp */
+static double ramp_factor(const pa_volume_ramp *r, unsigned channel, size_t pos) {
+    double t, s, e;
+
+    t = (double) pos / (double) r->length;
+
+    if (r->type == PA_VOLUME_RAMP_CUBIC) {
+        double v;
+
+        /* Same as pa_sw_volume_to_linear(), without rounding to
+         * pa_volume_t on the way */
+        s = (double) r->start.values[channel];
+        e = (double) r->end.values[channel];
+        v = (s + (e - s) * t) / PA_VOLUME_NORM;
+
+        return v * v * v;
+    }
+
+    s = pa_sw_volume_to_linear(r->start.values[channel]);
+    e = pa_sw_volume_to_linear(r->end.values[channel]);
+
+    return s + (e - s) * t;
+}
+
+pa_cvolume* pa_volume_ramp_get(const pa_volume_ramp *r, pa_cvolume *v) {
+    unsigned channel;
+
+    pa_assert(r);
+    pa_assert(v);
+
+    if (r->left <= 0) {
+        *v = r->end;
+        return v;
+    }
+
+    v->channels = r->end.channels;
+
+    for (channel = 0; channel < v->channels; channel++)
+        v->values[channel] = pa_sw_volume_from_linear(ramp_factor(r, channel, r->length - r->left));
+
+    return v;
+}
+
+void pa_volume_ramp_memchunk(
+        pa_memchunk *c,
+        const pa_sample_spec *spec,
+        pa_volume_ramp *r) {
+
+    size_t fs, n;
+
+    pa_assert(c);
+    pa_assert(spec);
+    pa_assert(pa_frame_aligned(c->length, spec));
+    pa_assert(r);
+    pa_assert(r->left <= 0 || r->end.channels == spec->channels);
+
+    fs = pa_frame_size(spec);
+    n = PA_MIN(c->length / fs, r->left);
+
+    if (n > 0 && !pa_memblock_is_silence(c->memblock)) {
+        volume_val linear[PA_CHANNELS_MAX + VOLUME_PADDING];
+        pa_do_volume_func_t do_volume;
+        pa_bool_t is_float;
+        uint8_t *ptr;
+        size_t k;
+
+        pa_assert(spec->format >= 0 && spec->format < PA_SAMPLE_MAX);
+
+        do_volume = pa_get_volume_func(spec->format);
+        pa_assert(do_volume);
+
+        is_float = spec->format == PA_SAMPLE_FLOAT32LE || spec->format == PA_SAMPLE_FLOAT32BE;
+
+        ptr = (uint8_t*) pa_memblock_acquire(c->memblock) + c->index;
+
+        /* A new volume for every frame, ramps are only a few ms long */
+        for (k = 0; k < n; k++, ptr += fs) {
+            unsigned channel, padding;
+
+            for (channel = 0; channel < spec->channels; channel++) {
+                double f = ramp_factor(r, channel, r->length - r->left + k);
+
+                if (is_float)
+                    linear[channel].f = (float) f;
+                else
+                    linear[channel].i = (uint32_t) lrint(f * 0x10000);
+            }
+
+            for (padding = 0; padding < VOLUME_PADDING; padding++, channel++)
+                linear[channel] = linear[padding];
+
+            do_volume(ptr, (void *) linear, spec->channels, (unsigned) fs);
+        }
+
+        pa_memblock_release(c->memblock);
+    }
+
+    pa_volume_ramp_advance(r, c->length / fs);
+
+    if (n * fs < c->length) {
+        pa_memchunk rest = *c;
+
+        rest.index += n * fs;
+        rest.length -= n * fs;
+        pa_volume_memchunk(&rest, spec, &r->end);
+    }
+}
+
+void pa_volume_ramp_advance(pa_volume_ramp *r, size_t n) {
+    size_t k;
+
+    pa_assert(r);
+
+    if (r->length <= 0)
+        return;
+
+    k = PA_MIN(n, r->left);
+    r->left -= k;
+    r->past_end += n - k;
+}
+
+void pa_volume_ramp_rewind(pa_volume_ramp *r, size_t n) {
+    size_t k;
+
+    pa_assert(r);
+
+    if (r->length <= 0)
+        return;
+
+    k = PA_MIN(n, r->past_end);
+    r->past_end -= k;
+    r->left = PA_MIN(r->left + (n - k), r->length);
+}
+
+int pa_parse_volume_ramp_type(const char *s, pa_volume_ramp_type_t *type) {
+    pa_assert(s);
+    pa_assert(type);
+
+    if (pa_streq(s, "linear"))
+        *type = PA_VOLUME_RAMP_LINEAR;
+    else if (pa_streq(s, "cubic"))
+        *type = PA_VOLUME_RAMP_CUBIC;
+    else
+        return -1;
+
+    return 0;
+}
+
+const char *pa_volume_ramp_type_to_string(pa_volume_ramp_type_t type) {
+    return type == PA_VOLUME_RAMP_CUBIC ? "cubic" : "linear";
+}
+
 size_t pa_frame_align(size_t l, const pa_sample_spec *ss) {
     size_t fs;
 
@@ -72,6 +72,49 @@ void pa_volume_memchunk(
     const pa_sample_spec *spec,
     const pa_cvolume *volume);
 
+/* How the volume gets from start to end of a ramp. LINEAR moves the
+ * gain factor in a straight line, CUBIC moves the pa_volume_t value,
+ * which sounds more even as that is closer to how loud it seems. */
+typedef enum pa_volume_ramp_type {
+    PA_VOLUME_RAMP_LINEAR,
+    PA_VOLUME_RAMP_CUBIC
+} pa_volume_ramp_type_t;
+
+typedef struct pa_volume_ramp {
+    pa_volume_ramp_type_t type;
+    pa_cvolume start, end;
+    size_t length, left; /* in frames */
+    size_t past_end; /* frames moved on since it ended, so that rewinds find their way back */
+} pa_volume_ramp;
+
+void pa_volume_ramp_init(
+    pa_volume_ramp *r,
+    pa_volume_ramp_type_t type,
+    const pa_cvolume *start,
+    const pa_cvolume *end,
+    size_t length);
+
+/* The volume the ramp has reached */
+pa_cvolume* pa_volume_ramp_get(const pa_volume_ramp *r, pa_cvolume *v);
+
+/* Like pa_volume_memchunk(), with the volume following the ramp from
+ * where it is. The ramp is advanced by the length of the chunk, what
+ * is beyond its end gets the end volume. */
+void pa_volume_ramp_memchunk(
+    pa_memchunk *c,
+    const pa_sample_spec *spec,
+    pa_volume_ramp *r);
+
+/* Moves the ramp on by n frames without applying it */
+void pa_volume_ramp_advance(pa_volume_ramp *r, size_t n);
+
+/* Moves the ramp back by n frames, for when the audio it was applied
+ * to is rewound. Going back beyond its start restarts it. */
+void pa_volume_ramp_rewind(pa_volume_ramp *r, size_t n);
+
+int pa_parse_volume_ramp_type(const char *s, pa_volume_ramp_type_t *type);
+const char *pa_volume_ramp_type_to_string(pa_volume_ramp_type_t type);
+
 size_t pa_frame_align(size_t l, const pa_sample_spec *ss) PA_GCC_PURE;
 
 pa_bool_t pa_frame_aligned(size_t l, const pa_sample_spec *ss) PA_GCC_PURE;
@@ -31,6 +31,8 @@
 #include <pulsecore/endianmacros.h>
 
 #include "cpu-x86.h"
+#include "sconv-s16le.h"
+#include "sconv-s16be.h"
 #include "sconv.h"
 
 #if !defined(__APPLE__) && defined (__i386__) || defined (__amd64__)
@@ -162,68 +164,281 @@ static void pa_sconv_s16le_from_f32ne_sse2(unsigned n, const float *a, int16_t *
     );
 }
 
-#undef RUN_TEST
-
-#ifdef RUN_TEST
-#define SAMPLES 1019
-#define TIMES 1000
-
-static void run_test(void) {
-    int16_t samples[SAMPLES];
-    int16_t samples_ref[SAMPLES];
-    float floats[SAMPLES];
-    int i;
-    pa_usec_t start, stop;
-    pa_convert_func_t func;
-
-    printf("checking SSE %zd\n", sizeof(samples));
-
-    memset(samples_ref, 0, sizeof(samples_ref));
-    memset(samples, 0, sizeof(samples));
-
-    for (i = 0; i < SAMPLES; i++) {
-        floats[i] = (rand()/(RAND_MAX+2.2)) - 1.1;
-    }
+/* The kernels below all convert four samples per iteration (eight for
+ * the s16 byte swap) and leave the last few to the C versions. The
+ * packed 24 bit formats are shuffled with pshufb and need SSSE3. */
+
+static const PA_DECLARE_ALIGNED (16, double, scale_s32[2]) = { 0x7fffffff, 0x7fffffff };
+static const PA_DECLARE_ALIGNED (16, float, scale_s24[4]) = { 1.0 / 0x80000000U, 1.0 / 0x80000000U, 1.0 / 0x80000000U, 1.0 / 0x80000000U };
+
+/* packed 24 bit samples to the upper 3 bytes of 32 bit samples */
+static const PA_DECLARE_ALIGNED (16, uint8_t, unpack_s24le[16]) = {
+    0x80, 0, 1, 2, 0x80, 3, 4, 5, 0x80, 6, 7, 8, 0x80, 9, 10, 11 };
+static const PA_DECLARE_ALIGNED (16, uint8_t, unpack_s24be[16]) = {
+    0x80, 2, 1, 0, 0x80, 5, 4, 3, 0x80, 8, 7, 6, 0x80, 11, 10, 9 };
+
+/* and back */
+static const PA_DECLARE_ALIGNED (16, uint8_t, pack_s24le[16]) = {
+    1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, 0x80, 0x80, 0x80, 0x80 };
+static const PA_DECLARE_ALIGNED (16, uint8_t, pack_s24be[16]) = {
+    3, 2, 1, 7, 6, 5, 11, 10, 9, 15, 14, 13, 0x80, 0x80, 0x80, 0x80 };
+
+/* the ones from sconv.c are static, we call whatever was set before us */
+static pa_convert_func_t float32re_to_float32ne_c, s16re_to_s16ne_c;
+
+#define LOAD_16                                                         \
+        " movq (%0), %%xmm0             \n\t"
+
+#define LOAD_24                                                         \
+        " movq (%0), %%xmm0             \n\t"                           \
+        " movd 8(%0), %%xmm1            \n\t"                           \
+        " punpcklqdq %%xmm1, %%xmm0     \n\t"
+
+#define LOAD_32                                                         \
+        " movdqu (%0), %%xmm0           \n\t"
+
+#define STORE_16                                                        \
+        " movq %%xmm0, (%1)             \n\t"
+
+#define STORE_24                                                        \
+        " movq %%xmm0, (%1)             \n\t"                           \
+        " psrldq $8, %%xmm0             \n\t"                           \
+        " movd %%xmm0, 8(%1)            \n\t"
+
+#define STORE_32                                                        \
+        " movdqu %%xmm0, (%1)           \n\t"
+
+#define SWAP_16                                                         \
+        " movdqa %%xmm0, %%xmm7         \n\t"                           \
+        " psllw $8, %%xmm0              \n\t"                           \
+        " psrlw $8, %%xmm7              \n\t"                           \
+        " por %%xmm7, %%xmm0            \n\t"
+
+#define SWAP_32                                                         \
+        " pshuflw $0xb1, %%xmm0, %%xmm0 \n\t" /* swap the words... */   \
+        " pshufhw $0xb1, %%xmm0, %%xmm0 \n\t"                           \
+        SWAP_16                               /* ...and their bytes */
+
+#define UNPACK_S24LE                                                    \
+        " pshufb %8, %%xmm0             \n\t"
+
+#define UNPACK_S24BE                                                    \
+        " pshufb %9, %%xmm0             \n\t"
+
+#define PACK_S24LE                                                      \
+        " pshufb %10, %%xmm0            \n\t"
+
+#define PACK_S24BE                                                      \
+        " pshufb %11, %%xmm0            \n\t"
+
+/* s16 to the lower or the upper half of s32 */
+#define S16_TO_S32                                                      \
+        " punpcklwd %%xmm0, %%xmm0      \n\t"                           \
+        " psrad $16, %%xmm0             \n\t"
+
+#define S16_TO_S32_HIGH                                                 \
+        " punpcklwd %%xmm0, %%xmm0      \n\t"                           \
+        " pslld $16, %%xmm0             \n\t"
+
+#define S32_TO_S16                                                      \
+        " psrad $16, %%xmm0             \n\t"                           \
+        " packssdw %%xmm0, %%xmm0       \n\t"
+
+#define S16_TO_FLOAT                                                    \
+        S16_TO_S32                                                      \
+        " cvtdq2ps %%xmm0, %%xmm0       \n\t"                           \
+        " divps %5, %%xmm0              \n\t" /* /= 0x7fff */
+
+#define FLOAT_TO_S16                                                    \
+        " minps %3, %%xmm0              \n\t" /* clamp to 1.0 */        \
+        " maxps %4, %%xmm0              \n\t" /* clamp to -1.0 */       \
+        " mulps %5, %%xmm0              \n\t" /* *= 0x7fff */           \
+        " cvtps2dq %%xmm0, %%xmm0       \n\t"                           \
+        " packssdw %%xmm0, %%xmm0       \n\t"
+
+/* s32 goes through double like the C version does */
+#define S32_TO_FLOAT                                                    \
+        " cvtdq2pd %%xmm0, %%xmm1       \n\t"                           \
+        " pshufd $0xee, %%xmm0, %%xmm0  \n\t"                           \
+        " cvtdq2pd %%xmm0, %%xmm0       \n\t"                           \
+        " divpd %6, %%xmm1              \n\t" /* /= 0x7fffffff */       \
+        " divpd %6, %%xmm0              \n\t"                           \
+        " cvtpd2ps %%xmm1, %%xmm1       \n\t"                           \
+        " cvtpd2ps %%xmm0, %%xmm0       \n\t"                           \
+        " movlhps %%xmm0, %%xmm1        \n\t"                           \
+        " movaps %%xmm1, %%xmm0         \n\t"
+
+#define FLOAT_TO_S32                                                    \
+        " minps %3, %%xmm0              \n\t"                           \
+        " maxps %4, %%xmm0              \n\t"                           \
+        " cvtps2pd %%xmm0, %%xmm1       \n\t"                           \
+        " movhlps %%xmm0, %%xmm0        \n\t"                           \
+        " cvtps2pd %%xmm0, %%xmm0       \n\t"                           \
+        " mulpd %6, %%xmm1              \n\t" /* *= 0x7fffffff */       \
+        " mulpd %6, %%xmm0              \n\t"                           \
+        " cvtpd2dq %%xmm1, %%xmm1       \n\t"                           \
+        " cvtpd2dq %%xmm0, %%xmm0       \n\t"                           \
+        " punpcklqdq %%xmm0, %%xmm1     \n\t"                           \
+        " movdqa %%xmm1, %%xmm0         \n\t"
+
+/* 24 bit samples in the upper 3 bytes fit into a float exactly */
+#define S32_HIGH_TO_FLOAT                                               \
+        " cvtdq2ps %%xmm0, %%xmm0       \n\t"                           \
+        " mulps %7, %%xmm0              \n\t" /* /= 0x80000000 */
+
+#define CONVERT_FUNC(name, stype, dtype, shift, ssize, dsize, BODY, tail)       \
+static void name(unsigned n, const stype *a, dtype *b) {                        \
+    pa_reg_x86 count = n >> shift;                                              \
+                                                                                \
+    __asm__ __volatile__ (                                                      \
+        " test %2, %2                   \n\t"                                   \
+        " je 2f                         \n\t"                                   \
+                                                                                \
+        "1:                             \n\t"                                   \
+        BODY                                                                    \
+        " add $" #ssize ", %0           \n\t"                                   \
+        " add $" #dsize ", %1           \n\t"                                   \
+        " dec %2                        \n\t"                                   \
+        " jne 1b                        \n\t"                                   \
+                                                                                \
+        "2:                             \n\t"                                   \
+        : "+r" (a), "+r" (b), "+r" (count)                                      \
+        : "m" (*one), "m" (*mone), "m" (*scale), "m" (*scale_s32),              \
+          "m" (*scale_s24), "m" (*unpack_s24le), "m" (*unpack_s24be),           \
+          "m" (*pack_s24le), "m" (*pack_s24be)                                  \
+        : "cc", "memory", "xmm0", "xmm1", "xmm7"                                \
+    );                                                                          \
+                                                                                \
+    if (n & ((1 << shift) - 1))                                                 \
+        tail(n & ((1 << shift) - 1), a, b);                                     \
+}
 
-    func = pa_get_convert_from_float32ne_function(PA_SAMPLE_S16LE);
-    func(SAMPLES, floats, samples_ref);
-    pa_sconv_s16le_from_f32ne_sse2(SAMPLES, floats, samples);
+/* to float32ne */
+CONVERT_FUNC(pa_sconv_s16le_to_f32ne_sse2, int16_t, float, 2, 8, 16,
+             LOAD_16 S16_TO_FLOAT STORE_32, pa_sconv_s16le_to_float32ne)
+CONVERT_FUNC(pa_sconv_s16be_to_f32ne_sse2, int16_t, float, 2, 8, 16,
+             LOAD_16 SWAP_16 S16_TO_FLOAT STORE_32, pa_sconv_s16be_to_float32ne)
+CONVERT_FUNC(pa_sconv_s32le_to_f32ne_sse2, int32_t, float, 2, 16, 16,
+             LOAD_32 S32_TO_FLOAT STORE_32, pa_sconv_s32le_to_float32ne)
+CONVERT_FUNC(pa_sconv_s32be_to_f32ne_sse2, int32_t, float, 2, 16, 16,
+             LOAD_32 SWAP_32 S32_TO_FLOAT STORE_32, pa_sconv_s32be_to_float32ne)
+CONVERT_FUNC(pa_sconv_s24_32le_to_f32ne_sse2, uint32_t, float, 2, 16, 16,
+             LOAD_32 " pslld $8, %%xmm0 \n\t" S32_HIGH_TO_FLOAT STORE_32, pa_sconv_s24_32le_to_float32ne)
+CONVERT_FUNC(pa_sconv_s24_32be_to_f32ne_sse2, uint32_t, float, 2, 16, 16,
+             LOAD_32 SWAP_32 " pslld $8, %%xmm0 \n\t" S32_HIGH_TO_FLOAT STORE_32, pa_sconv_s24_32be_to_float32ne)
+CONVERT_FUNC(pa_sconv_s24le_to_f32ne_ssse3, uint8_t, float, 2, 12, 16,
+             LOAD_24 UNPACK_S24LE S32_HIGH_TO_FLOAT STORE_32, pa_sconv_s24le_to_float32ne)
+CONVERT_FUNC(pa_sconv_s24be_to_f32ne_ssse3, uint8_t, float, 2, 12, 16,
+             LOAD_24 UNPACK_S24BE S32_HIGH_TO_FLOAT STORE_32, pa_sconv_s24be_to_float32ne)
+CONVERT_FUNC(pa_sconv_f32re_to_f32ne_sse2, float, float, 2, 16, 16,
+             LOAD_32 SWAP_32 STORE_32, float32re_to_float32ne_c)
+
+/* from float32ne, s16le is above */
+CONVERT_FUNC(pa_sconv_s16be_from_f32ne_sse2, float, int16_t, 2, 16, 8,
+             LOAD_32 FLOAT_TO_S16 SWAP_16 STORE_16, pa_sconv_s16be_from_float32ne)
+CONVERT_FUNC(pa_sconv_s32le_from_f32ne_sse2, float, int32_t, 2, 16, 16,
+             LOAD_32 FLOAT_TO_S32 STORE_32, pa_sconv_s32le_from_float32ne)
+CONVERT_FUNC(pa_sconv_s32be_from_f32ne_sse2, float, int32_t, 2, 16, 16,
+             LOAD_32 FLOAT_TO_S32 SWAP_32 STORE_32, pa_sconv_s32be_from_float32ne)
+CONVERT_FUNC(pa_sconv_s24_32le_from_f32ne_sse2, float, uint32_t, 2, 16, 16,
+             LOAD_32 FLOAT_TO_S32 " psrld $8, %%xmm0 \n\t" STORE_32, pa_sconv_s24_32le_from_float32ne)
+CONVERT_FUNC(pa_sconv_s24_32be_from_f32ne_sse2, float, uint32_t, 2, 16, 16,
+             LOAD_32 FLOAT_TO_S32 " psrld $8, %%xmm0 \n\t" SWAP_32 STORE_32, pa_sconv_s24_32be_from_float32ne)
+CONVERT_FUNC(pa_sconv_s24le_from_f32ne_ssse3, float, uint8_t, 2, 16, 12,
+             LOAD_32 FLOAT_TO_S32 PACK_S24LE STORE_24, pa_sconv_s24le_from_float32ne)
+CONVERT_FUNC(pa_sconv_s24be_from_f32ne_ssse3, float, uint8_t, 2, 16, 12,
+             LOAD_32 FLOAT_TO_S32 PACK_S24BE STORE_24, pa_sconv_s24be_from_float32ne)
+
+/* to s16ne, float32le is pa_sconv_s16le_from_f32ne_sse2() */
+CONVERT_FUNC(pa_sconv_s16re_to_s16ne_sse2, int16_t, int16_t, 3, 16, 16,
+             LOAD_32 SWAP_16 STORE_32, s16re_to_s16ne_c)
+CONVERT_FUNC(pa_sconv_f32be_to_s16ne_sse2, float, int16_t, 2, 16, 8,
+             LOAD_32 SWAP_32 FLOAT_TO_S16 STORE_16, pa_sconv_s16le_from_float32re)
+CONVERT_FUNC(pa_sconv_s32le_to_s16ne_sse2, int32_t, int16_t, 2, 16, 8,
+             LOAD_32 S32_TO_S16 STORE_16, pa_sconv_s32le_to_s16ne)
+CONVERT_FUNC(pa_sconv_s32be_to_s16ne_sse2, int32_t, int16_t, 2, 16, 8,
+             LOAD_32 SWAP_32 S32_TO_S16 STORE_16, pa_sconv_s32be_to_s16ne)
+CONVERT_FUNC(pa_sconv_s24_32le_to_s16ne_sse2, uint32_t, int16_t, 2, 16, 8,
+             LOAD_32 " pslld $8, %%xmm0 \n\t" S32_TO_S16 STORE_16, pa_sconv_s24_32le_to_s16ne)
+CONVERT_FUNC(pa_sconv_s24_32be_to_s16ne_sse2, uint32_t, int16_t, 2, 16, 8,
+             LOAD_32 SWAP_32 " pslld $8, %%xmm0 \n\t" S32_TO_S16 STORE_16, pa_sconv_s24_32be_to_s16ne)
+CONVERT_FUNC(pa_sconv_s24le_to_s16ne_ssse3, uint8_t, int16_t, 2, 12, 8,
+             LOAD_24 UNPACK_S24LE S32_TO_S16 STORE_16, pa_sconv_s24le_to_s16ne)
+CONVERT_FUNC(pa_sconv_s24be_to_s16ne_ssse3, uint8_t, int16_t, 2, 12, 8,
+             LOAD_24 UNPACK_S24BE S32_TO_S16 STORE_16, pa_sconv_s24be_to_s16ne)
+
+/* from s16ne, float32le is pa_sconv_s16le_to_f32ne_sse2() */
+CONVERT_FUNC(pa_sconv_f32be_from_s16ne_sse2, int16_t, float, 2, 8, 16,
+             LOAD_16 S16_TO_FLOAT SWAP_32 STORE_32, pa_sconv_s16le_to_float32re)
+CONVERT_FUNC(pa_sconv_s32le_from_s16ne_sse2, int16_t, int32_t, 2, 8, 16,
+             LOAD_16 S16_TO_S32_HIGH STORE_32, pa_sconv_s32le_from_s16ne)
+CONVERT_FUNC(pa_sconv_s32be_from_s16ne_sse2, int16_t, int32_t, 2, 8, 16,
+             LOAD_16 S16_TO_S32_HIGH SWAP_32 STORE_32, pa_sconv_s32be_from_s16ne)
+CONVERT_FUNC(pa_sconv_s24_32le_from_s16ne_sse2, int16_t, uint32_t, 2, 8, 16,
+             LOAD_16 S16_TO_S32_HIGH " psrld $8, %%xmm0 \n\t" STORE_32, pa_sconv_s24_32le_from_s16ne)
+CONVERT_FUNC(pa_sconv_s24_32be_from_s16ne_sse2, int16_t, uint32_t, 2, 8, 16,
+             LOAD_16 S16_TO_S32_HIGH " psrld $8, %%xmm0 \n\t" SWAP_32 STORE_32, pa_sconv_s24_32be_from_s16ne)
+CONVERT_FUNC(pa_sconv_s24le_from_s16ne_ssse3, int16_t, uint8_t, 2, 8, 12,
+             LOAD_16 S16_TO_S32_HIGH PACK_S24LE STORE_24, pa_sconv_s24le_from_s16ne)
+CONVERT_FUNC(pa_sconv_s24be_from_s16ne_ssse3, int16_t, uint8_t, 2, 8, 12,
+             LOAD_16 S16_TO_S32_HIGH PACK_S24BE STORE_24, pa_sconv_s24be_from_s16ne)
 
-    for (i = 0; i < SAMPLES; i++) {
-        if (samples[i] != samples_ref[i]) {
-            printf ("%d: %04x != %04x (%f)\n", i, samples[i], samples_ref[i],
-                      floats[i]);
-        }
-    }
-
-    start = pa_rtclock_now();
-    for (i = 0; i < TIMES; i++) {
-        pa_sconv_s16le_from_f32ne_sse2(SAMPLES, floats, samples);
-    }
-    stop = pa_rtclock_now();
-    pa_log_info("SSE: %llu usec.", (long long unsigned int)(stop - start));
-
-    start = pa_rtclock_now();
-    for (i = 0; i < TIMES; i++) {
-        func(SAMPLES, floats, samples_ref);
-    }
-    stop = pa_rtclock_now();
-    pa_log_info("ref: %llu usec.", (long long unsigned int)(stop - start));
-}
-#endif
 #endif /* defined (__i386__) || defined (__amd64__) */
 
 
 void pa_convert_func_init_sse(pa_cpu_x86_flag_t flags) {
 #if !defined(__APPLE__) && defined (__i386__) || defined (__amd64__)
 
-#ifdef RUN_TEST
-    run_test();
-#endif
-
     if (flags & PA_CPU_X86_SSE2) {
         pa_log_info("Initialising SSE2 optimized conversions.");
+
+        float32re_to_float32ne_c = pa_get_convert_to_float32ne_function(PA_SAMPLE_FLOAT32RE);
+        s16re_to_s16ne_c = pa_get_convert_to_s16ne_function(PA_SAMPLE_S16RE);
+
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) pa_sconv_s16le_to_f32ne_sse2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S16BE, (pa_convert_func_t) pa_sconv_s16be_to_f32ne_sse2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S32LE, (pa_convert_func_t) pa_sconv_s32le_to_f32ne_sse2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S32BE, (pa_convert_func_t) pa_sconv_s32be_to_f32ne_sse2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24_32LE, (pa_convert_func_t) pa_sconv_s24_32le_to_f32ne_sse2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_S24_32BE, (pa_convert_func_t) pa_sconv_s24_32be_to_f32ne_sse2);
+        pa_set_convert_to_float32ne_function(PA_SAMPLE_FLOAT32RE, (pa_convert_func_t) pa_sconv_f32re_to_f32ne_sse2);
+
         pa_set_convert_from_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_sse2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S16BE, (pa_convert_func_t) pa_sconv_s16be_from_f32ne_sse2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S32LE, (pa_convert_func_t) pa_sconv_s32le_from_f32ne_sse2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S32BE, (pa_convert_func_t) pa_sconv_s32be_from_f32ne_sse2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24_32LE, (pa_convert_func_t) pa_sconv_s24_32le_from_f32ne_sse2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_S24_32BE, (pa_convert_func_t) pa_sconv_s24_32be_from_f32ne_sse2);
+        pa_set_convert_from_float32ne_function(PA_SAMPLE_FLOAT32RE, (pa_convert_func_t) pa_sconv_f32re_to_f32ne_sse2);
+
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S16RE, (pa_convert_func_t) pa_sconv_s16re_to_s16ne_sse2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_FLOAT32LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_sse2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_FLOAT32BE, (pa_convert_func_t) pa_sconv_f32be_to_s16ne_sse2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S32LE, (pa_convert_func_t) pa_sconv_s32le_to_s16ne_sse2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S32BE, (pa_convert_func_t) pa_sconv_s32be_to_s16ne_sse2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S24_32LE, (pa_convert_func_t) pa_sconv_s24_32le_to_s16ne_sse2);
+        pa_set_convert_to_s16ne_function(PA_SAMPLE_S24_32BE, (pa_convert_func_t) pa_sconv_s24_32be_to_s16ne_sse2);
+
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S16RE, (pa_convert_func_t) pa_sconv_s16re_to_s16ne_sse2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_FLOAT32LE, (pa_convert_func_t) pa_sconv_s16le_to_f32ne_sse2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_FLOAT32BE, (pa_convert_func_t) pa_sconv_f32be_from_s16ne_sse2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S32LE, (pa_convert_func_t) pa_sconv_s32le_from_s16ne_sse2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S32BE, (pa_convert_func_t) pa_sconv_s32be_from_s16ne_sse2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S24_32LE, (pa_convert_func_t) pa_sconv_s24_32le_from_s16ne_sse2);
+        pa_set_convert_from_s16ne_function(PA_SAMPLE_S24_32BE, (pa_convert_func_t) pa_sconv_s24_32be_from_s16ne_sse2);
+
+        if (flags & PA_CPU_X86_SSSE3) {
+            pa_log_info("Initialising SSSE3 optimized 24 bit conversions.");
+
+            pa_set_convert_to_float32ne_function(PA_SAMPLE_S24LE, (pa_convert_func_t) pa_sconv_s24le_to_f32ne_ssse3);
+            pa_set_convert_to_float32ne_function(PA_SAMPLE_S24BE, (pa_convert_func_t) pa_sconv_s24be_to_f32ne_ssse3);
+            pa_set_convert_from_float32ne_function(PA_SAMPLE_S24LE, (pa_convert_func_t) pa_sconv_s24le_from_f32ne_ssse3);
+            pa_set_convert_from_float32ne_function(PA_SAMPLE_S24BE, (pa_convert_func_t) pa_sconv_s24be_from_f32ne_ssse3);
+            pa_set_convert_to_s16ne_function(PA_SAMPLE_S24LE, (pa_convert_func_t) pa_sconv_s24le_to_s16ne_ssse3);
+            pa_set_convert_to_s16ne_function(PA_SAMPLE_S24BE, (pa_convert_func_t) pa_sconv_s24be_to_s16ne_ssse3);
+            pa_set_convert_from_s16ne_function(PA_SAMPLE_S24LE, (pa_convert_func_t) pa_sconv_s24le_from_s16ne_ssse3);
+            pa_set_convert_from_s16ne_function(PA_SAMPLE_S24BE, (pa_convert_func_t) pa_sconv_s24be_from_s16ne_ssse3);
+        }
     } else {
         pa_log_info("Initialising SSE optimized conversions.");
         pa_set_convert_from_float32ne_function(PA_SAMPLE_S16LE, (pa_convert_func_t) pa_sconv_s16le_from_f32ne_sse);
@@ -489,6 +489,7 @@ int pa_sink_input_new(
     i->thread_info.resampler = resampler;
     i->thread_info.soft_volume = i->soft_volume;
     i->thread_info.muted = i->muted;
+    i->thread_info.ramp.length = i->thread_info.ramp.left = 0;
     i->thread_info.requested_sink_latency = (pa_usec_t) -1;
     i->thread_info.rewrite_nbytes = 0;
     i->thread_info.rewrite_flush = FALSE;
@@ -742,6 +743,7 @@ void pa_sink_input_put(pa_sink_input *i) {
 
     i->thread_info.soft_volume = i->soft_volume;
     i->thread_info.muted = i->muted;
+    i->thread_info.ramp.length = i->thread_info.ramp.left = 0;
 
     pa_assert_se(pa_asyncmsgq_send(i->sink->asyncmsgq, PA_MSGOBJECT(i->sink), PA_SINK_MESSAGE_ADD_INPUT, i, 0, NULL) == 0);
 
@@ -868,7 +870,11 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink frames */, p
                 wchunk.length = block_size_max_sink_input;
 
             /* It might be necessary to adjust the volume here */
-            if (do_volume_adj_here && !volume_is_norm) {
+            if (do_volume_adj_here && i->thread_info.ramp.left > 0 && !i->thread_info.ramp_on_drop) {
+                pa_memchunk_make_writable(&wchunk, 0);
+                pa_volume_ramp_memchunk(&wchunk, &i->thread_info.sample_spec, &i->thread_info.ramp);
+
+            } else if (do_volume_adj_here && !volume_is_norm) {
                 pa_memchunk_make_writable(&wchunk, 0);
 
                 if (i->thread_info.muted) {
@@ -944,7 +950,15 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink frames */, p
     if (do_volume_adj_here)
         /* We had different channel maps, so we already did the adjustment */
         pa_cvolume_reset(volume, i->sink->sample_spec.channels);
-    else if (i->thread_info.muted)
+    else if (i->thread_info.ramp.left > 0 && i->thread_info.ramp_on_drop) {
+        /* A volume change is being faded in, which the sink can't do
+         * for us. The ramp only moves on when the data is dropped. */
+        pa_volume_ramp r = i->thread_info.ramp;
+
+        pa_memchunk_make_writable(chunk, 0);
+        pa_volume_ramp_memchunk(chunk, &i->sink->sample_spec, &r);
+        pa_cvolume_reset(volume, i->sink->sample_spec.channels);
+    } else if (i->thread_info.muted)
         /* We've both the same channel map, so let's have the sink do the adjustment for us*/
         pa_cvolume_mute(volume, i->sink->sample_spec.channels);
     else
@@ -965,6 +979,9 @@ void pa_sink_input_drop(pa_sink_input *i, size_t nbytes /* in sink sample spec *
 #endif
 
     pa_memblockq_drop(i->thread_info.render_memblockq, nbytes);
+
+    if (i->thread_info.ramp_on_drop)
+        pa_volume_ramp_advance(&i->thread_info.ramp, nbytes / pa_frame_size(&i->sink->sample_spec));
 }
 
 /* Called from thread context */
@@ -986,6 +1003,11 @@ void pa_sink_input_process_rewind(pa_sink_input *i, size_t nbytes /* in sink sam
     if (nbytes > 0 && !i->thread_info.dont_rewind_render) {
         pa_log_debug("Have to rewind %lu bytes on render memblockq.", (unsigned long) nbytes);
         pa_memblockq_rewind(i->thread_info.render_memblockq, nbytes);
+
+        /* That data will be peeked and dropped again, so the ramp
+         * has to go back with it */
+        if (i->thread_info.ramp_on_drop)
+            pa_volume_ramp_rewind(&i->thread_info.ramp, nbytes / pa_frame_size(&i->sink->sample_spec));
     }
 
     if (i->thread_info.rewrite_nbytes == (size_t) -1) {
@@ -1782,6 +1804,54 @@ void pa_sink_input_set_state_within_thread(pa_sink_input *i, pa_sink_input_state
         i->thread_info.state = state;
 }
 
+/* Called from thread context */
+static pa_cvolume* get_thread_volume(pa_sink_input *i, pa_cvolume *v) {
+
+    if (i->thread_info.ramp.left > 0)
+        return pa_volume_ramp_get(&i->thread_info.ramp, v);
+
+    if (i->thread_info.muted)
+        return pa_cvolume_mute(v, i->thread_info.soft_volume.channels);
+
+    *v = i->thread_info.soft_volume;
+    return v;
+}
+
+/* Called from thread context */
+void pa_sink_input_set_soft_volume_within_thread(pa_sink_input *i, const pa_cvolume *volume, pa_bool_t muted) {
+    pa_cvolume from, to;
+    const pa_sample_spec *ss;
+
+    pa_sink_input_assert_ref(i);
+    pa_sink_input_assert_io_context(i);
+    pa_assert(volume);
+
+    if (pa_cvolume_equal(&i->thread_info.soft_volume, volume) && !i->thread_info.muted == !muted)
+        return;
+
+    get_thread_volume(i, &from);
+
+    i->thread_info.soft_volume = *volume;
+    i->thread_info.muted = !!muted;
+    i->thread_info.ramp.length = i->thread_info.ramp.left = 0;
+
+    if (i->core->volume_ramp_usec <= 0) {
+        pa_sink_input_request_rewind(i, 0, TRUE, FALSE, FALSE);
+        return;
+    }
+
+    /* No rewind, what is already in the sink's buffer keeps the old
+     * volume and the new one is faded in from where the buffer ends.
+     * See pa_sink_input_peek() for where the volume is applied. */
+    get_thread_volume(i, &to);
+
+    i->thread_info.ramp_on_drop = pa_channel_map_equal(&i->channel_map, &i->sink->channel_map);
+    ss = i->thread_info.ramp_on_drop ? &i->sink->sample_spec : &i->thread_info.sample_spec;
+
+    pa_volume_ramp_init(&i->thread_info.ramp, i->core->volume_ramp_type, &from, &to,
+                        pa_usec_to_bytes(i->core->volume_ramp_usec, ss) / pa_frame_size(ss));
+}
+
 /* Called from thread context, except when it is not. */
 int pa_sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offset, pa_memchunk *chunk) {
     pa_sink_input *i = PA_SINK_INPUT(o);
@@ -1790,17 +1860,11 @@ int pa_sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t
     switch (code) {
 
         case PA_SINK_INPUT_MESSAGE_SET_SOFT_VOLUME:
-            if (!pa_cvolume_equal(&i->thread_info.soft_volume, &i->soft_volume)) {
-                i->thread_info.soft_volume = i->soft_volume;
-                pa_sink_input_request_rewind(i, 0, TRUE, FALSE, FALSE);
-            }
+            pa_sink_input_set_soft_volume_within_thread(i, &i->soft_volume, i->thread_info.muted);
             return 0;
 
         case PA_SINK_INPUT_MESSAGE_SET_SOFT_MUTE:
-            if (i->thread_info.muted != i->muted) {
-                i->thread_info.muted = i->muted;
-                pa_sink_input_request_rewind(i, 0, TRUE, FALSE, FALSE);
-            }
+            pa_sink_input_set_soft_volume_within_thread(i, &i->thread_info.soft_volume, i->muted);
             return 0;
 
         case PA_SINK_INPUT_MESSAGE_GET_LATENCY: {
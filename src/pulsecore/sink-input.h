@@ -217,6 +217,14 @@ struct pa_sink_input {
         pa_cvolume soft_volume;
         pa_bool_t muted:1;
 
+        /* When volume ramps are enabled, changes of soft_volume and
+         * muted are faded in with this instead of rewinding. If the
+         * sink applies the volume the ramp counts sink frames and is
+         * advanced on drop, otherwise it counts frames of our own
+         * sample spec and is advanced when rendering. */
+        pa_volume_ramp ramp;
+        pa_bool_t ramp_on_drop:1;
+
         pa_bool_t attached:1; /* True only between ->attach() and ->detach() calls */
 
         /* rewrite_nbytes: 0: rewrite nothing, (size_t) -1: rewrite everything, otherwise how many bytes to rewrite */
@@ -390,6 +398,10 @@ void pa_sink_input_update_max_request(pa_sink_input *i, size_t nbytes  /* in the
 
 void pa_sink_input_set_state_within_thread(pa_sink_input *i, pa_sink_input_state_t state);
 
+/* Takes over a new soft volume and mute state, ramping to them if
+ * enabled and rewinding otherwise */
+void pa_sink_input_set_soft_volume_within_thread(pa_sink_input *i, const pa_cvolume *volume, pa_bool_t muted);
+
 int pa_sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offset, pa_memchunk *chunk);
 
 pa_usec_t pa_sink_input_set_requested_latency_within_thread(pa_sink_input *i, pa_usec_t usec);
@@ -2312,13 +2312,8 @@ static void sync_input_volumes_within_thread(pa_sink *s) {
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
 
-    PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state) {
-        if (pa_cvolume_equal(&i->thread_info.soft_volume, &i->soft_volume))
-            continue;
-
-        i->thread_info.soft_volume = i->soft_volume;
-        pa_sink_input_request_rewind(i, 0, TRUE, FALSE, FALSE);
-    }
+    PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state)
+        pa_sink_input_set_soft_volume_within_thread(i, &i->soft_volume, i->thread_info.muted);
 }
 
 /* Called from the IO thread. Only called for the root sink in volume sharing
@@ -37,7 +37,10 @@
 #include <pulsecore/core-error.h>
 #include <pulsecore/sink-input.h>
 #include <pulsecore/log.h>
+#include <pulsecore/thread.h>
 #include <pulsecore/thread-mq.h>
+#include <pulsecore/asyncq.h>
+#include <pulsecore/atomic.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/sndfile-util.h>
 
@@ -45,6 +48,10 @@
 
 #define MEMBLOCKQ_MAXLENGTH (16*1024*1024)
 
+/* How many decoded blocks the decoder thread may be ahead of the IO
+ * thread */
+#define DECODE_QUEUE_LENGTH 16
+
 typedef struct file_stream {
     pa_msgobject parent;
     pa_core *core;
@@ -52,6 +59,16 @@ typedef struct file_stream {
 
     SNDFILE *sndfile;
     sf_count_t (*readf_function)(SNDFILE *sndfile, void *ptr, sf_count_t frames);
+    size_t frame_size;
+
+    /* The file is decoded in a thread of its own, so that neither
+     * disk access nor the decoder ever block the IO thread. Decoded
+     * blocks are handed over in this queue, a chunk without a
+     * memblock marks the end of the file. */
+    pa_thread *thread;
+    pa_asyncq *decoded;
+    pa_atomic_t quit;
+    pa_bool_t eof;
 
     /* We need this memblockq here to easily fulfill rewind requests
      * (even beyond the file start!) */
@@ -65,6 +82,75 @@ enum {
 PA_DEFINE_PRIVATE_CLASS(file_stream, pa_msgobject);
 #define FILE_STREAM(o) (file_stream_cast(o))
 
+static void free_chunk(void *p) {
+    pa_memchunk *chunk = p;
+
+    if (chunk->memblock)
+        pa_memblock_unref(chunk->memblock);
+
+    pa_xfree(chunk);
+}
+
+/* Called from decoder thread context */
+static void decoder_thread_func(void *userdata) {
+    file_stream *u = userdata;
+    pa_memchunk *chunk;
+
+    while (!pa_atomic_load(&u->quit)) {
+        void *p;
+        sf_count_t n;
+        size_t l;
+
+        chunk = pa_xnew(pa_memchunk, 1);
+        chunk->memblock = pa_memblock_new(u->core->mempool, (size_t) -1);
+        chunk->index = 0;
+
+        l = pa_memblock_get_length(chunk->memblock);
+        p = pa_memblock_acquire(chunk->memblock);
+
+        if (u->readf_function)
+            n = u->readf_function(u->sndfile, p, (sf_count_t) (l / u->frame_size));
+        else
+            n = sf_read_raw(u->sndfile, p, (sf_count_t) (l - l % u->frame_size));
+
+        pa_memblock_release(chunk->memblock);
+
+        if (n <= 0) {
+            free_chunk(chunk);
+            break;
+        }
+
+        chunk->length = (size_t) n * (u->readf_function ? u->frame_size : 1);
+
+        /* Blocks while the queue is full */
+        pa_asyncq_push(u->decoded, chunk, TRUE);
+    }
+
+    chunk = pa_xnew0(pa_memchunk, 1);
+    pa_asyncq_push(u->decoded, chunk, TRUE);
+}
+
+/* Called from main context, when the IO thread doesn't access the
+ * queue anymore */
+static void decoder_stop(file_stream *u) {
+    pa_memchunk *chunk;
+
+    pa_assert(u);
+
+    if (!u->thread)
+        return;
+
+    pa_atomic_store(&u->quit, 1);
+
+    /* Make room in the queue, so that the thread doesn't block on it
+     * and sees the quit flag */
+    while ((chunk = pa_asyncq_pop(u->decoded, FALSE)))
+        free_chunk(chunk);
+
+    pa_thread_free(u->thread);
+    u->thread = NULL;
+}
+
 /* Called from main context */
 static void file_stream_unlink(file_stream *u) {
     pa_assert(u);
@@ -73,6 +159,7 @@ static void file_stream_unlink(file_stream *u) {
         return;
 
     pa_sink_input_unlink(u->sink_input);
+    decoder_stop(u);
     pa_sink_input_unref(u->sink_input);
     u->sink_input = NULL;
 
@@ -85,6 +172,11 @@ static void file_stream_free(pa_object *o) {
     file_stream *u = FILE_STREAM(o);
     pa_assert(u);
 
+    decoder_stop(u);
+
+    if (u->decoded)
+        pa_asyncq_free(u->decoded, free_chunk);
+
     if (u->memblockq)
         pa_memblockq_free(u->memblockq);
 
@@ -147,10 +239,7 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t length, pa_memchunk *chunk
         return -1;
 
     for (;;) {
-        pa_memchunk tchunk;
-        size_t fs;
-        void *p;
-        sf_count_t n;
+        pa_memchunk *tchunk;
 
         if (pa_memblockq_peek(u->memblockq, chunk) >= 0) {
             chunk->length = PA_MIN(chunk->length, length);
@@ -158,36 +247,19 @@ static int sink_input_pop_cb(pa_sink_input *i, size_t length, pa_memchunk *chunk
             return 0;
         }
 
-        if (!u->sndfile)
+        if (u->eof)
             break;
 
-        tchunk.memblock = pa_memblock_new(i->sink->core->mempool, length);
-        tchunk.index = 0;
-
-        p = pa_memblock_acquire(tchunk.memblock);
-
-        if (u->readf_function) {
-            fs = pa_frame_size(&i->sample_spec);
-            n = u->readf_function(u->sndfile, p, (sf_count_t) (length/fs));
-        } else {
-            fs = 1;
-            n = sf_read_raw(u->sndfile, p, (sf_count_t) length);
-        }
-
-        pa_memblock_release(tchunk.memblock);
+        /* If the decoder thread is lagging behind we underrun */
+        if (!(tchunk = pa_asyncq_pop(u->decoded, FALSE)))
+            return -1;
 
-        if (n <= 0) {
-            pa_memblock_unref(tchunk.memblock);
+        if (!tchunk->memblock)
+            u->eof = TRUE;
+        else
+            pa_memblockq_push(u->memblockq, tchunk);
 
-            sf_close(u->sndfile);
-            u->sndfile = NULL;
-            break;
-        }
-
-        tchunk.length = (size_t) n * fs;
-
-        pa_memblockq_push(u->memblockq, &tchunk);
-        pa_memblock_unref(tchunk.memblock);
+        free_chunk(tchunk);
     }
 
     if (pa_sink_input_safe_to_remove(i)) {
@@ -229,7 +301,10 @@ static void sink_input_update_max_rewind_cb(pa_sink_input *i, size_t nbytes) {
 int pa_play_file(
         pa_sink *sink,
         const char *fname,
-        const pa_cvolume *volume) {
+        const pa_cvolume *volume,
+        pa_proplist *p,
+        pa_sink_input_flags_t flags,
+        uint32_t *sink_input_index) {
 
     file_stream *u = NULL;
     pa_sample_spec ss;
@@ -249,6 +324,10 @@ int pa_play_file(
     u->sink_input = NULL;
     u->sndfile = NULL;
     u->readf_function = NULL;
+    u->thread = NULL;
+    u->decoded = NULL;
+    pa_atomic_store(&u->quit, 0);
+    u->eof = FALSE;
     u->memblockq = NULL;
 
     if ((fd = pa_open_cloexec(fname, O_RDONLY, 0)) < 0) {
@@ -256,11 +335,6 @@ int pa_play_file(
         goto fail;
     }
 
-    /* FIXME: For now we just use posix_fadvise to avoid page faults
-     * when accessing the file data. Eventually we should move the
-     * file reader into the main event loop and pass the data over the
-     * asyncmsgq. */
-
 #ifdef HAVE_POSIX_FADVISE
     if (posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL) < 0) {
         pa_log_warn("POSIX_FADV_SEQUENTIAL failed: %s", pa_cstrerror(errno));
@@ -295,6 +369,16 @@ int pa_play_file(
     }
 
     u->readf_function = pa_sndfile_readf_function(&ss);
+    u->frame_size = pa_frame_size(&ss);
+
+    /* Start decoding right away, so that there is something to play
+     * once the sink asks for it */
+    u->decoded = pa_asyncq_new(DECODE_QUEUE_LENGTH);
+
+    if (!(u->thread = pa_thread_new("file-decoder", decoder_thread_func, u))) {
+        pa_log("Failed to create decoder thread.");
+        goto fail;
+    }
 
     pa_sink_input_new_data_init(&data);
     pa_sink_input_new_data_set_sink(&data, sink, FALSE);
@@ -305,6 +389,10 @@ int pa_play_file(
     pa_proplist_sets(data.proplist, PA_PROP_MEDIA_NAME, pa_path_get_filename(fname));
     pa_proplist_sets(data.proplist, PA_PROP_MEDIA_FILENAME, fname);
     pa_sndfile_init_proplist(u->sndfile, data.proplist);
+    data.flags |= flags;
+
+    if (p)
+        pa_proplist_update(data.proplist, PA_UPDATE_REPLACE, p);
 
     pa_sink_input_new(&u->sink_input, sink->core, &data);
     pa_sink_input_new_data_done(&data);
@@ -325,6 +413,9 @@ int pa_play_file(
 
     pa_sink_input_put(u->sink_input);
 
+    if (sink_input_index)
+        *sink_input_index = u->sink_input->index;
+
     /* The reference to u is dangling here, because we want to keep
      * this stream around until it is fully played. */
 
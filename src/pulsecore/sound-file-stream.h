@@ -24,6 +24,6 @@
 
 #include <pulsecore/sink.h>
 
-int pa_play_file(pa_sink *sink, const char *fname, const pa_cvolume *volume);
+int pa_play_file(pa_sink *sink, const char *fname, const pa_cvolume *volume, pa_proplist *p, pa_sink_input_flags_t flags, uint32_t *sink_input_index);
 
 #endif
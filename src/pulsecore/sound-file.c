@@ -23,22 +23,186 @@
 #include <config.h>
 #endif
 
+#include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 
 #include <sndfile.h>
 
 #include <pulse/sample.h>
+#include <pulse/xmalloc.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/core-error.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/core-scache.h>
 #include <pulsecore/sndfile-util.h>
+#include <pulsecore/mutex.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/memtrap.h>
 
 #include "sound-file.h"
 
+/* How much of a mapped file we ask the kernel to read ahead right
+ * away, so that the first periods don't page fault in the IO thread */
+#define MAP_READAHEAD (256*1024)
+
+#ifdef HAVE_SYS_MMAN_H
+
+/* The memblock free callback only gets the data pointer, so we
+ * remember where each mapping starts and how long it is. If the file
+ * is truncated while it is mapped the trap turns the missing part into
+ * silence instead of killing us with SIGBUS. */
+typedef struct file_mapping {
+    void *data;
+    void *start;
+    size_t size;
+    pa_memtrap *trap;
+    PA_LLIST_FIELDS(struct file_mapping);
+} file_mapping;
+
+static PA_LLIST_HEAD(file_mapping, mappings) = NULL;
+static pa_static_mutex mappings_mutex = PA_STATIC_MUTEX_INIT;
+
+static void unmap_cb(void *data) {
+    pa_mutex *m;
+    file_mapping *fm;
+
+    m = pa_static_mutex_get(&mappings_mutex, FALSE, FALSE);
+    pa_mutex_lock(m);
+
+    PA_LLIST_FOREACH(fm, mappings)
+        if (fm->data == data)
+            break;
+
+    pa_assert(fm);
+    PA_LLIST_REMOVE(file_mapping, mappings, fm);
+
+    pa_mutex_unlock(m);
+
+    if (fm->trap)
+        pa_memtrap_remove(fm->trap);
+
+    munmap(fm->start, fm->size);
+    pa_xfree(fm);
+}
+
+/* Returns the offset of the sample data in a little endian RIFF WAVE
+ * file */
+static int wav_find_data(int fd, off_t *offset) {
+    uint8_t h[12];
+    off_t pos = 12;
+
+    if (pread(fd, h, sizeof(h), 0) != sizeof(h) ||
+        memcmp(h, "RIFF", 4) != 0 ||
+        memcmp(h + 8, "WAVE", 4) != 0)
+        return -1;
+
+    for (;;) {
+        uint8_t c[8];
+        uint32_t l;
+
+        if (pread(fd, c, sizeof(c), pos) != sizeof(c))
+            return -1;
+
+        if (memcmp(c, "data", 4) == 0) {
+            *offset = pos + 8;
+            return 0;
+        }
+
+        l = (uint32_t) c[4] | ((uint32_t) c[5] << 8) | ((uint32_t) c[6] << 16) | ((uint32_t) c[7] << 24);
+        pos += 8 + (off_t) l + (l & 1);
+    }
+}
+
+#endif
+
+/* PCM WAV files whose samples are stored the way we'd keep them in
+ * memory anyway can be mapped instead of read */
+static pa_bool_t can_map(const SF_INFO *sfi, const pa_sample_spec *ss) {
+
+#ifdef HAVE_SYS_MMAN_H
+    if ((sfi->format & SF_FORMAT_TYPEMASK) != SF_FORMAT_WAV &&
+        (sfi->format & SF_FORMAT_TYPEMASK) != SF_FORMAT_WAVEX)
+        return FALSE;
+
+    switch (sfi->format & SF_FORMAT_SUBMASK) {
+        case SF_FORMAT_PCM_16:
+        case SF_FORMAT_PCM_24:
+        case SF_FORMAT_PCM_32:
+        case SF_FORMAT_FLOAT:
+            /* WAV is little endian */
+            return pa_sample_format_is_le(ss->format) > 0;
+
+        case SF_FORMAT_ULAW:
+        case SF_FORMAT_ALAW:
+            return TRUE;
+    }
+#endif
+
+    return FALSE;
+}
+
+#ifdef HAVE_SYS_MMAN_H
+
+/* Returns 1 if the file doesn't qualify for mapping */
+static int map_file(pa_mempool *pool, int fd, const SF_INFO *sfi, const pa_sample_spec *ss, pa_memchunk *chunk) {
+    struct stat st;
+    off_t offset, start;
+    size_t l;
+    void *p;
+    file_mapping *fm;
+    pa_mutex *m;
+
+    if (!can_map(sfi, ss))
+        return 1;
+
+    if (wav_find_data(fd, &offset) < 0 || fstat(fd, &st) < 0)
+        return 1;
+
+    l = pa_frame_size(ss) * (size_t) sfi->frames;
+
+    if (l <= 0 || offset + (off_t) l > st.st_size)
+        return 1;
+
+    start = offset & ~((off_t) PA_PAGE_SIZE - 1);
+
+    if ((p = mmap(NULL, (size_t) (offset - start) + l, PROT_READ, MAP_PRIVATE, fd, start)) == MAP_FAILED) {
+        pa_log_debug("mmap() failed: %s", pa_cstrerror(errno));
+        return 1;
+    }
+
+#ifdef HAVE_POSIX_MADVISE
+    posix_madvise(p, (size_t) (offset - start) + l, POSIX_MADV_SEQUENTIAL);
+    posix_madvise(p, PA_MIN((size_t) (offset - start) + l, (size_t) MAP_READAHEAD), POSIX_MADV_WILLNEED);
+#endif
+
+    fm = pa_xnew(file_mapping, 1);
+    fm->start = p;
+    fm->size = (size_t) (offset - start) + l;
+    fm->data = (uint8_t*) p + (offset - start);
+    fm->trap = pa_memtrap_add(fm->start, fm->size);
+
+    m = pa_static_mutex_get(&mappings_mutex, FALSE, FALSE);
+    pa_mutex_lock(m);
+    PA_LLIST_PREPEND(file_mapping, mappings, fm);
+    pa_mutex_unlock(m);
+
+    chunk->memblock = pa_memblock_new_user(pool, fm->data, l, unmap_cb, TRUE);
+    chunk->index = 0;
+    chunk->length = l;
+
+    return 0;
+}
+
+#endif
+
 int pa_sound_file_load(
         pa_mempool *pool,
         const char *fname,
@@ -54,6 +218,9 @@ int pa_sound_file_load(
     sf_count_t (*readf_function)(SNDFILE *sndfile, void *ptr, sf_count_t frames) = NULL;
     void *ptr = NULL;
     int fd;
+#ifdef HAVE_SYS_MMAN_H
+    int map_fd;
+#endif
 
     pa_assert(fname);
     pa_assert(ss);
@@ -80,6 +247,9 @@ int pa_sound_file_load(
         goto finish;
     }
 
+#ifdef HAVE_SYS_MMAN_H
+    map_fd = fd;
+#endif
     fd = -1;
 
     if (pa_sndfile_read_sample_spec(sf, ss) < 0) {
@@ -96,6 +266,15 @@ int pa_sound_file_load(
     if (p)
         pa_sndfile_init_proplist(sf, p);
 
+#ifdef HAVE_SYS_MMAN_H
+    /* The file descriptor is still owned by sf here */
+    if (map_file(pool, map_fd, &sfi, ss, chunk) == 0) {
+        pa_log_debug("Mapped %lu bytes of %s", (unsigned long) chunk->length, fname);
+        ret = 0;
+        goto finish;
+    }
+#endif
+
     if ((l = pa_frame_size(ss) * (size_t) sfi.frames) > PA_SCACHE_ENTRY_SIZE_MAX) {
         pa_log("File too large");
         goto finish;
@@ -134,30 +313,40 @@ finish:
     return ret;
 }
 
-int pa_sound_file_too_big_to_cache(const char *fname) {
+int pa_sound_file_too_big_to_cache(const char *fname, pa_sample_spec *ss, pa_channel_map *map) {
 
     SNDFILE*sf = NULL;
     SF_INFO sfi;
-    pa_sample_spec ss;
+    pa_sample_spec _ss;
 
     pa_assert(fname);
 
+    if (!ss)
+        ss = &_ss;
+
     pa_zero(sfi);
     if (!(sf = sf_open(fname, SFM_READ, &sfi))) {
         pa_log("Failed to open file %s", fname);
         return -1;
     }
 
-    if (pa_sndfile_read_sample_spec(sf, &ss) < 0) {
+    if (pa_sndfile_read_sample_spec(sf, ss) < 0) {
         pa_log("Failed to determine file sample format.");
         sf_close(sf);
         return -1;
     }
 
+    if (map && pa_sndfile_read_channel_map(sf, map) < 0)
+        pa_channel_map_init_extend(map, ss->channels, PA_CHANNEL_MAP_DEFAULT);
+
     sf_close(sf);
 
-    if ((pa_frame_size(&ss) * (size_t) sfi.frames) > PA_SCACHE_ENTRY_SIZE_MAX) {
-        pa_log("File too large: %s", fname);
+    /* Mapped files don't take up memory of their own */
+    if (can_map(&sfi, ss))
+        return 0;
+
+    if ((pa_frame_size(ss) * (size_t) sfi.frames) > PA_SCACHE_ENTRY_STREAM_SIZE) {
+        pa_log_debug("File too large to cache, streaming it: %s", fname);
         return 1;
     }
 
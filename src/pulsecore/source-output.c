@@ -796,7 +796,12 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
             if (qchunk.length > mbs)
                 qchunk.length = mbs;
 
-            pa_resampler_run(o->thread_info.resampler, &qchunk, &rchunk);
+            /* Unchanged data may have gone through the same peak
+             * detection for another output already */
+            if (volume_is_norm)
+                pa_resampler_run_cached(o->thread_info.resampler, o->source->thread_info.resampler_cache, &qchunk, &rchunk);
+            else
+                pa_resampler_run(o->thread_info.resampler, &qchunk, &rchunk);
 
             if (rchunk.length > 0) {
                 if (nvfs) {
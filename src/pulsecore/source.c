@@ -307,6 +307,7 @@ pa_source* pa_source_new(
 
     s->thread_info.rtpoll = NULL;
     s->thread_info.outputs = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+    s->thread_info.resampler_cache = pa_resampler_cache_new();
     s->thread_info.soft_volume = s->soft_volume;
     s->thread_info.soft_muted = s->muted;
     s->thread_info.state = s->state;
@@ -656,6 +657,9 @@ static void source_free(pa_object *o) {
 
     pa_hashmap_free(s->thread_info.outputs, NULL, NULL);
 
+    if (s->thread_info.resampler_cache)
+        pa_resampler_cache_free(s->thread_info.resampler_cache);
+
     if (s->silence.memblock)
         pa_memblock_unref(s->silence.memblock);
 
@@ -37,6 +37,7 @@ typedef struct pa_source_volume_change pa_source_volume_change;
 #include <pulsecore/core.h>
 #include <pulsecore/idxset.h>
 #include <pulsecore/memchunk.h>
+#include <pulsecore/resampler.h>
 #include <pulsecore/sink.h>
 #include <pulsecore/module.h>
 #include <pulsecore/asyncmsgq.h>
@@ -191,6 +192,9 @@ struct pa_source {
         pa_source_state_t state;
         pa_hashmap *outputs;
 
+        /* Lets level meters of several clients share their peaks */
+        pa_resampler_cache *resampler_cache;
+
         pa_rtpoll *rtpoll;
 
         pa_cvolume soft_volume;
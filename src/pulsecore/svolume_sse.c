@@ -252,6 +252,202 @@ static void pa_volume_s16re_sse2(int16_t *samples, int32_t *volumes, unsigned ch
     );
 }
 
+/* The loop shared by all the 32 bit formats, same structure as the s16
+ * ones above. PRE and POST convert a register of samples to and from
+ * s32, VOLUME applies the volumes at the given offset into the table. */
+#define VOLUME_32_LOOP(PRE,VOLUME,POST)                                          \
+        " xor %3, %3                    \n\t"                                    \
+        " sar $2, %2                    \n\t" /* length /= 4 */                  \
+                                                                                 \
+        " test $1, %2                   \n\t" /* check for odd samples */        \
+        " je 2f                         \n\t"                                    \
+                                                                                 \
+        " movd (%0), %%xmm1             \n\t"                                    \
+        PRE (%%xmm1)                                                             \
+        VOLUME (%%xmm1, 0)                                                       \
+        POST (%%xmm1)                                                            \
+        " movd %%xmm1, (%0)             \n\t"                                    \
+        " add $4, %0                    \n\t"                                    \
+        MOD_ADD ($1, %5)                                                         \
+                                                                                 \
+        "2:                             \n\t"                                    \
+        " sar $1, %2                    \n\t" /* prepare for 2 samples at a time */ \
+        " test $1, %2                   \n\t"                                    \
+        " je 4f                         \n\t"                                    \
+                                                                                 \
+        " movq (%0), %%xmm1             \n\t"                                    \
+        PRE (%%xmm1)                                                             \
+        VOLUME (%%xmm1, 0)                                                       \
+        POST (%%xmm1)                                                            \
+        " movq %%xmm1, (%0)             \n\t"                                    \
+        " add $8, %0                    \n\t"                                    \
+        MOD_ADD ($2, %5)                                                         \
+                                                                                 \
+        "4:                             \n\t"                                    \
+        " sar $1, %2                    \n\t" /* prepare for 4 samples at a time */ \
+        " test $1, %2                   \n\t"                                    \
+        " je 6f                         \n\t"                                    \
+                                                                                 \
+        " movdqu (%0), %%xmm1           \n\t"                                    \
+        PRE (%%xmm1)                                                             \
+        VOLUME (%%xmm1, 0)                                                       \
+        POST (%%xmm1)                                                            \
+        " movdqu %%xmm1, (%0)           \n\t"                                    \
+        " add $16, %0                   \n\t"                                    \
+        MOD_ADD ($4, %5)                                                         \
+                                                                                 \
+        "6:                             \n\t"                                    \
+        " sar $1, %2                    \n\t" /* prepare for 8 samples at a time */ \
+        " cmp $0, %2                    \n\t"                                    \
+        " je 8f                         \n\t"                                    \
+                                                                                 \
+        "7:                             \n\t"                                    \
+        " movdqu (%0), %%xmm1           \n\t"                                    \
+        " movdqu 16(%0), %%xmm3         \n\t"                                    \
+        PRE (%%xmm1)                                                             \
+        PRE (%%xmm3)                                                             \
+        VOLUME (%%xmm1, 0)                                                       \
+        VOLUME (%%xmm3, 16)                                                      \
+        POST (%%xmm1)                                                            \
+        POST (%%xmm3)                                                            \
+        " movdqu %%xmm1, (%0)           \n\t"                                    \
+        " movdqu %%xmm3, 16(%0)         \n\t"                                    \
+        " add $32, %0                   \n\t"                                    \
+        MOD_ADD ($8, %5)                                                         \
+        " dec %2                        \n\t"                                    \
+        " jne 7b                        \n\t"                                    \
+        "8:                             \n\t"
+
+#define NO_SHIFT(s) ""
+
+#define S24_32_TO_S32(s)                                                         \
+      " pslld $8, "#s"               \n\t"
+
+#define S32_TO_S24_32(s)                                                         \
+      " psrld $8, "#s"               \n\t"
+
+#define VOLUME_FLOAT(s,o)                                                        \
+      " movups "#o"(%q1, %3, 4), %%xmm4 \n\t"                                    \
+      " mulps %%xmm4, "#s"           \n\t"
+
+/* 32x16 multiply, volumes of at most 1.0 only, so nothing needs to be
+ * clamped. Per sample s = sh << 16 | sl and volume v = vh << 16 | vl:
+ *
+ *  (s * v) >> 16 = (s * vh) + (sh * vl) + ((sl * vl) >> 16)
+ *
+ * pmaddwd only does signed words, for vl >= 0x8000 it multiplies with
+ * vl - 0x10000 and (sh << 16) is added back with the mask. vh is 0 or
+ * 1 and then vl is 0, the mask is all ones then. The table holds three
+ * blocks of 64 entries, | vl << 16 |, the mask and | vl |. */
+#define VOLUME_32x32(s,o)                                                        \
+      " movdqu "#o"(%q1, %3, 4), %%xmm4     \n\t" /* .. | vl  0 | */             \
+      " movdqu "#o"+256(%q1, %3, 4), %%xmm5 \n\t" /* .. |  mask | */             \
+      " movdqu "#o"+512(%q1, %3, 4), %%xmm6 \n\t" /* .. |  0 vl | */             \
+      " pmaddwd "#s", %%xmm4                \n\t" /* .. | sh * vl | */           \
+      " pand "#s", %%xmm5                   \n\t" /* .. | sh  0 | */             \
+      " pmulhuw "#s", %%xmm6                \n\t" /* .. | 0 (sl * vl) >> 16 | */ \
+      " paddd %%xmm5, %%xmm4                \n\t"                                \
+      " paddd %%xmm6, %%xmm4                \n\t"                                \
+      " movdqa %%xmm4, "#s"                 \n\t"
+
+static void pa_volume_float32ne_sse2(float *samples, float *volumes, unsigned channels, unsigned length) {
+    pa_reg_x86 channel, temp;
+
+    /* Channels must be at least 8 and always a multiple of the original number.
+     * This is also the max amount we overread the volume array, which should
+     * have enough padding. */
+    if (channels < 8)
+        channels = channel_overread_table[channels];
+
+    __asm__ __volatile__ (
+        VOLUME_32_LOOP (NO_SHIFT, VOLUME_FLOAT, NO_SHIFT)
+
+        : "+r" (samples), "+r" (volumes), "+r" (length), "=&D" (channel), "=&r" (temp)
+#if defined (__i386__)
+        : "m" (channels)
+#else
+        : "r" ((pa_reg_x86)channels)
+#endif
+        : "cc", "memory", "xmm1", "xmm3", "xmm4"
+    );
+}
+
+/* The C versions, for volumes above 1.0 */
+static pa_do_volume_func_t volume_s32ne_c;
+static pa_do_volume_func_t volume_s24_32ne_c;
+
+/* Splits the volumes into the table VOLUME_32x32 wants, fails if one of
+ * them is above 1.0 */
+static pa_bool_t split_volumes_32x32(int32_t *table, const int32_t *volumes, unsigned channels, unsigned n) {
+    unsigned i;
+
+    for (i = 0; i < channels; i++)
+        if (volumes[i] > 0x10000)
+            return FALSE;
+
+    for (i = 0; i < n + 8; i++) {
+        uint32_t vl = (uint32_t) volumes[i] & 0xFFFF;
+
+        table[i] = (int32_t) (vl << 16);
+        table[64 + i] = volumes[i] >= 0x10000 ? -1 : (vl >= 0x8000 ? (int32_t) 0xFFFF0000 : 0);
+        table[128 + i] = (int32_t) vl;
+    }
+
+    return TRUE;
+}
+
+static void pa_volume_s32ne_sse2(int32_t *samples, int32_t *volumes, unsigned channels, unsigned length) {
+    int32_t table[3 * 64];
+    int32_t *t = table;
+    pa_reg_x86 channel, temp;
+    unsigned n;
+
+    n = channels < 8 ? (unsigned) channel_overread_table[channels] : channels;
+
+    if (!split_volumes_32x32(table, volumes, channels, n)) {
+        volume_s32ne_c(samples, volumes, channels, length);
+        return;
+    }
+
+    __asm__ __volatile__ (
+        VOLUME_32_LOOP (NO_SHIFT, VOLUME_32x32, NO_SHIFT)
+
+        : "+r" (samples), "+r" (t), "+r" (length), "=&D" (channel), "=&r" (temp)
+#if defined (__i386__)
+        : "m" (n)
+#else
+        : "r" ((pa_reg_x86)n)
+#endif
+        : "cc", "memory", "xmm1", "xmm3", "xmm4", "xmm5", "xmm6"
+    );
+}
+
+static void pa_volume_s24_32ne_sse2(uint32_t *samples, int32_t *volumes, unsigned channels, unsigned length) {
+    int32_t table[3 * 64];
+    int32_t *t = table;
+    pa_reg_x86 channel, temp;
+    unsigned n;
+
+    n = channels < 8 ? (unsigned) channel_overread_table[channels] : channels;
+
+    if (!split_volumes_32x32(table, volumes, channels, n)) {
+        volume_s24_32ne_c(samples, volumes, channels, length);
+        return;
+    }
+
+    __asm__ __volatile__ (
+        VOLUME_32_LOOP (S24_32_TO_S32, VOLUME_32x32, S32_TO_S24_32)
+
+        : "+r" (samples), "+r" (t), "+r" (length), "=&D" (channel), "=&r" (temp)
+#if defined (__i386__)
+        : "m" (n)
+#else
+        : "r" ((pa_reg_x86)n)
+#endif
+        : "cc", "memory", "xmm1", "xmm3", "xmm4", "xmm5", "xmm6"
+    );
+}
+
 #undef RUN_TEST
 
 #ifdef RUN_TEST
@@ -346,6 +542,14 @@ void pa_volume_func_init_sse(pa_cpu_x86_flag_t flags) {
 
         pa_set_volume_func(PA_SAMPLE_S16NE, (pa_do_volume_func_t) pa_volume_s16ne_sse2);
         pa_set_volume_func(PA_SAMPLE_S16RE, (pa_do_volume_func_t) pa_volume_s16re_sse2);
+        pa_set_volume_func(PA_SAMPLE_FLOAT32NE, (pa_do_volume_func_t) pa_volume_float32ne_sse2);
+
+        if (pa_get_volume_func(PA_SAMPLE_S32NE) != (pa_do_volume_func_t) pa_volume_s32ne_sse2) {
+            volume_s32ne_c = pa_get_volume_func(PA_SAMPLE_S32NE);
+            volume_s24_32ne_c = pa_get_volume_func(PA_SAMPLE_S24_32NE);
+        }
+        pa_set_volume_func(PA_SAMPLE_S32NE, (pa_do_volume_func_t) pa_volume_s32ne_sse2);
+        pa_set_volume_func(PA_SAMPLE_S24_32NE, (pa_do_volume_func_t) pa_volume_s24_32ne_sse2);
     }
 #endif /* defined (__i386__) || defined (__amd64__) */
 }
@@ -37,6 +37,7 @@
 
 #include <pulsecore/socket.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/flist.h>
 
 #include "tagstruct.h"
 
@@ -50,12 +51,16 @@ struct pa_tagstruct {
     pa_bool_t dynamic;
 };
 
+PA_STATIC_FLIST_DECLARE(tagstructs, 0, pa_xfree);
+
 pa_tagstruct *pa_tagstruct_new(const uint8_t* data, size_t length) {
     pa_tagstruct*t;
 
     pa_assert(!data || (data && length));
 
-    t = pa_xnew(pa_tagstruct, 1);
+    if (!(t = pa_flist_pop(PA_STATIC_FLIST_GET(tagstructs))))
+        t = pa_xnew(pa_tagstruct, 1);
+
     t->data = (uint8_t*) data;
     t->allocated = t->length = data ? length : 0;
     t->rindex = 0;
@@ -69,7 +74,9 @@ void pa_tagstruct_free(pa_tagstruct*t) {
 
     if (t->dynamic)
         pa_xfree(t->data);
-    pa_xfree(t);
+
+    if (pa_flist_push(PA_STATIC_FLIST_GET(tagstructs), t) < 0)
+        pa_xfree(t);
 }
 
 uint8_t* pa_tagstruct_free_data(pa_tagstruct*t, size_t *l) {
@@ -81,7 +88,10 @@ uint8_t* pa_tagstruct_free_data(pa_tagstruct*t, size_t *l) {
 
     p = t->data;
     *l = t->length;
-    pa_xfree(t);
+
+    if (pa_flist_push(PA_STATIC_FLIST_GET(tagstructs), t) < 0)
+        pa_xfree(t);
+
     return p;
 }
 
@@ -92,7 +102,10 @@ static void extend(pa_tagstruct*t, size_t l) {
     if (t->length+l <= t->allocated)
         return;
 
-    t->data = pa_xrealloc(t->data, t->allocated = t->length+l+100);
+    /* Grow geometrically, so that building a large reply field by
+     * field needs only a logarithmic number of reallocations */
+    t->allocated = PA_MAX(t->length+l+100, t->allocated*2);
+    t->data = pa_xrealloc(t->data, t->allocated);
 }
 
 void pa_tagstruct_puts(pa_tagstruct*t, const char *s) {
@@ -0,0 +1,31 @@
+#ifndef footestsalloccounthfoo
+#define footestsalloccounthfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+/* Heap allocation counters for the benchmarking tests. Linking
+ * tests/alloc-count.c wraps malloc(), calloc() and realloc(); where
+ * that isn't possible both counters stay at 0. reallocs are included
+ * in the allocation count. */
+
+unsigned alloc_count_allocs(void);
+unsigned alloc_count_reallocs(void);
+
+#endif
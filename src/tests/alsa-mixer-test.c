@@ -0,0 +1,313 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include <modules/alsa/alsa-mixer.h>
+
+/* Drives the volume calls of a synthesized path against a fake mixer
+ * implemented below in place of the simple mixer API of alsa-lib. It
+ * checks that the dB tables give the same results as asking the mixer
+ * and measures the calls with and without cached handles and tables. */
+
+#define N_ELEMENTS 40
+#define N_STEPS 256
+#define N_CHANNELS 2
+#define N_ROUNDS 2000
+
+struct fake_selem_id {
+    char name[60];
+    unsigned index;
+};
+
+struct fake_elem {
+    char name[60];
+    long step[N_CHANNELS];
+    int on;
+};
+
+static struct fake_elem elements[N_ELEMENTS];
+static snd_mixer_t *fake_mixer = (snd_mixer_t*) elements;
+static unsigned n_lookups = 0, n_conversions = 0;
+
+/* Two linear segments, a coarse one at the bottom and a fine one at the
+ * top, like many codecs have */
+static long step_to_dB(long s) {
+    return s < 128 ? -9525 + 50 * s : -3150 + 25 * (s - 128);
+}
+
+/* What the TLV code in alsa-lib does, walking the steps */
+static long dB_to_step(long v, int dir) {
+    long s;
+
+    n_conversions++;
+
+    if (dir > 0) {
+        for (s = 0; s < N_STEPS - 1; s++)
+            if (step_to_dB(s) >= v)
+                break;
+    } else {
+        for (s = N_STEPS - 1; s > 0; s--)
+            if (step_to_dB(s) <= v)
+                break;
+    }
+
+    return s;
+}
+
+size_t snd_mixer_selem_id_sizeof(void) {
+    return sizeof(struct fake_selem_id);
+}
+
+void snd_mixer_selem_id_set_name(snd_mixer_selem_id_t *obj, const char *val) {
+    pa_strlcpy(((struct fake_selem_id*) obj)->name, val, sizeof(((struct fake_selem_id*) obj)->name));
+}
+
+void snd_mixer_selem_id_set_index(snd_mixer_selem_id_t *obj, unsigned int val) {
+    ((struct fake_selem_id*) obj)->index = val;
+}
+
+snd_mixer_elem_t *snd_mixer_find_selem(snd_mixer_t *mixer, const snd_mixer_selem_id_t *id) {
+    unsigned i;
+
+    pa_assert(mixer == fake_mixer);
+    n_lookups++;
+
+    for (i = 0; i < N_ELEMENTS; i++)
+        if (strcmp(elements[i].name, ((const struct fake_selem_id*) id)->name) == 0)
+            return (snd_mixer_elem_t*) &elements[i];
+
+    return NULL;
+}
+
+static struct fake_elem *E(snd_mixer_elem_t *elem) {
+    pa_assert((struct fake_elem*) elem >= elements && (struct fake_elem*) elem < elements + N_ELEMENTS);
+    return (struct fake_elem*) elem;
+}
+
+int snd_mixer_selem_has_playback_switch(snd_mixer_elem_t *elem) { E(elem); return 1; }
+int snd_mixer_selem_has_capture_switch(snd_mixer_elem_t *elem) { E(elem); return 0; }
+int snd_mixer_selem_has_playback_volume(snd_mixer_elem_t *elem) { E(elem); return 1; }
+int snd_mixer_selem_has_capture_volume(snd_mixer_elem_t *elem) { E(elem); return 0; }
+int snd_mixer_selem_is_enumerated(snd_mixer_elem_t *elem) { E(elem); return 0; }
+int snd_mixer_selem_is_playback_mono(snd_mixer_elem_t *elem) { E(elem); return 0; }
+
+int snd_mixer_selem_has_playback_channel(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel) {
+    E(elem);
+    return channel >= 0 && channel < N_CHANNELS;
+}
+
+int snd_mixer_selem_has_capture_channel(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel) {
+    E(elem);
+    return 0;
+}
+
+int snd_mixer_selem_get_playback_volume_range(snd_mixer_elem_t *elem, long *min, long *max) {
+    E(elem);
+    *min = 0;
+    *max = N_STEPS - 1;
+    return 0;
+}
+
+int snd_mixer_selem_get_playback_dB_range(snd_mixer_elem_t *elem, long *min, long *max) {
+    E(elem);
+    *min = step_to_dB(0);
+    *max = step_to_dB(N_STEPS - 1);
+    return 0;
+}
+
+int snd_mixer_selem_ask_playback_vol_dB(snd_mixer_elem_t *elem, long value, long *dBvalue) {
+    E(elem);
+    n_conversions++;
+    *dBvalue = step_to_dB(value);
+    return 0;
+}
+
+int snd_mixer_selem_ask_playback_dB_vol(snd_mixer_elem_t *elem, long dBvalue, int dir, long *value) {
+    E(elem);
+    *value = dB_to_step(dBvalue, dir);
+    return 0;
+}
+
+int snd_mixer_selem_get_playback_volume(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value) {
+    *value = E(elem)->step[channel];
+    return 0;
+}
+
+int snd_mixer_selem_set_playback_volume(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long value) {
+    pa_assert(value >= 0 && value < N_STEPS);
+    E(elem)->step[channel] = value;
+    return 0;
+}
+
+int snd_mixer_selem_get_playback_dB(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long *value) {
+    n_conversions++;
+    *value = step_to_dB(E(elem)->step[channel]);
+    return 0;
+}
+
+int snd_mixer_selem_set_playback_dB(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, long value, int dir) {
+    E(elem)->step[channel] = dB_to_step(value, dir);
+    return 0;
+}
+
+int snd_mixer_selem_get_playback_switch(snd_mixer_elem_t *elem, snd_mixer_selem_channel_id_t channel, int *value) {
+    *value = E(elem)->on;
+    return 0;
+}
+
+int snd_mixer_selem_set_playback_switch_all(snd_mixer_elem_t *elem, int value) {
+    E(elem)->on = value;
+    return 0;
+}
+
+/* Sets every volume in turn in all three modes, returns what came back
+ * and the hardware steps afterwards */
+static void sweep(pa_alsa_path *p, const pa_channel_map *map, pa_volume_t *out, long *steps) {
+    pa_volume_t vol;
+    unsigned i = 0, j = 0;
+
+    for (vol = PA_VOLUME_MUTED + 1; vol <= PA_VOLUME_NORM; vol += 97) {
+        pa_cvolume v;
+        int deferred, write;
+
+        for (deferred = 0; deferred <= 1; deferred++)
+            for (write = 0; write <= 1; write++) {
+                pa_cvolume_set(&v, map->channels, vol);
+                v.values[1] = vol / 2 + 1;
+
+                pa_assert_se(pa_alsa_path_set_volume(p, fake_mixer, map, &v, deferred, write) >= 0);
+                out[i] = v.values[0];
+                out[i + 1] = v.values[1];
+                i += 2;
+            }
+
+        pa_assert_se(pa_alsa_path_get_volume(p, fake_mixer, map, &v) >= 0);
+        out[i] = v.values[0];
+        out[i + 1] = v.values[1];
+        steps[j++] = elements[N_ELEMENTS - 1].step[0] * N_STEPS + elements[N_ELEMENTS - 1].step[1];
+        i += 2;
+    }
+}
+
+static void bench(const char *name, pa_alsa_path *p, const pa_channel_map *map) {
+    pa_usec_t start, set, get;
+    pa_cvolume v;
+    unsigned i;
+
+    n_lookups = n_conversions = 0;
+
+    start = pa_rtclock_now();
+    for (i = 0; i < N_ROUNDS; i++) {
+        pa_cvolume_set(&v, map->channels, (pa_volume_t) (PA_VOLUME_NORM * (i + 1) / N_ROUNDS));
+        pa_assert_se(pa_alsa_path_set_volume(p, fake_mixer, map, &v, TRUE, TRUE) >= 0);
+    }
+    set = pa_rtclock_now() - start;
+
+    start = pa_rtclock_now();
+    for (i = 0; i < N_ROUNDS; i++)
+        pa_assert_se(pa_alsa_path_get_volume(p, fake_mixer, map, &v) >= 0);
+    get = pa_rtclock_now() - start;
+
+    pa_log_info("%-24s set %6.3f us/call, get %6.3f us/call, %5.2f lookups and %6.2f dB conversions per call",
+                name,
+                (double) set / N_ROUNDS,
+                (double) get / N_ROUNDS,
+                (double) n_lookups / (2 * N_ROUNDS),
+                (double) n_conversions / (2 * N_ROUNDS));
+}
+
+#define N_SWEEP (PA_VOLUME_NORM / 97 + 1)
+
+int main(int argc, char *argv[]) {
+    pa_alsa_path *p;
+    pa_alsa_element *e;
+    pa_channel_map map;
+    long *table;
+    pa_bool_t muted;
+    static pa_volume_t compiled[N_SWEEP * 10], plain[N_SWEEP * 10];
+    static long compiled_steps[N_SWEEP], plain_steps[N_SWEEP];
+    unsigned i;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    for (i = 0; i < N_ELEMENTS - 1; i++)
+        pa_snprintf(elements[i].name, sizeof(elements[i].name), "Element %u", i);
+    pa_strlcpy(elements[N_ELEMENTS - 1].name, "Master", sizeof(elements[0].name));
+
+    pa_channel_map_init_stereo(&map);
+
+    pa_assert_se(p = pa_alsa_path_synthesize("Master", PA_ALSA_DIRECTION_OUTPUT));
+    pa_assert_se(pa_alsa_path_probe(p, fake_mixer, FALSE) >= 0);
+    pa_assert(p->has_volume && p->has_dB && p->has_mute);
+
+    e = p->elements;
+    pa_assert(e->alsa_channels == 3);
+    pa_assert_se(table = e->volume_dB);
+
+    pa_assert_se(pa_alsa_path_select(p, fake_mixer) >= 0);
+
+    /* Nothing is looked up by name or converted by the mixer anymore */
+    n_lookups = n_conversions = 0;
+    sweep(p, &map, compiled, compiled_steps);
+    pa_assert_se(pa_alsa_path_set_mute(p, fake_mixer, TRUE) >= 0);
+    pa_assert_se(pa_alsa_path_get_mute(p, fake_mixer, &muted) >= 0);
+    pa_assert(muted);
+    pa_assert(n_lookups == 0);
+    pa_assert(n_conversions == 0);
+
+    /* The same without the table and handles must end up identical */
+    e->volume_dB = NULL;
+    pa_alsa_path_drop_handles(p, fake_mixer);
+    sweep(p, &map, plain, plain_steps);
+    pa_assert(n_lookups > 0);
+    pa_assert(n_conversions > 0);
+
+    for (i = 0; i < PA_ELEMENTSOF(compiled); i++)
+        pa_assert(compiled[i] == plain[i]);
+    for (i = 0; i < PA_ELEMENTSOF(compiled_steps); i++)
+        pa_assert(compiled_steps[i] == plain_steps[i]);
+
+    bench("by name, ALSA dB", p, &map);
+
+    e->volume_dB = table;
+    bench("by name, dB table", p, &map);
+
+    pa_assert_se(pa_alsa_path_select(p, fake_mixer) >= 0);
+    bench("cached handle, dB table", p, &map);
+
+    pa_alsa_path_drop_handles(p, fake_mixer);
+    pa_alsa_path_free(p);
+
+    return 0;
+}
@@ -0,0 +1,236 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/util.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include <modules/alsa/alsa-mixer.h>
+#include <modules/alsa/alsa-util.h>
+
+/* Probes a made up card twice, once the normal way and once from the
+ * cache the first run wrote, and checks both agree. The PCMs are never
+ * really opened: pa_alsa_open_by_template() below stands in for the one
+ * in libalsa-util and takes a while for every device it "opens", like
+ * a slow USB device would. A device that is busy during the probe must
+ * keep the results out of the cache. */
+
+#define OPEN_DELAY_USEC (20 * PA_USEC_PER_MSEC)
+
+static const char profile_set_conf[] =
+    "[General]\n"
+    "auto-profiles = yes\n"
+    "\n"
+    "[Mapping analog-stereo]\n"
+    "device-strings = front:%f\n"
+    "channel-map = left,right\n"
+    "\n"
+    "[Mapping analog-surround-51]\n"
+    "device-strings = surround51:%f\n"
+    "channel-map = front-left,front-right,rear-left,rear-right,front-center,lfe\n"
+    "direction = output\n"
+    "\n"
+    "[Mapping iec958-stereo]\n"
+    "device-strings = broken:%f\n"
+    "channel-map = left,right\n";
+
+static char fake_pcm;
+static unsigned n_opened = 0;
+static pa_bool_t surround_busy = FALSE;
+
+snd_pcm_t *pa_alsa_open_by_template(
+        char **template,
+        const char *dev_id,
+        char **dev,
+        pa_sample_spec *ss,
+        pa_channel_map* map,
+        int mode,
+        snd_pcm_uframes_t *period_size,
+        snd_pcm_uframes_t *buffer_size,
+        snd_pcm_uframes_t tsched_size,
+        pa_bool_t *use_mmap,
+        pa_bool_t *use_tsched,
+        pa_bool_t require_exact_channel_number) {
+
+    pa_assert(template);
+    pa_assert(*template);
+
+    n_opened++;
+    pa_msleep(OPEN_DELAY_USEC / PA_USEC_PER_MSEC);
+
+    if (pa_startswith(*template, "broken:")) {
+        errno = ENOENT;
+        return NULL;
+    }
+
+    if (surround_busy && pa_startswith(*template, "surround51:")) {
+        errno = EBUSY;
+        return NULL;
+    }
+
+    /* Capture only works in stereo */
+    if (mode == SND_PCM_STREAM_CAPTURE && map->channels != 2) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    return (snd_pcm_t*) &fake_pcm;
+}
+
+int snd_pcm_close(snd_pcm_t *pcm) {
+    pa_assert(pcm == (snd_pcm_t*) &fake_pcm);
+    return 0;
+}
+
+/* No mixer either, the path sets end up empty in both runs */
+int snd_mixer_open(snd_mixer_t **mixer, int mode) {
+    return -1;
+}
+
+static pa_alsa_profile_set *probe(const char *conf, const char *cache, const char *key, pa_bool_t *cached, pa_usec_t *t) {
+    pa_alsa_profile_set *ps;
+    pa_sample_spec ss;
+    pa_channel_map map;
+    pa_usec_t start;
+
+    ss.format = PA_SAMPLE_S16LE;
+    ss.rate = 44100;
+    ss.channels = 2;
+    pa_channel_map_init_stereo(&map);
+
+    pa_assert_se(ps = pa_alsa_profile_set_new(conf, &map));
+
+    start = pa_rtclock_now();
+
+    if (!(*cached = pa_alsa_profile_set_probe_from_cache(ps, cache, key) >= 0)) {
+        pa_alsa_profile_set_probe(ps, "0", &ss, 4, 25);
+        pa_alsa_profile_set_save_probe_cache(ps, cache, key);
+    }
+
+    *t = pa_rtclock_now() - start;
+
+    pa_assert(ps->probed);
+    return ps;
+}
+
+static void assert_same(pa_alsa_profile_set *a, pa_alsa_profile_set *b) {
+    pa_alsa_profile *p;
+    pa_alsa_mapping *m, *n;
+    void *state;
+
+    pa_assert(pa_hashmap_size(a->profiles) == pa_hashmap_size(b->profiles));
+    pa_assert(pa_hashmap_size(a->mappings) == pa_hashmap_size(b->mappings));
+
+    PA_HASHMAP_FOREACH(p, a->profiles, state)
+        pa_assert_se(pa_hashmap_get(b->profiles, p->name));
+
+    PA_HASHMAP_FOREACH(m, a->mappings, state) {
+        pa_assert_se(n = pa_hashmap_get(b->mappings, m->name));
+        pa_assert(!m->output_path_set == !n->output_path_set);
+        pa_assert(!m->input_path_set == !n->input_path_set);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    char dir[] = "/tmp/alsa-probe-cache-test-XXXXXX";
+    char *conf, *cache;
+    FILE *f;
+    pa_alsa_profile_set *cold, *warm, *stale;
+    pa_bool_t cached;
+    pa_usec_t cold_usec, warm_usec, stale_usec;
+    unsigned cold_opened;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_assert_se(mkdtemp(dir));
+    conf = pa_sprintf_malloc("%s/test.conf", dir);
+    cache = pa_sprintf_malloc("%s/probe-cache", dir);
+
+    pa_assert_se(f = fopen(conf, "w"));
+    pa_assert_se(fputs(profile_set_conf, f) >= 0);
+    pa_assert_se(fclose(f) == 0);
+
+    cold = probe(conf, cache, "card-a", &cached, &cold_usec);
+    pa_assert(!cached);
+    pa_assert(!pa_hashmap_isempty(cold->profiles));
+    pa_assert(!pa_hashmap_get(cold->mappings, "iec958-stereo"));
+    pa_assert(n_opened > 0);
+    cold_opened = n_opened;
+
+    n_opened = 0;
+    warm = probe(conf, cache, "card-a", &cached, &warm_usec);
+    pa_assert(cached);
+    pa_assert(n_opened == 0);
+    assert_same(cold, warm);
+
+    /* A different key must not pick up the cache */
+    stale = probe(conf, cache, "card-b", &cached, &stale_usec);
+    pa_assert(!cached);
+    pa_assert(n_opened == cold_opened);
+    assert_same(cold, stale);
+
+    /* A busy device must not be cached as unsupported */
+    pa_assert_se(unlink(cache) == 0);
+    surround_busy = TRUE;
+    pa_alsa_profile_set_free(stale);
+    stale = probe(conf, cache, "card-a", &cached, &stale_usec);
+    pa_assert(!cached);
+    pa_assert(!pa_hashmap_get(stale->mappings, "analog-surround-51"));
+    pa_assert(access(cache, F_OK) < 0);
+
+    surround_busy = FALSE;
+    pa_alsa_profile_set_free(stale);
+    stale = probe(conf, cache, "card-a", &cached, &stale_usec);
+    pa_assert(!cached);
+    assert_same(cold, stale);
+    pa_assert(access(cache, F_OK) == 0);
+
+    pa_log_info("%u profiles, %u PCM opens: cold probe %0.1f ms, warm probe %0.1f ms",
+                pa_hashmap_size(cold->profiles), cold_opened,
+                (double) cold_usec / PA_USEC_PER_MSEC,
+                (double) warm_usec / PA_USEC_PER_MSEC);
+
+    pa_alsa_profile_set_free(cold);
+    pa_alsa_profile_set_free(warm);
+    pa_alsa_profile_set_free(stale);
+
+    pa_assert_se(unlink(cache) == 0);
+    pa_assert_se(unlink(conf) == 0);
+    pa_assert_se(rmdir(dir) == 0);
+
+    pa_xfree(conf);
+    pa_xfree(cache);
+
+    return 0;
+}
@@ -27,7 +27,7 @@ int main(int argc, char *argv[]) {
     int dir = 1;
     struct timespec start, last_timestamp = { 0, 0 };
     uint64_t start_us;
-    snd_pcm_sframes_t last_avail = 0, last_delay = 0;
+    snd_pcm_sframes_t last_avail = 0, last_delay = 0, last_sys_delay = 0;
     struct pollfd *pollfds;
     int n_pollfd;
     int64_t sample_count = 0;
@@ -134,11 +134,11 @@ int main(int argc, char *argv[]) {
     }
 
     for (;;) {
-        snd_pcm_sframes_t avail, delay;
+        snd_pcm_sframes_t avail, delay, sys_delay;
         struct timespec now, timestamp;
         unsigned short revents;
         int handled = 0;
-        uint64_t now_us, timestamp_us;
+        uint64_t now_us, timestamp_us, jitter_us;
         snd_pcm_state_t state;
         unsigned long long pos;
 
@@ -167,6 +167,13 @@ int main(int argc, char *argv[]) {
         delay = snd_pcm_status_get_delay(status);
         state = snd_pcm_status_get_state(status);
 
+        /* Query the delay a second time the way we'd do without
+         * timestamps: snd_pcm_delay() followed by a read of the system
+         * clock. The difference between the status timestamp and that read
+         * is the jitter using the system clock introduces. */
+        r = snd_pcm_delay(pcm, &sys_delay);
+        assert(r == 0);
+
         r = clock_gettime(CLOCK_MONOTONIC, &now);
         assert(r == 0);
 
@@ -190,20 +197,22 @@ int main(int argc, char *argv[]) {
         if (!handled &&
             memcmp(&timestamp, &last_timestamp, sizeof(timestamp)) == 0 &&
             avail == last_avail &&
-            delay == last_delay) {
+            delay == last_delay &&
+            sys_delay == last_sys_delay) {
             /* This is boring */
             continue;
         }
 
         now_us = timespec_us(&now);
         timestamp_us = timespec_us(&timestamp);
+        jitter_us = timestamp_us && now_us > timestamp_us ? now_us - timestamp_us : 0;
 
         if (cap == 0)
             pos = (unsigned long long) ((sample_count - handled - delay) * 1000000LU / 44100);
         else
             pos = (unsigned long long) ((sample_count - handled + delay) * 1000000LU / 44100);
 
-        printf("%llu\t%llu\t%llu\t%llu\t%li\t%li\t%i\t%i\t%i\n",
+        printf("%llu\t%llu\t%llu\t%llu\t%li\t%li\t%i\t%i\t%i\t%li\t%llu\n",
                (unsigned long long) (now_us - start_us),
                (unsigned long long) (timestamp_us ? timestamp_us - start_us : 0),
                pos,
@@ -212,7 +221,9 @@ int main(int argc, char *argv[]) {
                (signed long) delay,
                revents,
                handled,
-               state);
+               state,
+               (signed long) sys_delay,
+               (unsigned long long) jitter_us);
 
         if (cap == 0)
           /** When this assert is hit, most likely something bad
@@ -221,6 +232,7 @@ int main(int argc, char *argv[]) {
 
         last_avail = avail;
         last_delay = delay;
+        last_sys_delay = sys_delay;
         last_timestamp = timestamp;
     }
 
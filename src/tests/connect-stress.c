@@ -31,6 +31,7 @@
 
 #include <pulse/pulseaudio.h>
 #include <pulse/mainloop.h>
+#include <pulse/rtclock.h>
 
 #include <pulsecore/sink.h>
 
@@ -44,6 +45,12 @@
 #define NTESTS 1000
 #define SAMPLE_HZ 44100
 
+/* Number of simultaneous connections for the latency measurements. Note
+ * that the server needs to be configured to accept that many, see the
+ * max-connections= argument of module-native-protocol-unix. Its workers=
+ * argument moves the socket I/O of the connections into that many threads. */
+#define NCLIENTS 1000
+
 static pa_context *context = NULL;
 static pa_stream *streams[NSTREAMS];
 static pa_threaded_mainloop *mainloop = NULL;
@@ -187,8 +194,173 @@ static void context_state_callback(pa_context *c, void *userdata) {
     }
 }
 
+struct client {
+    pa_context *context;
+    pa_usec_t connect_start, ready, command_start, command_done;
+    pa_bool_t failed;
+};
+
+static pa_threaded_mainloop *latency_mainloop = NULL;
+static unsigned n_pending = 0;
+
+static void latency_state_callback(pa_context *c, void *userdata) {
+    struct client *cl = userdata;
+
+    switch (pa_context_get_state(c)) {
+        case PA_CONTEXT_READY:
+            cl->ready = pa_rtclock_now();
+            n_pending--;
+            pa_threaded_mainloop_signal(latency_mainloop, 0);
+            break;
+
+        case PA_CONTEXT_FAILED:
+            if (cl->failed)
+                break;
+
+            cl->failed = TRUE;
+
+            /* Don't wait for anything that this client won't deliver anymore */
+            if (!cl->ready || (cl->command_start && !cl->command_done)) {
+                n_pending--;
+                pa_threaded_mainloop_signal(latency_mainloop, 0);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void latency_server_info_callback(pa_context *c, const pa_server_info *i, void *userdata) {
+    struct client *cl = userdata;
+
+    cl->command_done = pa_rtclock_now();
+    n_pending--;
+    pa_threaded_mainloop_signal(latency_mainloop, 0);
+}
+
+static int compare_usec(const void *a, const void *b) {
+    const pa_usec_t *x = a, *y = b;
+
+    return *x < *y ? -1 : (*x > *y ? 1 : 0);
+}
+
+static void print_latencies(const char *what, pa_usec_t *l, unsigned n) {
+    pa_usec_t sum = 0;
+    unsigned i;
+
+    if (n <= 0) {
+        fprintf(stderr, "%s: no samples\n", what);
+        return;
+    }
+
+    qsort(l, n, sizeof(pa_usec_t), compare_usec);
+
+    for (i = 0; i < n; i++)
+        sum += l[i];
+
+    fprintf(stderr, "%s (%u samples): min %0.2f ms, avg %0.2f ms, 50%% %0.2f ms, 99%% %0.2f ms, max %0.2f ms\n",
+            what, n,
+            (double) l[0] / PA_USEC_PER_MSEC,
+            (double) sum / n / PA_USEC_PER_MSEC,
+            (double) l[n / 2] / PA_USEC_PER_MSEC,
+            (double) l[(n * 99) / 100] / PA_USEC_PER_MSEC,
+            (double) l[n - 1] / PA_USEC_PER_MSEC);
+}
+
+/* Connect lots of clients at once and measure how long it takes until
+ * each of them is ready, and then how long a simple round trip takes
+ * while all of them are waiting for a reply. */
+static void measure_latency(const char *name, unsigned n_clients) {
+    struct client *clients;
+    pa_usec_t *l;
+    unsigned i, n, n_ready = 0;
+    int ret;
+
+    clients = pa_xnew0(struct client, n_clients);
+    l = pa_xnew(pa_usec_t, n_clients);
+
+    latency_mainloop = pa_threaded_mainloop_new();
+    assert(latency_mainloop);
+
+    ret = pa_threaded_mainloop_start(latency_mainloop);
+    assert(ret == 0);
+
+    pa_threaded_mainloop_lock(latency_mainloop);
+
+    for (i = 0; i < n_clients; i++) {
+        clients[i].context = pa_context_new(pa_threaded_mainloop_get_api(latency_mainloop), name);
+        assert(clients[i].context);
+
+        pa_context_set_state_callback(clients[i].context, latency_state_callback, &clients[i]);
+        clients[i].connect_start = pa_rtclock_now();
+        n_pending++;
+
+        /* If the context already went to FAILED, the state callback
+         * has accounted for it */
+        if (pa_context_connect(clients[i].context, NULL, PA_CONTEXT_NOAUTOSPAWN, NULL) < 0 && !clients[i].failed) {
+            clients[i].failed = TRUE;
+            n_pending--;
+        }
+    }
+
+    while (n_pending > 0)
+        pa_threaded_mainloop_wait(latency_mainloop);
+
+    for (i = 0, n = 0; i < n_clients; i++)
+        if (clients[i].ready)
+            l[n++] = clients[i].ready - clients[i].connect_start;
+
+    n_ready = n;
+    fprintf(stderr, "%u of %u clients connected.\n", n_ready, n_clients);
+    print_latencies("Connect to ready", l, n);
+
+    for (i = 0; i < n_clients; i++) {
+        pa_operation *o;
+
+        if (clients[i].failed)
+            continue;
+
+        clients[i].command_start = pa_rtclock_now();
+        n_pending++;
+
+        o = pa_context_get_server_info(clients[i].context, latency_server_info_callback, &clients[i]);
+        assert(o);
+        pa_operation_unref(o);
+    }
+
+    while (n_pending > 0)
+        pa_threaded_mainloop_wait(latency_mainloop);
+
+    for (i = 0, n = 0; i < n_clients; i++)
+        if (clients[i].command_done)
+            l[n++] = clients[i].command_done - clients[i].command_start;
+
+    print_latencies("Command round trip", l, n);
+
+    for (i = 0; i < n_clients; i++) {
+        pa_context_disconnect(clients[i].context);
+        pa_context_unref(clients[i].context);
+    }
+
+    pa_threaded_mainloop_unlock(latency_mainloop);
+    pa_threaded_mainloop_stop(latency_mainloop);
+    pa_threaded_mainloop_free(latency_mainloop);
+    latency_mainloop = NULL;
+
+    pa_xfree(clients);
+    pa_xfree(l);
+}
+
 int main(int argc, char *argv[]) {
     int i;
+    unsigned n_clients = NCLIENTS;
+
+    if (argc > 1)
+        n_clients = (unsigned) atoi(argv[1]);
+
+    if (n_clients > 0)
+        measure_latency(argv[0], n_clients);
 
     for (i = 0; i < NSTREAMS; i++)
         streams[i] = NULL;
@@ -0,0 +1,213 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/database.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+/* Checks the database backend we are built with and measures open,
+ * get, set and sync with as many entries as a big stream-restore
+ * database has. make check only runs a smaller database through the
+ * same steps. */
+
+#define N_ENTRIES 100000
+#define N_SYNCS 100
+#define N_ENTRIES_CHECK 5000
+#define N_SYNCS_CHECK 10
+#define N_ITERATE 100
+
+static void make_datum(pa_datum *d, char *buf, size_t l, const char *prefix, unsigned i) {
+    pa_snprintf(buf, l, "%s-%u", prefix, i);
+    d->data = buf;
+    d->size = strlen(buf) + 1;
+}
+
+static void check_entry(pa_database *db, unsigned i, pa_bool_t present) {
+    char k[64], v[64];
+    pa_datum key, data, expected;
+
+    make_datum(&key, k, sizeof(k), "sink-input-by-application-name:Some Application", i);
+    make_datum(&expected, v, sizeof(v), "volume, channel map and device", i);
+
+    if (!present) {
+        pa_assert_se(!pa_database_get(db, &key, &data));
+        return;
+    }
+
+    pa_assert_se(pa_database_get(db, &key, &data));
+    pa_assert_se(data.size == expected.size);
+    pa_assert_se(memcmp(data.data, expected.data, data.size) == 0);
+    pa_datum_free(&data);
+}
+
+/* The backends name their files differently, just remove everything */
+static void remove_dir(const char *dir) {
+    DIR *d;
+    struct dirent *de;
+
+    pa_assert_se(d = opendir(dir));
+
+    while ((de = readdir(d))) {
+        char *p;
+
+        if (pa_streq(de->d_name, ".") || pa_streq(de->d_name, ".."))
+            continue;
+
+        p = pa_sprintf_malloc("%s/%s", dir, de->d_name);
+        pa_assert_se(unlink(p) == 0);
+        pa_xfree(p);
+    }
+
+    closedir(d);
+    pa_assert_se(rmdir(dir) == 0);
+}
+
+int main(int argc, char *argv[]) {
+    char *dir, *fn;
+    pa_database *db;
+    pa_usec_t start, t, sync_max = 0;
+    pa_datum key, data, next;
+    char k[64], v[64];
+    unsigned i, n, n_entries = N_ENTRIES, n_syncs = N_SYNCS;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+    else {
+        n_entries = N_ENTRIES_CHECK;
+        n_syncs = N_SYNCS_CHECK;
+    }
+
+    dir = pa_xstrdup("/tmp/database-test-XXXXXX");
+    pa_assert_se(mkdtemp(dir));
+    fn = pa_sprintf_malloc("%s/test", dir);
+
+    pa_assert_se(db = pa_database_open(fn, TRUE));
+
+    start = pa_rtclock_now();
+    for (i = 0; i < n_entries; i++) {
+        make_datum(&key, k, sizeof(k), "sink-input-by-application-name:Some Application", i);
+        make_datum(&data, v, sizeof(v), "volume, channel map and device", i);
+        pa_assert_se(pa_database_set(db, &key, &data, TRUE) == 0);
+    }
+    t = pa_rtclock_now() - start;
+    pa_log_info("set %u entries: %0.3f ms", n_entries, (double) t / PA_USEC_PER_MSEC);
+
+    pa_assert_se(pa_database_size(db) == n_entries);
+    pa_assert_se(pa_database_set(db, &key, &data, FALSE) < 0);
+
+    start = pa_rtclock_now();
+    pa_assert_se(pa_database_sync(db) == 0);
+    t = pa_rtclock_now() - start;
+    pa_log_info("first sync: %0.3f ms", (double) t / PA_USEC_PER_MSEC);
+
+    /* What stream-restore does: change an entry, sync a bit later */
+    for (i = 0; i < n_syncs; i++) {
+        make_datum(&key, k, sizeof(k), "sink-input-by-application-name:Some Application", i);
+        make_datum(&data, v, sizeof(v), "volume, channel map and device", i);
+        pa_assert_se(pa_database_set(db, &key, &data, TRUE) == 0);
+
+        start = pa_rtclock_now();
+        pa_assert_se(pa_database_sync(db) == 0);
+        t = pa_rtclock_now() - start;
+        sync_max = PA_MAX(sync_max, t);
+    }
+    pa_log_info("sync after a single change: max %0.3f ms", (double) sync_max / PA_USEC_PER_MSEC);
+
+    for (i = 0; i < n_entries; i += 2) {
+        make_datum(&key, k, sizeof(k), "sink-input-by-application-name:Some Application", i);
+        pa_assert_se(pa_database_unset(db, &key) == 0);
+    }
+
+    start = pa_rtclock_now();
+    pa_database_close(db);
+    t = pa_rtclock_now() - start;
+    pa_log_info("close: %0.3f ms", (double) t / PA_USEC_PER_MSEC);
+
+    start = pa_rtclock_now();
+    pa_assert_se(db = pa_database_open(fn, FALSE));
+    t = pa_rtclock_now() - start;
+    pa_log_info("open with %u entries: %0.3f ms", n_entries / 2, (double) t / PA_USEC_PER_MSEC);
+
+    pa_assert_se(pa_database_size(db) == n_entries / 2);
+
+    start = pa_rtclock_now();
+    for (i = 0; i < n_entries; i++)
+        check_entry(db, i, i % 2 == 1);
+    t = pa_rtclock_now() - start;
+    pa_log_info("get %u entries: %0.3f ms", n_entries, (double) t / PA_USEC_PER_MSEC);
+
+    pa_database_close(db);
+
+    /* Clear and reopen. Some backends iterate in O(n^2), so we check
+     * iteration on a small database only */
+    pa_assert_se(db = pa_database_open(fn, TRUE));
+    pa_assert_se(pa_database_clear(db) == 0);
+    for (i = 0; i < N_ITERATE; i++) {
+        make_datum(&key, k, sizeof(k), "sink-input-by-application-name:Some Application", i);
+        make_datum(&data, v, sizeof(v), "volume, channel map and device", i);
+        pa_assert_se(pa_database_set(db, &key, &data, FALSE) == 0);
+    }
+    pa_database_close(db);
+
+    pa_assert_se(db = pa_database_open(fn, FALSE));
+    pa_assert_se(pa_database_size(db) == N_ITERATE);
+    check_entry(db, 1, TRUE);
+    check_entry(db, N_ITERATE, FALSE);
+
+    /* Iterating visits every entry once */
+    n = 0;
+    if (pa_database_first(db, &key, NULL)) {
+        for (;;) {
+            pa_bool_t more;
+
+            n++;
+            more = !!pa_database_next(db, &key, &next, NULL);
+            pa_datum_free(&key);
+
+            if (!more)
+                break;
+
+            key = next;
+        }
+    }
+    pa_assert_se(n == N_ITERATE);
+
+    pa_database_close(db);
+
+    remove_dir(dir);
+
+    pa_xfree(fn);
+    pa_xfree(dir);
+
+    return 0;
+}
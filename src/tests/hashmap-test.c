@@ -0,0 +1,188 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/idxset.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+/* Checks that the tables keep working and keep their iteration order
+ * while they grow, and measures insert, lookup, remove and iterate for
+ * a few table sizes. */
+
+static const unsigned sizes[] = { 100, 10000, 100000 };
+
+static void hashmap_run(unsigned n) {
+    pa_hashmap *h;
+    char **keys;
+    void *state = NULL, *p;
+    pa_usec_t start, insert, lookup, iterate, remove;
+    unsigned i;
+
+    keys = pa_xnew(char*, n);
+    for (i = 0; i < n; i++)
+        keys[i] = pa_sprintf_malloc("key-%u", i);
+
+    h = pa_hashmap_new(pa_idxset_string_hash_func, pa_idxset_string_compare_func);
+
+    start = pa_rtclock_now();
+    for (i = 0; i < n; i++)
+        pa_assert_se(pa_hashmap_put(h, keys[i], PA_UINT_TO_PTR(i + 1)) == 0);
+    insert = pa_rtclock_now() - start;
+
+    pa_assert(pa_hashmap_size(h) == n);
+    pa_assert(pa_hashmap_put(h, keys[0], NULL) < 0);
+
+    start = pa_rtclock_now();
+    for (i = 0; i < n; i++)
+        pa_assert_se(pa_hashmap_get(h, keys[i]) == PA_UINT_TO_PTR(i + 1));
+    lookup = pa_rtclock_now() - start;
+
+    /* Iteration order is insertion order, forwards and backwards */
+    start = pa_rtclock_now();
+    i = 0;
+    PA_HASHMAP_FOREACH(p, h, state)
+        pa_assert_se(p == PA_UINT_TO_PTR(++i));
+    iterate = pa_rtclock_now() - start;
+    pa_assert(i == n);
+
+    state = NULL;
+    while ((p = pa_hashmap_iterate_backwards(h, &state, NULL)))
+        pa_assert_se(p == PA_UINT_TO_PTR(i--));
+    pa_assert(i == 0);
+
+    /* Removing the current entry while iterating is allowed */
+    i = 0;
+    PA_HASHMAP_FOREACH(p, h, state)
+        if (PA_PTR_TO_UINT(p) % 2 == 0) {
+            pa_assert_se(pa_hashmap_remove(h, keys[PA_PTR_TO_UINT(p) - 1]) == p);
+            i++;
+        }
+    pa_assert(pa_hashmap_size(h) == n - i);
+
+    start = pa_rtclock_now();
+    for (i = 0; i < n; i += 2)
+        pa_assert_se(pa_hashmap_remove(h, keys[i]) == PA_UINT_TO_PTR(i + 1));
+    remove = pa_rtclock_now() - start;
+
+    pa_assert(pa_hashmap_isempty(h));
+    pa_hashmap_free(h, NULL, NULL);
+
+    pa_log_info("hashmap %6u entries: insert %8.3f ms, lookup %8.3f ms, iterate %8.3f ms, remove (half) %8.3f ms",
+                n,
+                (double) insert / PA_USEC_PER_MSEC,
+                (double) lookup / PA_USEC_PER_MSEC,
+                (double) iterate / PA_USEC_PER_MSEC,
+                (double) remove / PA_USEC_PER_MSEC);
+
+    for (i = 0; i < n; i++)
+        pa_xfree(keys[i]);
+    pa_xfree(keys);
+}
+
+static void idxset_run(unsigned n) {
+    pa_idxset *s;
+    uint32_t idx, rr;
+    void *p;
+    pa_usec_t start, insert, lookup, iterate, remove;
+    unsigned i;
+
+    s = pa_idxset_new(NULL, NULL);
+
+    start = pa_rtclock_now();
+    for (i = 0; i < n; i++) {
+        pa_assert_se(pa_idxset_put(s, PA_UINT_TO_PTR(i + 1), &idx) == 0);
+        pa_assert(idx == i);
+    }
+    insert = pa_rtclock_now() - start;
+
+    pa_assert(pa_idxset_put(s, PA_UINT_TO_PTR(1), &idx) < 0);
+    pa_assert(idx == 0);
+
+    start = pa_rtclock_now();
+    for (i = 0; i < n; i++) {
+        pa_assert_se(pa_idxset_get_by_index(s, i) == PA_UINT_TO_PTR(i + 1));
+        pa_assert_se(pa_idxset_get_by_data(s, PA_UINT_TO_PTR(i + 1), &idx));
+        pa_assert(idx == i);
+    }
+    lookup = pa_rtclock_now() - start;
+
+    start = pa_rtclock_now();
+    i = 0;
+    PA_IDXSET_FOREACH(p, s, idx)
+        pa_assert_se(p == PA_UINT_TO_PTR(++i));
+    iterate = pa_rtclock_now() - start;
+    pa_assert(i == n);
+
+    /* Drop every other entry, round robin must still walk the rest in
+     * order and wrap around at the end */
+    start = pa_rtclock_now();
+    for (i = 0; i < n; i += 2)
+        pa_assert_se(pa_idxset_remove_by_index(s, i) == PA_UINT_TO_PTR(i + 1));
+    remove = pa_rtclock_now() - start;
+
+    pa_assert(pa_idxset_size(s) == n / 2);
+
+    rr = PA_IDXSET_INVALID;
+    for (i = 0; i < n / 2; i++) {
+        pa_assert_se(pa_idxset_rrobin(s, &rr));
+        pa_assert(rr == 2 * i + 1);
+    }
+    pa_assert_se(pa_idxset_rrobin(s, &rr));
+    pa_assert(rr == 1);
+
+    /* pa_idxset_next() from an index that is gone */
+    idx = 2;
+    pa_assert_se(pa_idxset_next(s, &idx) == PA_UINT_TO_PTR(4));
+    pa_assert(idx == 3);
+
+    pa_idxset_free(s, NULL, NULL);
+
+    pa_log_info("idxset  %6u entries: insert %8.3f ms, lookup %8.3f ms, iterate %8.3f ms, remove (half) %8.3f ms",
+                n,
+                (double) insert / PA_USEC_PER_MSEC,
+                (double) lookup / PA_USEC_PER_MSEC,
+                (double) iterate / PA_USEC_PER_MSEC,
+                (double) remove / PA_USEC_PER_MSEC);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned k;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    for (k = 0; k < PA_ELEMENTSOF(sizes); k++) {
+        hashmap_run(sizes[k]);
+        idxset_run(sizes[k]);
+    }
+
+    return 0;
+}
@@ -24,11 +24,100 @@
 #include <stdio.h>
 
 #include <pulse/proplist.h>
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
 #include <pulse/xmalloc.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/modargs.h>
 
+#include "alloc-count.h"
+
+#define N_STREAMS 10000
+
+static void test_copy_on_write(void) {
+    pa_proplist *a, *b;
+    const char *v;
+
+    a = pa_proplist_new();
+    pa_assert_se(pa_proplist_sets(a, PA_PROP_APPLICATION_NAME, "foo") == 0);
+    pa_assert_se(pa_proplist_sets(a, "x.custom", "bar") == 0);
+
+    b = pa_proplist_copy(a);
+    pa_assert_se(pa_proplist_equal(a, b));
+
+    /* Values handed out earlier stay valid while other keys change and
+     * after the list they were shared with is gone */
+    pa_assert_se(v = pa_proplist_gets(b, "x.custom"));
+    pa_assert_se(pa_proplist_sets(b, PA_PROP_APPLICATION_NAME, "waldo") == 0);
+    pa_assert_se(pa_streq(pa_proplist_gets(a, PA_PROP_APPLICATION_NAME), "foo"));
+    pa_assert_se(pa_streq(pa_proplist_gets(b, PA_PROP_APPLICATION_NAME), "waldo"));
+    pa_assert_se(!pa_proplist_equal(a, b));
+
+    pa_proplist_free(a);
+    pa_assert_se(pa_streq(v, "bar"));
+
+    a = pa_proplist_copy(b);
+    pa_assert_se(pa_proplist_unset(a, "x.custom") == 0);
+    pa_assert_se(pa_proplist_contains(b, "x.custom") == 1);
+    pa_assert_se(pa_proplist_size(a) == 1);
+    pa_assert_se(pa_proplist_size(b) == 2);
+
+    pa_proplist_clear(b);
+    pa_proplist_update(a, PA_UPDATE_SET, b);
+    pa_assert_se(pa_proplist_isempty(a));
+
+    pa_proplist_free(a);
+    pa_proplist_free(b);
+}
+
+/* Roughly what happens to the property lists when a client connects and
+ * creates a stream: the client's list is merged into the stream's,
+ * which is then copied into the sink input. */
+static void benchmark_stream_setup(void) {
+    pa_proplist *client, *stream, *sink_input;
+    pa_usec_t start, stop;
+    unsigned i;
+#ifdef __GLIBC__
+    unsigned allocs = alloc_count_allocs();
+#endif
+
+    client = pa_proplist_new();
+    pa_proplist_sets(client, PA_PROP_APPLICATION_NAME, "Music Player");
+    pa_proplist_sets(client, PA_PROP_APPLICATION_ID, "org.example.MusicPlayer");
+    pa_proplist_sets(client, PA_PROP_APPLICATION_VERSION, "1.0");
+    pa_proplist_sets(client, PA_PROP_APPLICATION_ICON_NAME, "music-player");
+    pa_proplist_sets(client, PA_PROP_APPLICATION_LANGUAGE, "en_US.UTF-8");
+    pa_proplist_sets(client, PA_PROP_APPLICATION_PROCESS_ID, "4711");
+    pa_proplist_sets(client, PA_PROP_APPLICATION_PROCESS_BINARY, "music-player");
+    pa_proplist_sets(client, PA_PROP_APPLICATION_PROCESS_USER, "lennart");
+    pa_proplist_sets(client, PA_PROP_APPLICATION_PROCESS_HOST, "localhost");
+
+    start = pa_rtclock_now();
+
+    for (i = 0; i < N_STREAMS; i++) {
+        stream = pa_proplist_new();
+        pa_proplist_sets(stream, PA_PROP_MEDIA_NAME, "Playback Stream");
+        pa_proplist_sets(stream, PA_PROP_MEDIA_ROLE, "music");
+        pa_proplist_update(stream, PA_UPDATE_MERGE, client);
+
+        sink_input = pa_proplist_copy(stream);
+        pa_proplist_sets(sink_input, "module-stream-restore.id", "sink-input-by-media-role:music");
+
+        pa_proplist_free(sink_input);
+        pa_proplist_free(stream);
+    }
+
+    stop = pa_rtclock_now();
+
+    pa_log_info("Stream setup: %0.3f usec per stream", (double) (stop - start) / N_STREAMS);
+#ifdef __GLIBC__
+    pa_log_info("Stream setup: %0.1f allocations per stream", (double) (alloc_count_allocs() - allocs) / N_STREAMS);
+#endif
+
+    pa_proplist_free(client);
+}
+
 int main(int argc, char*argv[]) {
     pa_modargs *ma;
     pa_proplist *a, *b, *c, *d;
@@ -95,5 +184,8 @@ int main(int argc, char*argv[]) {
     pa_proplist_free(a);
     pa_modargs_free(ma);
 
+    test_copy_on_write();
+    benchmark_stream_setup();
+
     return 0;
 }
@@ -0,0 +1,231 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <openssl/evp.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/endianmacros.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/random.h>
+
+#include <modules/raop/raop_packet.h>
+
+/* Builds AirTunes audio packets the way raop_client.c used to, a bit at
+ * a time and one AES block after the other, and checks that the packer
+ * and the one pass encryption produce the same bytes for every packet
+ * length up to a few SSE2 blocks. Then measures both with the packet
+ * size module-raop-sink uses (50 ms at 44.1 kHz). No receiver needed. */
+
+#define MAX_FRAMES 40
+#define BENCH_FRAMES 2205
+#define BENCH_ROUNDS 2000
+
+static void bit_writer(uint8_t **buffer, uint8_t *bit_pos, int *size, uint8_t data, uint8_t data_bit_len) {
+    int bits_left, bit_overflow;
+    uint8_t bit_data;
+
+    if (!data_bit_len)
+        return;
+
+    if (!*bit_pos)
+        *size += 1;
+
+    bits_left = 7 - *bit_pos + 1;
+    bit_overflow = bits_left - data_bit_len;
+    if (bit_overflow >= 0) {
+        bit_data = data << bit_overflow;
+        if (*bit_pos)
+            **buffer |= bit_data;
+        else
+            **buffer = bit_data;
+        if (0 == bit_overflow) {
+            *buffer += 1;
+            *bit_pos = 0;
+        } else
+            *bit_pos += data_bit_len;
+    } else {
+        bit_data = data >> -bit_overflow;
+        **buffer |= bit_data;
+        *buffer += 1;
+        *size += 1;
+        **buffer = data << (8 + bit_overflow);
+        *bit_pos = -bit_overflow;
+    }
+}
+
+/* Expects little endian samples, as the old code did */
+static size_t reference_write(uint8_t *b, const uint8_t *p, size_t n_frames) {
+    static const uint8_t header[] = {
+        0x24, 0x00, 0x00, 0x00,
+        0xF0, 0xFF, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00,
+    };
+    uint8_t *bp, bpos = 0;
+    int size = 0;
+    uint32_t bsize = (uint32_t) n_frames;
+    uint16_t len;
+    size_t i;
+
+    memcpy(b, header, sizeof(header));
+    bp = b + sizeof(header);
+
+    bit_writer(&bp, &bpos, &size, 1, 3);
+    bit_writer(&bp, &bpos, &size, 0, 4);
+    bit_writer(&bp, &bpos, &size, 0, 8);
+    bit_writer(&bp, &bpos, &size, 0, 4);
+    bit_writer(&bp, &bpos, &size, 1, 1);
+    bit_writer(&bp, &bpos, &size, 0, 2);
+    bit_writer(&bp, &bpos, &size, 1, 1);
+
+    bit_writer(&bp, &bpos, &size, (bsize >> 24) & 0xff, 8);
+    bit_writer(&bp, &bpos, &size, (bsize >> 16) & 0xff, 8);
+    bit_writer(&bp, &bpos, &size, (bsize >> 8) & 0xff, 8);
+    bit_writer(&bp, &bpos, &size, bsize & 0xff, 8);
+
+    for (i = 0; i < n_frames; i++, p += 4) {
+        bit_writer(&bp, &bpos, &size, p[1], 8);
+        bit_writer(&bp, &bpos, &size, p[0], 8);
+        bit_writer(&bp, &bpos, &size, p[3], 8);
+        bit_writer(&bp, &bpos, &size, p[2], 8);
+    }
+
+    len = (uint16_t) (size + sizeof(header) - 4);
+    b[2] = len >> 8;
+    b[3] = len & 0xff;
+
+    return sizeof(header) + (size_t) size;
+}
+
+/* CBC by hand, one block through the cipher at a time */
+static void reference_encrypt(EVP_CIPHER_CTX *ecb, const uint8_t *iv, uint8_t *packet, size_t size) {
+    uint8_t nv[PA_RAOP_AES_CHUNKSIZE];
+    uint8_t *data = packet + 16;
+    size_t i, j;
+    int l;
+
+    memcpy(nv, iv, sizeof(nv));
+    size -= 16;
+
+    for (i = 0; i + PA_RAOP_AES_CHUNKSIZE <= size; i += PA_RAOP_AES_CHUNKSIZE) {
+        for (j = 0; j < PA_RAOP_AES_CHUNKSIZE; j++)
+            data[i+j] ^= nv[j];
+
+        pa_assert_se(EVP_EncryptUpdate(ecb, data + i, &l, data + i, PA_RAOP_AES_CHUNKSIZE) == 1);
+        memcpy(nv, data + i, sizeof(nv));
+    }
+}
+
+int main(int argc, char *argv[]) {
+    uint8_t key[PA_RAOP_AES_CHUNKSIZE], iv[PA_RAOP_AES_CHUNKSIZE];
+    EVP_CIPHER_CTX *ecb, *cbc;
+    uint8_t *pcm, *ref, *out;
+    size_t n, size;
+    pa_usec_t start, t_ref_write, t_ref_encrypt, t_write, t_encrypt;
+    unsigned i;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_random(key, sizeof(key));
+    pa_random(iv, sizeof(iv));
+
+    pa_assert_se(ecb = EVP_CIPHER_CTX_new());
+    pa_assert_se(EVP_EncryptInit_ex(ecb, EVP_aes_128_ecb(), NULL, key, NULL) == 1);
+    EVP_CIPHER_CTX_set_padding(ecb, 0);
+
+    pa_assert_se(cbc = EVP_CIPHER_CTX_new());
+    pa_assert_se(EVP_EncryptInit_ex(cbc, EVP_aes_128_cbc(), NULL, key, iv) == 1);
+    EVP_CIPHER_CTX_set_padding(cbc, 0);
+
+    pcm = pa_xmalloc(BENCH_FRAMES * 4);
+    ref = pa_xmalloc(pa_raop_packet_size(BENCH_FRAMES));
+    out = pa_xmalloc(pa_raop_packet_size(BENCH_FRAMES));
+
+    pa_random(pcm, BENCH_FRAMES * 4);
+
+#ifdef WORDS_BIGENDIAN
+    /* The reference takes little endian, the packer native endian */
+    for (i = 0; i < BENCH_FRAMES * 2; i++)
+        ((uint16_t*) pcm)[i] = PA_UINT16_SWAP(((uint16_t*) pcm)[i]);
+#endif
+
+    for (n = 0; n <= MAX_FRAMES; n++) {
+        size = reference_write(ref, pcm, n);
+        pa_assert_se(pa_raop_packet_write(out, pcm, n) == size);
+        pa_assert_se(size == pa_raop_packet_size(n));
+        pa_assert_se(memcmp(ref, out, size) == 0);
+
+        reference_encrypt(ecb, iv, ref, size);
+        pa_raop_packet_encrypt(cbc, iv, out, size);
+        pa_assert_se(memcmp(ref, out, size) == 0);
+    }
+
+    pa_log_info("Packets of 0 to %u frames match the bit writer", MAX_FRAMES);
+
+    size = pa_raop_packet_size(BENCH_FRAMES);
+
+    start = pa_rtclock_now();
+    for (i = 0; i < BENCH_ROUNDS; i++)
+        reference_write(ref, pcm, BENCH_FRAMES);
+    t_ref_write = pa_rtclock_now() - start;
+
+    start = pa_rtclock_now();
+    for (i = 0; i < BENCH_ROUNDS; i++)
+        reference_encrypt(ecb, iv, ref, size);
+    t_ref_encrypt = pa_rtclock_now() - start;
+
+    start = pa_rtclock_now();
+    for (i = 0; i < BENCH_ROUNDS; i++)
+        pa_raop_packet_write(out, pcm, BENCH_FRAMES);
+    t_write = pa_rtclock_now() - start;
+
+    start = pa_rtclock_now();
+    for (i = 0; i < BENCH_ROUNDS; i++)
+        pa_raop_packet_encrypt(cbc, iv, out, size);
+    t_encrypt = pa_rtclock_now() - start;
+
+    pa_log_info("Bit writer %7.2f us, packer %7.2f us per %u frames",
+                (double) t_ref_write / BENCH_ROUNDS, (double) t_write / BENCH_ROUNDS, BENCH_FRAMES);
+    pa_log_info("Block by block %7.2f us, one pass %7.2f us per %lu bytes",
+                (double) t_ref_encrypt / BENCH_ROUNDS, (double) t_encrypt / BENCH_ROUNDS, (unsigned long) size);
+    pa_log_info("That is %.0f streams per core before, %.0f now",
+                (double) BENCH_ROUNDS * 50 * PA_USEC_PER_MSEC / (double) (t_ref_write + t_ref_encrypt),
+                (double) BENCH_ROUNDS * 50 * PA_USEC_PER_MSEC / (double) (t_write + t_encrypt));
+
+    EVP_CIPHER_CTX_free(ecb);
+    EVP_CIPHER_CTX_free(cbc);
+
+    pa_xfree(pcm);
+    pa_xfree(ref);
+    pa_xfree(out);
+
+    return 0;
+}
@@ -22,13 +22,186 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include <pulse/rtclock.h>
 #include <pulse/sample.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
 
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/remap.h>
 #include <pulsecore/resampler.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/memblock.h>
 
+/* With --benchmark the remapping kernels are also run on their own, once
+ * as installed by default and once with whatever optimized versions the
+ * CPU supports. Both must give the results the matrix walk below gives,
+ * and the time they took is printed. */
+
+#define BENCH_FRAMES 1024
+#define BENCH_ROUNDS 2000
+
+static const struct {
+    unsigned n_ic, n_oc;
+} layouts[] = {
+    { 1, 2 },
+    { 2, 1 },
+    { 6, 2 },
+    { 2, 6 },
+    { 8, 6 },
+    { 4, 2 },
+    { 3, 5 },
+    { 2, 8 },
+    { 6, 1 },
+};
+
+/* What the matrix remapping has always done, entries at or below 0 are
+ * skipped and entries at or above 1 copy the sample */
+static void remap_reference(pa_sample_format_t format, const float table[PA_CHANNELS_MAX][PA_CHANNELS_MAX],
+                            void *dst, const void *src, unsigned n, unsigned n_ic, unsigned n_oc) {
+    unsigned oc, ic, i;
+
+    memset(dst, 0, n * n_oc * pa_sample_size_of_format(format));
+
+    for (oc = 0; oc < n_oc; oc++)
+        for (ic = 0; ic < n_ic; ic++) {
+            float vol = table[oc][ic];
+            int32_t ivol = (int32_t) (vol * 0x10000);
+
+            if (format == PA_SAMPLE_FLOAT32NE) {
+                const float *s = (const float *) src + ic;
+                float *d = (float *) dst + oc;
+
+                if (vol <= 0.0)
+                    continue;
+
+                for (i = 0; i < n; i++, s += n_ic, d += n_oc)
+                    *d += vol >= 1.0 ? *s : *s * vol;
+            } else {
+                const int16_t *s = (const int16_t *) src + ic;
+                int16_t *d = (int16_t *) dst + oc;
+
+                if (ivol <= 0)
+                    continue;
+
+                for (i = 0; i < n; i++, s += n_ic, d += n_oc)
+                    *d += ivol >= 0x10000 ? *s : (int16_t) (((int32_t) *s * ivol) >> 16);
+            }
+        }
+}
+
+static void remap_setup(pa_remap_t *m, pa_init_remap_func_t init, const float table[PA_CHANNELS_MAX][PA_CHANNELS_MAX]) {
+    unsigned oc, ic;
+
+    for (oc = 0; oc < m->o_ss->channels; oc++)
+        for (ic = 0; ic < m->i_ss->channels; ic++) {
+            m->map_table_f[oc][ic] = table[oc][ic];
+            m->map_table_i[oc][ic] = (int32_t) (table[oc][ic] * 0x10000);
+        }
+
+    pa_set_init_remap_func(init);
+    pa_init_remap(m);
+}
+
+static double remap_time(pa_remap_t *m, void *dst, const void *src) {
+    pa_usec_t start;
+    unsigned i;
+
+    start = pa_rtclock_now();
+    for (i = 0; i < BENCH_ROUNDS; i++)
+        m->do_remap(m, dst, src, BENCH_FRAMES);
+
+    return (double) (pa_rtclock_now() - start) / BENCH_ROUNDS;
+}
+
+static void benchmark(pa_init_remap_func_t init_c, pa_init_remap_func_t init_opt, pa_sample_format_t format) {
+    static float table[PA_CHANNELS_MAX][PA_CHANNELS_MAX];
+    void *src, *ref, *out_c, *out_opt;
+    size_t size, ss;
+    unsigned k, oc, ic, i;
+
+    ss = pa_sample_size_of_format(format);
+    size = BENCH_FRAMES * 8 * ss;
+    src = pa_xmalloc(size);
+    ref = pa_xmalloc(size);
+    out_c = pa_xmalloc(size);
+    out_opt = pa_xmalloc(size);
+
+    for (i = 0; i < BENCH_FRAMES * 8; i++) {
+        if (format == PA_SAMPLE_FLOAT32NE)
+            ((float *) src)[i] = (float) (rand() - RAND_MAX / 2) / (float) RAND_MAX;
+        else
+            ((int16_t *) src)[i] = (int16_t) rand();
+    }
+
+    for (k = 0; k < PA_ELEMENTSOF(layouts); k++) {
+        pa_sample_spec iss, oss;
+        pa_sample_format_t work_format = format;
+        pa_remap_t m;
+        unsigned n_ic = layouts[k].n_ic, n_oc = layouts[k].n_oc;
+        double t_c, t_opt;
+
+        /* Something that looks like the tables the resampler builds,
+         * with a few entries out of range thrown in. Mono to stereo is
+         * left as a pure copy. */
+        for (oc = 0; oc < n_oc; oc++)
+            for (ic = 0; ic < n_ic; ic++) {
+                switch (rand() % 6) {
+                    case 0: table[oc][ic] = 0.0f; break;
+                    case 1: table[oc][ic] = 1.0f; break;
+                    case 2: table[oc][ic] = 1.5f; break;
+                    case 3: table[oc][ic] = -0.25f; break;
+                    default: table[oc][ic] = (float) (rand() % 1000) / 1000.0f; break;
+                }
+
+                if (n_ic == 1 && n_oc == 2)
+                    table[oc][ic] = 1.0f;
+            }
+
+        iss.format = oss.format = format;
+        iss.rate = oss.rate = 44100;
+        iss.channels = (uint8_t) n_ic;
+        oss.channels = (uint8_t) n_oc;
+
+        memset(&m, 0, sizeof(m));
+        m.format = &work_format;
+        m.i_ss = &iss;
+        m.o_ss = &oss;
+
+        /* Odd frame counts to get the tails covered too */
+        for (i = BENCH_FRAMES - 7; i <= BENCH_FRAMES; i++) {
+            remap_reference(format, (const float (*)[PA_CHANNELS_MAX]) table, ref, src, i, n_ic, n_oc);
+
+            remap_setup(&m, init_c, (const float (*)[PA_CHANNELS_MAX]) table);
+            m.do_remap(&m, out_c, src, i);
+            pa_assert_se(memcmp(ref, out_c, i * n_oc * ss) == 0);
+
+            remap_setup(&m, init_opt, (const float (*)[PA_CHANNELS_MAX]) table);
+            m.do_remap(&m, out_opt, src, i);
+            pa_assert_se(memcmp(ref, out_opt, i * n_oc * ss) == 0);
+        }
+
+        remap_setup(&m, init_c, (const float (*)[PA_CHANNELS_MAX]) table);
+        t_c = remap_time(&m, out_c, src);
+
+        remap_setup(&m, init_opt, (const float (*)[PA_CHANNELS_MAX]) table);
+        t_opt = remap_time(&m, out_opt, src);
+
+        pa_log_info("%-10s %u -> %u channels: C %8.3f us, optimized %8.3f us per %u frames",
+                    pa_sample_format_to_string(format), n_ic, n_oc, t_c, t_opt, BENCH_FRAMES);
+    }
+
+    pa_set_init_remap_func(init_c);
+
+    pa_xfree(src);
+    pa_xfree(ref);
+    pa_xfree(out_c);
+    pa_xfree(out_opt);
+}
+
 int main(int argc, char *argv[]) {
 
     static const pa_channel_map maps[] = {
@@ -52,6 +225,20 @@ int main(int argc, char *argv[]) {
 
     pa_log_set_level(PA_LOG_DEBUG);
 
+    if (argc > 1 && strcmp(argv[1], "--benchmark") == 0) {
+        pa_init_remap_func_t init_c, init_opt;
+        pa_cpu_x86_flag_t flags = 0;
+
+        init_c = pa_get_init_remap_func();
+        pa_cpu_init_x86(&flags);
+        init_opt = pa_get_init_remap_func();
+
+        benchmark(init_c, init_opt, PA_SAMPLE_FLOAT32NE);
+        benchmark(init_c, init_opt, PA_SAMPLE_S16NE);
+
+        return 0;
+    }
+
     pa_assert_se(pool = pa_mempool_new(FALSE, 0));
 
     for (i = 0; maps[i].channels > 0; i++)
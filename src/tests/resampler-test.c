@@ -22,6 +22,8 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
 #include <getopt.h>
 #include <locale.h>
 
@@ -31,6 +33,7 @@
 #include <pulse/sample.h>
 #include <pulse/volume.h>
 
+#include <pulsecore/cpu-x86.h>
 #include <pulsecore/i18n.h>
 #include <pulsecore/log.h>
 #include <pulsecore/resampler.h>
@@ -38,6 +41,7 @@
 #include <pulsecore/endianmacros.h>
 #include <pulsecore/memblock.h>
 #include <pulsecore/sample-util.h>
+#include <pulsecore/sconv.h>
 #include <pulsecore/core-util.h>
 
 static void dump_block(const char *label, const pa_sample_spec *ss, const pa_memchunk *chunk) {
@@ -253,6 +257,94 @@ static pa_memblock* generate_block(pa_mempool *pool, const pa_sample_spec *ss) {
     return r;
 }
 
+/* The optimized peak finders have to agree with the C versions for all
+ * channel counts, lengths and the extreme values */
+static void check_peak_funcs(pa_peaks_s16_func_t ref_s16, pa_peaks_float_func_t ref_float) {
+    int16_t s[64 * PA_CHANNELS_MAX];
+    float f[64 * PA_CHANNELS_MAX];
+    unsigned channels, n, i;
+
+    for (i = 0; i < PA_ELEMENTSOF(s); i++) {
+        s[i] = (int16_t) (rand() - RAND_MAX / 2);
+        f[i] = (float) s[i] / 0x8000;
+    }
+
+    for (channels = 1; channels <= PA_CHANNELS_MAX; channels++)
+        for (n = 0; n <= 64; n++) {
+            int16_t peak_s16[PA_CHANNELS_MAX], ref_peak_s16[PA_CHANNELS_MAX];
+            float peak_float[PA_CHANNELS_MAX], ref_peak_float[PA_CHANNELS_MAX];
+
+            /* Put the extremes in different places each time */
+            s[(n * 7) % PA_ELEMENTSOF(s)] = -0x8000;
+            s[(n * 13) % PA_ELEMENTSOF(s)] = 0x7FFF;
+            f[(n * 11) % PA_ELEMENTSOF(f)] = -1.0f;
+
+            memset(peak_s16, 0, sizeof(peak_s16));
+            memset(ref_peak_s16, 0, sizeof(ref_peak_s16));
+            memset(peak_float, 0, sizeof(peak_float));
+            memset(ref_peak_float, 0, sizeof(ref_peak_float));
+
+            ref_s16(s, n, channels, ref_peak_s16);
+            pa_get_peaks_s16_func()(s, n, channels, peak_s16);
+            ref_float(f, n, channels, ref_peak_float);
+            pa_get_peaks_float_func()(f, n, channels, peak_float);
+
+            pa_assert_se(memcmp(peak_s16, ref_peak_s16, sizeof(peak_s16)) == 0);
+            pa_assert_se(memcmp(peak_float, ref_peak_float, sizeof(peak_float)) == 0);
+        }
+}
+
+/* Two meters on the same data come up with the same peaks, the second
+ * one without scanning it again */
+static void check_peaks_cache(pa_mempool *pool) {
+    pa_sample_spec ss, meter_ss;
+    pa_resampler *first, *second;
+    pa_resampler_cache *cache;
+    pa_memchunk i, j, k;
+    unsigned round;
+
+    ss.format = PA_SAMPLE_FLOAT32NE;
+    ss.rate = 44100;
+    ss.channels = 2;
+    meter_ss = ss;
+    meter_ss.rate = 25;
+
+    pa_assert_se(cache = pa_resampler_cache_new());
+    pa_assert_se(first = pa_resampler_new(pool, &ss, NULL, &meter_ss, NULL, PA_RESAMPLER_PEAKS, 0));
+    pa_assert_se(second = pa_resampler_new(pool, &ss, NULL, &meter_ss, NULL, PA_RESAMPLER_PEAKS, 0));
+
+    for (round = 0; round < 8; round++) {
+        float *d;
+        unsigned n;
+
+        i.memblock = pa_memblock_new(pool, pa_usec_to_bytes(30 * PA_USEC_PER_MSEC, &ss));
+        i.index = 0;
+        i.length = pa_memblock_get_length(i.memblock);
+
+        d = pa_memblock_acquire(i.memblock);
+        for (n = 0; n < i.length / sizeof(float); n++)
+            d[n] = (float) sin(n * 0.01 + round) * (n & 1 ? 0.5f : 1.0f);
+        pa_memblock_release(i.memblock);
+
+        pa_resampler_run_cached(first, cache, &i, &j);
+        pa_resampler_run_cached(second, cache, &i, &k);
+
+        pa_assert_se(j.memblock == k.memblock);
+        pa_assert_se(j.index == k.index && j.length == k.length);
+
+        if (j.memblock)
+            pa_memblock_unref(j.memblock);
+        if (k.memblock)
+            pa_memblock_unref(k.memblock);
+
+        pa_memblock_unref(i.memblock);
+    }
+
+    pa_resampler_free(first);
+    pa_resampler_free(second);
+    pa_resampler_cache_free(cache);
+}
+
 static void help(const char *argv0) {
     printf(_("%s [options]\n\n"
              "-h, --help                            Show this help\n"
@@ -264,11 +356,17 @@ static void help(const char *argv0) {
              "      --to-format=SAMPLEFORMAT        To sample type (defaults to s16le)\n"
              "      --to-channels=CHANNELS          To number of channels (defaults to 1)\n"
              "      --resample-method=METHOD        Resample method (defaults to auto)\n"
-             "      --seconds=SECONDS               From stream duration (defaults to 60)\n"
+             "      --seconds=SECONDS               From stream duration (defaults to 60, 10 with --benchmark)\n"
+             "      --benchmark                     Compare quality and speed of all resample methods\n"
              "\n"
              "If the formats are not specified, the test performs all formats combinations,\n"
              "back and forth.\n"
              "\n"
+             "With --benchmark, a tone at 997 Hz and one at 40%% of the lower sample rate\n"
+             "are resampled in 10 ms blocks with every method, and the signal to noise and\n"
+             "distortion ratio of the first channel, the gain, the CPU time per second of\n"
+             "audio and the time a small change of the input rate takes are printed.\n"
+             "\n"
              "Sample type must be one of s16le, s16be, u8, float32le, float32be, ulaw, alaw,\n"
              "32le, s32be (defaults to s16ne)\n"
              "\n"
@@ -286,7 +384,8 @@ enum {
     ARG_TO_CHANNELS,
     ARG_SECONDS,
     ARG_RESAMPLE_METHOD,
-    ARG_DUMP_RESAMPLE_METHODS
+    ARG_DUMP_RESAMPLE_METHODS,
+    ARG_BENCHMARK
 };
 
 static void dump_resample_methods(void) {
@@ -298,11 +397,189 @@ static void dump_resample_methods(void) {
 
 }
 
+/* Output the resampler has not settled yet on */
+#define BENCH_SKIP_MSEC 250
+#define BENCH_RATE_ROUNDS 200
+
+/* Least squares fit of a sine of w radians per sample to y. Returns the
+ * ratio of its power to that of what is left in dB. */
+static double sine_snr(const float *y, unsigned n, double w, double *amplitude) {
+    double scc = 0, sss = 0, scs = 0, syc = 0, sys = 0, det, ac, as, sig = 0, noise = 0;
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        double c = cos(w * i), s = sin(w * i);
+
+        scc += c * c;
+        sss += s * s;
+        scs += c * s;
+        syc += y[i] * c;
+        sys += y[i] * s;
+    }
+
+    det = scc * sss - scs * scs;
+    ac = (syc * sss - sys * scs) / det;
+    as = (sys * scc - syc * scs) / det;
+
+    for (i = 0; i < n; i++) {
+        double f = ac * cos(w * i) + as * sin(w * i);
+
+        sig += f * f;
+        noise += (y[i] - f) * (y[i] - f);
+    }
+
+    *amplitude = sqrt(ac * ac + as * as);
+
+    return noise > 0 ? 10.0 * log10(sig / noise) : INFINITY;
+}
+
+/* Resamples seconds of a tone at freq Hz with amplitude 0.5 in 10 ms
+ * blocks. Returns the SNR of the first output channel, sets the gain
+ * and the time spent in pa_resampler_run(). */
+static double run_tone(pa_mempool *pool, const pa_sample_spec *a, const pa_sample_spec *b,
+                       pa_resample_method_t method, double freq, int seconds, double *gain, pa_usec_t *t) {
+    pa_resampler *resampler;
+    pa_convert_func_t from_float, to_float;
+    pa_memchunk i, j;
+    float *tone, *out, *f;
+    unsigned n_in, n_out, max_out, block, k, skip;
+    size_t fz;
+    pa_usec_t start;
+    double snr;
+    void *d;
+
+    pa_assert_se(resampler = pa_resampler_new(pool, a, NULL, b, NULL, method, 0));
+
+    n_in = (unsigned) seconds * a->rate;
+    tone = pa_xnew(float, n_in * a->channels);
+
+    for (k = 0; k < n_in * a->channels; k++)
+        tone[k] = (float) (0.5 * sin(2.0 * M_PI * freq * (k / a->channels) / a->rate));
+
+    fz = pa_frame_size(a);
+    i.memblock = pa_memblock_new(pool, n_in * fz);
+    d = pa_memblock_acquire(i.memblock);
+
+    if ((from_float = pa_get_convert_from_float32ne_function(a->format)))
+        from_float(n_in * a->channels, tone, d);
+    else
+        memcpy(d, tone, n_in * fz);
+
+    pa_memblock_release(i.memblock);
+    pa_xfree(tone);
+
+    max_out = (unsigned) (((uint64_t) n_in * b->rate) / a->rate) + 1024;
+    out = pa_xnew(float, max_out);
+    f = pa_xnew(float, 1024 * b->channels);
+    to_float = pa_get_convert_to_float32ne_function(b->format);
+
+    block = a->rate / 100;
+    n_out = 0;
+    *t = 0;
+
+    for (k = 0; k + block <= n_in; k += block) {
+        unsigned n, l;
+
+        i.index = k * fz;
+        i.length = block * fz;
+
+        start = pa_rtclock_now();
+        pa_resampler_run(resampler, &i, &j);
+        *t += pa_rtclock_now() - start;
+
+        if (!j.memblock)
+            continue;
+
+        /* Keep the first channel as float */
+        d = (uint8_t*) pa_memblock_acquire(j.memblock) + j.index;
+        n = (unsigned) (j.length / pa_frame_size(b));
+
+        for (; n > 0; n -= l, d = (uint8_t*) d + l * pa_frame_size(b)) {
+            unsigned c;
+
+            l = PA_MIN(n, 1024U);
+
+            if (to_float)
+                to_float(l * b->channels, d, f);
+            else
+                memcpy(f, d, l * b->channels * sizeof(float));
+
+            for (c = 0; c < l && n_out < max_out; c++)
+                out[n_out++] = f[c * b->channels];
+        }
+
+        pa_memblock_release(j.memblock);
+        pa_memblock_unref(j.memblock);
+    }
+
+    skip = b->rate * BENCH_SKIP_MSEC / 1000;
+    pa_assert_se(n_out > skip);
+
+    snr = sine_snr(out + skip, n_out - skip, 2.0 * M_PI * freq / b->rate, gain);
+    *gain = 20.0 * log10(*gain / 0.5);
+
+    pa_memblock_unref(i.memblock);
+    pa_xfree(out);
+    pa_xfree(f);
+    pa_resampler_free(resampler);
+
+    return snr;
+}
+
+/* The time to nudge the input rate by 1 Hz, as drift correction does */
+static double time_rate_update(pa_mempool *pool, const pa_sample_spec *a, const pa_sample_spec *b, pa_resample_method_t method) {
+    pa_resampler *resampler;
+    pa_usec_t start;
+    unsigned k;
+
+    pa_assert_se(resampler = pa_resampler_new(pool, a, NULL, b, NULL, method, PA_RESAMPLER_VARIABLE_RATE));
+
+    start = pa_rtclock_now();
+    for (k = 0; k < BENCH_RATE_ROUNDS; k++)
+        pa_resampler_set_input_rate(resampler, a->rate + 1 - (k & 1));
+
+    pa_resampler_free(resampler);
+
+    return (double) (pa_rtclock_now() - start) / BENCH_RATE_ROUNDS;
+}
+
+static void benchmark(pa_mempool *pool, const pa_sample_spec *a, const pa_sample_spec *b, int seconds) {
+    double high;
+    int m;
+
+    high = 0.4 * PA_MIN(a->rate, b->rate);
+
+    printf("%d seconds: %u Hz %u ch (%s) -> %u Hz %u ch (%s)\n\n", seconds,
+           a->rate, a->channels, pa_sample_format_to_string(a->format),
+           b->rate, b->channels, pa_sample_format_to_string(b->format));
+    printf("%-24s %12s %12s %10s %12s %12s\n", "method", "SNR 997 Hz", "SNR high", "gain high", "us per sec", "rate update");
+
+    for (m = 0; m < PA_RESAMPLER_MAX; m++) {
+        double snr_low, snr_high, gain_low, gain_high;
+        pa_usec_t t_low, t_high;
+
+        if (!pa_resample_method_supported(m) ||
+            m == PA_RESAMPLER_AUTO || m == PA_RESAMPLER_COPY || m == PA_RESAMPLER_PEAKS)
+            continue;
+
+        snr_low = run_tone(pool, a, b, m, 997.0, seconds, &gain_low, &t_low);
+        snr_high = run_tone(pool, a, b, m, high, seconds, &gain_high, &t_high);
+
+        printf("%-24s %9.1f dB %9.1f dB %7.2f dB %12.1f ", pa_resample_method_to_string(m),
+               snr_low, snr_high, gain_high, (double) (t_low + t_high) / (2.0 * seconds));
+
+        if (m == PA_RESAMPLER_FFMPEG)
+            printf("%12s\n", "-");
+        else
+            printf("%9.2f us\n", time_rate_update(pool, a, b, m));
+    }
+}
+
 int main(int argc, char *argv[]) {
     pa_mempool *pool = NULL;
     pa_sample_spec a, b;
     int ret = 1, c;
-    pa_bool_t all_formats = TRUE;
+    pa_bool_t all_formats = TRUE, bench = FALSE, verbose = FALSE;
     pa_resample_method_t method;
     int seconds;
 
@@ -319,6 +596,7 @@ int main(int argc, char *argv[]) {
         {"seconds",               1, NULL, ARG_SECONDS},
         {"resample-method",       1, NULL, ARG_RESAMPLE_METHOD},
         {"dump-resample-methods", 0, NULL, ARG_DUMP_RESAMPLE_METHODS},
+        {"benchmark",             0, NULL, ARG_BENCHMARK},
         {NULL,                    0, NULL, 0}
     };
 
@@ -338,7 +616,7 @@ int main(int argc, char *argv[]) {
     a.format = b.format = PA_SAMPLE_S16LE;
 
     method = PA_RESAMPLER_AUTO;
-    seconds = 60;
+    seconds = -1;
 
     while ((c = getopt_long(argc, argv, "hv", long_options, NULL)) != -1) {
 
@@ -350,6 +628,7 @@ int main(int argc, char *argv[]) {
 
             case 'v':
                 pa_log_set_level(PA_LOG_DEBUG);
+                verbose = TRUE;
                 break;
 
             case ARG_VERSION:
@@ -392,6 +671,10 @@ int main(int argc, char *argv[]) {
                 seconds = atoi(optarg);
                 break;
 
+            case ARG_BENCHMARK:
+                bench = TRUE;
+                break;
+
             case ARG_RESAMPLE_METHOD:
                 if (*optarg == '\0' || pa_streq(optarg, "help")) {
                     dump_resample_methods();
@@ -409,6 +692,22 @@ int main(int argc, char *argv[]) {
     ret = 0;
     pa_assert_se(pool = pa_mempool_new(FALSE, 0));
 
+    if (bench) {
+        pa_cpu_x86_flag_t flags = 0;
+
+        if (!verbose)
+            pa_log_set_level(PA_LOG_WARN);
+
+        /* The same optimized functions as the daemon */
+        pa_cpu_init_x86(&flags);
+
+        benchmark(pool, &a, &b, seconds > 0 ? seconds : 10);
+        goto quit;
+    }
+
+    if (seconds < 0)
+        seconds = 60;
+
     if (!all_formats) {
 
         pa_resampler *resampler;
@@ -473,6 +772,17 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    {
+        pa_peaks_s16_func_t ref_s16 = pa_get_peaks_s16_func();
+        pa_peaks_float_func_t ref_float = pa_get_peaks_float_func();
+        pa_cpu_x86_flag_t flags = 0;
+
+        pa_cpu_init_x86(&flags);
+
+        check_peak_funcs(ref_s16, ref_float);
+        check_peaks_cache(pool);
+    }
+
  quit:
     if (pool)
         pa_mempool_free(pool);
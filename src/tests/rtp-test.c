@@ -0,0 +1,417 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+
+#include <pulsecore/arpa-inet.h>
+#include <pulsecore/core-rtclock.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/memblockq.h>
+#include <pulsecore/sample-util.h>
+
+#include <modules/rtp/rtp.h>
+#include <modules/rtp/jitter.h>
+
+/* Sends 1ms packets over a loopback socket, dropping, delaying and
+ * reordering some of them on the way, receives them in batches and
+ * plays them out of a jitter buffer a millisecond at a time. Time is
+ * simulated, so this runs as fast as it can. Every frame carries its
+ * own timestamp, which makes it easy to check what comes out. Then
+ * measures batched against one-by-one receiving, and sending a packet
+ * per wakeup against sending several from a bigger one. */
+
+#define RATE 48000
+#define PACKET_FRAMES 48
+#define PACKET_BYTES (PACKET_FRAMES * 4)
+#define N_PACKETS 3000
+#define SSRC 0x12345678
+#define PAYLOAD 127
+#define MIN_LATENCY (20*PA_USEC_PER_MSEC)
+#define MAX_LATENCY (500*PA_USEC_PER_MSEC)
+#define BENCH_BURST 256
+#define BENCH_ROUNDS 100
+#define BENCH_STREAMS 32
+#define BENCH_SECONDS 2
+
+static const pa_sample_spec ss = {
+    .format = PA_SAMPLE_S16NE,
+    .rate = RATE,
+    .channels = 2
+};
+
+static const struct scenario {
+    const char *name;
+    unsigned loss;         /* in ‰ */
+    unsigned reorder;      /* in ‰ */
+    pa_usec_t jitter;
+} scenarios[] = {
+    { "clean", 0, 0, 0 },
+    { "2% loss", 20, 0, 0 },
+    { "8ms jitter, reordering", 0, 50, 8*PA_USEC_PER_MSEC },
+    { "60ms jitter, 1% loss", 10, 0, 60*PA_USEC_PER_MSEC }
+};
+
+static uint32_t seed = 1;
+
+static unsigned rnd(unsigned n) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 16) % n;
+}
+
+static void open_sockets(int *recv_fd, int *send_fd) {
+    struct sockaddr_in sa;
+    socklen_t salen = sizeof(sa);
+    int one = 1, size = 4*1024*1024;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    pa_assert_se((*recv_fd = socket(AF_INET, SOCK_DGRAM, 0)) >= 0);
+    pa_assert_se(setsockopt(*recv_fd, SOL_SOCKET, SO_TIMESTAMP, &one, sizeof(one)) == 0);
+    pa_assert_se(setsockopt(*recv_fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) == 0);
+    pa_assert_se(bind(*recv_fd, (struct sockaddr*) &sa, sizeof(sa)) == 0);
+    pa_assert_se(getsockname(*recv_fd, (struct sockaddr*) &sa, &salen) == 0);
+
+    pa_assert_se((*send_fd = socket(AF_INET, SOCK_DGRAM, 0)) >= 0);
+    pa_assert_se(connect(*send_fd, (struct sockaddr*) &sa, salen) == 0);
+}
+
+static void send_packet(int fd, unsigned i) {
+    uint32_t packet[3 + PACKET_FRAMES];
+    uint32_t ts = i * PACKET_FRAMES;
+    unsigned k;
+
+    packet[0] = htonl(((uint32_t) 2 << 30) | ((uint32_t) PAYLOAD << 16) | (i & 0xFFFFU));
+    packet[1] = htonl(ts);
+    packet[2] = htonl(SSRC);
+
+    for (k = 0; k < PACKET_FRAMES; k++) {
+        int16_t v[2];
+
+        v[0] = v[1] = (int16_t) (ts + k);
+        memcpy(&packet[3 + k], v, sizeof(v));
+    }
+
+    pa_assert_se(send(fd, packet, sizeof(packet), 0) == sizeof(packet));
+}
+
+static void run(const struct scenario *sc, pa_mempool *pool) {
+    pa_usec_t arrival[N_PACKETS];
+    unsigned order[N_PACKETS];
+    pa_bool_t lost[N_PACKETS];
+    pa_rtp_context c;
+    pa_memblockq *q;
+    pa_jitter_buffer *j;
+    pa_jitter_buffer_stats stats;
+    int recv_fd, send_fd;
+    unsigned i, k, sent = 0, n_lost = 0, batches = 0, received = 0, underruns = 0;
+    uint64_t frames = 0, good = 0, bad = 0;
+    int64_t offset = -1, credit = 0;
+    pa_usec_t t;
+
+    open_sockets(&recv_fd, &send_fd);
+    pa_rtp_context_init_recv(&c, recv_fd, pa_frame_size(&ss));
+
+    q = pa_memblockq_new("rtp-test memblockq", 0, 40*1024*1024, 40*1024*1024, &ss, 0, 0, 0, NULL);
+    j = pa_jitter_buffer_new(q, pool, &ss, MIN_LATENCY, MAX_LATENCY);
+
+    /* Leave the ends alone, a packet lost there never becomes a hole */
+    for (i = 0; i < N_PACKETS; i++) {
+        arrival[i] = i * PA_USEC_PER_MSEC;
+
+        if (sc->jitter > 0)
+            arrival[i] += rnd((unsigned) sc->jitter);
+
+        if (sc->reorder > 0 && rnd(1000) < sc->reorder)
+            arrival[i] += 3 * PA_USEC_PER_MSEC;
+
+        lost[i] = i >= 10 && i < N_PACKETS - 10 && sc->loss > 0 && rnd(1000) < sc->loss;
+        n_lost += lost[i];
+        order[i] = i;
+    }
+
+    /* Insertion sort by arrival, nothing moves very far */
+    for (i = 1; i < N_PACKETS; i++)
+        for (k = i; k > 0 && arrival[order[k]] < arrival[order[k-1]]; k--) {
+            unsigned x = order[k];
+            order[k] = order[k-1];
+            order[k-1] = x;
+        }
+
+    for (t = 0; t < (N_PACKETS + 1000) * PA_USEC_PER_MSEC; t += PA_USEC_PER_MSEC) {
+        pa_rtp_packet packets[PA_RTP_BATCH_MAX];
+        int n;
+
+        for (; sent < N_PACKETS && arrival[order[sent]] <= t; sent++)
+            if (!lost[order[sent]])
+                send_packet(send_fd, order[sent]);
+
+        while ((n = pa_rtp_recv_batch(&c, packets, PA_RTP_BATCH_MAX, pool)) > 0) {
+            batches++;
+
+            for (k = 0; k < (unsigned) n; k++) {
+                pa_assert(packets[k].payload == PAYLOAD);
+                pa_assert(packets[k].ssrc == SSRC);
+                pa_assert(packets[k].chunk.length == PACKET_BYTES);
+
+                pa_jitter_buffer_push(j, packets[k].timestamp, t, &packets[k].chunk);
+                pa_memblock_unref(packets[k].chunk.memblock);
+                received++;
+            }
+        }
+
+        pa_assert(n == 0);
+
+        /* The sink wants a millisecond every millisecond */
+        for (credit += PACKET_BYTES; credit > 0;) {
+            pa_memchunk chunk;
+            const int16_t *d;
+
+            if (pa_jitter_buffer_pop(j, &chunk) < 0) {
+                if (frames > 0 && sent < N_PACKETS)
+                    underruns++;
+
+                credit = 0;
+                break;
+            }
+
+            pa_assert(chunk.memblock);
+            d = (const int16_t*) ((uint8_t*) pa_memblock_acquire(chunk.memblock) + chunk.index);
+
+            for (k = 0; k < chunk.length / 4; k++, frames++) {
+                if (offset < 0)
+                    offset = (uint16_t) d[0] - (int64_t) frames;
+
+                if (d[2*k] == (int16_t) (frames + offset) && d[2*k+1] == d[2*k])
+                    good++;
+                else
+                    bad++;
+            }
+
+            pa_memblock_release(chunk.memblock);
+            pa_memblock_unref(chunk.memblock);
+
+            credit -= (int64_t) chunk.length;
+        }
+    }
+
+    pa_jitter_buffer_get_stats(j, &stats);
+
+    pa_log_info("%-24s %4u lost, %4llu reordered, %3llu late, %3u underruns, %5u batches, jitter %5.2f ms, latency %6.2f ms, %llu frames concealed, %llu/%llu frames intact",
+                sc->name, n_lost,
+                (unsigned long long) stats.reordered,
+                (unsigned long long) stats.late,
+                underruns, batches,
+                (double) stats.jitter / PA_USEC_PER_MSEC,
+                (double) pa_jitter_buffer_get_latency(j) / PA_USEC_PER_MSEC,
+                (unsigned long long) stats.concealed / 4,
+                (unsigned long long) good, (unsigned long long) frames);
+
+    pa_assert(received == N_PACKETS - n_lost);
+    pa_assert(stats.packets == received);
+
+    /* Everything that was not filled in came out in the right place */
+    pa_assert(bad == stats.concealed / 4);
+
+    if (sc->jitter == 0) {
+        pa_assert(stats.late == 0);
+        pa_assert(underruns == 0);
+        pa_assert(stats.concealed == (uint64_t) n_lost * PACKET_BYTES);
+        pa_assert(pa_jitter_buffer_get_latency(j) == MIN_LATENCY);
+    } else {
+        pa_assert(pa_jitter_buffer_get_latency(j) > MIN_LATENCY + sc->jitter / 2);
+        pa_assert(batches < received);
+        pa_assert(good > frames * 95 / 100);
+    }
+
+    /* Only a packet overtaken by the very first one can be too late */
+    if (sc->reorder > 0) {
+        pa_assert(stats.reordered > 0);
+        pa_assert(stats.late <= 1);
+        pa_assert(stats.concealed == 0);
+    }
+
+    pa_jitter_buffer_free(j);
+    pa_memblockq_free(q);
+    pa_rtp_context_destroy(&c);
+    pa_assert_se(pa_close(send_fd) == 0);
+}
+
+static void bench(pa_mempool *pool) {
+    pa_rtp_context c;
+    int recv_fd, send_fd;
+    pa_usec_t start, t_single = 0, t_batch = 0;
+    unsigned round, i;
+
+    open_sockets(&recv_fd, &send_fd);
+    pa_rtp_context_init_recv(&c, recv_fd, pa_frame_size(&ss));
+
+    for (round = 0; round < BENCH_ROUNDS; round++) {
+        pa_rtp_packet packets[PA_RTP_BATCH_MAX];
+        pa_memchunk chunk;
+        struct timeval tv;
+        int n;
+
+        for (i = 0; i < BENCH_BURST; i++)
+            send_packet(send_fd, i);
+
+        start = pa_rtclock_now();
+        for (i = 0; i < BENCH_BURST; i++) {
+            pa_assert_se(pa_rtp_recv(&c, &chunk, pool, &tv) == 0);
+            pa_memblock_unref(chunk.memblock);
+        }
+        t_single += pa_rtclock_now() - start;
+
+        for (i = 0; i < BENCH_BURST; i++)
+            send_packet(send_fd, i);
+
+        start = pa_rtclock_now();
+        for (i = 0; i < BENCH_BURST; i += (unsigned) n) {
+            int k;
+
+            pa_assert_se((n = pa_rtp_recv_batch(&c, packets, PA_RTP_BATCH_MAX, pool)) > 0);
+
+            for (k = 0; k < n; k++)
+                pa_memblock_unref(packets[k].chunk.memblock);
+        }
+        t_batch += pa_rtclock_now() - start;
+
+        pa_assert(i == BENCH_BURST);
+    }
+
+    pa_log_info("Receiving %u packets: one by one %0.3f us, batched %0.3f us per packet",
+                BENCH_BURST * BENCH_ROUNDS,
+                (double) t_single / (BENCH_BURST * BENCH_ROUNDS),
+                (double) t_batch / (BENCH_BURST * BENCH_ROUNDS));
+
+    pa_rtp_context_destroy(&c);
+    pa_assert_se(pa_close(send_fd) == 0);
+}
+
+static pa_usec_t cpu_now(void) {
+    struct timespec ts;
+
+    pa_assert_se(clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) == 0);
+    return pa_timespec_load(&ts);
+}
+
+/* Every stream gets a millisecond per packet, either one packet per
+ * wakeup or all that were collected over interval */
+static void bench_send(pa_mempool *pool, pa_usec_t interval) {
+    pa_rtp_context c[BENCH_STREAMS];
+    pa_memblockq *q[BENCH_STREAMS];
+    int recv_fd[BENCH_STREAMS];
+    pa_memchunk chunk;
+    pa_usec_t start, cpu_start, wall, cpu;
+    unsigned i, t, n_packets = 0;
+    int send_fd;
+
+    chunk.memblock = pa_memblock_new(pool, pa_usec_to_bytes(interval, &ss));
+    chunk.index = 0;
+    chunk.length = pa_memblock_get_length(chunk.memblock);
+    pa_silence_memchunk(&chunk, &ss);
+
+    for (i = 0; i < BENCH_STREAMS; i++) {
+        open_sockets(&recv_fd[i], &send_fd);
+        pa_rtp_context_init_send(&c[i], send_fd, SSRC + i, PAYLOAD, pa_frame_size(&ss));
+        q[i] = pa_memblockq_new("rtp-test memblockq", 0, 1024*1024, 1024*1024, &ss, 1, 0, 0, NULL);
+    }
+
+    start = pa_rtclock_now();
+    cpu_start = cpu_now();
+
+    for (t = 0; t < BENCH_SECONDS * PA_USEC_PER_SEC; t += (unsigned) interval)
+        for (i = 0; i < BENCH_STREAMS; i++) {
+            uint16_t seq = c[i].sequence;
+
+            pa_assert_se(pa_memblockq_push(q[i], &chunk) == 0);
+            pa_assert_se(pa_rtp_send(&c[i], PACKET_BYTES, q[i]) == 0);
+
+            n_packets += (uint16_t) (c[i].sequence - seq);
+        }
+
+    wall = pa_rtclock_now() - start;
+    cpu = cpu_now() - cpu_start;
+
+    pa_assert(n_packets == BENCH_STREAMS * BENCH_SECONDS * 1000);
+
+    pa_log_info("Sending %u streams, %2u packets per wakeup: %8.0f packets/s, %0.3f%% CPU per stream",
+                BENCH_STREAMS, (unsigned) (interval / PA_USEC_PER_MSEC),
+                (double) n_packets * PA_USEC_PER_SEC / wall,
+                (double) cpu * 100 / (BENCH_SECONDS * PA_USEC_PER_SEC) / BENCH_STREAMS);
+
+    /* Whatever the socket buffers kept has to be intact */
+    for (i = 0; i < BENCH_STREAMS; i++) {
+        pa_rtp_context r;
+        pa_rtp_packet packets[PA_RTP_BATCH_MAX];
+        int k, n;
+
+        pa_rtp_context_init_recv(&r, recv_fd[i], pa_frame_size(&ss));
+        pa_assert_se((n = pa_rtp_recv_batch(&r, packets, PA_RTP_BATCH_MAX, pool)) > 0);
+
+        for (k = 0; k < n; k++) {
+            pa_assert(packets[k].ssrc == SSRC + i);
+            pa_assert(packets[k].chunk.length == PACKET_BYTES);
+            pa_assert(packets[k].timestamp - packets[0].timestamp == (uint16_t) (packets[k].sequence - packets[0].sequence) * PACKET_FRAMES);
+            pa_memblock_unref(packets[k].chunk.memblock);
+        }
+
+        pa_rtp_context_destroy(&r);
+        pa_rtp_context_destroy(&c[i]);
+        pa_memblockq_free(q[i]);
+    }
+
+    pa_memblock_unref(chunk.memblock);
+}
+
+int main(int argc, char *argv[]) {
+    pa_mempool *pool;
+    unsigned i;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    pa_assert_se(pool = pa_mempool_new(FALSE, 0));
+
+    for (i = 0; i < PA_ELEMENTSOF(scenarios); i++)
+        run(&scenarios[i], pool);
+
+    bench(pool);
+    bench_send(pool, PA_USEC_PER_MSEC);
+    bench_send(pool, 10 * PA_USEC_PER_MSEC);
+
+    pa_mempool_free(pool);
+
+    return 0;
+}
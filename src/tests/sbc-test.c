@@ -0,0 +1,228 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-error.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include <modules/bluetooth/sbc/sbc.h>
+
+/* Encodes PCM with every subband, block, mode, allocation and bitpool
+ * setting, once with the generic C primitives and once with whatever
+ * the CPU has optimized ones for, and checks that both produce the same
+ * frames. Then measures both with the settings A2DP sinks usually ask
+ * for. The PCM is synthesized, or read from the file given as argument
+ * (raw S16LE stereo). */
+
+#define SYNTH_FRAMES 4096
+#define BENCH_ROUNDS 20
+#define BENCH_BITPOOL 53
+
+static const char *const mode_names[] = { "mono", "dual", "stereo", "joint" };
+
+/* A few sines, some noise, a clipped stretch and some silence */
+static int16_t *synthesize(size_t *length) {
+    int16_t *pcm;
+    uint32_t seed = 1;
+    unsigned i;
+
+    pcm = pa_xnew(int16_t, SYNTH_FRAMES * 2);
+
+    for (i = 0; i < SYNTH_FRAMES; i++) {
+        double l, r;
+
+        seed = seed * 1103515245 + 12345;
+
+        l = 0.5 * sin(i * 0.031) + 0.2 * sin(i * 0.71) + (double) (int16_t) (seed >> 16) / 0x20000;
+        r = 0.7 * sin(i * 0.0123 + 1.0) + 0.1 * sin(i * 1.9);
+
+        if (i >= SYNTH_FRAMES / 2 && i < SYNTH_FRAMES * 5 / 8) {
+            l *= 4;
+            r *= 4;
+        } else if (i >= SYNTH_FRAMES * 3 / 4 && i < SYNTH_FRAMES * 7 / 8)
+            l = r = 0;
+
+        pcm[2 * i] = (int16_t) PA_CLAMP(lrint(l * 0x7FFF), -0x8000, 0x7FFF);
+        pcm[2 * i + 1] = (int16_t) PA_CLAMP(lrint(r * 0x7FFF), -0x8000, 0x7FFF);
+    }
+
+    *length = SYNTH_FRAMES * 4;
+    return pcm;
+}
+
+static int16_t *load(const char *fn, size_t *length) {
+    FILE *f;
+    int16_t *pcm;
+    long size;
+
+    if (!(f = fopen(fn, "rb"))) {
+        pa_log("Failed to open %s: %s", fn, pa_cstrerror(errno));
+        return NULL;
+    }
+
+    pa_assert_se(fseek(f, 0, SEEK_END) == 0);
+    pa_assert_se((size = ftell(f)) >= 0);
+    rewind(f);
+
+    pcm = pa_xmalloc((size_t) size + 1);
+    pa_assert_se(fread(pcm, 1, (size_t) size, f) == (size_t) size);
+    fclose(f);
+
+    *length = (size_t) size;
+    return pcm;
+}
+
+/* Returns the number of bytes written to out */
+static size_t encode(sbc_t *sbc, const void *pcm, size_t length, uint8_t *out) {
+    const uint8_t *p = pcm;
+    size_t codesize, framelen, n = 0;
+
+    codesize = sbc_get_codesize(sbc);
+    framelen = sbc_get_frame_length(sbc);
+
+    while (length >= codesize) {
+        ssize_t written;
+
+        pa_assert_se(sbc_encode(sbc, p, length, out + n, framelen, &written) == (ssize_t) codesize);
+        pa_assert((size_t) written == framelen);
+
+        p += codesize;
+        length -= codesize;
+        n += (size_t) written;
+    }
+
+    return n;
+}
+
+static void setup(sbc_t *sbc, unsigned long flags, int subbands, int blocks, int mode, int allocation, int bitpool) {
+    pa_assert_se(sbc_init(sbc, flags) == 0);
+
+    sbc->frequency = SBC_FREQ_44100;
+    sbc->subbands = (uint8_t) subbands;
+    sbc->blocks = (uint8_t) blocks;
+    sbc->mode = (uint8_t) mode;
+    sbc->allocation = (uint8_t) allocation;
+    sbc->bitpool = (uint8_t) bitpool;
+    sbc->endian = SBC_LE;
+}
+
+int main(int argc, char *argv[]) {
+    int16_t *pcm;
+    size_t length;
+    uint8_t *c_out, *simd_out;
+    const char *impl = NULL;
+    int subbands, blocks, mode, allocation, bitpool;
+    unsigned n_configs = 0;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    if (argc > 1) {
+        if (!(pcm = load(argv[1], &length)))
+            return 1;
+    } else
+        pcm = synthesize(&length);
+
+    /* With high bitpools frames can be bigger than the PCM they come
+     * from, but not twice as big */
+    c_out = pa_xmalloc(2 * length + 1024);
+    simd_out = pa_xmalloc(2 * length + 1024);
+
+    for (subbands = SBC_SB_4; subbands <= SBC_SB_8; subbands++)
+        for (blocks = SBC_BLK_4; blocks <= SBC_BLK_16; blocks++)
+            for (mode = SBC_MODE_MONO; mode <= SBC_MODE_JOINT_STEREO; mode++)
+                for (allocation = SBC_AM_LOUDNESS; allocation <= SBC_AM_SNR; allocation++) {
+                    int max_bitpool = (subbands == SBC_SB_8 ? 8 : 4) * (mode <= SBC_MODE_DUAL_CHANNEL ? 16 : 32);
+
+                    for (bitpool = 2; bitpool <= PA_MIN(max_bitpool, 250); bitpool++) {
+                        sbc_t c, simd;
+                        size_t n;
+
+                        setup(&c, SBC_FLAG_NO_SIMD, subbands, blocks, mode, allocation, bitpool);
+                        setup(&simd, 0, subbands, blocks, mode, allocation, bitpool);
+
+                        n = encode(&c, pcm, length, c_out);
+                        pa_assert_se(encode(&simd, pcm, length, simd_out) == n);
+
+                        if (memcmp(c_out, simd_out, n) != 0) {
+                            pa_log("Mismatch with %s, %u subbands, %u blocks, %s, %s, bitpool %u",
+                                   sbc_get_implementation_info(&simd),
+                                   subbands == SBC_SB_8 ? 8 : 4, 4 + blocks * 4, mode_names[mode],
+                                   allocation == SBC_AM_SNR ? "SNR" : "loudness", bitpool);
+                            return 1;
+                        }
+
+                        impl = sbc_get_implementation_info(&simd);
+                        n_configs++;
+
+                        sbc_finish(&c);
+                        sbc_finish(&simd);
+                    }
+                }
+
+    pa_log_info("%s matches generic C in all %u configurations", impl, n_configs);
+
+    for (subbands = SBC_SB_4; subbands <= SBC_SB_8; subbands++)
+        for (blocks = SBC_BLK_4; blocks <= SBC_BLK_16; blocks++) {
+            sbc_t c, simd;
+            pa_usec_t start, t_c, t_simd;
+            unsigned i;
+
+            setup(&c, SBC_FLAG_NO_SIMD, subbands, blocks, SBC_MODE_JOINT_STEREO, SBC_AM_LOUDNESS, BENCH_BITPOOL);
+            setup(&simd, 0, subbands, blocks, SBC_MODE_JOINT_STEREO, SBC_AM_LOUDNESS, BENCH_BITPOOL);
+
+            start = pa_rtclock_now();
+            for (i = 0; i < BENCH_ROUNDS; i++)
+                encode(&c, pcm, length, c_out);
+            t_c = pa_rtclock_now() - start;
+
+            start = pa_rtclock_now();
+            for (i = 0; i < BENCH_ROUNDS; i++)
+                encode(&simd, pcm, length, simd_out);
+            t_simd = pa_rtclock_now() - start;
+
+            pa_log_info("%u subbands, %2u blocks, joint stereo, bitpool %u: C %7.1f us, %s %7.1f us per %lu frames",
+                        subbands == SBC_SB_8 ? 8 : 4, 4 + blocks * 4, BENCH_BITPOOL,
+                        (double) t_c / BENCH_ROUNDS, sbc_get_implementation_info(&simd),
+                        (double) t_simd / BENCH_ROUNDS, (unsigned long) (length / 4));
+
+            sbc_finish(&c);
+            sbc_finish(&simd);
+        }
+
+    pa_xfree(pcm);
+    pa_xfree(c_out);
+    pa_xfree(simd_out);
+
+    return 0;
+}
@@ -0,0 +1,142 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/sample.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/endianmacros.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/random.h>
+#include <pulsecore/sconv.h>
+
+/* Runs every sample format conversion the CPU has an optimized version
+ * of against the C one, checks that both produce the same bytes for all
+ * the leftover counts and prints how long they take. */
+
+#define SAMPLES 4096
+#define ROUNDS 500
+
+static const struct {
+    pa_convert_func_t (*get)(pa_sample_format_t f);
+    pa_bool_t to;
+    pa_sample_format_t other;
+} tables[] = {
+    { pa_get_convert_to_float32ne_function, TRUE, PA_SAMPLE_FLOAT32NE },
+    { pa_get_convert_from_float32ne_function, FALSE, PA_SAMPLE_FLOAT32NE },
+    { pa_get_convert_to_s16ne_function, TRUE, PA_SAMPLE_S16NE },
+    { pa_get_convert_from_s16ne_function, FALSE, PA_SAMPLE_S16NE },
+};
+
+static void fill(pa_sample_format_t f, void *d, unsigned n) {
+    unsigned i;
+
+    pa_random(d, n * pa_sample_size_of_format(f));
+
+    /* Random bits make bad floats, make them go somewhat beyond the
+     * range to exercise clamping */
+    if (f == PA_SAMPLE_FLOAT32NE || f == PA_SAMPLE_FLOAT32RE)
+        for (i = 0; i < n; i++) {
+            float x = (float) ((int16_t *) d)[2 * i] / 0x7800;
+
+            ((float *) d)[i] = f == PA_SAMPLE_FLOAT32NE ? x : PA_FLOAT32_SWAP(x);
+        }
+}
+
+static double convert_time(pa_convert_func_t func, const void *src, void *dst) {
+    pa_usec_t start;
+    unsigned i;
+
+    start = pa_rtclock_now();
+    for (i = 0; i < ROUNDS; i++)
+        func(SAMPLES, src, dst);
+
+    return (double) (pa_rtclock_now() - start) / ROUNDS;
+}
+
+int main(int argc, char *argv[]) {
+    pa_convert_func_t c_funcs[PA_ELEMENTSOF(tables)][PA_SAMPLE_MAX];
+    pa_cpu_x86_flag_t flags = 0;
+    unsigned t;
+    pa_sample_format_t f;
+    void *src, *c_dst, *opt_dst;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    for (t = 0; t < PA_ELEMENTSOF(tables); t++)
+        for (f = 0; f < PA_SAMPLE_MAX; f++)
+            c_funcs[t][f] = tables[t].get(f);
+
+    pa_cpu_init_x86(&flags);
+
+    src = pa_xmalloc(SAMPLES * 4);
+    c_dst = pa_xmalloc(SAMPLES * 4);
+    opt_dst = pa_xmalloc(SAMPLES * 4);
+
+    for (t = 0; t < PA_ELEMENTSOF(tables); t++)
+        for (f = 0; f < PA_SAMPLE_MAX; f++) {
+            pa_convert_func_t opt_func = tables[t].get(f);
+            pa_sample_format_t sf = tables[t].to ? f : tables[t].other;
+            pa_sample_format_t df = tables[t].to ? tables[t].other : f;
+            double t_c, t_opt;
+            unsigned n;
+
+            if (!opt_func || opt_func == c_funcs[t][f])
+                continue;
+
+            fill(sf, src, SAMPLES);
+
+            /* All leftover counts, the optimized versions work in
+             * blocks of up to eight samples */
+            for (n = SAMPLES - 8; n <= SAMPLES; n++) {
+                memset(c_dst, 0x55, SAMPLES * 4);
+                memset(opt_dst, 0x55, SAMPLES * 4);
+
+                c_funcs[t][f](n, src, c_dst);
+                opt_func(n, src, opt_dst);
+
+                pa_assert_se(memcmp(c_dst, opt_dst, SAMPLES * 4) == 0);
+            }
+
+            t_c = convert_time(c_funcs[t][f], src, c_dst);
+            t_opt = convert_time(opt_func, src, opt_dst);
+
+            pa_log_info("%-10s -> %-10s: C %8.3f us, optimized %8.3f us per %u samples",
+                        pa_sample_format_to_string(sf), pa_sample_format_to_string(df),
+                        t_c, t_opt, SAMPLES);
+        }
+
+    pa_xfree(src);
+    pa_xfree(c_dst);
+    pa_xfree(opt_dst);
+
+    return 0;
+}
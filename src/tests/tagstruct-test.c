@@ -0,0 +1,265 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+  USA.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+
+#include <pulse/channelmap.h>
+#include <pulse/def.h>
+#include <pulse/proplist.h>
+#include <pulse/rtclock.h>
+#include <pulse/sample.h>
+#include <pulse/timeval.h>
+#include <pulse/volume.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/packet.h>
+#include <pulsecore/tagstruct.h>
+
+#include "alloc-count.h"
+
+/* Serializes records shaped like the sink and sink input info replies
+ * of the native protocol, checks that they read back unchanged and
+ * reports how long that takes and how many heap allocations it needs. */
+
+#define N_RECORDS 20000
+#define N_PORTS 10
+#define N_PROPS 20
+
+static pa_sample_spec ss;
+static pa_channel_map map;
+static pa_cvolume volume;
+static pa_proplist *proplist;
+
+static void put_sink_info(pa_tagstruct *t, uint32_t idx) {
+    unsigned i;
+
+    pa_tagstruct_putu32(t, idx);
+    pa_tagstruct_puts(t, "alsa_output.pci-0000_00_1b.0.analog-stereo");
+    pa_tagstruct_put_sample_spec(t, &ss);
+    pa_tagstruct_put_channel_map(t, &map);
+    pa_tagstruct_putu32(t, 0);
+    pa_tagstruct_put_cvolume(t, &volume);
+    pa_tagstruct_put_boolean(t, FALSE);
+    pa_tagstruct_putu32(t, idx + 1);
+    pa_tagstruct_puts(t, "alsa_output.pci-0000_00_1b.0.analog-stereo.monitor");
+    pa_tagstruct_put_usec(t, 25000);
+    pa_tagstruct_puts(t, "module-alsa-card.c");
+    pa_tagstruct_putu32(t, 0x1f);
+    pa_tagstruct_put_proplist(t, proplist);
+    pa_tagstruct_put_usec(t, 24000);
+    pa_tagstruct_put_volume(t, PA_VOLUME_NORM);
+    pa_tagstruct_putu32(t, 0);
+    pa_tagstruct_putu32(t, 65537);
+    pa_tagstruct_putu32(t, 0);
+
+    pa_tagstruct_putu32(t, N_PORTS);
+    for (i = 0; i < N_PORTS; i++) {
+        char name[32];
+
+        pa_snprintf(name, sizeof(name), "analog-output-port-%u", i);
+        pa_tagstruct_puts(t, name);
+        pa_tagstruct_puts(t, "Analog Output Port With A Description");
+        pa_tagstruct_putu32(t, i);
+    }
+    pa_tagstruct_puts(t, "analog-output-port-0");
+}
+
+static void get_sink_info(pa_tagstruct *t, uint32_t idx) {
+    uint32_t u;
+    const char *s;
+    pa_sample_spec rss;
+    pa_channel_map rmap;
+    pa_cvolume rvolume;
+    pa_bool_t b;
+    pa_usec_t usec;
+    pa_volume_t v;
+    pa_proplist *p;
+    unsigned i;
+
+    pa_assert_se(pa_tagstruct_getu32(t, &u) >= 0 && u == idx);
+    pa_assert_se(pa_tagstruct_gets(t, &s) >= 0 && s);
+    pa_assert_se(pa_tagstruct_get_sample_spec(t, &rss) >= 0 && pa_sample_spec_equal(&rss, &ss));
+    pa_assert_se(pa_tagstruct_get_channel_map(t, &rmap) >= 0 && pa_channel_map_equal(&rmap, &map));
+    pa_assert_se(pa_tagstruct_getu32(t, &u) >= 0);
+    pa_assert_se(pa_tagstruct_get_cvolume(t, &rvolume) >= 0 && pa_cvolume_equal(&rvolume, &volume));
+    pa_assert_se(pa_tagstruct_get_boolean(t, &b) >= 0 && !b);
+    pa_assert_se(pa_tagstruct_getu32(t, &u) >= 0 && u == idx + 1);
+    pa_assert_se(pa_tagstruct_gets(t, &s) >= 0);
+    pa_assert_se(pa_tagstruct_get_usec(t, &usec) >= 0 && usec == 25000);
+    pa_assert_se(pa_tagstruct_gets(t, &s) >= 0);
+    pa_assert_se(pa_tagstruct_getu32(t, &u) >= 0 && u == 0x1f);
+
+    p = pa_proplist_new();
+    pa_assert_se(pa_tagstruct_get_proplist(t, p) >= 0);
+    pa_assert_se(pa_proplist_equal(p, proplist));
+    pa_proplist_free(p);
+
+    pa_assert_se(pa_tagstruct_get_usec(t, &usec) >= 0 && usec == 24000);
+    pa_assert_se(pa_tagstruct_get_volume(t, &v) >= 0 && v == PA_VOLUME_NORM);
+    pa_assert_se(pa_tagstruct_getu32(t, &u) >= 0);
+    pa_assert_se(pa_tagstruct_getu32(t, &u) >= 0 && u == 65537);
+    pa_assert_se(pa_tagstruct_getu32(t, &u) >= 0);
+
+    pa_assert_se(pa_tagstruct_getu32(t, &u) >= 0 && u == N_PORTS);
+    for (i = 0; i < N_PORTS; i++) {
+        pa_assert_se(pa_tagstruct_gets(t, &s) >= 0);
+        pa_assert_se(pa_tagstruct_gets(t, &s) >= 0);
+        pa_assert_se(pa_tagstruct_getu32(t, &u) >= 0 && u == i);
+    }
+    pa_assert_se(pa_tagstruct_gets(t, &s) >= 0);
+}
+
+static void put_sink_input_info(pa_tagstruct *t, uint32_t idx) {
+    pa_tagstruct_putu32(t, idx);
+    pa_tagstruct_puts(t, "Playback Stream");
+    pa_tagstruct_putu32(t, PA_INVALID_INDEX);
+    pa_tagstruct_putu32(t, idx);
+    pa_tagstruct_putu32(t, 0);
+    pa_tagstruct_put_sample_spec(t, &ss);
+    pa_tagstruct_put_channel_map(t, &map);
+    pa_tagstruct_put_cvolume(t, &volume);
+    pa_tagstruct_put_usec(t, 12000);
+    pa_tagstruct_put_usec(t, 25000);
+    pa_tagstruct_puts(t, "speex-float-1");
+    pa_tagstruct_puts(t, NULL);
+    pa_tagstruct_put_proplist(t, proplist);
+    pa_tagstruct_put_boolean(t, FALSE);
+    pa_tagstruct_put_boolean(t, TRUE);
+    pa_tagstruct_put_boolean(t, TRUE);
+}
+
+static void get_sink_input_info(pa_tagstruct *t, uint32_t idx) {
+    uint32_t u;
+    const char *s;
+    pa_sample_spec rss;
+    pa_channel_map rmap;
+    pa_cvolume rvolume;
+    pa_usec_t usec;
+    pa_proplist *p;
+    pa_bool_t b;
+
+    pa_assert_se(pa_tagstruct_getu32(t, &u) >= 0 && u == idx);
+    pa_assert_se(pa_tagstruct_gets(t, &s) >= 0 && s);
+    pa_assert_se(pa_tagstruct_getu32(t, &u) >= 0 && u == PA_INVALID_INDEX);
+    pa_assert_se(pa_tagstruct_getu32(t, &u) >= 0 && u == idx);
+    pa_assert_se(pa_tagstruct_getu32(t, &u) >= 0);
+    pa_assert_se(pa_tagstruct_get_sample_spec(t, &rss) >= 0 && pa_sample_spec_equal(&rss, &ss));
+    pa_assert_se(pa_tagstruct_get_channel_map(t, &rmap) >= 0 && pa_channel_map_equal(&rmap, &map));
+    pa_assert_se(pa_tagstruct_get_cvolume(t, &rvolume) >= 0 && pa_cvolume_equal(&rvolume, &volume));
+    pa_assert_se(pa_tagstruct_get_usec(t, &usec) >= 0 && usec == 12000);
+    pa_assert_se(pa_tagstruct_get_usec(t, &usec) >= 0 && usec == 25000);
+    pa_assert_se(pa_tagstruct_gets(t, &s) >= 0 && s);
+    pa_assert_se(pa_tagstruct_gets(t, &s) >= 0 && !s);
+
+    p = pa_proplist_new();
+    pa_assert_se(pa_tagstruct_get_proplist(t, p) >= 0);
+    pa_assert_se(pa_proplist_equal(p, proplist));
+    pa_proplist_free(p);
+
+    pa_assert_se(pa_tagstruct_get_boolean(t, &b) >= 0 && !b);
+    pa_assert_se(pa_tagstruct_get_boolean(t, &b) >= 0 && b);
+    pa_assert_se(pa_tagstruct_get_boolean(t, &b) >= 0 && b);
+}
+
+static void run(const char *name, void (*put)(pa_tagstruct *t, uint32_t idx), void (*get)(pa_tagstruct *t, uint32_t idx)) {
+    pa_usec_t start, serialize;
+    unsigned allocs, reallocs, i;
+    size_t bytes = 0;
+
+    allocs = alloc_count_allocs();
+    reallocs = alloc_count_reallocs();
+    start = pa_rtclock_now();
+
+    /* The same path a reply takes: build the tagstruct, hand the
+     * buffer over to a packet, drop the packet once it is sent */
+    for (i = 0; i < N_RECORDS; i++) {
+        pa_tagstruct *t;
+        pa_packet *packet;
+        uint8_t *data;
+        size_t length;
+
+        t = pa_tagstruct_new(NULL, 0);
+        put(t, i);
+        data = pa_tagstruct_free_data(t, &length);
+        packet = pa_packet_new_dynamic(data, length);
+        bytes += packet->length;
+        pa_packet_unref(packet);
+    }
+
+    serialize = pa_rtclock_now() - start;
+
+    pa_log_info("%s: %lu bytes per record, %0.2f us, %0.2f allocations and %0.2f reallocations per record",
+                name,
+                (unsigned long) (bytes / N_RECORDS),
+                (double) serialize / N_RECORDS,
+                (double) (alloc_count_allocs() - allocs) / N_RECORDS,
+                (double) (alloc_count_reallocs() - reallocs) / N_RECORDS);
+
+    for (i = 0; i < 100; i++) {
+        pa_tagstruct *t, *r;
+        const uint8_t *data;
+        size_t length;
+
+        t = pa_tagstruct_new(NULL, 0);
+        put(t, i);
+        data = pa_tagstruct_data(t, &length);
+
+        r = pa_tagstruct_new(data, length);
+        get(r, i);
+        pa_assert_se(pa_tagstruct_eof(r));
+        pa_tagstruct_free(r);
+        pa_tagstruct_free(t);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    unsigned i;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    ss.format = PA_SAMPLE_S16LE;
+    ss.rate = 44100;
+    ss.channels = 2;
+    pa_channel_map_init_stereo(&map);
+    pa_cvolume_set(&volume, 2, PA_VOLUME_NORM);
+
+    proplist = pa_proplist_new();
+    for (i = 0; i < N_PROPS; i++) {
+        char key[32], value[64];
+
+        pa_snprintf(key, sizeof(key), "device.test.property%u", i);
+        pa_snprintf(value, sizeof(value), "A value for property number %u", i);
+        pa_proplist_sets(proplist, key, value);
+    }
+
+    run("sink info", put_sink_info, get_sink_info);
+    run("sink input info", put_sink_input_info, get_sink_input_info);
+
+    pa_proplist_free(proplist);
+
+    return 0;
+}
@@ -22,12 +22,324 @@
 #endif
 
 #include <stdio.h>
+#include <string.h>
 #include <math.h>
 
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
 #include <pulse/volume.h>
 
+#include <pulsecore/cpu-x86.h>
+#include <pulsecore/endianmacros.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/random.h>
+#include <pulsecore/sample-util.h>
+
+/* Applies software volume to every sample format, once with the C
+ * implementations and once with whatever the CPU has optimized ones for,
+ * checks that both agree and prints how long they took. Then checks that
+ * volume ramps hit the curve they are supposed to follow on every frame,
+ * also when applied in pieces and when rewound on the way. */
+
+#define VOLUME_FRAMES 4096
+#define VOLUME_ROUNDS 200
+
+#define RAMP_FRAMES 441
+#define RAMP_TAIL 100
+
+static double volume_time(pa_memchunk *c, const pa_sample_spec *ss, const pa_cvolume *v, const pa_memchunk *orig) {
+    pa_usec_t start, t = 0;
+    unsigned i;
+
+    for (i = 0; i < VOLUME_ROUNDS; i++) {
+        memcpy(pa_memblock_acquire(c->memblock), pa_memblock_acquire(orig->memblock), c->length);
+        pa_memblock_release(c->memblock);
+        pa_memblock_release(orig->memblock);
+
+        start = pa_rtclock_now();
+        pa_volume_memchunk(c, ss, v);
+        t += pa_rtclock_now() - start;
+    }
+
+    return (double) t / VOLUME_ROUNDS;
+}
+
+static void volume_funcs_run(void) {
+    pa_do_volume_func_t c_funcs[PA_SAMPLE_MAX], opt_funcs[PA_SAMPLE_MAX];
+    pa_cpu_x86_flag_t flags = 0;
+    pa_mempool *pool;
+    pa_sample_format_t f;
+    unsigned k;
+
+    static const struct {
+        unsigned channels;
+        pa_volume_t values[6];
+    } volumes[] = {
+        { 2, { PA_VOLUME_NORM / 3, PA_VOLUME_NORM / 3 } },
+        { 2, { PA_VOLUME_NORM, PA_VOLUME_NORM / 2 } },
+        { 6, { 1000, 20000, 40000, 60000, PA_VOLUME_NORM, 5 } },
+        { 2, { PA_VOLUME_NORM * 3 / 2, PA_VOLUME_NORM / 2 } },
+    };
+
+    for (f = 0; f < PA_SAMPLE_MAX; f++)
+        c_funcs[f] = pa_get_volume_func(f);
+
+    pa_cpu_init_x86(&flags);
+
+    for (f = 0; f < PA_SAMPLE_MAX; f++)
+        opt_funcs[f] = pa_get_volume_func(f);
+
+    pa_assert_se(pool = pa_mempool_new(FALSE, 0));
+
+    for (f = 0; f < PA_SAMPLE_MAX; f++)
+        for (k = 0; k < PA_ELEMENTSOF(volumes); k++) {
+            pa_sample_spec ss;
+            pa_cvolume v;
+            pa_memchunk orig, c_chunk, opt_chunk;
+            double t_c, t_opt;
+            void *d;
+            unsigned i;
+
+            ss.format = f;
+            ss.rate = 44100;
+            ss.channels = (uint8_t) volumes[k].channels;
+
+            v.channels = ss.channels;
+            memcpy(v.values, volumes[k].values, sizeof(pa_volume_t) * v.channels);
+
+            orig.index = c_chunk.index = opt_chunk.index = 0;
+            orig.length = c_chunk.length = opt_chunk.length = pa_frame_size(&ss) * VOLUME_FRAMES;
+            orig.memblock = pa_memblock_new(pool, orig.length);
+            c_chunk.memblock = pa_memblock_new(pool, orig.length);
+            opt_chunk.memblock = pa_memblock_new(pool, orig.length);
+
+            d = pa_memblock_acquire(orig.memblock);
+            pa_random(d, orig.length);
+
+            /* Random bits make bad floats */
+            if (f == PA_SAMPLE_FLOAT32NE || f == PA_SAMPLE_FLOAT32RE)
+                for (i = 0; i < orig.length / sizeof(float); i++) {
+                    float x = (float) ((int16_t *) d)[2 * i] / 0x8000;
+
+                    ((float *) d)[i] = f == PA_SAMPLE_FLOAT32NE ? x : PA_FLOAT32_SWAP(x);
+                }
+
+            pa_memblock_release(orig.memblock);
+
+            pa_set_volume_func(f, c_funcs[f]);
+            t_c = volume_time(&c_chunk, &ss, &v, &orig);
+
+            pa_set_volume_func(f, opt_funcs[f]);
+            t_opt = volume_time(&opt_chunk, &ss, &v, &orig);
+
+            pa_assert_se(memcmp(pa_memblock_acquire(c_chunk.memblock), pa_memblock_acquire(opt_chunk.memblock), orig.length) == 0);
+            pa_memblock_release(c_chunk.memblock);
+            pa_memblock_release(opt_chunk.memblock);
+
+            pa_log_info("%-10s %u channels, volume %5u/%5u: C %8.3f us, optimized %8.3f us per %u frames",
+                        pa_sample_format_to_string(f), ss.channels, v.values[0], v.values[1],
+                        t_c, t_opt, VOLUME_FRAMES);
+
+            pa_memblock_unref(orig.memblock);
+            pa_memblock_unref(c_chunk.memblock);
+            pa_memblock_unref(opt_chunk.memblock);
+        }
+
+    pa_mempool_free(pool);
+}
+
+/* What the factor should be pos frames into the ramp */
+static double ramp_expected(pa_volume_ramp_type_t type, pa_volume_t s, pa_volume_t e, size_t pos) {
+    double t = PA_MIN((double) pos / RAMP_FRAMES, 1.0);
+
+    if (type == PA_VOLUME_RAMP_CUBIC) {
+        double v = ((double) s + ((double) e - (double) s) * t) / PA_VOLUME_NORM;
+
+        return v * v * v;
+    }
+
+    return pa_sw_volume_to_linear(s) + (pa_sw_volume_to_linear(e) - pa_sw_volume_to_linear(s)) * t;
+}
+
+static void volume_ramp_run(void) {
+    static const pa_sample_format_t formats[] = { PA_SAMPLE_S16NE, PA_SAMPLE_FLOAT32NE };
+    static const size_t pieces[] = { 1, 7, 64, 100, 333 };
+    pa_mempool *pool;
+    pa_cvolume start, end;
+    unsigned f, type;
+
+    pa_assert_se(pool = pa_mempool_new(FALSE, 0));
+
+    start.channels = end.channels = 2;
+    start.values[0] = PA_VOLUME_NORM;
+    start.values[1] = PA_VOLUME_NORM / 2;
+    end.values[0] = PA_VOLUME_MUTED;
+    end.values[1] = PA_VOLUME_NORM * 3 / 4;
+
+    for (f = 0; f < PA_ELEMENTSOF(formats); f++)
+        for (type = PA_VOLUME_RAMP_LINEAR; type <= PA_VOLUME_RAMP_CUBIC; type++) {
+            pa_sample_spec ss;
+            pa_volume_ramp r;
+            pa_memchunk c;
+            pa_cvolume v;
+            size_t pos = 0, k = 0, i;
+            double max_error = 0;
+            void *d;
+
+            ss.format = formats[f];
+            ss.rate = 44100;
+            ss.channels = 2;
+
+            c.index = 0;
+            c.length = pa_frame_size(&ss) * (RAMP_FRAMES + RAMP_TAIL);
+            c.memblock = pa_memblock_new(pool, c.length);
+
+            /* A constant signal, so that what comes out is the factor */
+            d = pa_memblock_acquire(c.memblock);
+            for (i = 0; i < (RAMP_FRAMES + RAMP_TAIL) * 2; i++)
+                if (ss.format == PA_SAMPLE_S16NE)
+                    ((int16_t*) d)[i] = 0x4000;
+                else
+                    ((float*) d)[i] = 0.5f;
+            pa_memblock_release(c.memblock);
+
+            pa_volume_ramp_init(&r, type, &start, &end, RAMP_FRAMES);
+
+            while (pos < RAMP_FRAMES + RAMP_TAIL) {
+                pa_memchunk piece = c;
+
+                piece.index = pos * pa_frame_size(&ss);
+                piece.length = PA_MIN(pieces[k++ % PA_ELEMENTSOF(pieces)], RAMP_FRAMES + RAMP_TAIL - pos) * pa_frame_size(&ss);
+
+                pa_volume_ramp_memchunk(&piece, &ss, &r);
+                pos += piece.length / pa_frame_size(&ss);
+
+                /* Where the ramp says it is has to match the curve too */
+                if (pos < RAMP_FRAMES) {
+                    pa_volume_ramp_get(&r, &v);
+                    pa_assert_se(fabs(pa_sw_volume_to_linear(v.values[1]) - ramp_expected(type, start.values[1], end.values[1], pos)) < 1e-4);
+                }
+            }
+
+            pa_assert_se(r.left == 0);
+            pa_assert_se(pa_cvolume_equal(pa_volume_ramp_get(&r, &v), &end));
+
+            d = pa_memblock_acquire(c.memblock);
+            for (pos = 0; pos < RAMP_FRAMES + RAMP_TAIL; pos++) {
+                unsigned channel;
+
+                for (channel = 0; channel < 2; channel++) {
+                    double got, error;
+
+                    if (ss.format == PA_SAMPLE_S16NE)
+                        got = (double) ((int16_t*) d)[pos * 2 + channel] / 0x4000;
+                    else
+                        got = (double) ((float*) d)[pos * 2 + channel] / 0.5;
+
+                    error = fabs(got - ramp_expected(type, start.values[channel], end.values[channel], pos));
+                    max_error = PA_MAX(max_error, error);
+                }
+            }
+            pa_memblock_release(c.memblock);
+
+            pa_log_info("%-10s %-6s ramp over %u frames: max error %g",
+                        pa_sample_format_to_string(ss.format), pa_volume_ramp_type_to_string(type),
+                        RAMP_FRAMES, max_error);
+
+            /* One step of the 16 bit samples, or what floats can do */
+            pa_assert_se(max_error <= (ss.format == PA_SAMPLE_S16NE ? 1.5 / 0x4000 : 1e-5));
+
+            pa_memblock_unref(c.memblock);
+        }
+
+    pa_mempool_free(pool);
+}
+
+/* Renders the ramp like a sink input whose sink is rewound now and then:
+ * every rewind goes back over frames that were already rendered and
+ * renders them once more, which has to give the same result */
+static void volume_ramp_rewind_run(void) {
+    static const struct {
+        size_t render, rewind;
+    } steps[] = {
+        { 100, 30 },                            /* in the middle */
+        { 200, 150 },                           /* back to before a previous rewind */
+        { RAMP_FRAMES, 60 },                    /* from past the end back into it */
+        { RAMP_TAIL, 20 },                      /* within the tail */
+        { 0, 2 * (RAMP_FRAMES + RAMP_TAIL) },   /* beyond the start */
+        { RAMP_FRAMES + RAMP_TAIL, 0 }
+    };
+    pa_mempool *pool;
+    pa_sample_spec ss;
+    pa_cvolume start, end, v;
+    pa_memchunk c;
+    unsigned type;
+
+    pa_assert_se(pool = pa_mempool_new(FALSE, 0));
+
+    ss.format = PA_SAMPLE_FLOAT32NE;
+    ss.rate = 44100;
+    ss.channels = 2;
+
+    start.channels = end.channels = 2;
+    start.values[0] = start.values[1] = PA_VOLUME_NORM / 4;
+    end.values[0] = end.values[1] = PA_VOLUME_NORM;
+
+    c.index = 0;
+    c.length = pa_frame_size(&ss) * (RAMP_FRAMES + RAMP_TAIL);
+    c.memblock = pa_memblock_new(pool, c.length);
+
+    for (type = PA_VOLUME_RAMP_LINEAR; type <= PA_VOLUME_RAMP_CUBIC; type++) {
+        pa_volume_ramp r;
+        size_t pos = 0, i, k;
+        float *d;
+
+        pa_volume_ramp_init(&r, type, &start, &end, RAMP_FRAMES);
+
+        for (k = 0; k < PA_ELEMENTSOF(steps); k++) {
+            pa_memchunk piece = c;
+            size_t n = PA_MIN(steps[k].render, RAMP_FRAMES + RAMP_TAIL - pos);
+
+            /* What was rendered before goes away on a rewind, so this
+             * starts over from the original signal */
+            d = pa_memblock_acquire(c.memblock);
+            for (i = pos * 2; i < (pos + n) * 2; i++)
+                d[i] = 0.5f;
+            pa_memblock_release(c.memblock);
+
+            piece.index = pos * pa_frame_size(&ss);
+            piece.length = n * pa_frame_size(&ss);
+            if (n > 0)
+                pa_volume_ramp_memchunk(&piece, &ss, &r);
+            pos += n;
+
+            pa_volume_ramp_rewind(&r, steps[k].rewind);
+            pos -= PA_MIN(steps[k].rewind, pos);
+
+            pa_assert_se(r.left == RAMP_FRAMES - PA_MIN(pos, RAMP_FRAMES));
+        }
+
+        pa_assert_se(pos == RAMP_FRAMES + RAMP_TAIL);
+        pa_assert_se(pa_cvolume_equal(pa_volume_ramp_get(&r, &v), &end));
+
+        /* Going back to the start restores the start volume */
+        pa_volume_ramp_rewind(&r, RAMP_FRAMES + RAMP_TAIL);
+        pa_assert_se(r.left == RAMP_FRAMES);
+        pa_assert_se(pa_cvolume_equal(pa_volume_ramp_get(&r, &v), &start));
+
+        d = pa_memblock_acquire(c.memblock);
+        for (pos = 0; pos < RAMP_FRAMES + RAMP_TAIL; pos++)
+            pa_assert_se(fabs((double) d[pos * 2] / 0.5 - ramp_expected(type, start.values[0], end.values[0], pos)) <= 1e-5);
+        pa_memblock_release(c.memblock);
+
+        pa_log_info("%-6s ramp over %u frames rewound %u times", pa_volume_ramp_type_to_string(type), RAMP_FRAMES, (unsigned) PA_ELEMENTSOF(steps) - 1);
+    }
+
+    pa_memblock_unref(c.memblock);
+    pa_mempool_free(pool);
+}
 
 int main(int argc, char *argv[]) {
     pa_volume_t v;
@@ -130,5 +442,9 @@ int main(int argc, char *argv[]) {
     pa_assert(md <= 1);
     pa_assert(mdn <= 251);
 
+    volume_funcs_run();
+    volume_ramp_run();
+    volume_ramp_rewind_run();
+
     return 0;
 }